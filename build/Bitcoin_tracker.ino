@@ -1,58 +1,918 @@
 #include <WiFi.h>
 #include <HTTPClient.h>
-#include <ArduinoJson.h>
+#include <WiFiClientSecure.h>
+#include <esp_heap_caps.h>
+#include <time.h>
+#include <algorithm>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/uart.h>
+#include "tracker_config.h"
+#include "frame.h"
+#include "fetch.h"
+#include "archive.h"
+#include "selftest.h"
+#include "flow.h"
+#include "metrics.h"
+#include "plan.h"
 
 const char* ssid = "ssid";
 const char* password = "password";
 
-void fetchAndSendBTCData() {
+// Power management between polls (CFG_POWER_MODE in tracker_config.cfg)
+#define POWER_AWAKE       0
+#define POWER_LIGHT_SLEEP 1
+#define POWER_DEEP_SLEEP  2
+#define RTC_STATE_MAGIC   0x42544331UL
+#define UART_TX_PIN       GPIO_NUM_1  // U0TXD, the line to the TM4C
+#define SELFTEST_PIN      0           // BOOT button: pressed and released, runs the link self-test
+#define FLOW_CTS_PIN      19          // CFG_UART_FLOW = FLOW_RTSCTS: from the TM4C's U1RTS (PC4)...
+#define FLOW_RTS_PIN      22          // ...and to its U1CTS (PC5)
+#define NOTIFY_OFF        0           // CFG_ALARM_NOTIFY: where alarm transitions are forwarded
+#define NOTIFY_WEBHOOK    1
+#define NOTIFY_MQTT       2
+#define NOTIFY_RECENT     4           // Forwarded transitions remembered to answer resends
+
+// Kept in RTC memory across deep sleep so a wake-up can skip the slow parts of boot.
+// (WiFiClientSecure has no API to export the TLS session, so each cycle does a full handshake.)
+struct RetainedState {
+  uint32_t magic;
+  uint32_t cycle;                     // Poll cycles since power-on
+  int32_t channel;                    // Channel and BSSID of the last association
+  uint8_t bssid[6];
+  uint32_t ip, gateway, subnet, dns;  // Last DHCP lease, reused as a static configuration
+  float lastPrice, lastChange;        // Last values sent to the TM4C
+  bool backfillSent;
+  uint32_t reconnects;                // Wi-Fi connections lost (not switched off by us)
+  uint32_t fetches, failures;         // Price fetches since power-on, and how many failed
+};
+RTC_DATA_ATTR RetainedState rtcState;
+
+static unsigned long wakeAt = 0;       // millis() at the start of this cycle (0 after a deep-sleep boot)
+static unsigned long radioOnAt = 0;    // millis() when Wi-Fi was started
+static unsigned long frameSentAt = 0;  // millis() when the price frame left the UART
+static FrameTelemetry telemetry;       // Timings and outcome of the last fetch (see sendTelemetry)
+static bool wifiUp = false;            // Associated and holding an address
+static bool radioOff = false;          // Wi-Fi switched off on purpose before a sleep
+
+// Downsampled long-term history answering the TM4C's window queries ($Q -> $W).
+// Plain RAM: it survives light sleep but starts over after every deep-sleep cycle.
+static ArchiveBucket archiveStore[ARCHIVE_BUCKETS];
+static Archive archive;
+static char queryLine[CFG_UART_BUFFER_SIZE];
+static size_t queryLen = 0;
+static FrameTestResult selfTestResult;  // Verdict of the last link self-test, as sent back by the TM4C
+static bool selfTestValid = false;
+
+// Alarm transitions already forwarded, with the ack sent for each: a resend from the TM4C
+// (its ack was lost on the wire) is acked again without notifying the endpoint twice.
+struct ForwardedAlarm {
+  FrameAlarm alarm;
+  FrameAlarmAck ack;
+};
+static ForwardedAlarm recentAlarms[NOTIFY_RECENT];
+static uint8_t recentCount = 0, recentNext = 0;
+
+// Rate-budget fetch planner (plan.h), awake mode only: the [assets] are fetched from
+// CFG_PROTO_SIMPLE_URL in multi-id requests within the [plan] budget, the most urgent first.
+// The line to the TM4C carries the BTC slot; the sleep modes keep the fixed poll of one asset.
+static Plan plan;
+static PlanAsset planAssets[CFG_ASSET_COUNT];
+static uint16_t planOrder[CFG_ASSET_COUNT];
+static PlanBatch planBatch;
+static uint32_t planStart;               // millis() when the plan was set up
+
+// Metrics registry (metrics.h). Fetch, failure and reconnect totals are the rtcState words,
+// so they survive deep sleep; everything else starts over with the RAM.
+static const uint32_t fetchBucketsMs[] = { 100, 250, 500, 1000, 2000, 5000, 10000 };
+static const uint32_t queryBucketsUs[] = { 50, 100, 200, 500, 1000, 2000 };
+static uint32_t failByPhase[6];         // Failed fetches per FRAME_FAIL_* phase
+static uint32_t fetchBytes;             // Response body bytes of the price fetches
+static uint32_t linesSent;              // Price lines sent to the TM4C
+static uint32_t queriesAnswered;        // '$Q' window queries answered
+static uint32_t notifyDelivered, notifyFailed;  // Alarm transitions forwarded / given up
+static int32_t heapFree, heapBlock, rssi, uptime;  // Sampled just before an export
+static int32_t incCycles, observeCycles;  // Cost of a metric update, measured at boot
+static int32_t planAgeMean, planAgeMax, planBudget;  // Planner freshness and budget use, sampled too
+static MetricHist fetchMs = { fetchBucketsMs, 7 };   // DNS to end of body
+static MetricHist ttfbMs = { fetchBucketsMs, 7 };    // Request sent to first byte of the answer
+static MetricHist queryUs = { queryBucketsUs, 6 };   // '$Q' parsed to '$W' built
+static const MetricDesc metrics[] = {
+  { "fetch", "tracker_fetches_total", "Price fetches since power-on", METRIC_COUNTER, &rtcState.fetches },
+  { "fail", "tracker_fetch_failures_total", "Failed price fetches since power-on", METRIC_COUNTER, &rtcState.failures },
+  { "f_wifi", "tracker_fetch_phase_failures_total{phase=\"wifi\"}", "Failed price fetches by the phase that failed", METRIC_COUNTER, &failByPhase[FRAME_FAIL_WIFI] },
+  { "f_dns", "tracker_fetch_phase_failures_total{phase=\"dns\"}", "", METRIC_COUNTER, &failByPhase[FRAME_FAIL_DNS] },
+  { "f_tls", "tracker_fetch_phase_failures_total{phase=\"tls\"}", "", METRIC_COUNTER, &failByPhase[FRAME_FAIL_TLS] },
+  { "f_http", "tracker_fetch_phase_failures_total{phase=\"http\"}", "", METRIC_COUNTER, &failByPhase[FRAME_FAIL_HTTP] },
+  { "f_api", "tracker_fetch_phase_failures_total{phase=\"api\"}", "", METRIC_COUNTER, &failByPhase[FRAME_FAIL_API] },
+  { "bytes", "tracker_fetch_bytes_total", "Response body bytes of the price fetches", METRIC_COUNTER, &fetchBytes },
+  { "lines", "tracker_lines_sent_total", "Price lines sent to the TM4C", METRIC_COUNTER, &linesSent },
+  { "query", "tracker_queries_total", "Window queries answered", METRIC_COUNTER, &queriesAnswered },
+  { "n_ok", "tracker_notifications_total{outcome=\"delivered\"}", "Alarm transitions forwarded to the endpoint", METRIC_COUNTER, &notifyDelivered },
+  { "n_fail", "tracker_notifications_total{outcome=\"failed\"}", "", METRIC_COUNTER, &notifyFailed },
+  { "reconn", "tracker_wifi_reconnects_total", "Wi-Fi connections lost", METRIC_COUNTER, &rtcState.reconnects },
+  { "rssi", "tracker_wifi_rssi_dbm", "Wi-Fi signal strength (0: not associated)", METRIC_GAUGE, &rssi },
+  { "heap", "tracker_heap_free_bytes", "Free heap", METRIC_GAUGE, &heapFree },
+  { "block", "tracker_heap_largest_block_bytes", "Largest free heap block", METRIC_GAUGE, &heapBlock },
+  { "up", "tracker_uptime_seconds", "Time since boot (deep sleep restarts it)", METRIC_GAUGE, &uptime },
+  { "link", "tracker_link_bytes_per_second", "Best error-free payload rate of the last link self-test", METRIC_GAUGE, &selfTestResult.best_bps },
+  { "age", "tracker_plan_age_ms{stat=\"mean\"}", "Price age of the planned assets (mean of the time-weighted means, longest gap)", METRIC_GAUGE, &planAgeMean },
+  { "age_max", "tracker_plan_age_ms{stat=\"max\"}", "", METRIC_GAUGE, &planAgeMax },
+  { "budget", "tracker_plan_budget_used_percent", "Share of the provider's request limit used", METRIC_GAUGE, &planBudget },
+  { "429", "tracker_plan_throttled_total", "Requests the provider answered with 429", METRIC_COUNTER, &plan.provider[0].throttled },
+  { "c_inc", "tracker_metric_update_cycles{op=\"inc\"}", "CPU cycles per metric update, measured at boot", METRIC_GAUGE, &incCycles },
+  { "c_obs", "tracker_metric_update_cycles{op=\"observe\"}", "", METRIC_GAUGE, &observeCycles },
+  { "fetch_ms", "tracker_fetch_duration_ms", "Price fetch time from DNS lookup to the end of the body", METRIC_HIST, &fetchMs },
+  { "ttfb_ms", "tracker_fetch_ttfb_ms", "Price fetch time from request to first response byte", METRIC_HIST, &ttfbMs },
+  { "query_us", "tracker_query_service_us", "Window query service time", METRIC_HIST, &queryUs },
+};
+#define METRIC_COUNT (sizeof(metrics) / sizeof(metrics[0]))
+static WiFiServer metricsServer(CFG_METRICS_HTTP_PORT);
+static unsigned long metricsDumpAt = 0;  // millis() of the last compact dump
+
+// Hold the TX line low for CFG_UART_BREAK_US before a line to the TM4C. The break reads as
+// a flagged character there and marks the start of a frame, so a receiver that lost sync
+// in the middle of a line recovers at once instead of at the next newline.
+static void sendBreak() {
+  if (CFG_UART_BREAK_US == 0) return;
+  Serial.flush();  // The break must not cut into the previous line
+  uart_set_line_inverse(UART_NUM_0, UART_SIGNAL_TXD_INV);
+  delayMicroseconds(CFG_UART_BREAK_US);
+  uart_set_line_inverse(UART_NUM_0, UART_SIGNAL_INV_DISABLE);
+  delayMicroseconds(20);  // A couple of bit times idle (stop level) before the start bit
+}
+
+// Host name of an https URL ("https://api.example.com/path" -> "api.example.com").
+static String urlHost(const char *url) {
+  String u(url);
+  int start = u.indexOf("://");
+  start = start < 0 ? 0 : start + 3;
+  int end = u.indexOf('/', start);
+  return u.substring(start, end < 0 ? u.length() : end);
+}
+
+// Send a telemetry frame after every failed fetch and every CFG_TELEMETRY_EVERY_POLLS-th good
+// one. It always follows the price line, so it never holds a price back on the wire.
+static void sendTelemetry(bool failed) {
+  if (!failed && rtcState.fetches % CFG_TELEMETRY_EVERY_POLLS != 0) return;
+  telemetry.uptime_s = millis() / 1000;
+  telemetry.rssi = WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0;
+  telemetry.reconnects = rtcState.reconnects;
+  telemetry.heap_free = ESP.getFreeHeap();
+  telemetry.heap_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  telemetry.fetches = rtcState.fetches;
+  telemetry.failures = rtcState.failures;
+  char frame[CFG_UART_BUFFER_SIZE + 1];
+  if (Frame_Encode_Telemetry(frame, sizeof(frame), &telemetry)) {
+    sendBreak();
+    Serial.print(frame);
+    Serial.print('\n');
+  }
+}
+
+// Fetch 'url' from 'host' into 'payload'. The phases are run one by one so each can be
+// timed for the telemetry frame: DNS lookup, then TCP connect + TLS handshake on our own
+// client (the second lookup inside connect() is answered from the lwIP cache), then the
+// request, which HTTPClient sends over the connection already open. Returns true with
+// telemetry.fail at FRAME_FAIL_API (parsing is up to the caller); 'retryMs' gets the
+// Retry-After time of a 429.
+static bool fetchBody(const String &host, const char *url, String &payload, uint32_t &retryMs) {
+  static const char *headers[] = { "Retry-After" };
+  WiFiClientSecure client;
   HTTPClient http;
-  http.begin("https://api.coingecko.com/api/v3/coins/bitcoin?localization=false&tickers=false&market_data=true");
-  int httpCode = http.GET();
+  IPAddress ip;
+  unsigned long t;
+  bool ok = false;
+
+  retryMs = 0;
+  telemetry.http_status = 0;
+  telemetry.dns_ms = telemetry.connect_ms = telemetry.ttfb_ms = telemetry.body_ms = 0;
+  telemetry.fail = FRAME_FAIL_WIFI;
+  if (WiFi.status() == WL_CONNECTED) {
+    t = millis();
+    telemetry.fail = FRAME_FAIL_DNS;
+    if (WiFi.hostByName(host.c_str(), ip)) {
+      telemetry.dns_ms = millis() - t;
+      client.setInsecure();  // No CA pinned, as HTTPClient does for a bare https URL
+      t = millis();
+      telemetry.fail = FRAME_FAIL_TLS;
+      if (client.connect(host.c_str(), 443)) {
+        telemetry.connect_ms = millis() - t;
+        http.begin(client, url);
+        http.collectHeaders(headers, 1);
+        t = millis();
+        int httpCode = http.GET();
+        telemetry.ttfb_ms = millis() - t;
+        telemetry.http_status = httpCode;
+        telemetry.fail = FRAME_FAIL_HTTP;
+        if (httpCode == 200) {
+          t = millis();
+          payload = http.getString();
+          telemetry.body_ms = millis() - t;
+          Metric_Add(&fetchBytes, payload.length());
+          telemetry.fail = FRAME_FAIL_API;
+          ok = true;
+        } else {
+          if (httpCode == 429) retryMs = (uint32_t)http.header("Retry-After").toInt() * 1000U;
+          Serial.printf("HTTP error: %d\n", httpCode);
+        }
+        http.end();
+      }
+    }
+  }
+  return ok;
+}
+
+// Send a price line to the TM4C and add the price to the archive.
+static void sendPrice(double price, double change) {
+  // Stamp the tick with Unix time so the TM4C can keep it in its flash history (0 = clock not set yet).
+  time_t now = time(nullptr);
+  unsigned long stamp = (now > 1600000000) ? (unsigned long)now : 0;
 
-  if (httpCode == 200) {
-    String payload = http.getString();
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, payload);
+  char message[128];
+  Fetch_Format_Price(message, sizeof(message), price, change, stamp);
+  sendBreak();
+  Serial.print(message);
+  Serial.flush();
+  frameSentAt = millis();
+  Metric_Inc(&linesSent);
+  Archive_Add(&archive, stamp, (int32_t)lround(price * 100.0));
+  rtcState.lastPrice = price;
+  rtcState.lastChange = change;
+}
+
+// Count the outcome of a fetch and send the telemetry frame.
+static void fetchDone() {
+  if (telemetry.fail != FRAME_FAIL_NONE) {
+    rtcState.failures++;
+    Metric_Inc(&failByPhase[telemetry.fail]);
+  }
+  if (telemetry.http_status > 0) {  // The request got an answer
+    Metric_Observe(&ttfbMs, telemetry.ttfb_ms);
+    if (telemetry.fail == FRAME_FAIL_NONE)
+      Metric_Observe(&fetchMs, telemetry.dns_ms + telemetry.connect_ms + telemetry.ttfb_ms + telemetry.body_ms);
+  }
+  sendTelemetry(telemetry.fail != FRAME_FAIL_NONE);
+}
 
-    if (!error) {
-      float price = doc["market_data"]["current_price"]["usd"];
-      float change = doc["market_data"]["price_change_percentage_24h"];
+// Fetch the price and send it to the TM4C.
+void fetchAndSendBTCData() {
+  static const String host = urlHost(CFG_PROTO_PRICE_URL);
+  String payload;
+  uint32_t retryMs;
+  double price, change;
 
-      char message[128];
-      snprintf(message, sizeof(message), "BTC Price: $%.2f, 24h Change: %.2f%%\n", price, change);
-      Serial.print(message);
+  rtcState.fetches++;
+  if (fetchBody(host, CFG_PROTO_PRICE_URL, payload, retryMs)) {
+    // Same extraction and line format as the Linux feeder (fetch.c)
+    if (Fetch_Parse_Coin(payload.c_str(), payload.length(), &price, &change)) {
+      sendPrice(price, change);
+      telemetry.fail = FRAME_FAIL_NONE;
     } else {
       Serial.println("JSON parsing error.");
     }
-  } else {
+  }
+  fetchDone();
+}
+
+// Set up the planner: one provider with the [plan] budget, all [assets] on it. Only BTC has
+// a threshold (the TM4C's default; its own selection is not sent over the link). The shortest
+// refresh is the poll interval, so with the single BTC asset the fetches come as before.
+static void planSetup() {
+  static const PlanPolicy policy = { CFG_PLAN_VOL_WEIGHT, CFG_PLAN_NEAR_WEIGHT, CFG_PLAN_NEAR_PCT, CFG_POLL_INTERVAL_MS };
+  planStart = millis();
+  Plan_Init(&plan, planAssets, planOrder, CFG_ASSET_COUNT, &policy, planStart);
+  Plan_Provider(&plan, CFG_PLAN_LIMIT, CFG_PLAN_WINDOW_S * 1000U, CFG_PLAN_MAX_IDS, 0, CFG_PLAN_PCT, planStart);
+  for (uint16_t i = 0; i < CFG_ASSET_COUNT; i++) planAssets[i].providers = 1;
+  planAssets[CFG_ASSET_BTC].threshold = (float)cfg_thresholds[CFG_THRESHOLD_DEFAULT];
+}
+
+// Send the planner's next batch, if the budget allows one and an asset is due. Every asset
+// in the answer refreshes the plan, and the BTC slot becomes the price line.
+static void fetchPlanned() {
+  static const String host = urlHost(CFG_PROTO_SIMPLE_URL);
+  String url(CFG_PROTO_SIMPLE_URL), payload;
+  uint32_t retryMs;
+
+  if (!Plan_Next(&plan, millis(), &planBatch)) return;
+  for (uint16_t i = 0; i < planBatch.n; i++) {
+    if (i) url += ',';
+    url += cfg_assets[planBatch.asset[i]].api_id;
+  }
+  rtcState.fetches++;
+  bool ok = fetchBody(host, url.c_str(), payload, retryMs);
+  uint32_t now = millis();
+  for (uint16_t i = 0; i < planBatch.n; i++) {
+    uint16_t slot = planBatch.asset[i];
+    double price, change;
+    if (!ok || !Fetch_Parse_Simple(payload.c_str(), payload.length(), cfg_assets[slot].api_id, &price, &change)) {
+      Plan_Failed(&plan, slot);
+      continue;
+    }
+    Plan_Update(&plan, slot, (float)price, now);
+    if (slot == CFG_ASSET_BTC) sendPrice(price, change);
+    telemetry.fail = FRAME_FAIL_NONE;  // At least one asset came through
+  }
+  if (ok && telemetry.fail != FRAME_FAIL_NONE) Serial.println("JSON parsing error.");
+  Plan_Answered(&plan, &planBatch, telemetry.http_status, retryMs, now);
+  fetchDone();
+}
+
+// Read the next character of a streamed response body, or -1 on timeout / closed connection.
+static int streamRead(WiFiClient &s, unsigned long deadline) {
+  while (!s.available()) {
+    if (!s.connected() || (long)(millis() - deadline) > 0) return -1;
+    delay(1);
+  }
+  return s.read();
+}
+
+// Read one JSON number; returns the character that ended it, or -1 if there was none.
+static int streamNumber(WiFiClient &s, unsigned long deadline, double &out) {
+  char num[24];
+  int len = 0;
+  int c = streamRead(s, deadline);
+  while (c == ' ') c = streamRead(s, deadline);
+  while (c >= 0 && (isdigit(c) || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E')) {
+    if (len < (int)sizeof(num) - 1) num[len++] = (char)c;
+    c = streamRead(s, deadline);
+  }
+  num[len] = '\0';
+  out = strtod(num, nullptr);
+  return len ? c : -1;
+}
+
+// Parse the "prices":[[ms,price],...] array of a market_chart response straight off the
+// socket, without buffering the body. Keeps the newest maxPts points, oldest first.
+static int readPriceSeries(WiFiClient &s, uint32_t *t, int32_t *p, int maxPts, unsigned long deadline) {
+  static const char key[] = "\"prices\":[";
+  int matched = 0, total = 0, c;
+
+  while (key[matched]) {
+    c = streamRead(s, deadline);
+    if (c < 0) return 0;
+    matched = (c == key[matched]) ? matched + 1 : (c == key[0] ? 1 : 0);
+  }
+  for (;;) {
+    double ms, price;
+    do { c = streamRead(s, deadline); } while (c == ',' || c == ' ');
+    if (c != '[') break;  // ']' closes the array
+    if (streamNumber(s, deadline, ms) != ',' || streamNumber(s, deadline, price) != ']') return 0;
+    t[total % maxPts] = (uint32_t)(ms / 1000.0);
+    p[total % maxPts] = (int32_t)lround(price);
+    total++;
+  }
+  if (total > maxPts) {  // The arrays were used as a ring: rotate the oldest point to the front
+    std::rotate(t, t + total % maxPts, t + maxPts);
+    std::rotate(p, p + total % maxPts, p + maxPts);
+    total = maxPts;
+  }
+  return total;
+}
+
+// Encode the series as '$B' frames; sends them when 'send' is true. Returns the frame count.
+static uint16_t encodeBackfill(const int32_t *p, int n, uint32_t t0, uint16_t dt, uint16_t total, bool send) {
+  char frame[CFG_UART_BUFFER_SIZE + 1];
+  FrameBackfill hdr;
+  uint16_t seq = 0;
+  for (int off = 0; off < n; off += hdr.n, seq++) {
+    hdr.seq = seq;
+    hdr.total = total;
+    hdr.t0 = t0 + (uint32_t)off * dt;
+    hdr.dt = dt;
+    if (Frame_Encode_Backfill(frame, sizeof(frame), &hdr, p + off, (uint16_t)(n - off)) == 0) return 0;
+    if (send) {
+      sendBreak();
+      Serial.print(frame);
+      Serial.print('\n');
+    }
+  }
+  return seq;
+}
+
+// Fetch the recent price series once and hand it to the TM4C so its history is warm at boot.
+void sendHistoryBackfill() {
+  static uint32_t times[CFG_BACKFILL_MAX_POINTS];
+  static int32_t prices[CFG_BACKFILL_MAX_POINTS];
+
+  HTTPClient http;
+  http.useHTTP10(true);  // No chunked encoding, so the stream is the raw JSON body
+  http.begin(String(CFG_PROTO_CHART_URL) + CFG_BACKFILL_DAYS);
+  int httpCode = http.GET();
+  if (httpCode != 200) {
     Serial.printf("HTTP error: %d\n", httpCode);
+    http.end();
+    return;
   }
+  int n = readPriceSeries(http.getStream(), times, prices, CFG_BACKFILL_MAX_POINTS,
+                          millis() + CFG_BACKFILL_TIMEOUT_MS);
   http.end();
+  for (int i = 0; i < n; i++) Archive_Add(&archive, times[i], prices[i] * 100);
+  if (n < 2) return;
+
+  // market_chart points are close to evenly spaced; the TM4C stores them that way.
+  uint16_t dt = (uint16_t)((times[n - 1] - times[0]) / (uint32_t)(n - 1));
+  if (dt == 0) return;
+
+  // The frame count is part of every header and its width affects packing, so settle it first.
+  uint16_t total = 1;
+  for (int pass = 0; pass < 4; pass++) {
+    uint16_t frames = encodeBackfill(prices, n, times[0], dt, total, false);
+    if (frames == 0) return;
+    if (frames == total) {
+      encodeBackfill(prices, n, times[0], dt, total, true);
+      return;
+    }
+    total = frames;
+  }
 }
 
-void setup() {
-  Serial.begin(115200);
-  delay(2000);
+// Answer one '$Q' line from the TM4C with a '$W' frame. Anything else is ignored.
+static void answerQuery(const char *line) {
+  const char *payload;
+  size_t len;
+  char tag;
+  FrameQuery q;
+  if (!Frame_Open(line, &tag, &payload, &len) || tag != CFG_FRAME_QUERY || !Frame_Decode_Query(payload, len, &q))
+    return;
 
-  Serial.println("Connecting to WiFi...");
-  WiFi.begin(ssid, password);
+  unsigned long start = micros();
+  FrameWindow w;
+  ArchiveWindow r;
+  memset(&w, 0, sizeof(w));
+  w.id = q.id;
+  w.asset = q.asset;
+  w.window_s = q.window_s;
+  if (q.asset == CFG_ASSET_BTC) {  // The only asset this sketch tracks
+    Archive_Query(&archive, q.window_s, &r);
+    w.res_s = r.res_s;
+    w.count = r.count;
+    w.open = r.open;
+    w.high = r.high;
+    w.low = r.low;
+    w.close = r.close;
+    w.mean = r.mean;
+  }
+  char frame[CFG_UART_BUFFER_SIZE + 1];
+  w.service_us = micros() - start;
+  Metric_Inc(&queriesAnswered);
+  Metric_Observe(&queryUs, w.service_us);
+  if (Frame_Encode_Window(frame, sizeof(frame), &w)) {
+    sendBreak();
+    Serial.print(frame);
+    Serial.print('\n');
+  }
+}
 
+static void sendTestFrame(const FrameTest &t) {
+  char frame[CFG_UART_BUFFER_SIZE + 1];
+  if (Frame_Encode_Test(frame, sizeof(frame), &t)) {
+    sendBreak();
+    Serial.print(frame);
+    Serial.print('\n');
+  }
+}
+
+static void serveQueries(unsigned long ms);
+
+// Link self-test (selftest.h): walk the plan, each step paced by micros() and capped by the
+// wire, then wait for the TM4C's '$R' verdict. No price is fetched meanwhile.
+static void runSelfTest() {
+  static bool running = false;
+  if (running) return;  // A start request heard while waiting for the verdict
+  running = true;
+  FrameTest t;
+  uint32_t size, rate;
+  for (t.step = 0; SelfTest_Plan(t.step, &size, &rate); t.step++) {
+    unsigned long start = millis(), next = micros();
+    t.rate = rate;
+    t.size = size;
+    for (t.seq = 0; millis() - start < CFG_SELFTEST_STEP_MS;) {
+      if ((long)(micros() - next) < 0) continue;
+      next += 1000000UL / rate;
+      sendTestFrame(t);
+      t.seq++;
+    }
+    t.size = 0;  // End of step: seq is the number sent
+    sendTestFrame(t);
+    delay(CFG_SELFTEST_GAP_MS);
+  }
+  t.seq = t.rate = t.size = 0;  // Done: step is the number of steps
+  sendTestFrame(t);
+  serveQueries(CFG_ARCHIVE_TIMEOUT_MS);
+  running = false;
+}
+
+static void sendAlarmAck(const FrameAlarmAck &k) {
+  char frame[CFG_UART_BUFFER_SIZE + 1];
+  if (Frame_Encode_Alarm_Ack(frame, sizeof(frame), &k)) {
+    sendBreak();
+    Serial.print(frame);
+    Serial.print('\n');
+  }
+}
+
+// Notification body. 'key' is the same for every attempt of one transition so the endpoint
+// can drop a repeat whose first delivery succeeded but whose answer was lost.
+static int alarmJson(char *out, size_t cap, const FrameAlarm &a) {
+  long cents = (long)a.cents;
+  return snprintf(out, cap,
+                  "{\"key\":\"%lu-%lu-%lu\",\"id\":%lu,\"alarm\":%s,\"price\":%ld.%02ld,\"time\":%lu,\"test\":%s}",
+                  (unsigned long)a.time, (unsigned long)a.on, (unsigned long)a.id, (unsigned long)a.id,
+                  a.on ? "true" : "false", cents / 100, labs(cents % 100), (unsigned long)a.time,
+                  a.test ? "true" : "false");
+}
+
+static bool postWebhook(const char *body) {
+  HTTPClient http;
+  http.setTimeout(2000);
+  if (!http.begin(CFG_PROTO_ALARM_URL)) return false;
+  http.addHeader("Content-Type", "application/json");
+  int code = http.POST(String(body));
+  http.end();
+  return code >= 200 && code < 300;
+}
+
+// Wait up to 'ms' for 'n' bytes from the broker.
+static bool mqttRead(WiFiClient &c, uint8_t *buf, size_t n, unsigned long ms) {
+  unsigned long start = millis();
+  size_t got = 0;
+  while (got < n && millis() - start < ms) {
+    int b = c.read();
+    if (b >= 0) buf[got++] = (uint8_t)b;
+    else delay(1);
+  }
+  return got == n;
+}
+
+// MQTT 3.1.1 packet: fixed header with the remaining length as a varint, then 'body'.
+static size_t mqttPacket(uint8_t *out, uint8_t type, const uint8_t *body, size_t len) {
+  size_t n = 0, rem = len;
+  out[n++] = type;
+  do {
+    uint8_t d = rem % 128;
+    rem /= 128;
+    out[n++] = rem ? (uint8_t)(d | 0x80) : d;
+  } while (rem);
+  memcpy(out + n, body, len);
+  return n + len;
+}
+
+static size_t mqttString(uint8_t *out, const char *s) {
+  size_t len = strlen(s);
+  out[0] = (uint8_t)(len >> 8);
+  out[1] = (uint8_t)len;
+  memcpy(out + 2, s, len);
+  return len + 2;
+}
+
+// One QoS 1 publish on a fresh clean session: CONNECT, CONNACK, PUBLISH, PUBACK, DISCONNECT.
+// Small enough not to need an MQTT library; the broker's PUBACK is the delivery proof.
+static bool publishMqtt(const char *body, uint16_t packetId) {
+  WiFiClient c;
+  uint8_t var[256], pkt[260], resp[4];
+  size_t n;
+  if (!c.connect(CFG_PROTO_ALARM_MQTT_HOST, CFG_ALARM_MQTT_PORT)) return false;
+  static const uint8_t connectHead[] = {0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60};  // Level 4, clean session
+  memcpy(var, connectHead, sizeof(connectHead));
+  n = sizeof(connectHead) + mqttString(var + sizeof(connectHead), "btc-tracker");
+  c.write(pkt, mqttPacket(pkt, 0x10, var, n));
+  bool ok = mqttRead(c, resp, 4, 2000) && resp[0] == 0x20 && resp[3] == 0;
+  if (ok) {
+    n = mqttString(var, CFG_PROTO_ALARM_MQTT_TOPIC);
+    var[n++] = (uint8_t)(packetId >> 8);
+    var[n++] = (uint8_t)packetId;
+    size_t len = strlen(body);
+    if (n + len > sizeof(var)) len = sizeof(var) - n;
+    memcpy(var + n, body, len);
+    c.write(pkt, mqttPacket(pkt, 0x32, var, n + len));  // PUBLISH, QoS 1
+    ok = mqttRead(c, resp, 4, 2000) && resp[0] == 0x40 && resp[2] == (uint8_t)(packetId >> 8) &&
+         resp[3] == (uint8_t)packetId;
+    static const uint8_t disconnect[] = {0xE0, 0};
+    c.write(disconnect, sizeof(disconnect));
+  }
+  c.stop();
+  return ok;
+}
+
+// Forward one alarm transition from the TM4C to the notification endpoint and ack it. Runs
+// inline, ahead of anything else the ESP32 does: CFG_ALARM_FORWARD_TRIES attempts 200 ms apart,
+// doubling, with a short Wi-Fi reconnect first if the link is down (the normal connect would
+// block until it succeeds).
+static void forwardAlarm(const FrameAlarm &a) {
+  for (uint8_t i = 0; i < recentCount; i++) {
+    const FrameAlarm &r = recentAlarms[i].alarm;
+    if (r.id == a.id && r.on == a.on && r.cents == a.cents && r.time == a.time) {
+      sendAlarmAck(recentAlarms[i].ack);  // Resend: the TM4C missed the first ack
+      return;
+    }
+  }
+  FrameAlarmAck k;
+  k.id = a.id;
+  k.status = FRAME_NOTIFY_DISABLED;
+  k.attempts = 0;
+  unsigned long start = millis(), backoff = 200;
+  if (CFG_ALARM_NOTIFY != NOTIFY_OFF) {
+    char body[160];
+    alarmJson(body, sizeof(body), a);
+    k.status = FRAME_NOTIFY_FAILED;
+    while (k.attempts < CFG_ALARM_FORWARD_TRIES) {
+      if (k.attempts++) {
+        delay(backoff);
+        backoff *= 2;
+      }
+      if (WiFi.status() != WL_CONNECTED) {
+        WiFi.reconnect();
+        unsigned long t = millis();
+        while (WiFi.status() != WL_CONNECTED && millis() - t < 2000) delay(10);
+        if (WiFi.status() != WL_CONNECTED) continue;
+      }
+      bool ok = CFG_ALARM_NOTIFY == NOTIFY_MQTT ? publishMqtt(body, (uint16_t)(a.id ? a.id : 1))
+                                                : postWebhook(body);
+      if (ok) {
+        k.status = FRAME_NOTIFY_DELIVERED;
+        break;
+      }
+    }
+  }
+  k.forward_ms = millis() - start;
+  if (k.status == FRAME_NOTIFY_DELIVERED) Metric_Inc(&notifyDelivered);
+  if (k.status == FRAME_NOTIFY_FAILED) Metric_Inc(&notifyFailed);
+  sendAlarmAck(k);
+  recentAlarms[recentNext].alarm = a;
+  recentAlarms[recentNext].ack = k;
+  recentNext = (uint8_t)((recentNext + 1) % NOTIFY_RECENT);
+  if (recentCount < NOTIFY_RECENT) recentCount++;
+}
+
+// One line from the TM4C: a window query, a self-test request or verdict, or an alarm.
+static void handleLine(const char *line) {
+  const char *payload;
+  size_t len;
+  char tag;
+  FrameTest t;
+  FrameTestResult r;
+  FrameAlarm a;
+  if (!Frame_Open(line, &tag, &payload, &len)) return;
+  if (tag == CFG_FRAME_QUERY) {
+    answerQuery(line);
+  } else if (tag == CFG_FRAME_TEST && Frame_Decode_Test(payload, len, &t) && t.step == 0 && t.size == 0) {
+    runSelfTest();
+  } else if (tag == CFG_FRAME_RESULT && Frame_Decode_Test_Result(payload, len, &r)) {
+    selfTestResult = r;
+    selfTestValid = true;
+  } else if (tag == CFG_FRAME_ALARM && Frame_Decode_Alarm(payload, len, &a)) {
+    forwardAlarm(a);
+  }
+}
+
+// Refresh the sampled gauges before an export.
+static void sampleGauges() {
+  Metric_Set(&heapFree, (int32_t)ESP.getFreeHeap());
+  Metric_Set(&heapBlock, (int32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  Metric_Set(&rssi, WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0);
+  Metric_Set(&uptime, (int32_t)(millis() / 1000));
+  if (plan.n_providers) {  // Awake mode, once planSetup() has run
+    uint32_t now = millis(), sum = 0, longest = 0;
+    for (uint16_t i = 0; i < CFG_ASSET_COUNT; i++) {
+      sum += Plan_Mean_Age(&plan, i, now);
+      longest = std::max(longest, planAssets[i].age_max);
+    }
+    Metric_Set(&planAgeMean, (int32_t)(sum / CFG_ASSET_COUNT));
+    Metric_Set(&planAgeMax, (int32_t)longest);
+    Metric_Set(&planBudget, (int32_t)Plan_Budget_Used(&plan, 0, planStart, now));
+  }
+}
+
+// Time 256 updates of each kind with the CPU cycle counter. The loop is part of the figure,
+// so it is an upper bound of what an update costs on the hot path.
+static void measureMetrics() {
+  static uint32_t scratch;
+  static MetricHist scratchHist = { fetchBucketsMs, 7 };
+  uint32_t t = ESP.getCycleCount();
+  for (int i = 0; i < 256; i++) Metric_Inc(&scratch);
+  Metric_Set(&incCycles, (int32_t)((ESP.getCycleCount() - t) / 256));
+  t = ESP.getCycleCount();
+  for (int i = 0; i < 256; i++) Metric_Observe(&scratchHist, (uint32_t)i * 40);  // Spread over the buckets
+  Metric_Set(&observeCycles, (int32_t)((ESP.getCycleCount() - t) / 256));
+}
+
+// Answer one HTTP request on the metrics port: the Prometheus text for GET /metrics, 404 for
+// anything else. Each metric is formatted into a small buffer and written out on its own.
+static void serveMetrics() {
+  WiFiClient c = metricsServer.available();
+  if (!c) return;
+  char buf[640];
+  size_t len = 0;
+  unsigned long start = millis();
+  while (c.connected() && millis() - start < 500) {  // Request line and headers, up to the blank line
+    if (!c.available()) {
+      delay(1);
+      continue;
+    }
+    char ch = (char)c.read();
+    if (len < sizeof(buf) - 1) buf[len++] = ch;
+    if (len >= 4 && memcmp(&buf[len - 4], "\r\n\r\n", 4) == 0) break;
+  }
+  buf[len] = '\0';
+  if (strncmp(buf, "GET /metrics ", 13) != 0) {
+    c.print("HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    c.stop();
+    return;
+  }
+  sampleGauges();
+  c.print("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+  for (size_t i = 0; i < METRIC_COUNT; i++) {
+    len = Metrics_Prometheus(buf, sizeof(buf), metrics, i);
+    if (len) c.write((const uint8_t *)buf, len);
+  }
+  c.stop();
+}
+
+// Compact dump on the serial port every CFG_METRICS_SERIAL_S seconds.
+static void dumpMetrics() {
+  if (CFG_METRICS_SERIAL_S == 0 || millis() - metricsDumpAt < CFG_METRICS_SERIAL_S * 1000UL) return;
+  metricsDumpAt = millis();
+  sampleGauges();
+  char line[512];
+  size_t len = Metrics_Compact(line, sizeof(line), metrics, METRIC_COUNT);
+  sendBreak();
+  Serial.write((const uint8_t *)line, len);
+}
+
+// Collect query lines from the TM4C for 'ms' milliseconds, answering each as it completes.
+// A press of the BOOT button starts the link self-test, and metrics are served meanwhile.
+static void serveQueries(unsigned long ms) {
+  unsigned long start = millis();
+  do {
+    while (Serial.available()) {
+      char c = (char)Serial.read();
+      if (c == '\n' || c == '\r') {
+        queryLine[queryLen] = '\0';
+        if (queryLen) handleLine(queryLine);
+        queryLen = 0;
+      } else if (queryLen < sizeof(queryLine) - 1) {
+        queryLine[queryLen++] = c;
+      }
+    }
+    if (digitalRead(SELFTEST_PIN) == LOW) {
+      while (digitalRead(SELFTEST_PIN) == LOW) delay(10);
+      runSelfTest();
+    }
+    if (CFG_METRICS_HTTP_PORT) serveMetrics();
+    dumpMetrics();
+    delay(1);
+  } while (millis() - start < ms);
+}
+
+// A lost connection counts as a reconnect unless the sketch switched Wi-Fi off itself.
+static void onWiFiEvent(WiFiEvent_t event) {
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    wifiUp = true;
+  } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    if (wifiUp && !radioOff) rtcState.reconnects++;
+    wifiUp = false;
+  }
+}
+
+// Join the network. 'fast' reuses the channel, BSSID and lease of the previous cycle, which
+// skips the scan and DHCP; if that does not work within 3 s a normal connect is done.
+static void connectWiFi(bool fast, bool verbose) {
+  radioOnAt = millis();
+  radioOff = false;
+  WiFi.mode(WIFI_STA);
+  if (fast && rtcState.channel > 0) {
+    WiFi.config(IPAddress(rtcState.ip), IPAddress(rtcState.gateway), IPAddress(rtcState.subnet),
+                IPAddress(rtcState.dns));
+    WiFi.begin(ssid, password, rtcState.channel, rtcState.bssid);
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start < 3000) delay(10);
+    if (WiFi.status() == WL_CONNECTED) return;
+    WiFi.disconnect();
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));  // Back to DHCP
+  }
+
+  WiFi.begin(ssid, password);
   while (WiFi.status() != WL_CONNECTED) {
     delay(500);
-    Serial.print(".");
+    if (verbose) Serial.print(".");
   }
+  rtcState.channel = WiFi.channel();
+  memcpy(rtcState.bssid, WiFi.BSSID(), sizeof(rtcState.bssid));
+  rtcState.ip = WiFi.localIP();
+  rtcState.gateway = WiFi.gatewayIP();
+  rtcState.subnet = WiFi.subnetMask();
+  rtcState.dns = WiFi.dnsIP();
+}
+
+// Power down until the next poll. A heartbeat frame first tells the TM4C how long the link
+// will be quiet (so it is not flagged stale) and reports this cycle's timings. After deep
+// sleep the wake-to-frame time excludes the ROM boot, which millis() cannot see.
+static void sleepUntilNextPoll() {
+  unsigned long spent = millis() - wakeAt;
+  uint32_t sleepMs = (spent < CFG_POLL_INTERVAL_MS) ? CFG_POLL_INTERVAL_MS - spent : 1000;
 
-  Serial.println("\nWiFi connected!");
-  Serial.print("IP Address: ");
-  Serial.println(WiFi.localIP());
+  radioOff = true;
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+
+  FrameHeartbeat hb;
+  hb.sleep_ms = sleepMs;
+  hb.awake_ms = millis() - wakeAt;
+  hb.radio_ms = millis() - radioOnAt;
+  hb.wake_to_frame_ms = frameSentAt ? frameSentAt - wakeAt : 0;
+  hb.cycle = rtcState.cycle++;
+  char frame[CFG_UART_BUFFER_SIZE + 1];
+  if (Frame_Encode_Heartbeat(frame, sizeof(frame), &hb)) {
+    sendBreak();
+    Serial.print(frame);
+    Serial.print('\n');
+  }
+  Serial.flush();  // Everything must leave the UART before the clocks stop
+
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+  if (CFG_POWER_MODE == POWER_DEEP_SLEEP) {
+    gpio_hold_en(UART_TX_PIN);  // Hold TX high (idle) so the TM4C sees no start bits
+    gpio_deep_sleep_hold_en();
+    esp_deep_sleep_start();     // Does not return: the next cycle starts in setup()
+  }
+  esp_light_sleep_start();
+  wakeAt = millis();
+  frameSentAt = 0;
+}
+
+void setup() {
+  bool resumed = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER && rtcState.magic == RTC_STATE_MAGIC;
+  if (resumed) gpio_hold_dis(UART_TX_PIN);  // Give the TX pin back to the UART
+  Serial.begin(CFG_UART_BAUD);
+  if (CFG_UART_FLOW == FLOW_RTSCTS) {
+    // The UART stops between characters while CTS is high: the TM4C's ring, not its FIFO, is full
+    Serial.setPins(-1, -1, FLOW_CTS_PIN, FLOW_RTS_PIN);
+    Serial.setHwFlowCtrlMode(UART_HW_FLOWCTRL_CTS_RTS, 64);
+  } else if (CFG_UART_FLOW == FLOW_XONXOFF) {
+    // The UART obeys XOFF/XON from the TM4C in hardware. Our own RX thresholds are never
+    // reached (the TM4C sends short queries), so no XOFF goes the other way.
+    uart_set_sw_flow_ctrl(UART_NUM_0, true, 16, 112);
+  }
+  pinMode(SELFTEST_PIN, INPUT_PULLUP);
+  Archive_Init(&archive, archiveStore);
+  measureMetrics();
+  WiFi.onEvent(onWiFiEvent);
+
+  if (resumed) {
+    connectWiFi(true, false);  // The clock survives deep sleep, so SNTP is not restarted
+  } else {
+    memset(&rtcState, 0, sizeof(rtcState));
+    rtcState.magic = RTC_STATE_MAGIC;
+    delay(2000);
+
+    Serial.println("Connecting to WiFi...");
+    connectWiFi(false, true);
+
+    Serial.println("\nWiFi connected!");
+    Serial.print("IP Address: ");
+    Serial.println(WiFi.localIP());
+    Serial.printf("History archive: %u bytes per asset, %u per day of retention\n",
+                  (unsigned)ARCHIVE_BYTES_PER_ASSET,
+                  (unsigned)(ARCHIVE_BYTES_PER_ASSET * 86400ULL / ((uint64_t)CFG_ARCHIVE_T2_BUCKETS * CFG_ARCHIVE_T2_BUCKET_S)));
+    Serial.printf("Metrics: %u series, update %ld cycles, histogram %ld cycles\n",
+                  (unsigned)METRIC_COUNT, (long)incCycles, (long)observeCycles);
+
+    // Start SNTP so ticks carry wall-clock time (UTC)
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+  }
+
+  if (CFG_METRICS_HTTP_PORT) metricsServer.begin();
+
+  // Warm up the TM4C's history with the last day of prices before the first live tick
+  if (!rtcState.backfillSent) {
+    sendHistoryBackfill();
+    rtcState.backfillSent = true;
+  }
 
   // Immediately fetch and send BTC data on startup
-  fetchAndSendBTCData();
+  if (CFG_POWER_MODE == POWER_AWAKE) {
+    planSetup();
+    fetchPlanned();  // Nothing has a price yet, so the first batch goes out at once
+  } else {
+    fetchAndSendBTCData();
+  }
+  if (CFG_POWER_MODE == POWER_DEEP_SLEEP) {
+    serveQueries(CFG_ARCHIVE_LISTEN_MS);  // The TM4C asks right after a price line
+    sleepUntilNextPoll();
+  }
 }
 
 void loop() {
-  // Fetch and send BTC data every 60 seconds thereafter
-  delay(20000);
+  if (CFG_POWER_MODE == POWER_AWAKE) {
+    // Fetch whenever the planner has budget and a due asset, answering queries meanwhile
+    serveQueries(Plan_Wait(&plan, millis(), CFG_POLL_INTERVAL_MS));
+    fetchPlanned();
+    return;
+  }
+  // Light sleep: the CPU resumes here with RAM intact
+  serveQueries(CFG_ARCHIVE_LISTEN_MS);
+  sleepUntilNextPoll();
+  connectWiFi(true, false);
   fetchAndSendBTCData();
 }
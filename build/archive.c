@@ -0,0 +1,113 @@
+//archive.c
+
+#include "archive.h"
+#include <string.h>
+
+static const uint32_t tier_len[ARCHIVE_TIERS] = {
+    CFG_ARCHIVE_T0_BUCKETS, CFG_ARCHIVE_T1_BUCKETS, CFG_ARCHIVE_T2_BUCKETS
+};
+static const uint32_t tier_bucket_s[ARCHIVE_TIERS] = {
+    CFG_ARCHIVE_T0_BUCKET_S, CFG_ARCHIVE_T1_BUCKET_S, CFG_ARCHIVE_T2_BUCKET_S
+};
+
+void Archive_Init(Archive *a, ArchiveBucket *store) {
+    int k;
+    memset(a, 0, sizeof(*a));
+    memset(store, 0, ARCHIVE_BYTES_PER_ASSET);
+    for (k = 0; k < ARCHIVE_TIERS; k++) {
+        a->tier[k].b = store;
+        a->tier[k].len = tier_len[k];
+        a->tier[k].bucket_s = tier_bucket_s[k];
+        store += tier_len[k];
+    }
+}
+
+static void Tier_Add(ArchiveTier *t, uint32_t time, int32_t cents) {
+    uint32_t start = time - time % t->bucket_s;
+    ArchiveBucket *b;
+
+    if (start > t->head_start) {
+        // Open a new bucket, emptying the ones skipped while no samples came in.
+        uint32_t steps = t->head_start ? (start - t->head_start) / t->bucket_s : 1;
+        if (steps > t->len)
+            steps = t->len;
+        while (steps--) {
+            t->head = (t->head + 1 == t->len) ? 0 : t->head + 1;
+            t->b[t->head].count = 0;
+        }
+        t->head_start = start;
+    } else if (start < t->head_start) {
+        return;                   // Older than the newest bucket: already summarised.
+    }
+
+    b = &t->b[t->head];
+    if (b->count == 0) {
+        b->open = b->high = b->low = b->close = cents;
+        b->sum = cents;
+        b->count = 1;
+        return;
+    }
+    if (cents > b->high) b->high = cents;
+    if (cents < b->low) b->low = cents;
+    b->close = cents;
+    b->count++;
+    b->sum += cents;
+}
+
+void Archive_Add(Archive *a, uint32_t time, int32_t cents) {
+    int k;
+    if (time == 0)
+        return;
+    for (k = 0; k < ARCHIVE_TIERS; k++)
+        Tier_Add(&a->tier[k], time, cents);
+    if (time > a->newest)
+        a->newest = time;
+    a->samples++;
+}
+
+uint32_t Archive_Query(const Archive *a, uint32_t window_s, ArchiveWindow *out) {
+    const ArchiveTier *t = &a->tier[ARCHIVE_TIERS - 1];
+    uint32_t since, i, idx, start;
+    int64_t sum = 0;
+    int k;
+
+    for (k = 0; k < ARCHIVE_TIERS; k++) {
+        if ((uint64_t)a->tier[k].bucket_s * a->tier[k].len >= window_s) {
+            t = &a->tier[k];      // Finest tier that still covers the whole window.
+            break;
+        }
+    }
+    memset(out, 0, sizeof(*out));
+    out->res_s = t->bucket_s;
+    if (t->head_start == 0)
+        return 0;
+    since = a->newest > window_s ? a->newest - window_s : 0;
+
+    // Walk the ring oldest first; bucket i (0 = oldest) starts (len - 1 - i) buckets before the head.
+    idx = t->head;
+    for (i = 0; i < t->len; i++) {
+        const ArchiveBucket *b;
+        uint32_t back = t->len - 1 - i;
+        idx = (idx + 1 == t->len) ? 0 : idx + 1;
+        b = &t->b[idx];
+        if (b->count == 0 || (uint64_t)back * t->bucket_s > t->head_start)
+            continue;
+        start = t->head_start - back * t->bucket_s;
+        if (start + t->bucket_s <= since)
+            continue;             // Ends before the window.
+        if (out->count == 0) {
+            out->start = start;
+            out->open = b->open;
+            out->high = b->high;
+            out->low = b->low;
+        }
+        if (b->high > out->high) out->high = b->high;
+        if (b->low < out->low) out->low = b->low;
+        out->close = b->close;
+        out->count += b->count;
+        sum += b->sum;
+    }
+    if (out->count)
+        out->mean = (int32_t)(sum / out->count);
+    return out->count;
+}
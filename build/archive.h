@@ -0,0 +1,74 @@
+//archive.h
+// Multi-resolution price archive kept by the ESP32 for each asset (portable C, so it can
+// also be built on a host).
+//
+// The TM4C only has room for a few days of raw ticks. The ESP32 keeps much longer
+// history, but only in downsampled form: three tiers of OHLC buckets (open, high, low,
+// close, mean, count), each tier a ring of fixed-size buckets:
+//
+//   tier 0: CFG_ARCHIVE_T0_BUCKETS x CFG_ARCHIVE_T0_BUCKET_S   (default 24 h of 1-minute buckets)
+//   tier 1: CFG_ARCHIVE_T1_BUCKETS x CFG_ARCHIVE_T1_BUCKET_S   (default 7 days of 15-minute buckets)
+//   tier 2: CFG_ARCHIVE_T2_BUCKETS x CFG_ARCHIVE_T2_BUCKET_S   (default 90 days of 2-hour buckets)
+//
+// Every sample updates the current bucket of all three tiers, so no roll-up pass is
+// needed. A window query is answered from the finest tier whose span covers the window;
+// its start is rounded down to that tier's bucket size. Memory is ARCHIVE_BYTES_PER_ASSET
+// (102 KB with the defaults, about 1.1 KB per day of retention).
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include "tracker_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARCHIVE_TIERS   3
+#define ARCHIVE_BUCKETS (CFG_ARCHIVE_T0_BUCKETS + CFG_ARCHIVE_T1_BUCKETS + CFG_ARCHIVE_T2_BUCKETS)
+#define ARCHIVE_BYTES_PER_ASSET (ARCHIVE_BUCKETS * sizeof(ArchiveBucket))
+
+typedef struct {
+    int64_t sum;                  // Sum of the samples (cents): the mean is divided out at query time
+    int32_t open, high, low, close;  // Prices in cents
+    uint32_t count;               // Samples in the bucket, 0 = empty
+} ArchiveBucket;
+
+typedef struct {
+    ArchiveBucket *b;             // Ring storage
+    uint32_t len;                 // Buckets in the ring
+    uint32_t bucket_s;            // Seconds per bucket
+    uint32_t head;                // Index of the newest bucket
+    uint32_t head_start;          // Start time of the newest bucket (0 = tier empty)
+} ArchiveTier;
+
+typedef struct {
+    ArchiveTier tier[ARCHIVE_TIERS];
+    uint32_t newest;              // Time of the newest sample
+    uint32_t samples;             // Samples accepted
+} Archive;
+
+// Aggregate over one window.
+typedef struct {
+    uint32_t start;               // Start of the first bucket used
+    uint32_t res_s;               // Bucket size of the tier used
+    uint32_t count;               // Samples in the window (0: the price fields are undefined)
+    int32_t open, high, low, close;
+    int32_t mean;                 // Exact mean of the samples, truncated to whole cents
+} ArchiveWindow;
+
+// Set up an empty archive on 'store' (ARCHIVE_BUCKETS buckets).
+void Archive_Init(Archive *a, ArchiveBucket *store);
+
+// Add a sample (Unix time, price in cents). Samples older than a tier's newest bucket are
+// not added to that tier; time 0 (clock not set) is ignored.
+void Archive_Add(Archive *a, uint32_t time, int32_t cents);
+
+// Aggregate the last 'window_s' seconds up to the newest sample. Returns out->count.
+uint32_t Archive_Query(const Archive *a, uint32_t window_s, ArchiveWindow *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARCHIVE_H
@@ -1,13 +1,14 @@
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include "tracker_config.h"
 
 // === WiFi Credentials ===
 const char* ssid = "ssid"; 
 const char* password = "password";
 
 void setup() {
-  Serial.begin(115200);
+  Serial.begin(CFG_UART_BAUD);
   delay(1000);
   
   // Connect to WiFi
@@ -37,7 +38,7 @@ void loop() {
 
 bool fetchBTCData(float &priceOut, float &percentOut) {
   HTTPClient http;
-  http.begin("https://api.coingecko.com/api/v3/coins/bitcoin?localization=false&tickers=false&market_data=true");
+  http.begin(CFG_PROTO_PRICE_URL);
 
   int httpCode = http.GET();
 
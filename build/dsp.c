@@ -0,0 +1,305 @@
+//dsp.c
+
+#include "dsp.h"
+#include <stddef.h>
+
+#if DSP_USE_SIMD
+#include "TM4C123GH6PM.h"         // CMSIS core header: __SMLAD, __SMLALD, __SSUB16, __SEL, __QADD16
+#endif
+#ifdef DSP_BENCHMARK
+#include "tracker.h"              // Cycles_Now()
+#endif
+
+// Plain C kernels: the host build uses them directly, the target build for short tails
+// and as the benchmark baseline.
+
+static int32_t Sum16_Scalar(const int16_t *x, uint32_t n) {
+    int32_t acc = 0;
+    while (n--)
+        acc += *x++;
+    return acc;
+}
+
+static void MinMax16_Scalar(const int16_t *x, uint32_t n, int16_t *min, int16_t *max) {
+    int16_t lo = x[0], hi = x[0];
+    uint32_t i;
+    for (i = 1; i < n; i++) {
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static int16_t Sat16(int32_t v) {
+    if (v > 32767) return 32767;
+    if (v < -32768) return -32768;
+    return (int16_t)v;
+}
+
+#if !DSP_USE_SIMD
+static uint64_t SumSquares16_Scalar(const int16_t *x, uint32_t n) {
+    uint64_t acc = 0;
+    while (n--) {
+        int32_t v = *x++;
+        acc += (uint64_t)(v * v);
+    }
+    return acc;
+}
+
+static void Offset16_Scalar(const int16_t *x, uint32_t n, int16_t offset, int16_t *out) {
+    while (n--)
+        *out++ = Sat16((int32_t)*x++ + offset);
+}
+#endif
+
+#if DSP_USE_SIMD
+// Cortex-M4 kernels. Pairs of int16 samples are loaded as one 32-bit word, so a leading
+// sample is peeled off when the array does not start on a word boundary.
+
+#define PAIR_ONES 0x00010001U     // (1, 1) in both halfwords: SMLAD(x, ones) = x.lo + x.hi
+
+static int32_t Sum16_Simd(const int16_t *x, uint32_t n) {
+    const uint32_t *w;
+    int32_t acc = 0;
+    if (n && ((uintptr_t)x & 2U)) {
+        acc = *x++;
+        n--;
+    }
+    w = (const uint32_t *)x;
+    for (; n >= 4; n -= 4, w += 2) {                      // Two dual-MACs per iteration.
+        acc = (int32_t)__SMLAD(w[0], PAIR_ONES, (uint32_t)acc);
+        acc = (int32_t)__SMLAD(w[1], PAIR_ONES, (uint32_t)acc);
+    }
+    return acc + Sum16_Scalar((const int16_t *)w, n);
+}
+
+static uint64_t SumSquares16_Simd(const int16_t *x, uint32_t n) {
+    const uint32_t *w;
+    uint64_t acc = 0;
+    if (n && ((uintptr_t)x & 2U)) {
+        acc = (uint64_t)((int32_t)*x * *x);
+        x++;
+        n--;
+    }
+    w = (const uint32_t *)x;
+    for (; n >= 2; n -= 2, w++)
+        acc = __SMLALD(*w, *w, acc);                      // lo*lo + hi*hi into a 64-bit accumulator.
+    if (n)
+        acc += (uint64_t)((int32_t)*(const int16_t *)w * *(const int16_t *)w);
+    return acc;
+}
+
+static void MinMax16_Simd(const int16_t *x, uint32_t n, int16_t *min, int16_t *max) {
+    const uint32_t *w;
+    uint32_t vmin, vmax, v, words, i;
+    int16_t lo, hi, a, b;
+    if (n < 4) {
+        MinMax16_Scalar(x, n, min, max);
+        return;
+    }
+    lo = hi = x[0];
+    if ((uintptr_t)x & 2U) {                              // Peel one sample to reach word alignment.
+        x++;
+        n--;
+    }
+    w = (const uint32_t *)x;
+    words = n / 2;
+    vmin = vmax = w[0];
+    for (i = 1; i < words; i++) {
+        v = w[i];
+        __SSUB16(v, vmax);                                // GE bits: v >= vmax, per halfword
+        vmax = __SEL(v, vmax);
+        __SSUB16(v, vmin);                                // GE bits: v >= vmin, per halfword
+        vmin = __SEL(vmin, v);
+    }
+    a = (int16_t)(vmin & 0xFFFFU);
+    b = (int16_t)(vmin >> 16);
+    if (a < lo) lo = a;
+    if (b < lo) lo = b;
+    a = (int16_t)(vmax & 0xFFFFU);
+    b = (int16_t)(vmax >> 16);
+    if (a > hi) hi = a;
+    if (b > hi) hi = b;
+    if (n & 1U) {                                         // Odd sample left after the pairs.
+        a = x[n - 1];
+        if (a < lo) lo = a;
+        if (a > hi) hi = a;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static void Offset16_Simd(const int16_t *x, uint32_t n, int16_t offset, int16_t *out) {
+    uint32_t off2 = ((uint32_t)(uint16_t)offset << 16) | (uint16_t)offset;
+    if (n && ((uintptr_t)x & 2U) && ((uintptr_t)out & 2U)) {
+        *out++ = Sat16((int32_t)*x++ + offset);
+        n--;
+    }
+    if ((((uintptr_t)x ^ (uintptr_t)out) & 2U) == 0) {     // Same alignment: two samples per QADD16.
+        const uint32_t *wi = (const uint32_t *)x;
+        uint32_t *wo = (uint32_t *)out;
+        for (; n >= 2; n -= 2)
+            *wo++ = __QADD16(*wi++, off2);
+        x = (const int16_t *)wi;
+        out = (int16_t *)wo;
+    }
+    while (n--)
+        *out++ = Sat16((int32_t)*x++ + offset);
+}
+#endif
+
+// Public entry points: pick the kernel selected at compile time.
+
+int32_t Dsp_Sum16(const int16_t *x, uint32_t n) {
+#if DSP_USE_SIMD
+    return Sum16_Simd(x, n);
+#else
+    return Sum16_Scalar(x, n);
+#endif
+}
+
+uint64_t Dsp_SumSquares16(const int16_t *x, uint32_t n) {
+#if DSP_USE_SIMD
+    return SumSquares16_Simd(x, n);
+#else
+    return SumSquares16_Scalar(x, n);
+#endif
+}
+
+void Dsp_MinMax16(const int16_t *x, uint32_t n, int16_t *min, int16_t *max) {
+#if DSP_USE_SIMD
+    MinMax16_Simd(x, n, min, max);
+#else
+    MinMax16_Scalar(x, n, min, max);
+#endif
+}
+
+void Dsp_Offset16(const int16_t *x, uint32_t n, int16_t offset, int16_t *out) {
+#if DSP_USE_SIMD
+    Offset16_Simd(x, n, offset, out);
+#else
+    Offset16_Scalar(x, n, offset, out);
+#endif
+}
+
+// Sliding-window mean: the first window is summed with the sum kernel, each later one is
+// updated by adding the sample entering and subtracting the one leaving.
+static uint32_t Window_Mean(const int16_t *x, uint32_t n, uint32_t w, int16_t *out,
+                            int32_t (*sum)(const int16_t *, uint32_t)) {
+    int32_t acc;
+    uint32_t i;
+    if (w == 0 || w > n)
+        return 0;
+    acc = sum(x, w);
+    for (i = 0;; i++) {
+        int32_t q = acc / (int32_t)w;
+        if (acc < 0 && q * (int32_t)w != acc)
+            q--;                                          // Round toward minus infinity.
+        out[i] = (int16_t)q;
+        if (i + w >= n)
+            break;
+        acc += x[i + w] - x[i];
+    }
+    return n - w + 1;
+}
+
+static void Resample(const int16_t *x, uint32_t n, uint32_t width, int16_t *col_min, int16_t *col_max,
+                     void (*minmax)(const int16_t *, uint32_t, int16_t *, int16_t *)) {
+    uint32_t c;
+    for (c = 0; c < width; c++) {
+        uint32_t s = (uint32_t)(((uint64_t)c * n) / width);
+        uint32_t e = (uint32_t)(((uint64_t)(c + 1) * n) / width);
+        if (e <= s)
+            e = s + 1;                                    // Fewer samples than columns.
+        if (s >= n) {
+            s = n - 1;
+            e = n;
+        }
+        minmax(x + s, e - s, &col_min[c], &col_max[c]);
+    }
+}
+
+uint32_t Dsp_WindowMean16(const int16_t *x, uint32_t n, uint32_t w, int16_t *out) {
+    return Window_Mean(x, n, w, out, Dsp_Sum16);
+}
+
+void Dsp_Resample16(const int16_t *x, uint32_t n, uint32_t width, int16_t *col_min, int16_t *col_max) {
+    if (n == 0)
+        return;
+    Resample(x, n, width, col_min, col_max, Dsp_MinMax16);
+}
+
+int64_t Dsp_Sum32(const int32_t *x, uint32_t n) {
+    int64_t acc0 = 0, acc1 = 0;
+    for (; n >= 4; n -= 4, x += 4) {                      // Two accumulators hide the add latency.
+        acc0 += (int64_t)x[0] + x[2];
+        acc1 += (int64_t)x[1] + x[3];
+    }
+    while (n--)
+        acc0 += *x++;
+    return acc0 + acc1;
+}
+
+void Dsp_MinMax32(const int32_t *x, uint32_t n, int32_t *min, int32_t *max) {
+    int32_t lo = x[0], hi = x[0];
+    uint32_t i;
+    for (i = 1; i < n; i++) {
+        int32_t v = x[i];
+        lo = (v < lo) ? v : lo;
+        hi = (v > hi) ? v : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+#ifdef DSP_BENCHMARK
+#define BENCH_SAMPLES 1024U
+#define BENCH_WIDTH   160U        // Columns of a chart page
+
+static int16_t bench_x[BENCH_SAMPLES];
+static int16_t bench_out[BENCH_SAMPLES];
+static int16_t bench_min[BENCH_WIDTH], bench_max[BENCH_WIDTH];
+volatile int32_t dsp_bench_sink;   // Keeps the compiler from discarding results.
+
+void Dsp_Benchmark(DspBench *out) {
+    uint32_t i, t, seed = 12345U;
+    int16_t lo, hi;
+    int32_t v = 0;
+    for (i = 0; i < BENCH_SAMPLES; i++) {                 // Random walk like a price series.
+        seed = seed * 1664525U + 1013904223U;
+        v += (int32_t)(seed >> 24) - 128;
+        bench_x[i] = Sat16(v);
+    }
+    out->samples = BENCH_SAMPLES;
+
+    t = Cycles_Now();
+    dsp_bench_sink = Dsp_Sum16(bench_x, BENCH_SAMPLES);
+    out->sum_simd = Cycles_Now() - t;
+    t = Cycles_Now();
+    dsp_bench_sink = Sum16_Scalar(bench_x, BENCH_SAMPLES);
+    out->sum_scalar = Cycles_Now() - t;
+
+    t = Cycles_Now();
+    Dsp_MinMax16(bench_x, BENCH_SAMPLES, &lo, &hi);
+    out->minmax_simd = Cycles_Now() - t;
+    t = Cycles_Now();
+    MinMax16_Scalar(bench_x, BENCH_SAMPLES, &lo, &hi);
+    out->minmax_scalar = Cycles_Now() - t;
+    dsp_bench_sink = lo + hi;
+
+    t = Cycles_Now();
+    Window_Mean(bench_x, BENCH_SAMPLES, 64, bench_out, Dsp_Sum16);
+    out->mean_simd = Cycles_Now() - t;
+    t = Cycles_Now();
+    Window_Mean(bench_x, BENCH_SAMPLES, 64, bench_out, Sum16_Scalar);
+    out->mean_scalar = Cycles_Now() - t;
+
+    t = Cycles_Now();
+    Resample(bench_x, BENCH_SAMPLES, BENCH_WIDTH, bench_min, bench_max, Dsp_MinMax16);
+    out->resample_simd = Cycles_Now() - t;
+    t = Cycles_Now();
+    Resample(bench_x, BENCH_SAMPLES, BENCH_WIDTH, bench_min, bench_max, MinMax16_Scalar);
+    out->resample_scalar = Cycles_Now() - t;
+}
+#endif
@@ -0,0 +1,61 @@
+//dsp.h
+// Batch kernels over stored price history (sum, min/max, windowed mean, chart resampling).
+//
+// When built for the TM4C123 (Cortex-M4 with the DSP extension) the 16-bit kernels process
+// two samples per instruction: SMLAD for dual multiply-accumulate sums, SSUB16 + SEL for
+// packed min/max and QADD16 for saturating re-basing. Other builds (host tools) get plain C
+// loops with identical results. DSP_USE_SIMD reports which variant was compiled.
+//
+// The int16 kernels are meant for the delta arrays of HistBlock (history.h): add the block
+// base to a result to get prices. The int32 kernels handle raw price arrays.
+#ifndef DSP_H
+#define DSP_H
+
+#include <stdint.h>
+
+#ifndef DSP_USE_SIMD              // The host test sets 1 and gets the intrinsics from qemu/
+#if (defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP) || defined(__TARGET_FEATURE_DSPMUL)
+#define DSP_USE_SIMD 1            // Cortex-M4 DSP instructions available
+#else
+#define DSP_USE_SIMD 0            // Portable C fallback
+#endif
+#endif
+
+// Sum of x[0..n-1]. Exact for n <= 65536.
+int32_t Dsp_Sum16(const int16_t *x, uint32_t n);
+
+// Sum of squares of x[0..n-1] (for variance / volatility).
+uint64_t Dsp_SumSquares16(const int16_t *x, uint32_t n);
+
+// Minimum and maximum of x[0..n-1]; n must be at least 1.
+void Dsp_MinMax16(const int16_t *x, uint32_t n, int16_t *min, int16_t *max);
+
+// out[i] = x[i] + offset with saturation to the int16 range (moves deltas to a new base).
+void Dsp_Offset16(const int16_t *x, uint32_t n, int16_t offset, int16_t *out);
+
+// Moving mean over a window of 'w' samples: out[i] = floor(mean(x[i..i+w-1])),
+// for i = 0 .. n-w. Returns the number of outputs (0 if w is 0 or larger than n).
+uint32_t Dsp_WindowMean16(const int16_t *x, uint32_t n, uint32_t w, int16_t *out);
+
+// Split x[0..n-1] into 'width' equal columns (e.g. display pixels) and report the minimum
+// and maximum of each. When n < width, samples are repeated across columns.
+void Dsp_Resample16(const int16_t *x, uint32_t n, uint32_t width, int16_t *col_min, int16_t *col_max);
+
+// 32-bit variants for raw price arrays.
+int64_t Dsp_Sum32(const int32_t *x, uint32_t n);
+void Dsp_MinMax32(const int32_t *x, uint32_t n, int32_t *min, int32_t *max);
+
+#ifdef DSP_BENCHMARK
+// Cycle counts of the selected kernels against the plain C loops over the same data.
+typedef struct {
+    uint32_t samples;             // Samples per run
+    uint32_t sum_simd, sum_scalar;
+    uint32_t minmax_simd, minmax_scalar;
+    uint32_t mean_simd, mean_scalar;
+    uint32_t resample_simd, resample_scalar;
+} DspBench;
+
+void Dsp_Benchmark(DspBench *out);
+#endif
+
+#endif // DSP_H
@@ -0,0 +1,71 @@
+//encoder.c
+
+#include "encoder.h"
+#include "tracker.h"
+
+#define ENC_PINS     0xC0U        // PD6 (PhA0), PD7 (PhB0)
+#define ENC_SWITCH   0x04U        // PD2, encoder push switch (active low)
+
+// QEI0 CTL bits
+#define QEI_ENABLE   0x00000001U
+#define QEI_CAPMODE  0x00000008U  // Count both edges of PhA and PhB (4 counts per quadrature cycle)
+#define QEI_VELEN    0x00000020U  // Capture velocity every LOAD + 1 clocks
+#define QEI_FILTEN   0x00002000U  // Input noise filter
+#define QEI_FILTCNT  (7U << 16)   // Filter: input must be stable for 8 clocks
+
+// A detent's edges come in one burst, so a velocity period shorter than the gap between
+// detents reads 0 or a whole detent and says nothing about the speed. Two detents at
+// mid_speed per period keep the mid step reachable.
+typedef char enc_period_fits[(CFG_ENCODER_MID_SPEED * CFG_ENCODER_VELOCITY_MS >= 2000U) ? 1 : -1];
+
+static uint32_t last_pos;         // POS at the previous Encoder_Read()
+static int32_t residual;          // Counts short of a full detent, carried over
+
+void Encoder_Init(void) {
+    SYSCTL->RCGCGPIO |= 0x08;     // Port D clock.
+    SYSCTL->RCGCQEI |= 0x01;      // QEI0 clock.
+    while ((SYSCTL->PRGPIO & 0x08) == 0) { }
+    while ((SYSCTL->PRQEI & 0x01) == 0) { }
+
+    GPIOD->LOCK = 0x4C4F434B;     // PD7 is an NMI pin: unlock it before changing its function.
+    GPIOD->CR |= ENC_PINS;
+    GPIOD->DIR &= ~(ENC_PINS | ENC_SWITCH);
+    GPIOD->AMSEL &= ~(ENC_PINS | ENC_SWITCH);
+    GPIOD->AFSEL |= ENC_PINS;
+    GPIOD->PCTL = (GPIOD->PCTL & 0x00FFFFFF) | 0x66000000;  // PD6/PD7 mux 6: PhA0/PhB0.
+    GPIOD->PUR |= ENC_PINS | ENC_SWITCH;  // Mechanical encoders switch to ground.
+    GPIOD->DEN |= ENC_PINS | ENC_SWITCH;
+
+    QEI0->CTL = 0;                // Disabled while configuring.
+    QEI0->MAXPOS = 0xFFFFFFFF;    // Free-running position; Encoder_Read works on differences.
+    QEI0->POS = 0;
+    QEI0->LOAD = (CFG_SYSTEM_CLOCK_HZ / 1000U) * CFG_ENCODER_VELOCITY_MS - 1U;
+    QEI0->CTL = QEI_CAPMODE | QEI_VELEN | QEI_FILTEN | QEI_FILTCNT | QEI_ENABLE;
+    last_pos = 0;
+    residual = 0;
+}
+
+int32_t Encoder_Read(void) {
+    uint32_t pos = QEI0->POS;
+    int32_t counts = (int32_t)(pos - last_pos) + residual;
+    int32_t detents = counts / (int32_t)CFG_ENCODER_COUNTS_PER_DETENT;
+    uint32_t edges, step;
+    last_pos = pos;
+    residual = counts - detents * (int32_t)CFG_ENCODER_COUNTS_PER_DETENT;
+    if (detents == 0)
+        return 0;
+
+    // Edges in the last velocity period, compared as detents per second without dividing.
+    edges = QEI0->SPEED * 1000U;
+    if (edges >= CFG_ENCODER_FAST_SPEED * CFG_ENCODER_COUNTS_PER_DETENT * CFG_ENCODER_VELOCITY_MS)
+        step = CFG_ENCODER_COARSE_STEP;
+    else if (edges >= CFG_ENCODER_MID_SPEED * CFG_ENCODER_COUNTS_PER_DETENT * CFG_ENCODER_VELOCITY_MS)
+        step = CFG_ENCODER_MID_STEP;
+    else
+        step = CFG_ENCODER_FINE_STEP;
+    return detents * (int32_t)step;
+}
+
+int Encoder_Switch_Pressed(void) {
+    return (GPIOD->DATA & ENC_SWITCH) == 0;
+}
@@ -0,0 +1,27 @@
+//encoder.h
+// Rotary encoder input for threshold selection, read by the TM4C123's QEI0 module.
+//
+// The encoder's A/B phases go to PhA0 (PD6) and PhB0 (PD7) and its push switch to PD2
+// (active low, internal pull-up). QEI0 counts every edge of both phases into its position
+// register and the number of edges per CFG_ENCODER_VELOCITY_MS into its speed register, so
+// turning the knob costs no CPU time; the selection loop only reads the two registers.
+//
+// Each detent moves the threshold by CFG_ENCODER_FINE_STEP, MID_STEP or COARSE_STEP USD
+// depending on how fast the knob is turned. The PF4 push button keeps working alongside
+// the encoder, so a board without one behaves as before.
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdint.h>
+
+// Configure PD6/PD7 for QEI0, PD2 for the push switch, and start counting.
+void Encoder_Init(void);
+
+// USD to add to the threshold for the detents turned since the previous call (negative
+// when turned counter-clockwise). Partial detents are carried over to the next call.
+int32_t Encoder_Read(void);
+
+// Non-zero while the encoder's push switch is held down.
+int Encoder_Switch_Pressed(void);
+
+#endif // ENCODER_H
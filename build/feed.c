@@ -0,0 +1,300 @@
+//feed.c
+
+#include "feed.h"
+#include "usbcdc.h"
+#include "tracker.h"
+#include "flashlog.h"
+#include "link.h"
+#include "rules.h"
+#include "dsp.h"
+#include <string.h>
+
+#define FEED_OVERHEAD 4U          // Sync, type, length and check bytes around each payload
+
+typedef char feed_dump_fits[(FEED_OVERHEAD + 8U * CFG_FEED_DUMP_CHUNK <= CFG_FEED_BUFFER_SIZE &&
+                             8U * CFG_FEED_DUMP_CHUNK <= 255U) ? 1 : -1];
+
+FeedStats feed_stats;
+
+static uint8_t buf[2][CFG_FEED_BUFFER_SIZE];  // One buffer fills while the other is sent
+static uint8_t fill = 0;                       // Buffer being filled
+static uint32_t fill_len = 0;                  // Bytes in it
+
+static uint8_t dumping = 0;       // 1 while a history dump is in progress
+static uint32_t dump_from;        // Time of the next record to dump
+static uint32_t dump_count;       // Records sent so far
+static uint32_t counters_due;     // Millis() of the next counters record
+static uint8_t boot_sent;         // 1 once the completed boot timeline went to a host
+static uint32_t test_sent;        // link_self_test.runs whose result went to the host
+static uint32_t notify_sent;      // link_alarm_stats.acked + timeouts reported to the host
+static uint32_t rules_sent;       // rules_stats.changes reported to the host
+static uint8_t cmd_rec[3 + 255 + 1];  // Command record being received (FEED_CMD_LOAD)
+static uint32_t cmd_len;          // Bytes of it so far, 0 outside a record
+
+// Hand the filled buffer to the USB driver if it is idle. Runs from the main loop (with the
+// USB interrupt masked) and from the interrupt when a transfer ends.
+static void Feed_Kick(void) {
+    if (fill_len && Cdc_Send(buf[fill], fill_len)) {
+        fill ^= 1;
+        fill_len = 0;
+    }
+}
+
+static void Feed_Tx_Done(void) {
+    Feed_Kick();
+}
+
+static void Put16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void Put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Free bytes in the filling buffer (0 when the host is absent).
+static uint32_t Feed_Room(void) {
+    return Cdc_Ready() ? CFG_FEED_BUFFER_SIZE - fill_len : 0;
+}
+
+// Queue one record. Returns 0 if it was dropped.
+static int Feed_Put(uint8_t type, const uint8_t *payload, uint32_t len) {
+    uint8_t *p, check = (uint8_t)(type ^ len);
+    uint32_t i;
+    int ok = 0;
+    NVIC_DisableIRQ(USB0_IRQn);
+    if (!Cdc_Ready()) {
+        fill_len = 0;                 // Nothing stale is left for the next host.
+    } else if (fill_len + len + FEED_OVERHEAD <= CFG_FEED_BUFFER_SIZE) {
+        p = &buf[fill][fill_len];
+        p[0] = FEED_SYNC;
+        p[1] = type;
+        p[2] = (uint8_t)len;
+        for (i = 0; i < len; i++) {
+            p[3 + i] = payload[i];
+            check ^= payload[i];
+        }
+        p[3 + len] = check;
+        fill_len += len + FEED_OVERHEAD;
+        Feed_Kick();                  // Goes out at once unless a transfer is in flight.
+        ok = 1;
+    }
+    NVIC_EnableIRQ(USB0_IRQn);
+    if (ok)
+        feed_stats.records++;
+    else
+        feed_stats.dropped++;
+    return ok;
+}
+
+void Feed_Init(void) {
+    Cdc_Init(Feed_Tx_Done);
+}
+
+void Feed_Tick(uint32_t time, int32_t price_cents, int16_t change_centi) {
+    uint8_t r[14];
+    Put32(&r[0], time);
+    Put32(&r[4], (uint32_t)price_cents);
+    Put16(&r[8], (uint16_t)change_centi);
+    Put32(&r[10], Millis());
+    if (Feed_Put(FEED_TICK, r, sizeof(r)))
+        feed_stats.ticks++;
+}
+
+void Feed_Frame(char tag, int accepted, uint32_t len) {
+    uint8_t r[8];
+    r[0] = (uint8_t)tag;
+    r[1] = (uint8_t)(accepted != 0);
+    Put16(&r[2], len);
+    Put32(&r[4], Millis());
+    Feed_Put(FEED_FRAME, r, sizeof(r));
+}
+
+void Feed_Alarm(int on, int32_t price_cents) {
+    uint8_t r[9];
+    r[0] = (uint8_t)(on != 0);
+    Put32(&r[1], (uint32_t)price_cents);
+    Put32(&r[5], Millis());
+    Feed_Put(FEED_ALARM, r, sizeof(r));
+}
+
+static void Feed_Counters(uint32_t now) {
+    uint8_t r[36];
+    Put32(&r[0], now);
+    Put32(&r[4], feed_stats.ticks);
+    Put32(&r[8], uart_rx_dropped);
+    Put32(&r[12], link_bad_frames);
+    Put32(&r[16], feed_stats.records);
+    Put32(&r[20], feed_stats.dropped);
+    Put32(&r[24], cdc_stats.bytes_in);
+    Put32(&r[28], lcd_stats.bytes_per_s);
+    Put32(&r[32], lcd_stats.busy_us);
+    Feed_Put(FEED_COUNTERS, r, sizeof(r));
+}
+
+static int Feed_Boot(void) {
+    uint8_t r[4 * BOOT_STAGES + 8];
+    uint32_t i;
+    for (i = 0; i < BOOT_STAGES; i++)
+        Put32(&r[4 * i], boot_timeline.us[i]);
+    Put32(&r[4 * BOOT_STAGES], boot_timeline.early_lines);
+    Put32(&r[4 * BOOT_STAGES + 4], boot_timeline.ring_peak);
+    return Feed_Put(FEED_BOOT, r, sizeof(r));
+}
+
+static int Feed_Test(void) {
+    const FrameTestResult *t = &link_self_test.result;
+    uint8_t r[32];
+    Put32(&r[0], t->steps);
+    Put32(&r[4], t->best_rate);
+    Put32(&r[8], t->best_size);
+    Put32(&r[12], t->best_bps);
+    Put32(&r[16], t->cpu_pct);
+    Put32(&r[20], t->parse_rate);
+    Put32(&r[24], t->display_rate);
+    Put32(&r[28], t->lost);
+    return Feed_Put(FEED_TEST, r, sizeof(r));
+}
+
+static int Feed_Notify(void) {
+    const LinkAlarmStats *a = &link_alarm_stats;
+    uint8_t r[24];
+    Put32(&r[0], a->id_last);
+    Put32(&r[4], a->status_last);
+    Put32(&r[8], a->attempts_last);
+    Put32(&r[12], a->latency_last_ms);
+    Put32(&r[16], a->forward_last_ms);
+    Put32(&r[20], a->timeouts);
+    return Feed_Put(FEED_NOTIFY, r, sizeof(r));
+}
+
+static int Feed_Rules(void) {
+    const RulesStats *s = &rules_stats;
+    uint8_t r[40];
+    r[0] = s->status;
+    r[1] = s->source;
+    r[2] = s->count;
+    r[3] = s->bytes;
+    Put32(&r[4], s->ops);
+    Put32(&r[8], s->bound);
+    Put32(&r[12], CFG_RULES_BUDGET_CYCLES);
+    Put32(&r[16], s->last);
+    Put32(&r[20], s->max);
+    Put32(&r[24], s->inputs_max);
+    Put32(&r[28], s->overruns);
+    Put32(&r[32], s->fired);
+    Put32(&r[36], s->op_ns_x10);
+    return Feed_Put(FEED_RULES, r, sizeof(r));
+}
+
+#ifdef DSP_BENCHMARK
+static int Feed_Dsp(void) {
+    DspBench b;
+    uint8_t r[36];
+    Dsp_Benchmark(&b);
+    Put32(&r[0], b.samples);
+    Put32(&r[4], b.sum_simd);
+    Put32(&r[8], b.sum_scalar);
+    Put32(&r[12], b.minmax_simd);
+    Put32(&r[16], b.minmax_scalar);
+    Put32(&r[20], b.mean_simd);
+    Put32(&r[24], b.mean_scalar);
+    Put32(&r[28], b.resample_simd);
+    Put32(&r[32], b.resample_scalar);
+    return Feed_Put(FEED_DSP, r, sizeof(r));
+}
+#endif
+
+// Collect a command record byte by byte; act on it once it is complete and intact.
+static void Feed_Record_Byte(uint8_t c) {
+    uint32_t i;
+    uint8_t check;
+    cmd_rec[cmd_len++] = c;
+    if (cmd_len < 3 || cmd_len < (uint32_t)cmd_rec[2] + FEED_OVERHEAD)
+        return;
+    cmd_len = 0;
+    check = cmd_rec[1] ^ cmd_rec[2];
+    for (i = 0; i < cmd_rec[2]; i++)
+        check ^= cmd_rec[3 + i];
+    if (check == cmd_rec[3 + cmd_rec[2]] && cmd_rec[1] == FEED_CMD_LOAD)
+        Rules_Load(&cmd_rec[3], cmd_rec[2], RULES_HOST);
+}
+
+// Send the next chunk of the history dump if it fits without dropping anything.
+static void Feed_Dump_Step(void) {
+    FlashLogRecord recs[CFG_FEED_DUMP_CHUNK];
+    uint8_t r[8 * CFG_FEED_DUMP_CHUNK];
+    uint32_t n, i;
+    if (Feed_Room() < sizeof(r) + FEED_OVERHEAD)
+        return;                       // Try again once the buffer has drained.
+    n = FlashLog_Read(dump_from, 0xFFFFFFFFU, recs, CFG_FEED_DUMP_CHUNK);
+    if (n == 0) {
+        Put32(r, dump_count);
+        Feed_Put(FEED_DUMP_END, r, 4);
+        dumping = 0;
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        Put32(&r[8 * i], recs[i].time);
+        Put32(&r[8 * i + 4], (uint32_t)recs[i].price);
+    }
+    if (Feed_Put(FEED_HISTORY, r, 8 * n)) {
+        dump_count += n;
+        dump_from = recs[n - 1].time + 1;
+    }
+}
+
+void Feed_Poll(uint32_t now) {
+    uint8_t cmd[8];
+    uint32_t n = Cdc_Receive(cmd, sizeof(cmd)), i;
+    for (i = 0; i < n; i++) {
+        if (cmd_len || cmd[i] == FEED_SYNC) {
+            Feed_Record_Byte(cmd[i]);
+        } else if (cmd[i] == FEED_CMD_DUMP) {
+            dumping = 1;
+            dump_from = 0;
+            dump_count = 0;
+        } else if (cmd[i] == FEED_CMD_ABORT) {
+            dumping = 0;
+        } else if (cmd[i] == FEED_CMD_COUNTERS) {
+            counters_due = now;
+        } else if (cmd[i] == FEED_CMD_BOOT) {
+            Feed_Boot();
+        } else if (cmd[i] == FEED_CMD_TEST) {
+            Link_SelfTest_Request();
+        } else if (cmd[i] == FEED_CMD_NOTIFY) {
+            Link_Alarm(1, 0, 0, 1);
+        } else if (cmd[i] == FEED_CMD_STORE) {
+            Rules_Store();
+        } else if (cmd[i] == FEED_CMD_RULES) {
+            Feed_Rules();
+#ifdef DSP_BENCHMARK
+        } else if (cmd[i] == FEED_CMD_DSP) {
+            Feed_Dsp();
+#endif
+        }
+    }
+    if (rules_stats.changes != rules_sent && Cdc_Ready() && Feed_Rules())
+        rules_sent = rules_stats.changes;
+    if (link_alarm_stats.acked + link_alarm_stats.timeouts != notify_sent && Cdc_Ready() && Feed_Notify())
+        notify_sent = link_alarm_stats.acked + link_alarm_stats.timeouts;
+    if (link_self_test.runs != test_sent && Cdc_Ready() && Feed_Test())
+        test_sent = link_self_test.runs;
+    if (!boot_sent && boot_timeline.us[BOOT_FIRST_PRICE] && Cdc_Ready())
+        boot_sent = (uint8_t)Feed_Boot();
+    if ((int32_t)(now - counters_due) >= 0) {
+        counters_due = now + CFG_FEED_COUNTERS_MS;
+        if (Cdc_Ready())
+            Feed_Counters(now);
+    }
+    if (dumping) {
+        if (Cdc_Ready())
+            Feed_Dump_Step();
+        else
+            dumping = 0;              // Host went away.
+    }
+}
@@ -0,0 +1,73 @@
+//feed.h
+// Binary tick/event feed to a PC over the USB CDC port (usbcdc.h).
+//
+// Every record is
+//
+//     0xA5  <type>  <len>  <payload: len bytes>  <check>
+//
+// with multi-byte fields little-endian and <check> the XOR of type, len and the payload,
+// so a reader that attaches mid-stream can resynchronise on the next valid record.
+// tools/feed_decode.py decodes the stream and reports throughput.
+//
+// Records are appended to one of two buffers while the other is on the bus; the USB
+// interrupt switches buffers as soon as a transfer ends. Appending never waits: with no
+// host attached, or when the host does not keep up, records are dropped and counted.
+#ifndef FEED_H
+#define FEED_H
+
+#include <stdint.h>
+
+#define FEED_SYNC      0xA5
+
+// Record types (device -> host)
+#define FEED_TICK      'T'        // u32 time, i32 price (cents), i16 change (0.01 %), u32 ms
+#define FEED_FRAME     'F'        // u8 tag, u8 accepted, u16 line length, u32 ms
+#define FEED_ALARM     'A'        // u8 on, i32 price (cents), u32 ms
+#define FEED_COUNTERS  'C'        // u32 ms, ticks, uart_rx_dropped, link_bad_frames, records, dropped, usb bytes,
+                                  // LCD bytes per s (all panels), LCD busy (us)
+#define FEED_HISTORY   'R'        // n x (u32 time, i32 price (cents)) from the flash log, oldest first
+#define FEED_DUMP_END  'E'        // u32 records sent in the dump
+#define FEED_BOOT      'B'        // BOOT_STAGES x u32 stage end (us), u32 early lines, u32 ring peak (bytes)
+#define FEED_TEST      'S'        // Link self-test result: u32 x 8 as in FrameTestResult (frame.h)
+#define FEED_NOTIFY    'N'        // Alarm notification outcome: u32 id, status (FRAME_NOTIFY_*), attempts,
+                                  // latency (ms), forward (ms), timeouts
+#define FEED_RULES     'V'        // Alert rules (rules.h): u8 status, source, count, bytes, u32 ops, bound,
+                                  // budget, last, max, inputs_max, overruns, fired, ns per op (x10)
+#define FEED_DSP       'K'        // Dsp_Benchmark() (dsp.h): u32 samples, then cycles of the kernel and of
+                                  // the plain C loop for sum, min/max, mean and resample
+
+// Commands (host -> device), one byte each except FEED_CMD_LOAD
+#define FEED_CMD_DUMP     'D'     // Dump the whole flash history
+#define FEED_CMD_ABORT    'X'     // Stop a dump in progress
+#define FEED_CMD_COUNTERS 'C'     // Send a counters record now
+#define FEED_CMD_BOOT     'B'     // Send the boot timeline now (it is also sent once, after the first price)
+#define FEED_CMD_TEST     'S'     // Ask the ESP32 for a link self-test (the result record follows when it ends)
+#define FEED_CMD_NOTIFY   'N'     // Send a test alarm notification through the ESP32 (its outcome record follows)
+#define FEED_CMD_RULES    'V'     // Send the alert rules record now
+#define FEED_CMD_DSP      'K'     // Run the DSP kernel benchmark and send its record (DSP_BENCHMARK builds)
+#define FEED_CMD_STORE    'W'     // Store the running alert rules in the EEPROM (a rules record follows)
+#define FEED_CMD_LOAD     'L'     // A record in the framing above, 0xA5 'L' <len> <rule image> <check>:
+                                  // load the image as the running rules (empty: the built-in set).
+                                  // A rules record follows; a record with a bad check is ignored.
+
+typedef struct {
+    uint32_t records;             // Records queued for the host
+    uint32_t dropped;             // Records dropped (no host, or both buffers full)
+    uint32_t ticks;               // Tick records queued
+} FeedStats;
+
+extern FeedStats feed_stats;
+
+// Start the USB CDC port and the feed.
+void Feed_Init(void);
+
+// Event records, called from the main loop.
+void Feed_Tick(uint32_t time, int32_t price_cents, int16_t change_centi);
+void Feed_Frame(char tag, int accepted, uint32_t len);
+void Feed_Alarm(int on, int32_t price_cents);
+
+// Handle host commands, send the periodic counters and advance a history dump.
+// Call whenever the main loop is idle; 'now' is Millis().
+void Feed_Poll(uint32_t now);
+
+#endif // FEED_H
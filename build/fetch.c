@@ -0,0 +1,65 @@
+//fetch.c
+
+#include "fetch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Start of the value of "key" inside [p, end), or NULL.
+static const char *Json_Value(const char *p, const char *end, const char *key) {
+    size_t klen = strlen(key);
+    while (p < end && (p = memchr(p, '"', (size_t)(end - p))) != NULL) {
+        if ((size_t)(end - p) > klen + 1 && memcmp(p + 1, key, klen) == 0 && p[klen + 1] == '"') {
+            const char *v = p + klen + 2;
+            while (v < end && (*v == ' ' || *v == '\t' || *v == '\r' || *v == '\n'))
+                v++;
+            if (v < end && *v == ':') {
+                v++;
+                while (v < end && (*v == ' ' || *v == '\t' || *v == '\r' || *v == '\n'))
+                    v++;
+                return v;
+            }
+        }
+        p++;
+    }
+    return NULL;
+}
+
+static int Json_Number(const char *p, const char *end, const char *key, double *out) {
+    const char *v = Json_Value(p, end, key);
+    char *stop;
+    double d;
+    if (v == NULL || v >= end)
+        return 0;
+    d = strtod(v, &stop);
+    if (stop == v || stop > end)
+        return 0;
+    *out = d;
+    return 1;
+}
+
+int Fetch_Parse_Coin(const char *json, size_t len, double *price, double *change) {
+    const char *end = json + len;
+    const char *cur = Json_Value(json, end, "current_price");
+    if (cur == NULL || *cur != '{')
+        return 0;
+    return Json_Number(cur, end, "usd", price) &&
+           Json_Number(json, end, "price_change_percentage_24h", change);
+}
+
+int Fetch_Parse_Simple(const char *json, size_t len, const char *id, double *price, double *change) {
+    const char *end = json + len;
+    const char *obj = Json_Value(json, end, id), *close;
+    if (obj == NULL || *obj != '{')
+        return 0;
+    close = memchr(obj, '}', (size_t)(end - obj));   // The per-asset object holds no nested objects.
+    if (close == NULL)
+        return 0;
+    return Json_Number(obj, close, "usd", price) &&
+           Json_Number(obj, close, "usd_24h_change", change);
+}
+
+size_t Fetch_Format_Price(char *buf, size_t cap, double price, double change, unsigned long stamp) {
+    int n = snprintf(buf, cap, CFG_PROTO_PRICE_TX "\n", price, change, stamp);
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
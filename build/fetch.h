@@ -0,0 +1,35 @@
+//fetch.h
+// Price extraction and price-line encoding shared by the ESP32 sketch and the Linux feeder
+// daemon (linux/feederd.c). Portable C, no allocation.
+//
+// The parsers scan the API's JSON text for the few keys they need instead of building a
+// document, so a response of any size costs no memory beyond the text itself. The text
+// must be NUL-terminated.
+#ifndef FETCH_H
+#define FETCH_H
+
+#include <stddef.h>
+#include "tracker_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Response of /coins/<id> (CFG_PROTO_PRICE_URL): market_data.current_price.usd and
+// market_data.price_change_percentage_24h. Returns 1 when both were found.
+int Fetch_Parse_Coin(const char *json, size_t len, double *price, double *change);
+
+// Response of /simple/price (CFG_PROTO_SIMPLE_URL), which holds several assets:
+//   {"bitcoin":{"usd":65000.1,"usd_24h_change":-1.2},"ethereum":{...}}
+// Returns 1 when both values of 'id' were found.
+int Fetch_Parse_Simple(const char *json, size_t len, const char *id, double *price, double *change);
+
+// Format the price line sent to the TM4C (CFG_PROTO_PRICE_TX plus a newline). 'stamp' is
+// Unix time, or 0 when the sender's clock is not set. Returns the length, 0 if it did not fit.
+size_t Fetch_Format_Price(char *buf, size_t cap, double price, double change, unsigned long stamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FETCH_H
@@ -0,0 +1,353 @@
+//flashlog.c
+
+#include "tracker.h"
+#include "flashlog.h"
+#include <stddef.h>
+
+#define FLASHLOG_MAGIC 0x464C4F47U   // "FLOG"
+#define FLASH_ERASED   0xFFFFFFFFU   // Value of an erased flash word
+
+// Flash controller keys and command bits (TM4C123GH6PM datasheet, "Flash Memory"):
+#define FLASH_WRKEY    0xA4420000U   // Write key for FMC/FMC2 (BOOTCFG KEY bit set, the default)
+#define FMC_WRITE      0x00000001U   // FMC: program one word from FMD
+#define FMC_ERASE      0x00000002U   // FMC: erase the 1 KB block containing FMA
+#define FMC2_WRBUF     0x00000001U   // FMC2: program the 32-word write buffer
+#define FWB_WORDS      32U           // Words in the write buffer (one 128-byte aligned block)
+
+// A board shim (qemu/TM4C123GH6PM.h) may stand in for the flash with its own model.
+#ifndef FLASH_FWB
+#define FLASH_FWB(n)   (*((volatile uint32_t *)(0x400FD100U + 4U * (n))))  // Write buffer word n
+#endif
+#ifndef FLASH_MEM_BASE
+#define FLASH_MEM_BASE 0U            // Flash is read where it is mapped, from address 0
+#endif
+
+#define SEG_COUNT      CFG_FLASHLOG_SEGMENTS
+#define SEG_ADDR(i)    (CFG_FLASHLOG_BASE + (uint32_t)(i) * CFG_FLASHLOG_SECTOR_SIZE)
+#define SEG_HDR(i)     ((const volatile FlashLogHeader *)(FLASH_MEM_BASE + SEG_ADDR(i)))
+#define SEG_REC(i)     ((const volatile FlashLogRecord *)(FLASH_MEM_BASE + SEG_ADDR(i) + sizeof(FlashLogHeader)))
+
+// Compile-time layout checks (a failed check declares an array of size -1).
+typedef char flashlog_assert_header[(sizeof(FlashLogHeader) == 96) ? 1 : -1];
+typedef char flashlog_assert_batch[(CFG_FLASHLOG_BATCH <= FLASHLOG_RECORDS_PER_SEG) ? 1 : -1];
+typedef char flashlog_assert_align[(CFG_FLASHLOG_BASE % CFG_FLASHLOG_SECTOR_SIZE) == 0 ? 1 : -1];
+typedef char flashlog_assert_count[(FLASHLOG_RECORDS_PER_SEG < 0x10000U) ? 1 : -1];
+
+// RAM index of the segments: time range and committed record count of each one.
+static uint32_t seg_first[SEG_COUNT];   // Time of the first record (only valid if seg_count > 0)
+static uint32_t seg_last[SEG_COUNT];    // Time of the last committed record
+static uint16_t seg_count[SEG_COUNT];   // Committed records (0 = empty or invalid segment)
+
+static int active = -1;                 // Segment currently being appended to, -1 if the log is empty
+static uint32_t active_seq = 0;         // Sequence number of the active segment
+static uint8_t active_commits = 0;      // Commit slots used in the active segment
+static uint8_t active_open = 0;         // 1 if the active segment can take more records
+
+static FlashLogRecord batch[CFG_FLASHLOG_BATCH];  // Ticks waiting to be committed
+static uint8_t batch_len = 0;                     // Number of ticks in 'batch'
+static uint32_t last_time = 0;                    // Newest time accepted (logged or batched)
+
+// Low-level flash access:
+
+static void Flash_Erase_Sector(uint32_t addr) {
+    FLASH_CTRL->FMA = addr;                         // Address inside the block to erase.
+    FLASH_CTRL->FMC = FLASH_WRKEY | FMC_ERASE;      // Start the erase.
+    while (FLASH_CTRL->FMC & FMC_ERASE) { }         // The bit clears when the erase is done.
+}
+
+static void Flash_Program_Word(uint32_t addr, uint32_t word) {
+    FLASH_CTRL->FMA = addr;                         // Word-aligned destination.
+    FLASH_CTRL->FMD = word;                         // Data to program.
+    FLASH_CTRL->FMC = FLASH_WRKEY | FMC_WRITE;      // Start programming.
+    while (FLASH_CTRL->FMC & FMC_WRITE) { }         // Wait until the word is programmed.
+}
+
+// Program 'n' consecutive words using the 32-word write buffer, split at 128-byte blocks.
+static void Flash_Program_Words(uint32_t addr, const uint32_t *words, uint32_t n) {
+    while (n) {
+        uint32_t base = addr & ~(FWB_WORDS * 4U - 1U);    // 128-byte aligned block holding 'addr'
+        uint32_t first = (addr - base) / 4U;              // First buffer slot to fill
+        uint32_t chunk = FWB_WORDS - first;               // Slots left in this block
+        uint32_t i;
+        if (chunk > n)
+            chunk = n;
+        FLASH_CTRL->FMA = base;
+        for (i = 0; i < chunk; i++)
+            FLASH_FWB(first + i) = words[i];              // Writing a slot marks it valid in FWBVAL.
+        FLASH_CTRL->FMC2 = FLASH_WRKEY | FMC2_WRBUF;      // Program all valid slots at once.
+        while (FLASH_CTRL->FMC2 & FMC2_WRBUF) { }
+        addr += chunk * 4U;
+        words += chunk;
+        n -= chunk;
+    }
+}
+
+// Commit words hold the record count in the low half and its complement in the high half,
+// so an erased word (0xFFFFFFFF) and a torn write are both rejected.
+static uint32_t Commit_Encode(uint32_t count) {
+    return (count & 0xFFFFU) | ((~count & 0xFFFFU) << 16);
+}
+
+static int Commit_Decode(uint32_t word, uint32_t *count) {
+    if ((word >> 16) != (~word & 0xFFFFU))
+        return 0;
+    *count = word & 0xFFFFU;
+    return *count <= FLASHLOG_RECORDS_PER_SEG;
+}
+
+static int Header_Valid(int i) {
+    const volatile FlashLogHeader *h = SEG_HDR(i);
+    return h->magic == FLASHLOG_MAGIC && h->seq_inv == ~h->seq;
+}
+
+// Walk the commit table of segment 'i'. Returns the committed record count, the number of
+// commit slots in use and whether anything after the last good commit was partly written.
+static uint32_t Segment_Scan(int i, uint8_t *commits, int *torn) {
+    const volatile FlashLogHeader *h = SEG_HDR(i);
+    uint32_t count = 0, c, j;
+    *torn = 0;
+    for (j = 0; j < FLASHLOG_COMMIT_SLOTS; j++) {
+        uint32_t w = h->commit[j];
+        if (w == FLASH_ERASED)
+            break;                          // First free slot: everything before it is committed.
+        if (!Commit_Decode(w, &c) || c < count) {
+            *torn = 1;                      // Power was lost while programming this commit word.
+            break;
+        }
+        count = c;
+    }
+    *commits = (uint8_t)j;
+    if (!*torn && count < FLASHLOG_RECORDS_PER_SEG) {
+        // The slot after the last commit must still be erased, otherwise a batch was cut short.
+        const volatile FlashLogRecord *r = &SEG_REC(i)[count];
+        if ((uint32_t)r->time != FLASH_ERASED || (uint32_t)r->price != FLASH_ERASED)
+            *torn = 1;
+    }
+    return count;
+}
+
+static void Segment_Seal(void) {
+    if (seg_count[active])               // Mark it sealed: the next boot does not append to it.
+        Flash_Program_Word(SEG_ADDR(active) + offsetof(FlashLogHeader, t_last), seg_last[active]);
+    active_open = 0;
+}
+
+static void Segment_Open(uint32_t t_first) {
+    uint32_t hdr[4];
+    int next = (active < 0) ? 0 : (active + 1) % (int)SEG_COUNT;  // Oldest segment: round-robin wear levelling.
+    Flash_Erase_Sector(SEG_ADDR(next));
+    seg_count[next] = 0;
+
+    active_seq = (active < 0) ? 1 : active_seq + 1;
+    hdr[0] = FLASHLOG_MAGIC;
+    hdr[1] = active_seq;
+    hdr[2] = ~active_seq;
+    hdr[3] = t_first;
+    Flash_Program_Words(SEG_ADDR(next), hdr, 4);
+
+    active = next;
+    active_commits = 0;
+    active_open = 1;
+}
+
+// Program records into the log, opening and sealing segments as they fill up. The CPU stalls
+// on flash reads while an erase or a program runs, the UART interrupt with it, so the ESP32
+// is held off meanwhile (with flow control configured) instead of overrunning the RX FIFO.
+static void Log_Commit(const FlashLogRecord *recs, uint32_t n) {
+    UART1_Hold(1);
+    while (n) {
+        uint32_t room, pos;
+        if (!active_open)
+            Segment_Open(recs[0].time);
+        pos = seg_count[active];
+        room = FLASHLOG_RECORDS_PER_SEG - pos;
+        if (room > n)
+            room = n;
+
+        Flash_Program_Words(SEG_ADDR(active) + sizeof(FlashLogHeader) + pos * sizeof(FlashLogRecord),
+                            (const uint32_t *)recs, room * 2U);
+        Flash_Program_Word(SEG_ADDR(active) + offsetof(FlashLogHeader, commit) + 4U * active_commits,
+                           Commit_Encode(pos + room));   // The batch becomes durable here.
+        active_commits++;
+
+        if (pos == 0)
+            seg_first[active] = recs[0].time;
+        seg_count[active] = (uint16_t)(pos + room);
+        seg_last[active] = recs[room - 1].time;
+
+        if (seg_count[active] == FLASHLOG_RECORDS_PER_SEG || active_commits == FLASHLOG_COMMIT_SLOTS)
+            Segment_Seal();
+        recs += room;
+        n -= room;
+    }
+    UART1_Hold(0);
+}
+
+void FlashLog_Init(void) {
+    int i, torn;
+    uint8_t commits;
+
+    active = -1;
+    active_open = 0;
+    batch_len = 0;
+    last_time = 0;
+
+    // Pass 1: headers and commit tables only, to rebuild the time index.
+    for (i = 0; i < (int)SEG_COUNT; i++) {
+        const volatile FlashLogHeader *h = SEG_HDR(i);
+        seg_count[i] = 0;
+        if (!Header_Valid(i))
+            continue;
+        seg_count[i] = (uint16_t)Segment_Scan(i, &commits, &torn);
+        if (seg_count[i]) {
+            // The times come from the committed records, not from t_first/t_last: power may
+            // have been lost while either header word was programmed.
+            seg_first[i] = SEG_REC(i)[0].time;
+            seg_last[i] = SEG_REC(i)[seg_count[i] - 1].time;
+        }
+        if (active < 0 || (int32_t)(h->seq - active_seq) > 0) {
+            active = i;                      // Newest segment so far.
+            active_seq = h->seq;
+        }
+    }
+    if (active < 0)
+        return;                              // Empty log: the first append opens segment 0.
+
+    // Pass 2: decide whether the newest segment can keep taking records.
+    seg_count[active] = (uint16_t)Segment_Scan(active, &active_commits, &torn);
+    if (SEG_HDR(active)->t_last != FLASH_ERASED || seg_count[active] == FLASHLOG_RECORDS_PER_SEG) {
+        active_open = 0;                     // Already sealed or full.
+    } else if (torn || active_commits == FLASHLOG_COMMIT_SLOTS) {
+        Segment_Seal();                      // Cut off the torn tail; new records go to the next segment.
+    } else {
+        active_open = 1;
+    }
+    for (i = 0; i < (int)SEG_COUNT; i++)
+        if (seg_count[i] && seg_last[i] > last_time)
+            last_time = seg_last[i];
+}
+
+void FlashLog_Flush(void) {
+    if (batch_len == 0)
+        return;
+    Log_Commit(batch, batch_len);
+    batch_len = 0;
+}
+
+void FlashLog_Append(uint32_t time, int32_t price_cents) {
+    if (time == 0 || time == FLASH_ERASED || time <= last_time)
+        return;                              // Unknown or out-of-order time: keep segments sorted.
+    batch[batch_len].time = time;
+    batch[batch_len].price = price_cents;
+    batch_len++;
+    last_time = time;
+    if (batch_len == CFG_FLASHLOG_BATCH || time - batch[0].time >= CFG_FLASHLOG_FLUSH_S)
+        FlashLog_Flush();
+}
+
+// Index of the first record in segment 'i' with time >= t (binary search, records are sorted).
+static uint32_t Segment_Lower_Bound(int i, uint32_t t) {
+    const volatile FlashLogRecord *r = SEG_REC(i);
+    uint32_t lo = 0, hi = seg_count[i];
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2U;
+        if (r[mid].time < t)
+            lo = mid + 1U;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Visit every record in [t_from, t_to], oldest first. Stops early when 'visit' returns 0.
+static uint32_t Log_Walk(uint32_t t_from, uint32_t t_to,
+                         int (*visit)(const FlashLogRecord *rec, void *ctx), void *ctx) {
+    uint32_t n = 0, k, j;
+    FlashLogRecord rec;
+    if (active >= 0) {
+        for (k = 1; k <= SEG_COUNT; k++) {
+            int i = (int)((active + k) % SEG_COUNT);   // Oldest segment first, active one last.
+            const volatile FlashLogRecord *r = SEG_REC(i);
+            if (seg_count[i] == 0 || seg_last[i] < t_from || seg_first[i] > t_to)
+                continue;                              // Skipped using the RAM index only.
+            for (j = Segment_Lower_Bound(i, t_from); j < seg_count[i] && r[j].time <= t_to; j++) {
+                rec.time = r[j].time;
+                rec.price = r[j].price;
+                n++;
+                if (!visit(&rec, ctx))
+                    return n;
+            }
+        }
+    }
+    for (j = 0; j < batch_len; j++) {                  // Ticks not committed yet.
+        if (batch[j].time < t_from || batch[j].time > t_to)
+            continue;
+        n++;
+        if (!visit(&batch[j], ctx))
+            break;
+    }
+    return n;
+}
+
+typedef struct {
+    FlashLogRecord *out;
+    uint32_t max;
+    uint32_t n;
+} ReadCtx;
+
+static int Read_Visit(const FlashLogRecord *rec, void *ctx) {
+    ReadCtx *c = (ReadCtx *)ctx;
+    c->out[c->n++] = *rec;
+    return c->n < c->max;
+}
+
+uint32_t FlashLog_Read(uint32_t t_from, uint32_t t_to, FlashLogRecord *out, uint32_t max) {
+    ReadCtx c;
+    if (max == 0)
+        return 0;
+    c.out = out;
+    c.max = max;
+    c.n = 0;
+    Log_Walk(t_from, t_to, Read_Visit, &c);
+    return c.n;
+}
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+} MinMaxCtx;
+
+static int MinMax_Visit(const FlashLogRecord *rec, void *ctx) {
+    MinMaxCtx *c = (MinMaxCtx *)ctx;
+    if (rec->price < c->min) c->min = rec->price;
+    if (rec->price > c->max) c->max = rec->price;
+    return 1;
+}
+
+uint32_t FlashLog_MinMax(uint32_t t_from, uint32_t t_to, int32_t *min, int32_t *max) {
+    MinMaxCtx c;
+    uint32_t n;
+    c.min = 0x7FFFFFFF;
+    c.max = (int32_t)0x80000000;
+    n = Log_Walk(t_from, t_to, MinMax_Visit, &c);
+    if (n) {
+        *min = c.min;
+        *max = c.max;
+    }
+    return n;
+}
+
+uint32_t FlashLog_Oldest(void) {
+    uint32_t k;
+    if (active >= 0)
+        for (k = 1; k <= SEG_COUNT; k++) {
+            int i = (int)((active + k) % SEG_COUNT);
+            if (seg_count[i])
+                return seg_first[i];
+        }
+    return batch_len ? batch[0].time : 0;
+}
+
+uint32_t FlashLog_Newest(void) {
+    return last_time;
+}
@@ -0,0 +1,70 @@
+//flashlog.h
+// Append-only tick history log in internal flash.
+//
+// The log region (CFG_FLASHLOG_BASE, CFG_FLASHLOG_SEGMENTS sectors) is used as a ring of
+// erase-sector-sized segments. Each segment starts with a header and a commit table,
+// followed by fixed-size tick records:
+//
+//   +--------------------+  header: magic, sequence number (and its complement),
+//   | FlashLogHeader     |          time of the first record, time of the last record
+//   |   commit[16]       |          (written when the segment is sealed)
+//   +--------------------+
+//   | FlashLogRecord 0   |  records: {time, price in cents}, in time order
+//   | ...                |
+//   +--------------------+
+//
+// Ticks are batched in RAM and programmed CFG_FLASHLOG_BATCH at a time. A batch only
+// counts once its commit word (record count + complement) has been programmed, so a
+// power cut in the middle of a batch loses that batch and nothing else. Segments are
+// reused strictly round-robin, which spreads erases evenly over the whole region.
+#ifndef FLASHLOG_H
+#define FLASHLOG_H
+
+#include <stdint.h>
+#include "tracker_config.h"
+
+#define FLASHLOG_COMMIT_SLOTS 16  // Batch commits per segment (partial batches each use one)
+
+typedef struct {
+    uint32_t time;                // Tick time, seconds since the Unix epoch
+    int32_t price;                // Price in cents
+} FlashLogRecord;
+
+typedef struct {
+    uint32_t magic;               // FLASHLOG_MAGIC when the header is valid
+    uint32_t seq;                 // Monotonic segment sequence number
+    uint32_t seq_inv;             // ~seq, detects a torn header write
+    uint32_t t_first;             // Time of the first record in the segment
+    uint32_t t_last;              // Time of the last record, 0xFFFFFFFF until sealed
+    uint32_t reserved[3];         // Pads the header to 32 bytes
+    uint32_t commit[FLASHLOG_COMMIT_SLOTS];  // Committed record counts, one word per batch
+} FlashLogHeader;
+
+// Records that fit in one segment after the header (116 for 1 KB sectors).
+#define FLASHLOG_RECORDS_PER_SEG ((CFG_FLASHLOG_SECTOR_SIZE - sizeof(FlashLogHeader)) / sizeof(FlashLogRecord))
+
+// Scan the segment headers, rebuild the time index and prepare the active segment.
+// Only headers, commit tables and the first and last committed record of each segment are read.
+void FlashLog_Init(void);
+
+// Queue one tick for logging. Ticks must arrive in increasing time order; older or
+// duplicate timestamps are ignored. The batch is committed to flash once it is full or
+// its oldest tick is more than CFG_FLASHLOG_FLUSH_S seconds older than 'time'.
+void FlashLog_Append(uint32_t time, int32_t price_cents);
+
+// Commit whatever is buffered in RAM (e.g. before a planned power-down).
+void FlashLog_Flush(void);
+
+// Copy the records with t_from <= time <= t_to into 'out' (oldest first), including
+// ticks still waiting in the RAM batch. Returns the number of records copied (<= max).
+uint32_t FlashLog_Read(uint32_t t_from, uint32_t t_to, FlashLogRecord *out, uint32_t max);
+
+// Minimum and maximum price (cents) over [t_from, t_to] without copying records.
+// Returns the number of records in the range (0 leaves *min and *max untouched).
+uint32_t FlashLog_MinMax(uint32_t t_from, uint32_t t_to, int32_t *min, int32_t *max);
+
+// Time span covered by the log (0 if empty).
+uint32_t FlashLog_Oldest(void);
+uint32_t FlashLog_Newest(void);
+
+#endif // FLASHLOG_H
@@ -0,0 +1,30 @@
+//flow.c
+
+#include "flow.h"
+#include "tracker_config.h"
+
+typedef char flow_marks[(CFG_UART_FLOW_LOW < CFG_UART_FLOW_HIGH) ? 1 : -1];
+
+int Flow_Update(UartFlow *f, uint32_t pending) {
+    if (pending > f->peak)
+        f->peak = pending;
+    if (!f->stopped && pending >= CFG_UART_FLOW_HIGH) {
+        f->stopped = 1;
+        f->stops++;
+        return FLOW_STOP;
+    }
+    if (f->stopped && !f->held && pending <= CFG_UART_FLOW_LOW) {
+        f->stopped = 0;
+        return FLOW_GO;
+    }
+    return FLOW_KEEP;
+}
+
+int Flow_Hold(UartFlow *f, int hold, uint32_t pending) {
+    f->held = (uint8_t)(hold != 0);
+    if (hold && !f->stopped) {
+        f->stopped = 1;           // Not counted in 'stops': those measure a slow consumer.
+        return FLOW_STOP;
+    }
+    return Flow_Update(f, pending);
+}
@@ -0,0 +1,54 @@
+//flow.h
+// Receive flow control for the ESP32 -> TM4C UART (portable C, built for the TM4C and fleetsim).
+//
+// Bulk transfers (the history backfill, the link self-test) can arrive faster than the main
+// loop handles lines. Without flow control the 2 KB receive ring fills and the receive
+// interrupt drops bytes. With CFG_UART_FLOW set, the fill level of that ring, not the 16-byte
+// hardware FIFO, decides when the ESP32 has to wait: at CFG_UART_FLOW_HIGH bytes pending it is
+// held off, at CFG_UART_FLOW_LOW it may go on. The headroom above the high mark takes the
+// bytes already on their way (one or two with RTS/CTS, up to a TX FIFO's worth with XON/XOFF).
+//
+//   FLOW_RTSCTS   the TM4C drives U1RTS (PC4, as GPIO: low = send) into the ESP32's CTS, and
+//                 its transmitter honours the ESP32's RTS on U1CTS (PC5)
+//   FLOW_XONXOFF  two-wire fallback: the TM4C sends XOFF / XON, which the ESP32's UART obeys
+#ifndef FLOW_H
+#define FLOW_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLOW_NONE    0
+#define FLOW_RTSCTS  1
+#define FLOW_XONXOFF 2
+
+#define FLOW_XON     0x11         // DC1
+#define FLOW_XOFF    0x13         // DC3
+
+// What the receiver has to do after Flow_Update().
+#define FLOW_KEEP    0
+#define FLOW_STOP    1            // Deassert RTS / send XOFF
+#define FLOW_GO      2            // Assert RTS / send XON
+
+typedef struct {
+    uint8_t stopped;              // 1 while the sender is held off
+    uint8_t held;                 // 1 while Flow_Hold() keeps it off regardless of the fill level
+    uint32_t stops;               // Times the sender was held off
+    uint32_t peak;                // Most bytes seen waiting
+} UartFlow;
+
+// Report 'pending' bytes waiting in the receive ring (after a fill in the receive interrupt,
+// or after the main loop took a line). Returns FLOW_STOP or FLOW_GO on a change of state.
+int Flow_Update(UartFlow *f, uint32_t pending);
+
+// Hold the sender off (hold = 1) around a stretch in which the receive interrupt cannot run,
+// e.g. a flash erase, and release it again (hold = 0). Same return value as Flow_Update().
+int Flow_Hold(UartFlow *f, int hold, uint32_t pending);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLOW_H
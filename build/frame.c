@@ -0,0 +1,377 @@
+//frame.c
+
+#include "frame.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+uint8_t Frame_Checksum(const char *s, size_t len) {
+    uint8_t sum = 0;
+    while (len--)
+        sum ^= (uint8_t)*s++;
+    return sum;
+}
+
+size_t Frame_Seal(char *buf, size_t len, size_t cap) {
+    uint8_t sum;
+    if (len < 2 || buf[0] != '$' || len + 4 > cap || len + 3 > FRAME_MAX_LEN)
+        return 0;
+    sum = Frame_Checksum(buf + 1, len - 1);     // Everything between '$' and '*'.
+    buf[len++] = '*';
+    buf[len++] = hex_digits[sum >> 4];
+    buf[len++] = hex_digits[sum & 0x0F];
+    buf[len] = '\0';
+    return len;
+}
+
+static int Hex_Value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int Frame_Open(const char *line, char *tag, const char **payload, size_t *payload_len) {
+    const char *star;
+    int hi, lo;
+    if (line[0] != '$' || line[1] == '\0')
+        return 0;
+    star = strrchr(line, '*');
+    if (star == NULL || star < line + 2)
+        return 0;
+    hi = Hex_Value(star[1]);
+    lo = Hex_Value(hi < 0 ? '\0' : star[2]);
+    if (hi < 0 || lo < 0 || star[3] != '\0')
+        return 0;                                // Checksum missing or trailing garbage.
+    if (Frame_Checksum(line + 1, (size_t)(star - line - 1)) != (uint8_t)((hi << 4) | lo))
+        return 0;
+    *tag = line[1];
+    *payload = line + 2;
+    *payload_len = (size_t)(star - line - 2);
+    return 1;
+}
+
+size_t Frame_Put_Delta(char *out, int32_t delta) {
+    // Zig-zag: 0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ... so small magnitudes stay short.
+    uint32_t z = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    size_t n = 0;
+    do {
+        uint32_t sym = z & 0x1F;
+        z >>= 5;
+        if (z)
+            sym |= 0x20;                         // More symbols follow.
+        out[n++] = (char)('0' + sym);
+    } while (z);
+    return n;
+}
+
+int Frame_Get_Delta(const char **p, const char *end, int32_t *delta) {
+    uint32_t z = 0;
+    unsigned shift = 0;
+    const char *s = *p;
+    for (;;) {
+        uint32_t sym;
+        if (s >= end || shift > 30 || *s < '0' || *s > 'o')
+            return 0;
+        sym = (uint32_t)(*s++ - '0');
+        if (shift == 30 && (sym & 0x1F) > 3)
+            return 0;                            // The seventh symbol only holds bits 30 and 31.
+        z |= (sym & 0x1F) << shift;
+        shift += 5;
+        if ((sym & 0x20) == 0)
+            break;
+    }
+    *delta = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+    *p = s;
+    return 1;
+}
+
+size_t Frame_Encode_Backfill(char *buf, size_t cap, FrameBackfill *hdr, const int32_t *p, uint16_t n) {
+    char first[16], sym[8];
+    size_t limit, len, budget;
+    uint16_t used, i;
+    int k;
+    if (n == 0 || cap < 8)
+        return 0;
+    limit = (cap - 1 < FRAME_MAX_LEN ? cap - 1 : FRAME_MAX_LEN) - 3;    // Keep room for "*hh".
+    k = snprintf(buf, cap, "$%c%u/%u,%lu,%u,", CFG_FRAME_BACKFILL, (unsigned)hdr->seq,
+                 (unsigned)hdr->total, (unsigned long)hdr->t0, (unsigned)hdr->dt);
+    if (k < 0 || (size_t)k >= limit)
+        return 0;
+    len = (size_t)k;
+    k = snprintf(first, sizeof(first), "%ld,", (long)p[0]);
+
+    // Count the deltas that fit. The point count precedes them, so budget its widest form ("65535,").
+    budget = len + 6 + (size_t)k;
+    if (budget > limit)
+        return 0;
+    for (used = 1; used < n; used++) {
+        size_t w = Frame_Put_Delta(sym, p[used] - p[used - 1]);
+        if (budget + w > limit)
+            break;
+        budget += w;
+    }
+
+    len += (size_t)sprintf(buf + len, "%u,%s", (unsigned)used, first);
+    for (i = 1; i < used; i++)
+        len += Frame_Put_Delta(buf + len, p[i] - p[i - 1]);
+    hdr->n = used;
+    return Frame_Seal(buf, len, cap);
+}
+
+// Parse an unsigned decimal field terminated by 'stop' ('\0': the end of the payload).
+// Advances '*p' past the terminator. A value above 2^32 - 1 is refused, not wrapped.
+static int Get_Field(const char **p, const char *end, char stop, uint32_t *value) {
+    const char *s = *p;
+    uint32_t v = 0, d;
+    if (s >= end || *s < '0' || *s > '9')
+        return 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        d = (uint32_t)(*s++ - '0');
+        if (v > (0xFFFFFFFFUL - d) / 10U)
+            return 0;
+        v = v * 10U + d;
+    }
+    if (stop == '\0') {
+        if (s != end)
+            return 0;
+    } else {
+        if (s >= end || *s != stop)
+            return 0;
+        s++;
+    }
+    *value = v;
+    *p = s;
+    return 1;
+}
+
+// Signed decimal field ('-' allowed), otherwise like Get_Field.
+static int Get_Signed(const char **p, const char *end, char stop, int32_t *value) {
+    const char *s = *p;
+    uint32_t mag;
+    int neg = 0;
+    if (s < end && *s == '-') {
+        neg = 1;
+        s++;
+    }
+    if (!Get_Field(&s, end, stop, &mag) || mag > 0x7FFFFFFFUL + (uint32_t)neg)
+        return 0;                                // -2^31 is the one magnitude only a negative has
+    *value = neg ? (int32_t)(0U - mag) : (int32_t)mag;
+    *p = s;
+    return 1;
+}
+
+// 'base' + 'delta' into '*out'; 0 if the sum leaves the int32 range (a damaged frame).
+static int Add_Delta(int32_t base, int32_t delta, int32_t *out) {
+    int64_t v = (int64_t)base + delta;
+    if (v < -0x7FFFFFFFLL - 1 || v > 0x7FFFFFFFLL)
+        return 0;
+    *out = (int32_t)v;
+    return 1;
+}
+
+int Frame_Decode_Backfill(const char *payload, size_t len, FrameBackfill *hdr, int32_t *p, uint16_t max) {
+    const char *s = payload, *end = payload + len;
+    uint32_t seq, total, t0, dt, n, i;
+    if (!Get_Field(&s, end, '/', &seq) || !Get_Field(&s, end, ',', &total) ||
+        !Get_Field(&s, end, ',', &t0) || !Get_Field(&s, end, ',', &dt) || !Get_Field(&s, end, ',', &n))
+        return 0;
+    if (seq >= total || total > 0xFFFFU || dt > 0xFFFFU || n == 0 || n > max)
+        return 0;
+    if (!Get_Signed(&s, end, ',', &p[0]))
+        return 0;
+    for (i = 1; i < n; i++) {
+        int32_t d;
+        if (!Frame_Get_Delta(&s, end, &d) || !Add_Delta(p[i - 1], d, &p[i]))
+            return 0;
+    }
+    if (s != end)
+        return 0;                                // Extra characters: not what the sender meant.
+    hdr->seq = (uint16_t)seq;
+    hdr->total = (uint16_t)total;
+    hdr->t0 = t0;
+    hdr->dt = (uint16_t)dt;
+    hdr->n = (uint16_t)n;
+    return 1;
+}
+
+size_t Frame_Encode_Heartbeat(char *buf, size_t cap, const FrameHeartbeat *hb) {
+    int k = snprintf(buf, cap, "$%c%lu,%lu,%lu,%lu,%lu", CFG_FRAME_HEARTBEAT, (unsigned long)hb->sleep_ms,
+                     (unsigned long)hb->awake_ms, (unsigned long)hb->radio_ms,
+                     (unsigned long)hb->wake_to_frame_ms, (unsigned long)hb->cycle);
+    if (k < 0 || (size_t)k >= cap)
+        return 0;
+    return Frame_Seal(buf, (size_t)k, cap);
+}
+
+int Frame_Decode_Heartbeat(const char *payload, size_t len, FrameHeartbeat *hb) {
+    const char *s = payload, *end = payload + len;
+    return Get_Field(&s, end, ',', &hb->sleep_ms) && Get_Field(&s, end, ',', &hb->awake_ms) &&
+           Get_Field(&s, end, ',', &hb->radio_ms) && Get_Field(&s, end, ',', &hb->wake_to_frame_ms) &&
+           Get_Field(&s, end, '\0', &hb->cycle);
+}
+
+size_t Frame_Encode_Query(char *buf, size_t cap, const FrameQuery *q) {
+    int k = snprintf(buf, cap, "$%c%u,%u,%lu", CFG_FRAME_QUERY, (unsigned)q->id, (unsigned)q->asset,
+                     (unsigned long)q->window_s);
+    if (k < 0 || (size_t)k >= cap)
+        return 0;
+    return Frame_Seal(buf, (size_t)k, cap);
+}
+
+int Frame_Decode_Query(const char *payload, size_t len, FrameQuery *q) {
+    const char *s = payload, *end = payload + len;
+    uint32_t id, asset;
+    if (!Get_Field(&s, end, ',', &id) || !Get_Field(&s, end, ',', &asset) ||
+        !Get_Field(&s, end, '\0', &q->window_s) || id > 0xFFU || asset > 0xFFU)
+        return 0;
+    q->id = (uint8_t)id;
+    q->asset = (uint8_t)asset;
+    return 1;
+}
+
+size_t Frame_Encode_Window(char *buf, size_t cap, const FrameWindow *w) {
+    size_t len;
+    int k;
+    if (cap < 64)
+        return 0;                                // The widest frame is about 90 characters.
+    k = snprintf(buf, cap, "$%c%u,%u,%lu,%lu,%lu,%lu,%ld,", CFG_FRAME_WINDOW, (unsigned)w->id,
+                 (unsigned)w->asset, (unsigned long)w->service_us, (unsigned long)w->window_s,
+                 (unsigned long)w->res_s, (unsigned long)w->count, (long)(w->count ? w->open : 0));
+    if (k < 0 || (size_t)k + 4 * 7 + 4 > cap)
+        return 0;
+    len = (size_t)k;
+    if (w->count) {
+        len += Frame_Put_Delta(buf + len, w->high - w->open);
+        len += Frame_Put_Delta(buf + len, w->low - w->open);
+        len += Frame_Put_Delta(buf + len, w->close - w->open);
+        len += Frame_Put_Delta(buf + len, w->mean - w->open);
+    }
+    return Frame_Seal(buf, len, cap);
+}
+
+int Frame_Decode_Window(const char *payload, size_t len, FrameWindow *w) {
+    const char *s = payload, *end = payload + len;
+    uint32_t id, asset;
+    int32_t d[4];
+    int i;
+    if (!Get_Field(&s, end, ',', &id) || !Get_Field(&s, end, ',', &asset) ||
+        !Get_Field(&s, end, ',', &w->service_us) || !Get_Field(&s, end, ',', &w->window_s) ||
+        !Get_Field(&s, end, ',', &w->res_s) || !Get_Field(&s, end, ',', &w->count) ||
+        id > 0xFFU || asset > 0xFFU)
+        return 0;
+    if (!Get_Signed(&s, end, ',', &w->open))
+        return 0;
+    w->id = (uint8_t)id;
+    w->asset = (uint8_t)asset;
+    for (i = 0; i < 4; i++) {
+        d[i] = 0;
+        if (w->count && !Frame_Get_Delta(&s, end, &d[i]))
+            return 0;
+    }
+    return s == end && Add_Delta(w->open, d[0], &w->high) && Add_Delta(w->open, d[1], &w->low) &&
+           Add_Delta(w->open, d[2], &w->close) && Add_Delta(w->open, d[3], &w->mean);
+}
+
+size_t Frame_Encode_Telemetry(char *buf, size_t cap, const FrameTelemetry *t) {
+    int k = snprintf(buf, cap, "$%c%lu,%ld,%lu,%ld,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu", CFG_FRAME_TELEMETRY,
+                     (unsigned long)t->uptime_s, (long)t->rssi, (unsigned long)t->reconnects,
+                     (long)t->http_status, (unsigned long)t->fail, (unsigned long)t->dns_ms,
+                     (unsigned long)t->connect_ms, (unsigned long)t->ttfb_ms, (unsigned long)t->body_ms,
+                     (unsigned long)t->heap_free, (unsigned long)t->heap_block,
+                     (unsigned long)t->fetches, (unsigned long)t->failures);
+    if (k < 0 || (size_t)k >= cap)
+        return 0;
+    return Frame_Seal(buf, (size_t)k, cap);
+}
+
+int Frame_Decode_Telemetry(const char *payload, size_t len, FrameTelemetry *t) {
+    const char *s = payload, *end = payload + len;
+    return Get_Field(&s, end, ',', &t->uptime_s) && Get_Signed(&s, end, ',', &t->rssi) &&
+           Get_Field(&s, end, ',', &t->reconnects) && Get_Signed(&s, end, ',', &t->http_status) &&
+           Get_Field(&s, end, ',', &t->fail) && Get_Field(&s, end, ',', &t->dns_ms) &&
+           Get_Field(&s, end, ',', &t->connect_ms) && Get_Field(&s, end, ',', &t->ttfb_ms) &&
+           Get_Field(&s, end, ',', &t->body_ms) && Get_Field(&s, end, ',', &t->heap_free) &&
+           Get_Field(&s, end, ',', &t->heap_block) && Get_Field(&s, end, ',', &t->fetches) &&
+           Get_Field(&s, end, '\0', &t->failures);
+}
+
+size_t Frame_Encode_Test(char *buf, size_t cap, const FrameTest *t) {
+    int k = snprintf(buf, cap, "$%c%lu,%lu,%lu,%lu,", CFG_FRAME_TEST, (unsigned long)t->step,
+                     (unsigned long)t->seq, (unsigned long)t->rate, (unsigned long)t->size);
+    size_t len, i;
+    if (k < 0 || (size_t)k >= cap)
+        return 0;
+    len = (size_t)k;
+    if (t->size != 0) {
+        if (t->size < len + 3 || t->size >= cap)
+            return 0;
+        for (i = 0; len + 3 < t->size; i++)
+            buf[len++] = (char)('a' + (t->seq + i) % 26);
+    }
+    return Frame_Seal(buf, len, cap);
+}
+
+int Frame_Decode_Test(const char *payload, size_t len, FrameTest *t) {
+    const char *s = payload, *end = payload + len;
+    size_t i;
+    if (!Get_Field(&s, end, ',', &t->step) || !Get_Field(&s, end, ',', &t->seq) ||
+        !Get_Field(&s, end, ',', &t->rate) || !Get_Field(&s, end, ',', &t->size))
+        return 0;
+    if (t->size == 0)
+        return s == end;
+    if (len + 5 != t->size)                      // '$', the tag and "*hh" around the payload.
+        return 0;
+    for (i = 0; s + i < end; i++) {
+        if (s[i] != (char)('a' + (t->seq + i) % 26))
+            return 0;
+    }
+    return 1;
+}
+
+size_t Frame_Encode_Test_Result(char *buf, size_t cap, const FrameTestResult *r) {
+    int k = snprintf(buf, cap, "$%c%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu", CFG_FRAME_RESULT,
+                     (unsigned long)r->steps, (unsigned long)r->best_rate, (unsigned long)r->best_size,
+                     (unsigned long)r->best_bps, (unsigned long)r->cpu_pct, (unsigned long)r->parse_rate,
+                     (unsigned long)r->display_rate, (unsigned long)r->lost);
+    if (k < 0 || (size_t)k >= cap)
+        return 0;
+    return Frame_Seal(buf, (size_t)k, cap);
+}
+
+int Frame_Decode_Test_Result(const char *payload, size_t len, FrameTestResult *r) {
+    const char *s = payload, *end = payload + len;
+    return Get_Field(&s, end, ',', &r->steps) && Get_Field(&s, end, ',', &r->best_rate) &&
+           Get_Field(&s, end, ',', &r->best_size) && Get_Field(&s, end, ',', &r->best_bps) &&
+           Get_Field(&s, end, ',', &r->cpu_pct) && Get_Field(&s, end, ',', &r->parse_rate) &&
+           Get_Field(&s, end, ',', &r->display_rate) && Get_Field(&s, end, '\0', &r->lost);
+}
+
+size_t Frame_Encode_Alarm(char *buf, size_t cap, const FrameAlarm *a) {
+    int k = snprintf(buf, cap, "$%c%lu,%lu,%ld,%lu,%lu", CFG_FRAME_ALARM, (unsigned long)a->id,
+                     (unsigned long)a->on, (long)a->cents, (unsigned long)a->time, (unsigned long)a->test);
+    if (k < 0 || (size_t)k >= cap)
+        return 0;
+    return Frame_Seal(buf, (size_t)k, cap);
+}
+
+int Frame_Decode_Alarm(const char *payload, size_t len, FrameAlarm *a) {
+    const char *s = payload, *end = payload + len;
+    return Get_Field(&s, end, ',', &a->id) && Get_Field(&s, end, ',', &a->on) &&
+           Get_Signed(&s, end, ',', &a->cents) && Get_Field(&s, end, ',', &a->time) &&
+           Get_Field(&s, end, '\0', &a->test);
+}
+
+size_t Frame_Encode_Alarm_Ack(char *buf, size_t cap, const FrameAlarmAck *k) {
+    int n = snprintf(buf, cap, "$%c%lu,%lu,%lu,%lu", CFG_FRAME_ALARM_ACK, (unsigned long)k->id,
+                     (unsigned long)k->status, (unsigned long)k->attempts, (unsigned long)k->forward_ms);
+    if (n < 0 || (size_t)n >= cap)
+        return 0;
+    return Frame_Seal(buf, (size_t)n, cap);
+}
+
+int Frame_Decode_Alarm_Ack(const char *payload, size_t len, FrameAlarmAck *k) {
+    const char *s = payload, *end = payload + len;
+    return Get_Field(&s, end, ',', &k->id) && Get_Field(&s, end, ',', &k->status) &&
+           Get_Field(&s, end, ',', &k->attempts) && Get_Field(&s, end, '\0', &k->forward_ms);
+}
@@ -0,0 +1,210 @@
+//frame.h
+// Checksummed extension frames on the ESP32 -> TM4C link (portable C, built on both sides).
+//
+// The legacy price line ("BTC Price: ...") is unchanged. Every other message is one line
+//
+//     $<tag><payload>*<hh>\n
+//
+// where <tag> is one letter from the [frames] section of tracker_config.cfg and <hh> is the
+// XOR of all characters between '$' and '*' as two upper-case hex digits (as in NMEA).
+// A frame, including '$' and the checksum but not the newline, never exceeds FRAME_MAX_LEN
+// so it always fits the TM4C's line buffer.
+//
+// Price series are sent as signed deltas, each packed as a zig-zag varint of 6-bit
+// symbols written as printable characters '0'..'o' (bit 5 = more symbols follow). Deltas
+// below 16 in magnitude cost one character.
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tracker_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_MAX_LEN (CFG_UART_BUFFER_SIZE - 1)  // Longest frame line, newline excluded
+
+// Header of one backfill frame:  $B<seq>/<total>,<t0>,<dt>,<n>,<p0>,<deltas>*hh
+typedef struct {
+    uint16_t seq;                 // Frame number, 0..total-1
+    uint16_t total;               // Number of frames in the sequence
+    uint32_t t0;                  // Unix time of the first point in this frame
+    uint16_t dt;                  // Seconds between consecutive points
+    uint16_t n;                   // Points in this frame
+} FrameBackfill;
+
+// Heartbeat sent by the ESP32 at the end of each poll cycle:
+//   $H<sleep_ms>,<awake_ms>,<radio_ms>,<wake_to_frame_ms>,<cycle>*hh
+typedef struct {
+    uint32_t sleep_ms;            // Time until the next fetch; the link is quiet until then
+    uint32_t awake_ms;            // Time the ESP32 was awake in this cycle
+    uint32_t radio_ms;            // Time Wi-Fi was powered in this cycle
+    uint32_t wake_to_frame_ms;    // From wake-up to the price frame leaving the UART
+    uint32_t cycle;               // Poll cycles since power-on
+} FrameHeartbeat;
+
+// History query sent by the TM4C to the ESP32 (the only frame going that way):
+//   $Q<id>,<asset>,<window_s>*hh
+typedef struct {
+    uint8_t id;                   // Echoed in the answer so late answers can be told apart
+    uint8_t asset;                // Asset slot (cfg_assets[])
+    uint32_t window_s;            // Window ending at the newest sample, in seconds
+} FrameQuery;
+
+// Answer to a query. Prices are in cents; high, low, close and mean follow the open price
+// as zig-zag varint deltas (as in the backfill frames), so a window costs ~50 characters:
+//   $W<id>,<asset>,<service_us>,<window_s>,<res_s>,<count>,<open>,<deltas>*hh
+// count == 0 means no samples in the window; the open price and the deltas are then 0.
+typedef struct {
+    uint8_t id;
+    uint8_t asset;
+    uint32_t service_us;          // Time the ESP32 took to answer (query parsed to frame built)
+    uint32_t window_s;            // Window asked for
+    uint32_t res_s;               // Bucket size used: window edges are rounded to it
+    uint32_t count;               // Samples in the window
+    int32_t open, high, low, close, mean;
+} FrameWindow;
+
+// Fetch phase at which the ESP32's last price fetch failed (FrameTelemetry.fail).
+#define FRAME_FAIL_NONE 0         // The fetch succeeded
+#define FRAME_FAIL_WIFI 1         // Not associated with the access point
+#define FRAME_FAIL_DNS  2         // The API host name did not resolve
+#define FRAME_FAIL_TLS  3         // TCP connect or TLS handshake failed
+#define FRAME_FAIL_HTTP 4         // No response, or a status other than 200
+#define FRAME_FAIL_API  5         // A 200 response whose body did not parse
+
+// ESP32 health and the timings of its last fetch, sent after every CFG_TELEMETRY_EVERY_POLLS
+// good fetches and after every failed one, always behind the price line:
+//   $T<uptime_s>,<rssi>,<reconnects>,<http_status>,<fail>,<dns_ms>,<connect_ms>,<ttfb_ms>,
+//     <body_ms>,<heap_free>,<heap_block>,<fetches>,<failures>*hh
+// Phases that were not reached are 0.
+typedef struct {
+    uint32_t uptime_s;            // Since the ESP32 booted (a deep-sleep wake-up is a boot)
+    int32_t rssi;                 // Signal of the access point in dBm, 0 when not associated
+    uint32_t reconnects;          // Wi-Fi connections lost since power-on
+    int32_t http_status;          // Status of the last request, or a negative HTTPClient error
+    uint32_t fail;                // FRAME_FAIL_* of the last fetch
+    uint32_t dns_ms;              // Host name lookup
+    uint32_t connect_ms;          // TCP connect and TLS handshake
+    uint32_t ttfb_ms;             // Request sent to response headers received
+    uint32_t body_ms;             // Response body read
+    uint32_t heap_free;           // Free heap bytes
+    uint32_t heap_block;          // Largest free heap block (TLS needs ~40 KB in one piece)
+    uint32_t fetches;             // Fetches since power-on
+    uint32_t failures;            // Of which failed
+} FrameTelemetry;
+
+// Link self-test (see selftest.h), sent by the ESP32 at rising rates:
+//   $X<step>,<seq>,<rate>,<size>,<pad>*hh
+// The frame is exactly 'size' characters long; the padding cycles through 'a'..'z' starting at
+// seq % 26, so the receiver checks content as well as the checksum. Control frames have size 0
+// and no padding: the end of a step (seq = frames sent, rate = as asked), the end of the test
+// (step = steps run, seq = rate = 0) and, TM4C -> ESP32, the start request (all zero).
+typedef struct {
+    uint32_t step;                // Index into the plan (SelfTest_Plan)
+    uint32_t seq;                 // Frame number within the step
+    uint32_t rate;                // Frames per second asked for in this step
+    uint32_t size;                // Frame length, newline excluded (0: control frame)
+} FrameTest;
+
+// Outcome of a self-test, sent back by the TM4C:
+//   $R<steps>,<best_rate>,<best_size>,<best_bps>,<cpu_pct>,<parse_rate>,<display_rate>,<lost>*hh
+typedef struct {
+    uint32_t steps;               // Steps completed
+    uint32_t best_rate;           // Frames/s measured in the error-free step with the highest byte rate
+    uint32_t best_size;           // Frame size of that step
+    uint32_t best_bps;            // Its payload rate in bytes/s, newlines included
+    uint32_t cpu_pct;             // TM4C time spent receiving and drawing in that step
+    uint32_t parse_rate;          // Frames/s at which the UART backlog reached half the ring (0: never)
+    uint32_t display_rate;        // Frames/s at which progress redraws had to be skipped (0: never)
+    uint32_t lost;                // Test frames sent but not received intact, all steps
+} FrameTestResult;
+
+// Alarm transition, TM4C -> ESP32, which forwards it to the notification endpoint:
+//   $A<id>,<on>,<cents>,<time>,<test>*hh
+// Retries repeat the frame unchanged, so the ESP32 forwards each transition once.
+typedef struct {
+    uint32_t id;                  // Transition number (wraps), echoed in the ack
+    uint32_t on;                  // 1: alarm raised, 0: cleared
+    int32_t cents;                // Price that caused it
+    uint32_t time;                // Unix time of that tick (0 if the ESP32 had no clock yet)
+    uint32_t test;                // 1: test notification requested over USB, not a real alarm
+} FrameAlarm;
+
+// Outcome of forwarding an alarm, ESP32 -> TM4C:
+//   $K<id>,<status>,<attempts>,<forward_ms>*hh
+typedef struct {
+    uint32_t id;
+    uint32_t status;              // FRAME_NOTIFY_*
+    uint32_t attempts;            // Endpoint attempts made
+    uint32_t forward_ms;          // Frame received to the endpoint's acknowledgement (or giving up)
+} FrameAlarmAck;
+
+#define FRAME_NOTIFY_DELIVERED 0  // The endpoint accepted it
+#define FRAME_NOTIFY_FAILED    1  // Every attempt failed
+#define FRAME_NOTIFY_DISABLED  2  // No endpoint configured ([alarm] notify = 0)
+
+// XOR checksum of 'len' characters.
+uint8_t Frame_Checksum(const char *s, size_t len);
+
+// Append "*hh" to the 'len' characters already in 'buf' (which start with '$').
+// Returns the new length, or 0 if it would exceed 'cap' - 1 or FRAME_MAX_LEN.
+size_t Frame_Seal(char *buf, size_t len, size_t cap);
+
+// Validate a received line. On success returns 1 and sets the tag and the payload span
+// (the characters between the tag and '*'); returns 0 for anything malformed.
+int Frame_Open(const char *line, char *tag, const char **payload, size_t *payload_len);
+
+// Write one delta as a zig-zag varint. 'out' needs room for 7 characters.
+// Returns the number of characters written.
+size_t Frame_Put_Delta(char *out, int32_t delta);
+
+// Read one delta, advancing '*p'. Returns 0 on a malformed or truncated symbol sequence,
+// or one holding more than 32 bits.
+int Frame_Get_Delta(const char **p, const char *end, int32_t *delta);
+
+// Encode a backfill frame holding as many points of p[0..n-1] as fit. 'hdr->n' is set to
+// the number of points packed. Returns the frame length (no newline), or 0 on error.
+size_t Frame_Encode_Backfill(char *buf, size_t cap, FrameBackfill *hdr, const int32_t *p, uint16_t n);
+
+// Decode a backfill payload (as returned by Frame_Open) into 'hdr' and up to 'max' points.
+// Returns 1 on success, 0 if the payload is malformed, holds more than 'max' points or
+// a point outside the int32 range.
+int Frame_Decode_Backfill(const char *payload, size_t len, FrameBackfill *hdr, int32_t *p, uint16_t max);
+
+// Encode / decode a heartbeat frame (same conventions as the backfill functions).
+size_t Frame_Encode_Heartbeat(char *buf, size_t cap, const FrameHeartbeat *hb);
+int Frame_Decode_Heartbeat(const char *payload, size_t len, FrameHeartbeat *hb);
+
+// Encode / decode a history query and its answer (same conventions).
+size_t Frame_Encode_Query(char *buf, size_t cap, const FrameQuery *q);
+int Frame_Decode_Query(const char *payload, size_t len, FrameQuery *q);
+size_t Frame_Encode_Window(char *buf, size_t cap, const FrameWindow *w);
+int Frame_Decode_Window(const char *payload, size_t len, FrameWindow *w);
+
+// Encode / decode a telemetry frame (same conventions).
+size_t Frame_Encode_Telemetry(char *buf, size_t cap, const FrameTelemetry *t);
+int Frame_Decode_Telemetry(const char *payload, size_t len, FrameTelemetry *t);
+
+// Encode / decode an alarm transition and its ack (same conventions).
+size_t Frame_Encode_Alarm(char *buf, size_t cap, const FrameAlarm *a);
+int Frame_Decode_Alarm(const char *payload, size_t len, FrameAlarm *a);
+size_t Frame_Encode_Alarm_Ack(char *buf, size_t cap, const FrameAlarmAck *k);
+int Frame_Decode_Alarm_Ack(const char *payload, size_t len, FrameAlarmAck *k);
+
+// Encode / decode a self-test frame (same conventions). Encoding fails if 'size' is non-zero
+// but too short for the header and the checksum.
+size_t Frame_Encode_Test(char *buf, size_t cap, const FrameTest *t);
+int Frame_Decode_Test(const char *payload, size_t len, FrameTest *t);
+
+// Encode / decode a self-test result (same conventions).
+size_t Frame_Encode_Test_Result(char *buf, size_t cap, const FrameTestResult *r);
+int Frame_Decode_Test_Result(const char *payload, size_t len, FrameTestResult *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_H
@@ -0,0 +1,210 @@
+//history.c
+
+#include "history.h"
+#include "dsp.h"
+#include <stddef.h>
+
+static HistBlock blocks[HIST_BLOCKS];   // Ring of history blocks
+static uint32_t head = 0;               // Index of the oldest block
+static uint32_t used = 0;               // Blocks in use
+static int64_t slot_sum;                // Sum of the live ticks averaged into the newest sample
+static uint32_t slot_ticks;             // Their count (0: the newest sample is not a live slot)
+
+// A day of samples fits even right after the oldest block was dropped, so the 24 h windows
+// (alert rules, TFT chart, statistics page) always span 24 h.
+typedef char hist_day_fits[((HIST_BLOCKS - 1) * HIST_BLOCK_LEN * HIST_SPACING_S >= 86400U) ? 1 : -1];
+
+static HistBlock *Block_At(uint32_t k) {
+    return &blocks[(head + k) % HIST_BLOCKS];
+}
+
+// Time of sample i in block b (samples are evenly spaced between t0 and t1).
+static uint32_t Sample_Time(const HistBlock *b, uint32_t i) {
+    if (b->n < 2)
+        return b->t0;
+    return b->t0 + (uint32_t)(((uint64_t)(b->t1 - b->t0) * i) / (uint32_t)(b->n - 1));
+}
+
+static int16_t Clamp_Delta(int32_t d) {
+    if (d > 32767) return 32767;
+    if (d < -32768) return -32768;
+    return (int16_t)d;
+}
+
+// Fill block b with p[0..n-1], centring the base so the deltas use the full int16 range.
+static void Block_Fill(HistBlock *b, uint32_t t0, uint32_t t1, const int32_t *p, uint32_t n) {
+    int32_t lo = p[0], hi = p[0];
+    uint32_t i;
+    for (i = 1; i < n; i++) {
+        if (p[i] < lo) lo = p[i];
+        if (p[i] > hi) hi = p[i];
+    }
+    b->base = lo + (hi - lo) / 2;
+    for (i = 0; i < n; i++)
+        b->d[i] = Clamp_Delta(p[i] - b->base);
+    b->t0 = t0;
+    b->t1 = t1;
+    b->n = (uint16_t)n;
+}
+
+void History_Add(uint32_t time, int32_t price) {
+    HistBlock *b;
+    if (time == 0)
+        return;
+    time -= time % HIST_SPACING_S;                // Start of the tick's slot.
+    if (used) {
+        b = Block_At(used - 1);
+        if (time == b->t1 && slot_ticks) {
+            // Same slot as the newest sample: it becomes the mean of the slot's ticks.
+            slot_sum += price;
+            slot_ticks++;
+            b->d[b->n - 1] = Clamp_Delta((int32_t)(slot_sum / slot_ticks) - b->base);
+            return;
+        }
+        if (time <= b->t1)
+            return;                               // Out of order or duplicate.
+        if (b->n < HIST_BLOCK_LEN && price - b->base >= -32768 && price - b->base <= 32767) {
+            // Keep the "evenly spaced" assumption: a big change in spacing starts a new block.
+            uint32_t gap = time - b->t1;
+            uint32_t avg = (b->n > 1) ? (b->t1 - b->t0) / (uint32_t)(b->n - 1) : gap;
+            if (gap <= 2 * avg + 1 && 2 * gap + 1 >= avg) {
+                b->d[b->n++] = (int16_t)(price - b->base);
+                b->t1 = time;
+                slot_sum = price;
+                slot_ticks = 1;
+                return;
+            }
+        }
+    }
+    slot_sum = price;
+    slot_ticks = 1;
+    if (used == HIST_BLOCKS) {
+        head = (head + 1) % HIST_BLOCKS;          // Drop the oldest block.
+        used--;
+    }
+    b = Block_At(used++);
+    b->t0 = b->t1 = time;
+    b->base = price;
+    b->n = 1;
+    b->d[0] = 0;
+}
+
+uint32_t History_Ingest(uint32_t t0, uint32_t dt, const int32_t *p, uint32_t n) {
+    uint32_t keep = n, start, end;
+    if (dt == 0 || n == 0)
+        return 0;
+    if (used) {
+        uint32_t oldest = Block_At(0)->t0;
+        keep = (oldest > t0) ? (oldest - t0 + dt - 1) / dt : 0;   // Points strictly older than 'oldest'.
+        if (keep > n)
+            keep = n;
+    }
+    start = 0;
+    if (keep > (HIST_BLOCKS - used) * HIST_BLOCK_LEN)
+        start = keep - (HIST_BLOCKS - used) * HIST_BLOCK_LEN;      // Not enough room: drop the oldest points.
+
+    // Build blocks newest first, each one prepended in front of the current oldest block.
+    for (end = keep; end > start; ) {
+        uint32_t s = (end - start > HIST_BLOCK_LEN) ? end - HIST_BLOCK_LEN : start;
+        head = (head + HIST_BLOCKS - 1) % HIST_BLOCKS;
+        used++;
+        Block_Fill(&blocks[head], t0 + s * dt, t0 + (end - 1) * dt, p + s, end - s);
+        end = s;
+    }
+    return keep - start;
+}
+
+// Index of the first sample in block b with time >= t (b->n if none).
+static uint32_t Sample_Index(const HistBlock *b, uint32_t t) {
+    uint32_t i;
+    if (t <= b->t0)
+        return 0;
+    if (t > b->t1)
+        return b->n;
+    // Invert the even spacing, then correct for rounding.
+    i = (uint32_t)(((uint64_t)(t - b->t0) * (uint32_t)(b->n - 1)) / (b->t1 - b->t0));
+    while (i > 0 && Sample_Time(b, i - 1) >= t)
+        i--;
+    while (i < b->n && Sample_Time(b, i) < t)
+        i++;
+    return i;
+}
+
+void History_Stats(uint32_t since, HistStats *out) {
+    int64_t sum = 0;
+    uint32_t k;
+    out->min = 0x7FFFFFFF;
+    out->max = (int32_t)0x80000000;
+    out->count = 0;
+    for (k = 0; k < used; k++) {
+        const HistBlock *b = Block_At(k);
+        uint32_t i = Sample_Index(b, since), n;
+        int16_t lo, hi;
+        if (i >= b->n)
+            continue;
+        n = b->n - i;
+        Dsp_MinMax16(&b->d[i], n, &lo, &hi);             // Packed min/max over the deltas.
+        if (b->base + lo < out->min) out->min = b->base + lo;
+        if (b->base + hi > out->max) out->max = b->base + hi;
+        sum += (int64_t)b->base * n + Dsp_Sum16(&b->d[i], n);
+        out->count += n;
+    }
+    out->mean = out->count ? (int32_t)(sum / (int64_t)out->count) : 0;
+}
+
+uint32_t History_Chart(uint32_t since, uint32_t width, int32_t *col_min, int32_t *col_max) {
+    uint32_t newest = History_Newest(), span, c, k, filled = 0;
+    if (used == 0 || width == 0 || since > newest)
+        return 0;
+    if (since < History_Oldest())
+        since = History_Oldest();
+    span = newest - since + 1;
+    for (c = 0; c < width; c++) {
+        uint32_t c0 = since + (uint32_t)(((uint64_t)span * c) / width);       // Column time range [c0, c1)
+        uint32_t c1 = since + (uint32_t)(((uint64_t)span * (c + 1)) / width);
+        int32_t lo = 0x7FFFFFFF, hi = (int32_t)0x80000000;
+        for (k = 0; k < used; k++) {
+            const HistBlock *b = Block_At(k);
+            uint32_t s, e;
+            int16_t dlo, dhi;
+            if (b->t1 < c0 || b->t0 >= c1)
+                continue;
+            s = Sample_Index(b, c0);
+            e = Sample_Index(b, c1);
+            if (e <= s)
+                continue;
+            Dsp_MinMax16(&b->d[s], e - s, &dlo, &dhi);
+            if (b->base + dlo < lo) lo = b->base + dlo;
+            if (b->base + dhi > hi) hi = b->base + dhi;
+        }
+        if (lo > hi) {                                    // No sample in this column: repeat the previous one.
+            if (c == 0)
+                continue;
+            lo = col_min[c - 1];
+            hi = col_max[c - 1];
+        }
+        col_min[c] = lo;
+        col_max[c] = hi;
+        filled++;
+    }
+    return filled;
+}
+
+uint32_t History_Count(void) {
+    uint32_t k, n = 0;
+    for (k = 0; k < used; k++)
+        n += Block_At(k)->n;
+    return n;
+}
+
+uint32_t History_Oldest(void) {
+    return used ? Block_At(0)->t0 : 0;
+}
+
+uint32_t History_Newest(void) {
+    return used ? Block_At(used - 1)->t1 : 0;
+}
+
+const HistBlock *History_Block(uint32_t k) {
+    return (k < used) ? Block_At(k) : NULL;
+}
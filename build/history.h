@@ -0,0 +1,62 @@
+//history.h
+// RAM price history feeding the rolling statistics, sparklines and alert windows.
+//
+// Samples are whole USD prices kept in blocks: each block stores a base price and up to
+// HIST_BLOCK_LEN signed 16-bit deltas from that base, plus the times of its first and
+// last sample (samples inside a block are treated as evenly spaced). The blocks form a
+// ring, oldest first; when the ring is full the oldest block is dropped.
+//
+// Live ticks are averaged into one sample per HIST_SPACING_S slot, the spacing of the
+// backfilled series, and appended at the newest end. A boot-time backfill is ingested in
+// one batch at the oldest end, so it never reorders or overwrites live samples.
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+
+#define HIST_BLOCK_LEN 64         // Samples per block
+#define HIST_BLOCKS    12         // Blocks in the ring (768 samples: 2.6 days of 5-min points)
+#define HIST_SPACING_S 300U       // Seconds per sample: live ticks in one slot are averaged
+
+typedef struct {
+    uint32_t t0;                  // Unix time of the first sample
+    uint32_t t1;                  // Unix time of the last sample
+    int32_t base;                 // Price (USD) every delta is relative to
+    int16_t d[HIST_BLOCK_LEN];    // Sample i is base + d[i] (word aligned for the DSP kernels)
+    uint16_t n;                   // Samples in use
+} HistBlock;
+
+typedef struct {
+    int32_t min;                  // Lowest price in the window (USD)
+    int32_t max;                  // Highest price in the window (USD)
+    int32_t mean;                 // Mean price in the window (USD, rounded down)
+    uint32_t count;               // Samples in the window (0: other fields undefined)
+} HistStats;
+
+// Add a live tick. Ticks in the slot of the newest sample (time / HIST_SPACING_S) update
+// its mean; a later slot appends a sample stamped with the slot's start. Ignored if 'time'
+// is 0 or in an earlier slot than the newest sample.
+void History_Add(uint32_t time, int32_t price);
+
+// Ingest an evenly spaced series (t0, t0 + dt, ...) older than everything already held.
+// Points at or after the oldest stored sample are skipped, and if the free blocks cannot
+// hold the whole series its oldest part is dropped. Returns the number of samples stored.
+uint32_t History_Ingest(uint32_t t0, uint32_t dt, const int32_t *p, uint32_t n);
+
+// Statistics over the samples with time >= since.
+void History_Stats(uint32_t since, HistStats *out);
+
+// Resample [since, newest] into 'width' time columns (e.g. chart pixels) and store each
+// column's minimum and maximum price. A column with no sample repeats its left neighbour;
+// leading empty columns are left untouched. Returns the number of columns written.
+uint32_t History_Chart(uint32_t since, uint32_t width, int32_t *col_min, int32_t *col_max);
+
+// Sample count, oldest and newest sample times (0 when empty).
+uint32_t History_Count(void);
+uint32_t History_Oldest(void);
+uint32_t History_Newest(void);
+
+// Block access for batch kernels: block k (0 = oldest) or NULL past the end.
+const HistBlock *History_Block(uint32_t k);
+
+#endif // HISTORY_H
@@ -0,0 +1,146 @@
+//lcdbus.c
+
+#include "lcdbus.h"
+#include <string.h>
+
+#define LCDBUS_CELLS (CFG_LCD_ROWS * CFG_LCD_COLS)
+
+typedef char lcdbus_geometry[((CFG_LCD_ROWS <= 2 && CFG_LCD_COLS <= 40) ||
+                              (CFG_LCD_ROWS <= 4 && CFG_LCD_COLS <= 20)) ? 1 : -1];
+
+// DDRAM address of the first cell of each row (a 4-row panel continues rows 0 and 1).
+static const uint8_t row_base[4] = { 0x00, 0x40, 0x00 + CFG_LCD_COLS, 0x40 + CFG_LCD_COLS };
+
+static uint8_t Cell_Addr(uint32_t cell) {
+    return (uint8_t)(row_base[cell / CFG_LCD_COLS] + cell % CFG_LCD_COLS);
+}
+
+// Cell shown at DDRAM address 'addr', or LCDBUS_CELLS if it is not visible.
+static uint32_t Addr_Cell(uint8_t addr) {
+    uint32_t r;
+    for (r = 0; r < CFG_LCD_ROWS; r++)
+        if (addr >= row_base[r] && addr < row_base[r] + CFG_LCD_COLS)
+            return r * CFG_LCD_COLS + (addr - row_base[r]);
+    return LCDBUS_CELLS;
+}
+
+// The next cell whose shadow differs, starting at the address counter so that a run of
+// changes goes out without set-address commands. LCDBUS_CELLS when there is none.
+static uint32_t Pending(const LcdPanel *p) {
+    const char *want = &p->want[0][0], *shown = &p->shown[0][0];
+    uint32_t start = Addr_Cell(p->addr), i, cell;
+    if (start == LCDBUS_CELLS)
+        start = 0;
+    for (i = 0; i < LCDBUS_CELLS; i++) {
+        cell = start + i < LCDBUS_CELLS ? start + i : start + i - LCDBUS_CELLS;
+        if (want[cell] != shown[cell])
+            return cell;
+    }
+    return LCDBUS_CELLS;
+}
+
+void LcdBus_Init(LcdBus *b, uint8_t panels, uint32_t exec) {
+    uint8_t i;
+    memset(b, 0, sizeof(*b));
+    b->n = panels < LCDBUS_MAX_PANELS ? panels : LCDBUS_MAX_PANELS;
+    b->exec = exec;
+    for (i = 0; i < b->n; i++)
+        memset(b->panel[i].want, ' ', sizeof(b->panel[i].want));
+}
+
+void LcdBus_Up(LcdBus *b, uint32_t ready) {
+    uint8_t i;
+    for (i = 0; i < b->n; i++) {
+        LcdPanel *p = &b->panel[i];
+        memset(p->shown, ' ', sizeof(p->shown));
+        p->addr = 0;
+        p->ready = ready;
+        p->dirty = 1;
+    }
+    b->up = 1;
+}
+
+void LcdBus_Clear(LcdBus *b, uint8_t panel) {
+    LcdPanel *p;
+    if (panel >= b->n)
+        return;
+    p = &b->panel[panel];
+    memset(p->want, ' ', sizeof(p->want));
+    p->row = 0;
+    p->col = 0;
+    p->dirty = 1;
+}
+
+void LcdBus_Cursor(LcdBus *b, uint8_t panel, uint8_t col, uint8_t row) {
+    LcdPanel *p;
+    if (panel >= b->n)
+        return;
+    p = &b->panel[panel];
+    p->row = row;
+    p->col = row < CFG_LCD_ROWS ? col : CFG_LCD_COLS;  // A row that does not exist takes nothing.
+}
+
+void LcdBus_Put(LcdBus *b, uint8_t panel, char c) {
+    LcdPanel *p;
+    if (panel >= b->n || b->panel[panel].col >= CFG_LCD_COLS)
+        return;
+    p = &b->panel[panel];
+    if (p->want[p->row][p->col] != c) {
+        p->want[p->row][p->col] = c;
+        p->dirty = 1;
+    }
+    p->col++;
+}
+
+int LcdBus_Next(LcdBus *b, uint32_t now, LcdBusOp *op) {
+    uint32_t k, cell;
+    uint8_t i, addr;
+    if (!b->up)
+        return 0;
+    for (k = 0; k < b->n; k++) {
+        LcdPanel *p;
+        i = (uint8_t)((b->next + k) % b->n);
+        p = &b->panel[i];
+        if (!p->dirty || (int32_t)(now - p->ready) < 0)
+            continue;
+        cell = Pending(p);
+        if (cell == LCDBUS_CELLS) {
+            p->dirty = 0;             // Shows its shadow; nothing to send until the next write.
+            continue;
+        }
+        addr = Cell_Addr(cell);
+        op->panel = i;
+        if (addr != p->addr) {
+            op->rs = 0;
+            op->byte = (uint8_t)(0x80 | addr);  // Set DDRAM address.
+            p->addr = addr;
+        } else {
+            op->rs = 1;
+            op->byte = (uint8_t)(&p->want[0][0])[cell];
+            (&p->shown[0][0])[cell] = (char)op->byte;
+            p->addr++;                // Entry mode: the counter moves on by one.
+        }
+        p->ready = now + b->exec;
+        p->bytes++;
+        b->bytes++;
+        b->next = (uint8_t)((i + 1) % b->n);  // The others go first while this one executes.
+        return 1;
+    }
+    return 0;
+}
+
+uint32_t LcdBus_Wait(LcdBus *b, uint32_t now) {
+    uint32_t wait = LCDBUS_IDLE, left;
+    uint8_t i;
+    if (!b->up)
+        return LCDBUS_IDLE;
+    for (i = 0; i < b->n; i++) {
+        const LcdPanel *p = &b->panel[i];
+        if (!p->dirty)
+            continue;
+        left = (int32_t)(p->ready - now) > 0 ? p->ready - now : 0;
+        if (left < wait)
+            wait = left;
+    }
+    return wait;
+}
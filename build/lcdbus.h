@@ -0,0 +1,84 @@
+//lcdbus.h
+// HD44780 panels sharing one bus (portable C, built for the TM4C and fleetsim).
+//
+// Up to LCDBUS_MAX_PANELS 16x2 panels hang on the same 4-bit data lines (PA2-PA5) and RS
+// (PE0), each with its own enable line, so a second display needs one more pin and no
+// other controller. The screens write into a shadow of each panel (what it should show);
+// the panels' own state (what they show, where their address counter points) is tracked
+// beside it, and only the cells that differ are sent, with a set-address command where a
+// run of changes is not contiguous.
+//
+// A byte takes the bus for a few microseconds, then its panel needs 'exec' before it
+// accepts the next one (37 us per the datasheet; R/W is tied low, so the busy flag cannot
+// be read and the time is waited out). LcdBus_Next picks the next byte from any panel that
+// is ready, round-robin, so one panel's execution time is spent writing to the others
+// instead of waiting. Clearing a panel only blanks its shadow: the 1.5 ms clear command is
+// never sent after power-up, a clear costs the cells that were not blank.
+//
+// Times are in the caller's unit (CPU cycles on the TM4C, microseconds in fleetsim) and
+// wrap freely; spans must stay below 2^31 units.
+#ifndef LCDBUS_H
+#define LCDBUS_H
+
+#include <stdint.h>
+#include "tracker_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LCDBUS_MAX_PANELS 4
+#define LCDBUS_IDLE       0xFFFFFFFFU  // LcdBus_Wait: nothing left to send
+
+typedef struct {
+    char want[CFG_LCD_ROWS][CFG_LCD_COLS];   // Shadow: what the screens wrote
+    char shown[CFG_LCD_ROWS][CFG_LCD_COLS];  // What the panel displays
+    uint8_t row, col;             // Write position of LcdBus_Put
+    uint8_t addr;                 // The panel's DDRAM address counter
+    uint8_t dirty;                // 1 while 'want' may differ from 'shown'
+    uint32_t ready;               // Time from which the panel takes the next byte
+    uint32_t bytes;               // Commands and characters sent to this panel
+} LcdPanel;
+
+typedef struct {
+    LcdPanel panel[LCDBUS_MAX_PANELS];
+    uint8_t n;                    // Panels on the bus
+    uint8_t up;                   // 1 once LcdBus_Up has been called
+    uint8_t next;                 // Panel LcdBus_Next looks at first
+    uint32_t exec;                // From the start of a byte until its panel takes the next one
+    uint32_t bytes;               // Bytes sent, all panels
+} LcdBus;
+
+// A byte for the bus: RS (0 command, 1 character) and the enable line of 'panel'.
+typedef struct {
+    uint8_t panel;
+    uint8_t rs;
+    uint8_t byte;
+} LcdBusOp;
+
+// Start with 'panels' blank shadows. Nothing is sent before LcdBus_Up.
+void LcdBus_Init(LcdBus *b, uint8_t panels, uint32_t exec);
+
+// The power-up sequence has run on every panel at 'ready': they are blank, the address
+// counters at 0 and incrementing. What the shadows hold already goes out from here.
+void LcdBus_Up(LcdBus *b, uint32_t ready);
+
+// Shadow writes, as the LCD_* calls make them. Writes to a panel that does not exist and
+// characters past the end of a row are dropped.
+void LcdBus_Clear(LcdBus *b, uint8_t panel);
+void LcdBus_Cursor(LcdBus *b, uint8_t panel, uint8_t col, uint8_t row);
+void LcdBus_Put(LcdBus *b, uint8_t panel, char c);
+
+// The next byte to put on the bus at 'now': fills 'op' and returns 1 (the panel counts as
+// busy from 'now' for 'exec'), or returns 0 when no panel with changes is ready.
+int LcdBus_Next(LcdBus *b, uint32_t now, LcdBusOp *op);
+
+// Time until LcdBus_Next may have a byte (0: now), or LCDBUS_IDLE when every panel shows
+// its shadow.
+uint32_t LcdBus_Wait(LcdBus *b, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCDBUS_H
@@ -0,0 +1,476 @@
+//link.c
+
+#include "tracker.h"
+#include "link.h"
+#include "frame.h"
+#include "history.h"
+
+BackfillStats backfill_stats;             // Zero-initialized: BACKFILL_IDLE
+uint32_t link_bad_frames = 0;
+LinkHeartbeat link_heartbeat;
+LinkTelemetry link_telemetry;
+LinkWindow link_windows[LINK_WINDOWS] = {
+    { .window_s = CFG_ARCHIVE_SHORT_WINDOW_S }, { .window_s = CFG_ARCHIVE_LONG_WINDOW_S }
+};
+LinkQueryStats link_query_stats;
+LinkQuality link_quality;
+SelfTest link_self_test;
+LinkAlarmStats link_alarm_stats;
+
+static uint8_t price_seen = 0;            // 1 once the first price line has arrived
+static uint32_t stale_deadline = 0;       // Millis() after which the link counts as stale
+static uint32_t price_ms;                 // Millis() of the last price line
+static uint32_t fail_ms[4];               // Millis() of the last failed line per LINE_* class
+static uint8_t fail_seen;                 // Bit per LINE_* class with a valid fail_ms entry
+
+// Backfill points are staged here until the last frame arrives, then ingested in one batch.
+static int32_t bf_points[CFG_BACKFILL_MAX_POINTS];
+static uint32_t bf_t0;                    // Time of the first staged point
+static uint16_t bf_dt;                    // Spacing of the staged points (seconds)
+static uint16_t bf_total;                 // Frames announced by the sender
+static uint32_t bf_start;                 // Cycle count when frame 0 arrived
+
+// The one window query in flight (answers are matched by id).
+static uint8_t q_pending = 0;             // 1 while waiting for an answer
+static uint8_t q_id = 0;                  // Id of the last query sent
+static uint8_t q_window;                  // Index into link_windows[] of the pending query
+static uint32_t q_sent_ms;                // Millis() when it was sent
+static uint32_t q_sent_cycles;            // Cycle count when it was sent
+static uint32_t q_asked[LINK_WINDOWS];    // Millis() of the last query per window
+
+// Alarm transitions waiting for the ESP32's ack; the oldest one is on the wire.
+static FrameAlarm al_queue[LINK_ALARM_QUEUE];
+static uint8_t al_head, al_count;
+static uint8_t al_tries;                  // Sends of the oldest one so far
+static uint32_t al_first_ms;              // Millis() of its first send
+static uint32_t al_sent_ms;               // Millis() of its last send
+static uint32_t al_next_id;
+
+// Rolling receive error rate: the quality window split into slots, advanced by Link_Is_Noisy.
+#define LQ_SLOTS 6
+static uint32_t lq_bytes[LQ_SLOTS];       // Bytes received per slot
+static uint32_t lq_errors[LQ_SLOTS];      // Errors per slot
+static uint8_t lq_slot;                   // Slot being filled
+static uint32_t lq_slot_start;            // Millis() when it started
+static uint32_t lq_last_bytes;            // Counters at that time
+static uint32_t lq_last_errors;
+
+static void Backfill_Abort(void) {
+    backfill_stats.state = BACKFILL_FAILED;
+}
+
+static void Backfill_Frame(const char *payload, uint32_t len, uint32_t line_len) {
+    FrameBackfill hdr;
+    uint32_t room = CFG_BACKFILL_MAX_POINTS - backfill_stats.points;
+    int32_t *dst = &bf_points[backfill_stats.points];
+
+    if (backfill_stats.state != BACKFILL_RECEIVING) {
+        room = CFG_BACKFILL_MAX_POINTS;   // Only frame 0 can start a sequence.
+        dst = bf_points;
+    }
+    if (!Frame_Decode_Backfill(payload, len, &hdr, dst, (uint16_t)(room > 0xFFFFU ? 0xFFFFU : room))) {
+        link_bad_frames++;
+        if (backfill_stats.state == BACKFILL_RECEIVING)
+            Backfill_Abort();             // A hole in the series: drop the whole sequence.
+        return;
+    }
+
+    if (hdr.seq == 0) {                   // Start (or restart) a sequence.
+        backfill_stats.state = BACKFILL_RECEIVING;
+        backfill_stats.frames = 0;
+        backfill_stats.bytes = 0;
+        backfill_stats.points = 0;
+        backfill_stats.ingested = 0;
+        bf_t0 = hdr.t0;
+        bf_dt = hdr.dt;
+        bf_total = hdr.total;
+        bf_start = Cycles_Now();
+        if (dst != bf_points) {           // Decoded behind a previous partial sequence: move to the front.
+            uint32_t i;
+            for (i = 0; i < hdr.n; i++)
+                bf_points[i] = dst[i];
+        }
+    } else if (backfill_stats.state != BACKFILL_RECEIVING || hdr.seq != backfill_stats.frames ||
+               hdr.total != bf_total || hdr.dt != bf_dt ||
+               hdr.t0 != bf_t0 + backfill_stats.points * bf_dt) {
+        if (backfill_stats.state == BACKFILL_RECEIVING)
+            Backfill_Abort();             // Missing, repeated or inconsistent frame.
+        return;
+    }
+
+    backfill_stats.frames++;
+    backfill_stats.bytes += line_len + 1;
+    backfill_stats.points += hdr.n;
+
+    if (backfill_stats.frames == bf_total) {
+        uint32_t t = Cycles_Now();
+        backfill_stats.transfer_cycles = t - bf_start;
+        backfill_stats.ingested = History_Ingest(bf_t0, bf_dt, bf_points, backfill_stats.points);
+        backfill_stats.ingest_cycles = Cycles_Now() - t;
+        backfill_stats.state = BACKFILL_DONE;
+    }
+}
+
+static void Heartbeat_Frame(const char *payload, uint32_t len) {
+    FrameHeartbeat hb;
+    if (!Frame_Decode_Heartbeat(payload, len, &hb)) {
+        link_bad_frames++;
+        return;
+    }
+    link_heartbeat.received++;
+    link_heartbeat.sleep_ms = hb.sleep_ms;
+    link_heartbeat.awake_ms = hb.awake_ms;
+    link_heartbeat.radio_ms = hb.radio_ms;
+    link_heartbeat.wake_to_frame_ms = hb.wake_to_frame_ms;
+    link_heartbeat.cycle = hb.cycle;
+    if (price_seen)                       // The ESP32 is asleep until then: not a fault.
+        stale_deadline = Millis() + hb.sleep_ms + CFG_POWER_STALE_GRACE_MS;
+}
+
+static void Telemetry_Frame(const char *payload, uint32_t len) {
+    FrameTelemetry t;
+    if (!Frame_Decode_Telemetry(payload, len, &t)) {
+        link_bad_frames++;
+        return;
+    }
+    link_telemetry.last = t;      // Only copied: the page and the marker read it when they draw.
+    link_telemetry.updated = Millis();
+    link_telemetry.received++;
+}
+
+uint8_t Link_Stale_Cause(void) {
+    if (link_telemetry.received == 0 || link_telemetry.last.fail > FRAME_FAIL_API)
+        return FRAME_FAIL_NONE;
+    if (price_seen && (int32_t)(link_telemetry.updated - price_ms) < 0)
+        return FRAME_FAIL_NONE;   // Reported before the last price: it says nothing about now.
+    return (uint8_t)link_telemetry.last.fail;
+}
+
+const char *Link_Fail_Text(uint8_t fail) {
+    static const char *const text[] = {
+        NULL, CFG_STR_FAIL_WIFI, CFG_STR_FAIL_DNS, CFG_STR_FAIL_TLS, CFG_STR_FAIL_HTTP, CFG_STR_FAIL_API
+    };
+    return fail <= FRAME_FAIL_API ? text[fail] : NULL;
+}
+
+static void Link_Send_Frame(const char *frame) {
+    UART1_Output_String(frame);
+    UART1_Output_Character('\n');
+}
+
+static void Test_Frame(const char *payload, uint32_t len) {
+    FrameTest f;
+    FrameTestResult r;
+    char frame[64];
+    uint32_t runs = link_self_test.runs;
+    if (!Frame_Decode_Test(payload, len, &f)) {
+        link_bad_frames++;
+        SelfTest_Bad(&link_self_test);
+        return;
+    }
+    SelfTest_Frame(&link_self_test, &f, Millis() * 1000U, UART1_Pending());
+    if (price_seen)                       // No prices while the ESP32 is testing: not a fault.
+        stale_deadline = Millis() + CFG_POLL_INTERVAL_MS + CFG_POWER_STALE_GRACE_MS;
+    if (link_self_test.runs != runs) {
+        r = link_self_test.result;
+        if (Frame_Encode_Test_Result(frame, sizeof(frame), &r))
+            Link_Send_Frame(frame);
+    }
+}
+
+static void Alarm_Send(uint32_t now) {
+    char frame[64];
+    if (Frame_Encode_Alarm(frame, sizeof(frame), &al_queue[al_head]) == 0)
+        return;
+    Link_Send_Frame(frame);
+    if (al_tries++ == 0)
+        al_first_ms = now;
+    al_sent_ms = now;
+    link_alarm_stats.sent++;
+}
+
+// Drop the oldest transition and put the next one on the wire.
+static void Alarm_Next(uint32_t now) {
+    al_head = (uint8_t)((al_head + 1) % LINK_ALARM_QUEUE);
+    al_count--;
+    al_tries = 0;
+    if (al_count)
+        Alarm_Send(now);
+}
+
+static void Alarm_Ack_Frame(const char *payload, uint32_t len) {
+    FrameAlarmAck k;
+    uint32_t now = Millis(), latency;
+    if (!Frame_Decode_Alarm_Ack(payload, len, &k)) {
+        link_bad_frames++;
+        return;
+    }
+    if (al_count == 0 || k.id != al_queue[al_head].id)
+        return;                           // Ack of a resend already answered.
+    latency = now - al_first_ms;
+    link_alarm_stats.acked++;
+    if (k.status == FRAME_NOTIFY_DELIVERED)
+        link_alarm_stats.delivered++;
+    link_alarm_stats.id_last = k.id;
+    link_alarm_stats.status_last = k.status;
+    link_alarm_stats.attempts_last = k.attempts;
+    link_alarm_stats.latency_last_ms = latency;
+    if (latency > link_alarm_stats.latency_max_ms)
+        link_alarm_stats.latency_max_ms = latency;
+    link_alarm_stats.forward_last_ms = k.forward_ms;
+    Alarm_Next(now);
+}
+
+void Link_Alarm(int on, int32_t cents, uint32_t time, int test) {
+    FrameAlarm *a;
+    link_alarm_stats.queued++;
+    if (al_count == LINK_ALARM_QUEUE) {
+        link_alarm_stats.overflows++;     // The ESP32 has not answered for a while: keep the newest.
+        Alarm_Next(Millis());
+    }
+    a = &al_queue[(al_head + al_count) % LINK_ALARM_QUEUE];
+    a->id = ++al_next_id;
+    a->on = on != 0;
+    a->cents = cents;
+    a->time = time;
+    a->test = test != 0;
+    if (al_count++ == 0)
+        Alarm_Send(Millis());             // High priority: no waiting for the next poll.
+}
+
+void Link_Alarm_Poll(uint32_t now) {
+    if (al_count == 0 || now - al_sent_ms < CFG_ALARM_ACK_MS)
+        return;
+    if (al_tries > CFG_ALARM_RETRIES) {
+        link_alarm_stats.timeouts++;      // No ESP32, or an older build that ignores '$A'.
+        Alarm_Next(now);
+        return;
+    }
+    Alarm_Send(now);
+}
+
+void Link_SelfTest_Request(void) {
+    FrameTest f = { 0, 0, 0, 0 };
+    char frame[32];
+    if (Frame_Encode_Test(frame, sizeof(frame), &f))
+        Link_Send_Frame(frame);
+}
+
+static void Window_Frame(const char *payload, uint32_t len) {
+    FrameWindow fw;
+    LinkWindow *w;
+    uint32_t rtt;
+    if (!Frame_Decode_Window(payload, len, &fw)) {
+        link_bad_frames++;
+        return;
+    }
+    if (!q_pending || fw.id != q_id) {
+        link_query_stats.stray++;         // Answer to a query already given up on.
+        return;
+    }
+    q_pending = 0;
+    rtt = (Cycles_Now() - q_sent_cycles) / (SystemCoreClock / 1000000U);
+    link_query_stats.answered++;
+    link_query_stats.rtt_last_us = rtt;
+    if (rtt > link_query_stats.rtt_max_us)
+        link_query_stats.rtt_max_us = rtt;
+    link_query_stats.service_last_us = fw.service_us;
+
+    w = &link_windows[q_window];
+    w->res_s = fw.res_s;
+    w->count = fw.count;
+    w->open = fw.open;
+    w->high = fw.high;
+    w->low = fw.low;
+    w->close = fw.close;
+    w->mean = fw.mean;
+    w->updated = Millis();
+}
+
+void Link_Query_Poll(uint32_t now) {
+    FrameQuery q;
+    char frame[32];
+    uint32_t k;
+    if (q_pending) {
+        if (now - q_sent_ms < CFG_ARCHIVE_TIMEOUT_MS)
+            return;
+        q_pending = 0;                    // No answer (ESP32 busy, asleep or an older build).
+        link_query_stats.timeouts++;
+    }
+    for (k = 0; k < LINK_WINDOWS; k++) {
+        if (link_windows[k].updated == 0 || now - q_asked[k] >= CFG_ARCHIVE_QUERY_MS)
+            break;                        // Never answered, or due for a refresh.
+    }
+    if (k == LINK_WINDOWS)
+        return;
+    q.id = ++q_id;
+    q.asset = CFG_ASSET_BTC;
+    q.window_s = link_windows[k].window_s;
+    if (Frame_Encode_Query(frame, sizeof(frame), &q) == 0)
+        return;
+    Link_Send_Frame(frame);
+    q_pending = 1;
+    q_window = (uint8_t)k;
+    q_sent_ms = now;
+    q_sent_cycles = Cycles_Now();
+    q_asked[k] = now;
+    link_query_stats.sent++;
+}
+
+void Link_Line_Dropped(void) {
+    link_quality.lines_dropped++;
+    SelfTest_Bad(&link_self_test);
+    fail_ms[LINE_CORRUPT] = Millis();
+    fail_seen |= 1U << LINE_CORRUPT;
+}
+
+// Case-insensitive substring search.
+static int Line_Contains(const char *line, uint32_t len, const char *word) {
+    uint32_t i, k;
+    for (i = 0; i < len; i++) {
+        for (k = 0; word[k] && i + k < len; k++) {
+            char c = line[i + k];
+            if (c >= 'A' && c <= 'Z')
+                c = (char)(c - 'A' + 'a');
+            if (c != word[k])
+                break;
+        }
+        if (word[k] == '\0')
+            return 1;
+    }
+    return 0;
+}
+
+// Does the line carry a piece of the price format? True for a line cut off inside the
+// format's leading text, or one holding any literal run of at least 6 characters of
+// CFG_PROTO_PRICE_RX ("BTC Price: $", ", 24h Change: ").
+static int Line_Looks_Like_Price(const char *line, uint32_t len) {
+    const char *f = CFG_PROTO_PRICE_RX;
+    uint32_t i, k, run;
+    for (i = 0; i < len && f[i] && f[i] != '%' && line[i] == f[i]; i++) { }
+    if (i == len)
+        return 1;
+    while (*f) {
+        for (run = 0; f[run] && f[run] != '%'; run++) { }
+        for (i = 0; run >= 6 && i + run <= len; i++) {
+            for (k = 0; k < run && line[i + k] == f[k]; k++) { }
+            if (k == run)
+                return 1;
+        }
+        f += run;
+        if (*f == '%') {                  // Skip the conversion ("%f", "%lu", "%%").
+            f++;
+            if (*f == 'l')
+                f++;
+            if (*f)
+                f++;
+        }
+    }
+    return 0;
+}
+
+uint8_t Link_Line_Failed(const char *line, uint32_t len, uint32_t now) {
+    uint8_t cls = LINE_NOISE;
+    uint32_t i;
+    for (i = 0; i < len; i++) {
+        if ((unsigned char)line[i] < 0x20 || (unsigned char)line[i] > 0x7E)
+            cls = LINE_CORRUPT;           // The ESP32 only ever sends printable text.
+    }
+    if (cls != LINE_CORRUPT && len > 0 && Line_Looks_Like_Price(line, len))
+        cls = LINE_CORRUPT;
+    else if (cls != LINE_CORRUPT && (Line_Contains(line, len, "error") || Line_Contains(line, len, "fail")))
+        cls = LINE_ERROR;
+    if (cls == LINE_NOISE)
+        link_quality.lines_noise++;
+    else if (cls == LINE_ERROR)
+        link_quality.lines_error++;
+    else
+        link_quality.lines_corrupt++;
+    fail_ms[cls] = now;
+    fail_seen |= 1U << cls;
+    return cls;
+}
+
+char Link_Status_Glyph(uint32_t now) {
+    static const char glyph[4] = { ' ', '.', '!', '?' };
+    uint8_t cls;
+    for (cls = LINE_CORRUPT; cls >= LINE_NOISE; cls--) {    // Worst class first.
+        if ((fail_seen & (1U << cls)) && now - fail_ms[cls] < CFG_STATUS_HOLD_MS)
+            return glyph[cls];
+    }
+    return ' ';
+}
+
+int Link_No_Data(uint32_t now) {
+    return !price_seen || now - price_ms >= CFG_LOADING_TIMEOUT_MS;
+}
+
+void Link_Resync(void) {
+    link_quality.resyncs++;
+}
+
+int Link_Is_Noisy(uint32_t now) {
+    if (now - lq_slot_start >= CFG_UART_QUALITY_WINDOW_S * 1000U / LQ_SLOTS) {
+        uint32_t bytes = uart_rx_stats.bytes;
+        uint32_t errors = uart_rx_stats.framing + uart_rx_stats.parity + uart_rx_stats.overrun + uart_rx_dropped;
+        uint32_t k, b = 0, e = 0;
+        lq_bytes[lq_slot] = bytes - lq_last_bytes;
+        lq_errors[lq_slot] = errors - lq_last_errors;
+        lq_last_bytes = bytes;
+        lq_last_errors = errors;
+        lq_slot = (uint8_t)((lq_slot + 1) % LQ_SLOTS);
+        lq_slot_start = now;
+        for (k = 0; k < LQ_SLOTS; k++) {
+            b += lq_bytes[k];
+            e += lq_errors[k];
+        }
+        link_quality.window_bytes = b;
+        link_quality.window_errors = e;
+        link_quality.errors_per_kb = b ? (uint32_t)((uint64_t)e * 1024U / b) : 0;
+    }
+    return link_quality.window_errors != 0 && link_quality.errors_per_kb >= CFG_UART_NOISY_PER_KB;
+}
+
+void Link_Price_Received(uint32_t now) {
+    price_seen = 1;
+    price_ms = now;
+    stale_deadline = now + CFG_POLL_INTERVAL_MS + CFG_POWER_STALE_GRACE_MS;
+}
+
+int Link_Is_Stale(uint32_t now) {
+    return price_seen && (int32_t)(now - stale_deadline) > 0;   // Signed difference survives wrap-around.
+}
+
+void Link_Handle_Frame(const char *line, uint32_t len) {
+    const char *payload;
+    size_t payload_len;
+    char tag;
+
+    if (!Frame_Open(line, &tag, &payload, &payload_len)) {
+        link_bad_frames++;                // Corrupted in transit; the sender will move on.
+        SelfTest_Bad(&link_self_test);
+        return;
+    }
+    switch (tag) {
+    case CFG_FRAME_BACKFILL:
+        Backfill_Frame(payload, (uint32_t)payload_len, len);
+        break;
+    case CFG_FRAME_HEARTBEAT:
+        Heartbeat_Frame(payload, (uint32_t)payload_len);
+        break;
+    case CFG_FRAME_WINDOW:
+        Window_Frame(payload, (uint32_t)payload_len);
+        break;
+    case CFG_FRAME_TELEMETRY:
+        Telemetry_Frame(payload, (uint32_t)payload_len);
+        break;
+    case CFG_FRAME_TEST:
+        Test_Frame(payload, (uint32_t)payload_len);
+        break;
+    case CFG_FRAME_ALARM_ACK:
+        Alarm_Ack_Frame(payload, (uint32_t)payload_len);
+        break;
+    default:
+        break;                            // Unknown tag from a newer ESP32 build: ignore it.
+    }
+}
@@ -0,0 +1,168 @@
+//link.h
+// Handlers for the checksummed '$' frames arriving from the ESP32 (see frame.h).
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+#include "frame.h"
+#include "selftest.h"
+
+// Boot-time history backfill bookkeeping, kept for diagnostics.
+typedef struct {
+    uint8_t state;                // BACKFILL_IDLE / _RECEIVING / _DONE / _FAILED
+    uint16_t frames;              // Backfill frames accepted so far
+    uint32_t bytes;               // Backfill bytes received, newlines included
+    uint32_t points;              // Points staged (then ingested) in this sequence
+    uint32_t ingested;            // Points actually stored by History_Ingest
+    uint32_t transfer_cycles;     // Cycles from the first to the last backfill frame
+    uint32_t ingest_cycles;       // Cycles spent in History_Ingest
+} BackfillStats;
+
+#define BACKFILL_IDLE      0
+#define BACKFILL_RECEIVING 1
+#define BACKFILL_DONE      2
+#define BACKFILL_FAILED    3
+
+// Latest heartbeat from the ESP32 (all zero until the first one arrives).
+typedef struct {
+    uint32_t received;            // Heartbeats accepted
+    uint32_t sleep_ms;            // Announced quiet period after the last fetch
+    uint32_t awake_ms;            // ESP32 awake time in its last cycle
+    uint32_t radio_ms;            // Wi-Fi on time in its last cycle
+    uint32_t wake_to_frame_ms;    // ESP32 wake-up to price frame sent
+    uint32_t cycle;               // ESP32 poll cycle number
+} LinkHeartbeat;
+
+// Latest health and fetch telemetry from the ESP32.
+typedef struct {
+    uint32_t received;            // Telemetry frames accepted
+    uint32_t updated;             // Millis() when the last one arrived
+    FrameTelemetry last;          // As sent (all zero until the first frame)
+} LinkTelemetry;
+
+// Long-horizon window answered by the ESP32's archive (see archive.h), prices in cents.
+typedef struct {
+    uint32_t window_s;            // Window asked for
+    uint32_t res_s;               // Bucket size of the answer (window start rounded to it)
+    uint32_t count;               // Samples in the window (0: no answer yet, or no data)
+    int32_t open, high, low, close, mean;
+    uint32_t updated;             // Millis() when the answer arrived
+} LinkWindow;
+
+// Query round trips, for diagnostics.
+typedef struct {
+    uint32_t sent;                // Queries sent
+    uint32_t answered;            // Answers matched to the pending query
+    uint32_t timeouts;            // Queries given up after CFG_ARCHIVE_TIMEOUT_MS
+    uint32_t stray;               // Answers with no matching query (late or duplicated)
+    uint32_t rtt_last_us;         // Query sent to answer handled
+    uint32_t rtt_max_us;
+    uint32_t service_last_us;     // Part of rtt_last_us the ESP32 spent computing the answer
+} LinkQueryStats;
+
+// Alarm notifications forwarded through the ESP32, for diagnostics.
+typedef struct {
+    uint32_t queued;              // Transitions handed to Link_Alarm()
+    uint32_t sent;                // Alarm frames sent, resends included
+    uint32_t acked;               // Transitions answered by the ESP32
+    uint32_t delivered;           // ...of which the endpoint accepted
+    uint32_t timeouts;            // Transitions given up after CFG_ALARM_RETRIES resends
+    uint32_t overflows;           // Transitions dropped because LINK_ALARM_QUEUE were pending
+    uint32_t id_last;             // Last transition answered
+    uint32_t status_last;         // Its FRAME_NOTIFY_* outcome
+    uint32_t attempts_last;       // Endpoint attempts the ESP32 made for it
+    uint32_t latency_last_ms;     // First send to the ack: TM4C to endpoint and back over the link
+    uint32_t latency_max_ms;
+    uint32_t forward_last_ms;     // Part of latency_last_ms spent between the ESP32 and the endpoint
+} LinkAlarmStats;
+
+#define LINK_ALARM_QUEUE 4        // Transitions waiting for an ack
+
+#define LINK_WINDOWS 2            // CFG_ARCHIVE_SHORT_WINDOW_S, CFG_ARCHIVE_LONG_WINDOW_S
+
+// Receive line quality, from the UART1 error flags (uart_rx_stats) and the line handling.
+typedef struct {
+    uint32_t lines_dropped;       // Lines discarded because one of their bytes was flagged
+    uint32_t resyncs;             // Breaks that cut off a partial or damaged line
+    uint32_t window_bytes;        // Bytes received in the last CFG_UART_QUALITY_WINDOW_S
+    uint32_t window_errors;       // Framing/parity/overrun errors and ring drops in that window
+    uint32_t errors_per_kb;       // window_errors per 1024 bytes
+    uint32_t lines_noise;         // Lines that failed to parse, by class (LINE_NOISE ...)
+    uint32_t lines_error;
+    uint32_t lines_corrupt;
+} LinkQuality;
+
+// Classes of received lines that are neither a price nor a '$' frame.
+#define LINE_NOISE   1            // ESP32 console chatter: Wi-Fi progress dots, connection messages
+#define LINE_ERROR   2            // The ESP32 reporting a failure ("HTTP error: -1", "JSON parsing error.")
+#define LINE_CORRUPT 3            // Damaged in transit: a truncated or garbled price line, or flagged bytes
+
+extern BackfillStats backfill_stats;  // Statistics of the most recent backfill
+extern LinkWindow link_windows[LINK_WINDOWS];  // Latest answer per window
+extern LinkQueryStats link_query_stats;
+extern LinkQuality link_quality;
+extern LinkHeartbeat link_heartbeat;  // Power/latency figures reported by the ESP32
+extern LinkTelemetry link_telemetry;  // ESP32 health and fetch timings (diagnostics page)
+extern uint32_t link_bad_frames;      // '$' lines rejected for a bad checksum or format
+extern SelfTest link_self_test;       // Link throughput self-test, running or last completed
+extern LinkAlarmStats link_alarm_stats;
+
+// Handle one received '$' line ('len' characters, no newline). Never touches the display,
+// so extension frames can be interleaved with price lines without disturbing them.
+void Link_Handle_Frame(const char *line, uint32_t len);
+
+// Record that a price line was received at 'now' (Millis()). The link is expected to
+// deliver the next one within the poll interval.
+void Link_Price_Received(uint32_t now);
+
+// Non-zero once a price has been received and the next one is overdue. A heartbeat
+// announcing an ESP32 sleep period pushes the deadline out accordingly.
+int Link_Is_Stale(uint32_t now);
+
+// Why no price has arrived, as far as the ESP32 can tell: the FRAME_FAIL_* phase of its last
+// fetch if a telemetry frame since the last price reported a failure, else FRAME_FAIL_NONE
+// (no report: the ESP32 or the link itself is down).
+uint8_t Link_Stale_Cause(void);
+
+// Marker text of a FRAME_FAIL_* phase (CFG_STR_FAIL_*), NULL for FRAME_FAIL_NONE.
+const char *Link_Fail_Text(uint8_t fail);
+
+// Line handling events for the quality metrics: a line dropped for a receive error, and
+// a break (frame-start marker) that cut off a partial line.
+void Link_Line_Dropped(void);
+void Link_Resync(void);
+
+// Classify a line that did not parse as a price ('len' characters, no newline), count it
+// and remember it for the status glyph. Returns its LINE_* class.
+uint8_t Link_Line_Failed(const char *line, uint32_t len, uint32_t now);
+
+// Character for the display's status cell: the class of the worst line failure in the last
+// CFG_STATUS_HOLD_MS ('?' corrupt, '!' error report, '.' noise), or ' ' if there was none.
+char Link_Status_Glyph(uint32_t now);
+
+// Non-zero while there is no price worth showing: none received since boot, or none for
+// CFG_LOADING_TIMEOUT_MS.
+int Link_No_Data(uint32_t now);
+
+// Advance the rolling error rate (call often, e.g. from the idle loop) and report whether
+// it is at or above CFG_UART_NOISY_PER_KB.
+int Link_Is_Noisy(uint32_t now);
+
+// Send the next due window query to the ESP32 over UART1 (one outstanding at a time, each
+// window refreshed every CFG_ARCHIVE_QUERY_MS). Call right after a price line: an ESP32
+// in a sleep mode only listens for CFG_ARCHIVE_LISTEN_MS after sending one.
+void Link_Query_Poll(uint32_t now);
+
+// Queue an alarm transition for the ESP32 to forward to the notification endpoint; the oldest
+// unanswered one goes out at once. 'test' marks a notification requested over USB.
+void Link_Alarm(int on, int32_t cents, uint32_t time, int test);
+
+// Resend the oldest unanswered transition every CFG_ALARM_ACK_MS, up to CFG_ALARM_RETRIES
+// times. Call from the idle loop and right after a price line (when a sleeping ESP32 listens).
+void Link_Alarm_Poll(uint32_t now);
+
+// Ask the ESP32 to run the link self-test (a start request frame over UART1). The result is
+// sent back to it as a '$R' frame when the test's done frame arrives.
+void Link_SelfTest_Request(void);
+
+#endif // LINK_H
@@ -2,125 +2,352 @@
 //  @file main.c
 
 #include "tracker.h"          
+#include "flashlog.h"            
+#include "history.h"             
+#include "rules.h"               
+#include "link.h"                
+#include "encoder.h"             
+#include "feed.h"                
+#include "sdlog.h"               
+#include "ui.h"                  
+#include "tft.h"                 
 #include <stdio.h>               
+#include <string.h>              
+
+#define MARKER_BLANK "     "     // Erases a status marker ("STALE" / "NOISY", same width).
+typedef char marker_width_check[(sizeof(CFG_STR_STALE) == sizeof(MARKER_BLANK) &&
+                                 sizeof(CFG_STR_NOISY) == sizeof(MARKER_BLANK) &&
+                                 sizeof(CFG_STR_FAIL_WIFI) <= sizeof(MARKER_BLANK) &&
+                                 sizeof(CFG_STR_FAIL_DNS) <= sizeof(MARKER_BLANK) &&
+                                 sizeof(CFG_STR_FAIL_TLS) <= sizeof(MARKER_BLANK) &&
+                                 sizeof(CFG_STR_FAIL_HTTP) <= sizeof(MARKER_BLANK) &&
+                                 sizeof(CFG_STR_FAIL_API) <= sizeof(MARKER_BLANK)) ? 1 : -1];
+#define STATUS_COL (CFG_LCD_COLS - 1)                  // Reserved cell for the status glyph (first row)
+#define MARKER_COL (STATUS_COL - (sizeof(MARKER_BLANK) - 1))  // The marker sits just left of it
+
+static const char *marker_shown = NULL;  // Status marker on the display: CFG_STR_STALE, CFG_STR_NOISY or none.
+static char glyph_shown = ' ';   // Character in the status cell (see Link_Status_Glyph).
+static int loading_shown = 0;    // 1 while "Loading..." stands in for a price.
+
+// Price screen: label on the first row, price and 24h change ('line2') on the second.
+static void Show_Price(const char *line2, float change) {
+    marker_shown = NULL;       // The clear below removes the marker and the glyph.
+    glyph_shown = ' ';
+    loading_shown = 0;
+    LCD_Clear();               // Clear the LCD.
+    LCD_Set_Cursor(0, 0);      // Set the cursor at the beginning of the first row.
+    LCD_Display_String(CFG_STR_PRICE_LABEL);  // Display a static label.
+    LCD_Set_Cursor(0, 1);      // Set the cursor at the beginning of the second row.
+    LCD_Display_String(line2); // Display the formatted price and change string.
+    RGB_LED_Set_Normal(change);  // Set the LED color according to the price change.
+}
+
+// Line assembly and the latest tick, shared by the boot loops and the main loop.
+static char uart_buffer[BUFFER_SIZE];  // Received characters of the current line.
+static uint8_t line_pos = 0;     // Position of the next character in uart_buffer.
+static uint8_t line_len = 0;     // Length of the line Read_Line() completed last.
+static int discard = 0;          // 1 while skipping the rest of a line that contained a receive error.
+static float price = 0.0f, change = 0.0f;  // The parsed BTC price and 24h change percentage.
+static unsigned long tick_time = 0;        // Unix time of the tick as stamped by the ESP32 (0 if it has no clock yet).
+static int32_t cents = 0;                  // The parsed price in cents (as logged and streamed).
+static uint32_t fired = 0;                 // Alert rules that fired on this tick, bit per rule (rules.h).
+static int boot_price = 0;       // 1 once a price was ingested while the boot screens held the display.
+
+// Move received characters into uart_buffer until a line is complete. Returns 1 with the line
+// null-terminated in uart_buffer (line_len characters, possibly none), 0 once the ring is empty.
+static int Read_Line(void) {
+    char c;
+    while (UART1_Char_Available()) {
+        c = UART1_Input_Character();  // Get a character from UART.
+        if (c == UART_RX_ERROR) {
+            // A byte of this line arrived damaged (or was lost): drop the line right away rather
+            // than let the parser guess, and skip what is left of it.
+            if (!discard)
+                Link_Line_Dropped();
+            line_pos = 0;
+            discard = 1;
+            continue;
+        }
+        if (c == UART_RX_BREAK) {
+            // The ESP32 sends a break before every line, so the next byte starts a fresh frame.
+            if (line_pos > 0 || discard)
+                Link_Resync();     // Cut off a partial or damaged line.
+            line_pos = 0;
+            discard = 0;
+            continue;
+        }
+        if (discard) {
+            if (c == '\n' || c == '\r')
+                discard = 0;       // End of the damaged line.
+            continue;
+        }
+        // Check if we reached the end of a line (newline or carriage return) or the buffer is nearly full.
+        if ((c == '\n') || (c == '\r') || (line_pos >= BUFFER_SIZE - 1)) {
+            uart_buffer[line_pos] = '\0';    // Null-terminate the UART buffer to form a valid string.
+            line_len = line_pos;
+            line_pos = 0;               // The next character starts a new line.
+            if (line_len > 0)
+                Boot_Mark(BOOT_FIRST_LINE);
+            return 1;
+        }
+        uart_buffer[line_pos++] = c;  // Append the received character to the buffer and increment the line_pos.
+    }
+    return 0;
+}
+
+// Everything a received line causes except the display update: frames go to the link, a price
+// to the logs, the RAM history and the link deadlines. Returns 1 for a price line (now in
+// price, change, tick_time, cents and fired) that the display should show.
+static int Ingest_Line(void) {
+    uint32_t bad_frames;                // link_bad_frames before handling a '$' frame.
+    // Parse the UART buffer expecting a format: "BTC Price: $<price>, 24h Change: <change>%, T: <time>"
+    // Older ESP32 firmware omits the time field; such ticks are shown but not logged.
+    tick_time = 0;
+    if (uart_buffer[0] == '$') {
+        // Checksummed extension frame (e.g. history backfill): handled without touching the display.
+        bad_frames = link_bad_frames;
+        Link_Handle_Frame(uart_buffer, line_len);
+        Feed_Frame(uart_buffer[1], link_bad_frames == bad_frames, line_len);  // Report the frame and whether it was accepted.
+        return 0;
+    }
+    if (sscanf(uart_buffer, CFG_PROTO_PRICE_RX, &price, &change, &tick_time) >= 2) {
+        // Extract the price and change percentage from the string into variables.
+        cents = (int32_t)(price * 100.0f + 0.5f);
+        FlashLog_Append((uint32_t)tick_time, cents);  // Queue the tick for the flash history log.
+        Feed_Tick((uint32_t)tick_time, cents, (int16_t)(change * 100.0f));  // Stream the tick to the USB host.
+        SdLog_Tick((uint32_t)tick_time, cents, (int16_t)(change * 100.0f));  // Long-term log on the microSD card.
+        History_Add((uint32_t)tick_time, (int32_t)price);  // Feed the RAM history used for rolling statistics.
+        fired = Rules_Tick(price, change, local_threshold, (uint32_t)tick_time);  // Evaluate the alert rules.
+        Link_Price_Received(Millis());  // Restart the staleness deadline.
+        Link_Query_Poll(Millis());      // Refresh a long-horizon window while the ESP32 listens.
+        Link_Alarm_Poll(Millis());      // Resend an unanswered alarm notification likewise.
+        return 1;
+    }
+    if (line_len > 0) {
+        // Not a price (Wi-Fi progress dots, an ESP32 error report, a damaged line): keep
+        // the last good price on screen. The line is classified and counted, and the idle
+        // loop shows its class in the status cell.
+        Link_Line_Failed(uart_buffer, line_len, Millis());
+    }
+    return 0;
+}
+
+static uint32_t test_lcd_us;     // lcd_stats.busy_us already charged to a self-test redraw
+
+// Self-test bookkeeping for a handled line: its cost from 'start' (cycle count before it was
+// read), then the progress row if the link asks for one and the price screen is up ('draw').
+// The row only reaches the shadow here; LCD_Poll() sends it on the following passes, so a
+// redraw costs the formatting plus the LCD bus time since the previous one. While the panel
+// still has changes to send ('lcd_pending') the redraw is skipped: the display is behind.
+static void Test_Line(uint32_t start, int draw, int lcd_pending) {
+    uint32_t t = Cycles_Now(), us;
+    SelfTest_Busy(&link_self_test, (t - start) / (SystemCoreClock / 1000000U));
+    if (link_self_test.draw && draw) {
+        if (lcd_pending) {
+            SelfTest_Skipped(&link_self_test);
+            return;
+        }
+        Ui_Test_Progress(&link_self_test);
+        us = (Cycles_Now() - t) / (SystemCoreClock / 1000000U) + (lcd_stats.busy_us - test_lcd_us);
+        test_lcd_us = lcd_stats.busy_us;
+        SelfTest_Drawn(&link_self_test, us);
+    }
+}
+
+// One round of the boot loops. The boot screens own the display, but the USB feed, the microSD
+// writer, the TFT and the LCD bus are served and received lines are ingested as they arrive, so nothing
+// piles up in the UART ring. A price is only noted; main() shows it once the screens are done.
+static void Boot_Poll(void) {
+    uint32_t pending = UART1_Pending();
+    if (pending > boot_timeline.ring_peak)
+        boot_timeline.ring_peak = pending;
+    Feed_Poll(Millis());
+    SdLog_Poll(Millis());
+    Tft_Poll(Millis());
+    LCD_Poll();
+    if (Read_Line()) {
+        boot_timeline.early_lines++;
+        if (Ingest_Line())
+            boot_price = 1;
+    }
+}
 
 int main(void) {                 
-    char uart_buffer[BUFFER_SIZE];  // Declare a buffer to store received UART characters.
-    uint8_t index = 0;         // Initialize an index to track the current position in uart_buffer.
-    float price = 0.0f, change = 0.0f;  // Variables to store the parsed BTC price and 24h change percentage.
     char line2[17] = {0};      // A string buffer for formatting the second line of LCD output (16 characters + null terminator).
     
-    // Declare an array of threshold values for price alert (from 10,000 to 120,000).
-    int thresholds[] = {10000, 20000, 30000, 40000, 50000, 60000, 70000, 80000, 90000, 100000, 110000, 120000};
-    int total_thresholds = sizeof(thresholds) / sizeof(thresholds[0]);  
-    // Calculate the number of thresholds by dividing the total size of the array by the size of one element.
-    int adjustable_index = 0;  // Index into the thresholds array; initially set to 0.
-    char threshStr[17] = {0};  // Buffer for formatting threshold string for LCD display (16 characters max + null terminator).
-    uint32_t elapsed = 0;      // Timer variable to count elapsed time in the threshold adjustment phase.
-
-    // Initialize all peripherals:
+    const char *marker;        // Marker the link state calls for.
+    char glyph;                // Status glyph the line failures call for.
+    int show;                  // 1 when the tick in price/change is to be displayed.
+    Pt pt_ui;                  // Coroutine running the LCD power-up sequence, then the boot screens.
+    Pt pt_alarm;               // Coroutine running the alarm blink/beep pattern.
+    int alarm_on = 0;          // 1 while pt_alarm is running.
+    uint32_t alarm_time = 0;   // Tick time reported with the alarm transitions.
+    Pt pt_page;                // Coroutine showing the long-horizon statistics page.
+    int page_on = 0;           // 1 while pt_page is running.
+    Pt pt_test;                // Coroutine showing the result of a link self-test.
+    int test_on = 0;           // 1 while pt_test is running.
+    uint32_t test_shown = 0;   // link_self_test.runs when the last result went up.
+    uint32_t line_start;       // Cycle count before the line being handled was read.
+    int lcd_pending;           // 1 while the LCD bus has changes left to send.
+
+    // Initialize all peripherals. Reception comes first: from BOOT_UART on, whatever the ESP32
+    // sends lands in the UART ring and is ingested by the boot loops below.
+    Cycles_Init();             // Start the cycle counter used for timing measurements (and the boot timeline).
+    SysTick_Init();            // Start the 1 ms time base used for link staleness.
+    Clocks_Init();             // Clock every GPIO port and UART1 at once.
+    Boot_Mark(BOOT_CLOCKS);
+    UART1_Init();              // Initialize UART1 (for receiving BTC price data).
+    Boot_Mark(BOOT_UART);
+    PT_INIT(&pt_ui);
+    LCD_Init_Thread(&pt_ui);   // Start the LCD power-up sequence; it finishes while the rest initialises.
     PushButton_Init();         // Initialize push button (GPIO configuration for PF4).
+    Encoder_Init();            // Start QEI0 counting the rotary encoder (PD6/PD7, switch on PD2).
     RGB_LED_Init();            // Initialize the RGB LED (GPIO configuration for PD0 and PD1).
     Buzzer_Init();             // Initialize the buzzer (GPIO configuration for PF1).
-    LCD_Init();                // Initialize the LCD (including port setup and command sequence).
-    UART1_Init();              // Initialize UART1 (for receiving BTC price data).
-
-    // Threshold adjustment phase: allow the user to select the minimum price value.
-    LCD_Clear();               // Clear the LCD screen.
-    LCD_Set_Cursor(0, 0);      // Set the cursor to the first column of the first row.
-    LCD_Display_String("Set min val:");  // Display the prompt to set the minimum value.
-    
-    // Format and display the initial threshold value using a fixed field width.
-    // "$%-7d" formats the number as left-justified in a field of 7 characters,
-    // ensuring that previous characters are overwritten on the LCD.
-    sprintf(threshStr, "$%-7d", thresholds[adjustable_index]);
-    LCD_Set_Cursor(0, 1);      // Set the cursor to the first column of the second row.
-    LCD_Display_String(threshStr);  // Display the threshold string.
-    
-    // Wait for 4 seconds while monitoring the push button to allow the user to adjust the threshold.
-    while (elapsed < 4000) {   // 4000 milliseconds = 4 seconds.
-        if (PushButton_Pressed()) {  
-            // If the button is pressed, cycle to the next threshold.
-            adjustable_index = (adjustable_index + 1) % total_thresholds;
-            // Use modulo to wrap the index when reaching the end of the thresholds array.
-            sprintf(threshStr, "$%-7d", thresholds[adjustable_index]);
-            // Format the new threshold value.
-            LCD_Set_Cursor(0, 1);      // Set the cursor to the second row.
-            LCD_Display_String(threshStr);  // Update the LCD with the new threshold.
-            elapsed = 0;           // Reset the elapsed time to allow further adjustments.
-            DelayMs(300);          // Wait 300 ms to debounce and avoid rapid cycling.
-        }
-        DelayMs(100);             // Delay 100 ms between checks.
-        elapsed += 100;           // Increment elapsed time by 100 ms.
-    }
+    FlashLog_Init();           // Rebuild the flash history index from the segment headers.
+    Rules_Init();              // Load the alert rules stored in the EEPROM (or the built-in price < threshold).
+    Feed_Init();               // Connect the USB CDC port that streams ticks and events to a PC.
+    SdLog_Init();              // Set up SSI2/uDMA for the microSD log (the card is mounted when idle).
+    Boot_Mark(BOOT_PERIPH);
 
-    // Save the selected threshold value into the global variable.
-    local_threshold = (float)thresholds[adjustable_index];  
-    // Convert the selected integer threshold to float.
-    
-    LCD_Clear();                // Clear the LCD.
-    LCD_Set_Cursor(0, 0);       // Set cursor to the first row.
-    LCD_Display_String("Threshold Saved");  // Inform the user that threshold is saved.
-    DelayMs(3000);              // Wait 3 seconds for the user to read the message.
-    LCD_Clear();                // Clear the LCD in preparation for the main loop.
+    // Boot screens: the LCD power-up sequence, then threshold selection and the "Threshold Saved"
+    // banner. They run as coroutines (ui.c); every wait returns here, and Boot_Poll() serves the
+    // USB feed, the microSD log and the TFT and ingests received lines meanwhile.
+    while (PT_SCHEDULE(LCD_Init_Thread(&pt_ui)))
+        Boot_Poll();
+    Boot_Mark(BOOT_LCD);
+    PT_INIT(&pt_ui);
+    while (PT_SCHEDULE(Ui_Select(&pt_ui)))     // Sets local_threshold when it finishes.
+        Boot_Poll();
+    Boot_Mark(BOOT_UI);
 
     // Main loop: continuously read UART data, parse price, and update the display/alerts.
+    // A price that arrived during the boot screens goes up first, without waiting for the next one.
+    show = boot_price;
     while (1) {
-        char c = UART1_Input_Character();  // Get a character from UART.
-        // Check if we reached the end of a line (newline or carriage return) or the buffer is nearly full.
-        if ((c == '\n') || (c == '\r') || (index >= BUFFER_SIZE - 1)) {
-            uart_buffer[index] = '\0';    // Null-terminate the UART buffer to form a valid string.
-            // Parse the UART buffer expecting a format: "BTC Price: $<price>, 24h Change: <change>%"
-            if (sscanf(uart_buffer, "BTC Price: $%f, 24h Change: %f%%", &price, &change) == 2) {
-                // Extract the price and change percentage from the string into variables.
-                int intPrice = (int)price;  // Convert the float price to an integer for formatting.
-                int thousands = intPrice / 1000;  // Calculate the thousands part (integer division).
-                int remainder = intPrice % 1000;  // Calculate the remainder (modulo operation).
-                // Format the price and change to show thousands separated by a comma and a 2-decimal change.
-                sprintf(line2, "$%d,%03d  %+.2f%%", thousands, remainder, change);
-
-                // Check if the current price is below the user-selected threshold.
-                if (price < local_threshold) {
-                    // Continue alerting while price is below threshold and the user hasn't pressed the button.
-                    while (price < local_threshold && !PushButton_Pressed()) {
-                        LCD_Clear();      // Clear the display.
-                        char priceStr[17];  // Buffer for formatting the price string.
-                        sprintf(priceStr, "$%d,%03d", thousands, remainder);  // Format the price.
-                        LCD_Set_Cursor(0, 0);  // Set cursor on the first row.
-                        LCD_Display_String(priceStr);  // Display the formatted price.
-                        LCD_Set_Cursor(0, 1);  // Set cursor on the second row.
-                        LCD_Display_String("BUY NOW");  // Display the alert message.
-                        RGB_LED_Flash_Yellow();  // Flash the RGB LED to signal an alert.
-                        Buzzer_Toggle();   // Toggle the buzzer to generate an audible alert.
-                        DelayMs(150);      // Wait 150 ms between alert updates.
-                    }
-                    alarmStopped = 1;      // If the loop exits, assume the user has stopped the alarm.
-                    Buzzer_Off();          // Make sure the buzzer is turned off.
-                }
-                if (price >= local_threshold) {  
-                    // If the price is above the threshold, ensure the alarm flag is reset.
-                    alarmStopped = 0;
-                }
-
-                LCD_Clear();            // Clear the LCD.
-                LCD_Set_Cursor(0, 0);   // Set the cursor at the beginning of the first row.
-                LCD_Display_String("BTC Price:");  // Display a static label.
-                LCD_Set_Cursor(0, 1);   // Set the cursor at the beginning of the second row.
-                LCD_Display_String(line2);  // Display the formatted price and change string.
-                RGB_LED_Set_Normal(change); // Set the LED color according to the price change.
-                Buzzer_Off();         // Ensure the buzzer is off when no alert is needed.
-            } else {
-                // If the UART data doesn't match the expected format, display a "Loading..." message.
+        if (alarm_on && !PT_SCHEDULE(Ui_Alarm(&pt_alarm))) {
+            // The alarm ended (button pressed or the price recovered): back to the price screen.
+            alarm_on = 0;
+            alarmStopped = 1;      // Assume the user has stopped the alarm.
+            Feed_Alarm(0, cents);
+            SdLog_Alarm(0, cents, alarm_time);
+            Link_Alarm(0, cents, alarm_time, 0);  // Clear notification through the ESP32.
+            Show_Price(line2, change);
+        }
+        if (page_on && !PT_SCHEDULE(Ui_Stats(&pt_page))) {
+            page_on = 0;           // Statistics page timed out: back to the price screen.
+            Show_Price(line2, change);
+        }
+        if (test_on && !PT_SCHEDULE(Ui_Test_Result(&pt_test))) {
+            test_on = 0;           // Self-test result shown: back to the price screen.
+            Show_Price(line2, change);
+        }
+        lcd_pending = LCD_Poll();  // HD44780: send what the screens changed, panels interleaved.
+        if (link_self_test.state != SELFTEST_RUNNING)
+            test_lcd_us = lcd_stats.busy_us;  // Bus time before a self-test is not charged to it.
+        line_start = Cycles_Now();
+        if (!show && !Read_Line()) {
+            // Nothing received: flag the link once the next frame is overdue (heartbeats from a
+            // sleeping ESP32 extend the deadline, so planned quiet periods are not flagged).
+            Feed_Poll(Millis());   // Host commands, periodic counters and history dumps.
+            SdLog_Poll(Millis());  // One non-blocking step of the microSD sector writer.
+            Tft_Poll(Millis());    // TFT: one tile of a pending screen update (no-op with the LCD).
+            Link_Alarm_Poll(Millis());  // Resend an alarm notification the ESP32 has not acked.
+            if (!alarm_on && !test_on && link_self_test.runs != test_shown) {
+                test_shown = link_self_test.runs;
+                PT_INIT(&pt_test); // A self-test just finished: show its result.
+                test_on = 1;
+                page_on = 0;
+            }
+            if (!alarm_on && !page_on && !test_on && PushButton_Pressed()) {
+                PT_INIT(&pt_page); // Button outside an alarm: show the 24h / 7d statistics page.
+                page_on = 1;
+            }
+            // The last good price stays up; "Loading..." only once there has been none for a long time.
+            if (!alarm_on && !page_on && !test_on && !loading_shown && Link_No_Data(Millis())) {
                 LCD_Clear();
                 LCD_Set_Cursor(0, 0);
-                LCD_Display_String("Loading...");
-                GPIOD->DATA &= ~0x03;  // Turn off the RGB LED.
-                Buzzer_Off();          // Turn off the buzzer.
+                LCD_Display_String(CFG_STR_LOADING);
+                GPIOD->DATA &= ~0x03;  // Turn off the RGB LED: it showed the trend of that price.
+                marker_shown = NULL;   // The clear removed the marker and the glyph.
+                glyph_shown = ' ';
+                loading_shown = 1;
+            }
+            // Status marker: STALE outranks NOISY (receive errors per KB over the last minute).
+            // A stale price shows the failing fetch phase instead if the ESP32 reported one.
+            // "Loading..." already says the price is missing, so it gets no marker.
+            marker = Link_Is_Noisy(Millis()) ? CFG_STR_NOISY : NULL;
+            if (Link_Is_Stale(Millis())) {
+                marker = Link_Fail_Text(Link_Stale_Cause());
+                if (marker == NULL)
+                    marker = CFG_STR_STALE;
+            }
+            if (loading_shown)
+                marker = NULL;
+            if (marker != marker_shown && !page_on && !test_on) {
+                LCD_Set_Cursor(MARKER_COL, 0);
+                if (marker)
+                    LCD_Display_String(marker);
+                LCD_Display_String(MARKER_BLANK + (marker ? strlen(marker) : 0));  // Pad a shorter marker.
+                marker_shown = marker;
             }
-            index = 0;               // Reset the buffer index after processing a complete line.
-        } else {
-            uart_buffer[index++] = c;  // Append the received character to the buffer and increment the index.
+            // Status glyph for recent bad lines: rewrites that one cell and nothing else.
+            glyph = Link_Status_Glyph(Millis());
+            if (glyph != glyph_shown && !page_on && !test_on) {
+                LCD_Set_Cursor(STATUS_COL, 0);
+                LCD_Send_Data((unsigned char)glyph);
+                glyph_shown = glyph;
+            }
+            continue;
+        }
+        if (!show && !Ingest_Line()) {
+            if (link_self_test.state == SELFTEST_RUNNING)
+                Test_Line(line_start, !alarm_on && !page_on && !test_on, lcd_pending);
+            continue;              // A frame or a line that is not a price: the display keeps its price.
+        }
+        show = 0;
+        if (CFG_LCD_PANELS > 1)
+            Ui_Side_Panel();       // Second panel: the statistics windows, refreshed with every price.
+        marker_shown = NULL;             // The redraw below removes the marker and the glyph.
+        glyph_shown = ' ';
+        int intPrice = (int)price;  // Convert the float price to an integer for formatting.
+        int thousands = intPrice / 1000;  // Calculate the thousands part (integer division).
+        int remainder = intPrice % 1000;  // Calculate the remainder (modulo operation).
+        // Format the price and change to show thousands separated by a comma and a 2-decimal change,
+        // two spaces apart when the row has room for both (not for a six-digit price with a
+        // two-digit change). Anything longer than the row is cut at its end.
+        int len2 = snprintf(line2, sizeof(line2), "$%d,%03d %+.2f%%", thousands, remainder, change);
+        char *gap = strchr(line2, ' ');
+        if (len2 < (int)sizeof(line2) - 1 && gap != NULL)
+            memmove(gap + 1, gap, strlen(gap) + 1);
+        Boot_Mark(BOOT_FIRST_PRICE);
+
+        if (alarm_on) {
+            // The alarm coroutine owns the display; it shows the new price and stops by
+            // itself once no rule fires any more.
+            Ui_Alarm_Price(price, fired != 0);
+            alarm_time = (uint32_t)tick_time;
+            continue;
+        }
+        // Check whether an alert rule fired (by default: the price is below the selected threshold).
+        if (fired) {
+            Feed_Alarm(1, cents);  // Report the alarm transition to the USB host.
+            SdLog_Alarm(1, cents, (uint32_t)tick_time);  // ...and log it on the microSD card.
+            Link_Alarm(1, cents, (uint32_t)tick_time, 0);  // ...and notify the endpoint at once.
+            // Alert until the price recovers or the button is pressed, without blocking the UART.
+            Ui_Alarm_Price(price, 1);
+            alarm_time = (uint32_t)tick_time;
+            PT_INIT(&pt_alarm);
+            alarm_on = 1;
+            page_on = 0;           // The alarm takes the display from the statistics page.
+            test_on = 0;
+            continue;
         }
+        alarmStopped = 0;       // No rule fired: reset the alarm flag.
+
+        if (!page_on && !test_on)  // Otherwise the page redraws the price when it closes.
+            Show_Price(line2, change);
+        Buzzer_Off();         // Ensure the buzzer is off when no alert is needed.
     }
     return 0;                    // End of main (in an embedded system, main usually never returns).
 }
@@ -0,0 +1,99 @@
+//metrics.c
+
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+static uint32_t Load(const uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+// Append to buf[*len..cap). Returns 0, leaving *len alone, if the text does not fit.
+static int Put(char *buf, size_t cap, size_t *len, const char *fmt, ...) {
+    va_list ap;
+    int n;
+    va_start(ap, fmt);
+    n = vsnprintf(buf + *len, cap - *len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= cap - *len)
+        return 0;
+    *len += (size_t)n;
+    return 1;
+}
+
+// Length of the family name of a series (its name without the labels).
+static size_t Family_Len(const char *name) {
+    const char *brace = strchr(name, '{');
+    return brace ? (size_t)(brace - name) : strlen(name);
+}
+
+uint32_t Metric_Hist_Count(const MetricHist *h) {
+    uint32_t total = 0;
+    uint8_t i;
+    for (i = 0; i <= h->n; i++)
+        total += Load(&h->count[i]);
+    return total;
+}
+
+size_t Metrics_Compact(char *buf, size_t cap, const MetricDesc *m, size_t n) {
+    size_t len = 0, i;
+    if (cap < 3)
+        return 0;
+    Put(buf, cap - 1, &len, "M");               // cap - 1: room for the newline below
+    for (i = 0; i < n; i++) {
+        size_t mark = len;
+        int ok;
+        if (m[i].type == METRIC_HIST) {
+            const MetricHist *h = (const MetricHist *)m[i].p;
+            uint8_t b;
+            ok = Put(buf, cap - 1, &len, " %s=%lu:%lu:", m[i].key,
+                     (unsigned long)Metric_Hist_Count(h), (unsigned long)Load(&h->sum));
+            for (b = 0; ok && b <= h->n; b++)
+                ok = Put(buf, cap - 1, &len, b ? ",%lu" : "%lu", (unsigned long)Load(&h->count[b]));
+        } else if (m[i].type == METRIC_GAUGE) {
+            ok = Put(buf, cap - 1, &len, " %s=%ld", m[i].key,
+                     (long)__atomic_load_n((const int32_t *)m[i].p, __ATOMIC_RELAXED));
+        } else {
+            ok = Put(buf, cap - 1, &len, " %s=%lu", m[i].key, (unsigned long)Load((const uint32_t *)m[i].p));
+        }
+        if (!ok)
+            len = mark;                         // Leave the metric out, keep the line whole.
+    }
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+size_t Metrics_Prometheus(char *buf, size_t cap, const MetricDesc *m, size_t i) {
+    static const char *const types[] = { "counter", "gauge", "histogram" };
+    const MetricDesc *d = &m[i];
+    size_t fam = Family_Len(d->name), len = 0;
+    int ok = 1;
+
+    if (i == 0 || Family_Len(m[i - 1].name) != fam || strncmp(m[i - 1].name, d->name, fam) != 0)
+        ok = Put(buf, cap, &len, "# HELP %.*s %s\n# TYPE %.*s %s\n",
+                 (int)fam, d->name, d->help, (int)fam, d->name, types[d->type]);
+    if (d->type == METRIC_HIST) {
+        const MetricHist *h = (const MetricHist *)d->p;
+        uint32_t cumulative = 0;
+        uint8_t b;
+        for (b = 0; ok && b <= h->n; b++) {
+            cumulative += Load(&h->count[b]);
+            if (b < h->n)
+                ok = Put(buf, cap, &len, "%s_bucket{le=\"%lu\"} %lu\n", d->name,
+                         (unsigned long)h->le[b], (unsigned long)cumulative);
+            else
+                ok = Put(buf, cap, &len, "%s_bucket{le=\"+Inf\"} %lu\n", d->name, (unsigned long)cumulative);
+        }
+        // _count is the +Inf bucket as read above, so the two always agree.
+        ok = ok && Put(buf, cap, &len, "%s_sum %lu\n%s_count %lu\n", d->name,
+                       (unsigned long)Load(&h->sum), d->name, (unsigned long)cumulative);
+    } else if (d->type == METRIC_GAUGE) {
+        ok = ok && Put(buf, cap, &len, "%s %ld\n", d->name,
+                       (long)__atomic_load_n((const int32_t *)d->p, __ATOMIC_RELAXED));
+    } else {
+        ok = ok && Put(buf, cap, &len, "%s %lu\n", d->name, (unsigned long)Load((const uint32_t *)d->p));
+    }
+    return ok ? len : 0;
+}
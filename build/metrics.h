@@ -0,0 +1,82 @@
+//metrics.h
+// Metrics registry of the ESP32 (portable C, also built on the host).
+//
+// Counters, gauges and fixed-bucket histograms are plain words in static storage: nothing is
+// allocated, and an update is a single relaxed atomic add or store, so any task (the loop,
+// the Wi-Fi event handler) may update a metric while another exports it. A histogram is a
+// counter per bucket plus a running sum; an observation scans at most METRIC_BUCKETS bounds.
+//
+// The registry itself is a const table of MetricDesc in flash, one entry per series. Entries
+// of one family (same name up to '{') must be adjacent, e.g.
+//   tracker_fetch_failures_total{phase="dns"}, tracker_fetch_failures_total{phase="tls"}
+// Histogram names take no labels. Two exports walk the table:
+//   compact     one "M key=value ..." line for the debug serial port; a histogram is
+//               key=count:sum:b0,b1,...,bInf
+//   Prometheus  text format 0.0.4, one metric at a time, for the HTTP endpoint
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRIC_COUNTER 0
+#define METRIC_GAUGE   1
+#define METRIC_HIST    2
+
+#define METRIC_BUCKETS 8          // Most finite bucket bounds of a histogram
+
+typedef struct {
+    const uint32_t *le;           // Ascending upper bounds (inclusive) of the finite buckets
+    uint8_t n;                    // Number of bounds in 'le'
+    uint32_t count[METRIC_BUCKETS + 1];  // Observations per bucket, [n] is +Inf (not cumulative)
+    uint32_t sum;                 // Sum of all observations
+} MetricHist;
+
+typedef struct {
+    const char *key;              // Short name for the compact export
+    const char *name;             // Prometheus series name, labels included
+    const char *help;             // HELP text of the family (read from its first entry)
+    uint8_t type;                 // METRIC_COUNTER / _GAUGE / _HIST
+    void *p;                      // uint32_t (counter), int32_t (gauge) or MetricHist
+} MetricDesc;
+
+static inline void Metric_Add(uint32_t *c, uint32_t n) {
+    __atomic_fetch_add(c, n, __ATOMIC_RELAXED);
+}
+
+static inline void Metric_Inc(uint32_t *c) {
+    __atomic_fetch_add(c, 1U, __ATOMIC_RELAXED);
+}
+
+static inline void Metric_Set(int32_t *g, int32_t v) {
+    __atomic_store_n(g, v, __ATOMIC_RELAXED);
+}
+
+static inline void Metric_Observe(MetricHist *h, uint32_t v) {
+    uint8_t i = 0;
+    while (i < h->n && v > h->le[i])
+        i++;
+    __atomic_fetch_add(&h->count[i], 1U, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, v, __ATOMIC_RELAXED);
+}
+
+// Observations held by a histogram (all buckets).
+uint32_t Metric_Hist_Count(const MetricHist *h);
+
+// Compact export of m[0..n-1] as one line (with newline) into 'buf'. Metrics that do not fit
+// are left out. Returns the line length.
+size_t Metrics_Compact(char *buf, size_t cap, const MetricDesc *m, size_t n);
+
+// Prometheus text of entry 'i' of m[], preceded by the HELP and TYPE lines when it opens a
+// family. Returns the length, or 0 if it does not fit in 'cap'.
+size_t Metrics_Prometheus(char *buf, size_t cap, const MetricDesc *m, size_t i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,243 @@
+//plan.c
+
+#include "plan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PLAN_NEW_URGENCY 1e30f    // An asset never updated goes before every other
+
+// Credit is kept in 1/(window_ms * 100) of a request, so the refill per millisecond,
+// (limit - burst) * pct, is an integer and nothing is lost to rounding.
+static uint64_t Cost(const PlanProvider *v) {
+    return (uint64_t)v->window_ms * 100U;
+}
+
+// Requests refilled per window. A limit of one per window leaves nothing beside the burst.
+static uint32_t Rate(const PlanProvider *v) {
+    return v->limit > v->burst ? v->limit - v->burst : v->limit;
+}
+
+static void Refill(PlanProvider *v, uint32_t now) {
+    uint64_t cap = (uint64_t)v->burst * Cost(v);
+    uint32_t elapsed = now - v->updated_ms;
+    v->updated_ms = now;
+    if (v->blocked && (int32_t)(now - v->blocked_until) < 0)
+        return;                                   // No credit builds up while blocked.
+    v->blocked = 0;
+    v->credit += (uint64_t)elapsed * Rate(v) * v->pct;
+    if (v->credit > cap)
+        v->credit = cap;
+}
+
+static int Ready(const PlanProvider *v) {
+    return !v->blocked && v->credit >= Cost(v);
+}
+
+static float Urgency(const Plan *p, uint16_t i, uint32_t now) {
+    const PlanAsset *a = &p->asset[i];
+    float age;
+    if (!a->fresh)
+        return PLAN_NEW_URGENCY;
+    age = (float)(now - a->updated_ms);
+    return age * age * Plan_Weight(p, i);
+}
+
+// qsort() has no context argument, so the comparison finds the assets here.
+static const PlanAsset *sort_assets;
+
+static int By_Urgency(const void *x, const void *y) {
+    float a = sort_assets[*(const uint16_t *)x].urgency, b = sort_assets[*(const uint16_t *)y].urgency;
+    return a < b ? 1 : (a > b ? -1 : 0);
+}
+
+void Plan_Init(Plan *p, PlanAsset *assets, uint16_t *order, uint16_t n, const PlanPolicy *policy, uint32_t now) {
+    uint16_t i;
+    memset(p, 0, sizeof(*p));
+    p->policy = *policy;
+    p->asset = assets;
+    p->order = order;
+    p->n_assets = n;
+    memset(assets, 0, n * sizeof(*assets));
+    for (i = 0; i < n; i++)
+        assets[i].updated_ms = assets[i].since_ms = now;
+}
+
+int Plan_Provider(Plan *p, uint32_t limit, uint32_t window_ms, uint16_t max_ids, uint16_t burst, uint8_t pct, uint32_t now) {
+    PlanProvider *v;
+    if (p->n_providers == PLAN_MAX_PROVIDERS || limit == 0 || window_ms == 0)
+        return -1;
+    v = &p->provider[p->n_providers];
+    memset(v, 0, sizeof(*v));
+    v->limit = limit;
+    v->window_ms = window_ms;
+    v->max_ids = (max_ids == 0 || max_ids > PLAN_MAX_IDS) ? PLAN_MAX_IDS : max_ids;
+    v->burst = burst ? burst : (uint16_t)(limit / 8 ? limit / 8 : 1);
+    if (v->burst >= limit)                        // Some refill is needed to go on at all.
+        v->burst = (uint16_t)(limit > 1 ? limit - 1 : 1);
+    v->pct = (pct == 0 || pct > 100) ? 100 : pct;
+    v->credit = Cost(v);                          // The first request may go out at once.
+    v->updated_ms = now;
+    return p->n_providers++;
+}
+
+int Plan_Next(Plan *p, uint32_t now, PlanBatch *b) {
+    uint16_t n = 0, i, j;
+    int best = -1;
+    float best_score = 0.0f;
+
+    for (i = 0; i < p->n_providers; i++) {
+        Refill(&p->provider[i], now);
+        if (Ready(&p->provider[i]))
+            best = 0;
+    }
+    if (best < 0)
+        return 0;
+
+    // Assets that are due, most urgent first.
+    for (i = 0; i < p->n_assets; i++) {
+        PlanAsset *a = &p->asset[i];
+        if (a->asked || !a->providers || (a->fresh && now - a->updated_ms < p->policy.min_age_ms))
+            continue;
+        a->urgency = Urgency(p, i, now);
+        p->order[n++] = i;
+    }
+    if (n == 0)
+        return 0;
+    sort_assets = p->asset;
+    qsort(p->order, n, sizeof(p->order[0]), By_Urgency);
+
+    // The ready provider whose share of the queue is the most urgent gets the batch.
+    best = -1;
+    for (i = 0; i < p->n_providers; i++) {
+        const PlanProvider *v = &p->provider[i];
+        uint16_t taken = 0;
+        float score = 0.0f;
+        if (!Ready(v))
+            continue;
+        for (j = 0; j < n && taken < v->max_ids; j++)
+            if (p->asset[p->order[j]].providers & (1UL << i)) {
+                score += p->asset[p->order[j]].urgency;
+                taken++;
+            }
+        if (taken && score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    if (best < 0)
+        return 0;
+
+    b->provider = (uint8_t)best;
+    b->n = 0;
+    for (j = 0; j < n && b->n < p->provider[best].max_ids; j++) {
+        PlanAsset *a = &p->asset[p->order[j]];
+        if (a->providers & (1UL << best)) {
+            a->asked = 1;
+            b->asset[b->n++] = p->order[j];
+        }
+    }
+    p->provider[best].credit -= Cost(&p->provider[best]);
+    p->provider[best].requests++;
+    p->provider[best].in_flight++;
+    p->provider[best].ids += b->n;
+    return 1;
+}
+
+uint32_t Plan_Wait(Plan *p, uint32_t now, uint32_t cap) {
+    uint32_t wait_v = cap, wait_a = cap, t;
+    uint16_t i;
+    for (i = 0; i < p->n_providers; i++) {
+        PlanProvider *v = &p->provider[i];
+        uint64_t rate = (uint64_t)Rate(v) * v->pct;
+        Refill(v, now);
+        if (v->blocked)
+            t = v->blocked_until - now;
+        else if (v->credit >= Cost(v))
+            t = 0;
+        else
+            t = (uint32_t)((Cost(v) - v->credit + rate - 1) / rate);
+        if (t < wait_v)
+            wait_v = t;
+    }
+    for (i = 0; i < p->n_assets; i++) {
+        const PlanAsset *a = &p->asset[i];
+        if (a->asked || !a->providers)
+            continue;
+        t = (!a->fresh || now - a->updated_ms >= p->policy.min_age_ms) ? 0
+            : p->policy.min_age_ms - (now - a->updated_ms);
+        if (t < wait_a)
+            wait_a = t;
+    }
+    return wait_v > wait_a ? wait_v : wait_a;
+}
+
+void Plan_Update(Plan *p, uint16_t asset, float price, uint32_t now) {
+    PlanAsset *a = &p->asset[asset];
+    uint32_t age = now - a->updated_ms;
+    if (a->fresh) {
+        a->age_area += (uint64_t)age * age / 2U;
+        if (age > a->age_max)
+            a->age_max = age;
+        if (a->price > 0.0f) {
+            float move = (price - a->price) / a->price * 100.0f;
+            a->vol += ((move < 0.0f ? -move : move) - a->vol) / 8.0f;
+        }
+    } else {
+        a->since_ms = now;                        // Freshness is measured from the first price.
+    }
+    a->price = price;
+    a->fresh = 1;
+    a->asked = 0;
+    a->updated_ms = now;
+    a->updates++;
+}
+
+void Plan_Failed(Plan *p, uint16_t asset) {
+    p->asset[asset].asked = 0;
+}
+
+void Plan_Answered(Plan *p, const PlanBatch *b, int status, uint32_t retry_ms, uint32_t now) {
+    PlanProvider *v = &p->provider[b->provider];
+    if (v->in_flight)
+        v->in_flight--;
+    if (status == 429) {
+        v->throttled++;
+        Refill(v, now);
+        v->credit = 0;
+        v->blocked = 1;
+        v->blocked_until = now + (retry_ms ? retry_ms : v->window_ms / v->limit + 1U);
+    } else if (status != 200) {
+        v->failed++;
+    }
+}
+
+float Plan_Weight(const Plan *p, uint16_t asset) {
+    const PlanAsset *a = &p->asset[asset];
+    float w = 1.0f + p->policy.vol_weight * a->vol;
+    if (a->threshold > 0.0f && a->price > 0.0f && p->policy.near_pct > 0.0f) {
+        float d = (a->price - a->threshold) / a->price * 100.0f;
+        if (d < 0.0f)
+            d = -d;
+        if (d < p->policy.near_pct)
+            w += p->policy.near_weight * (1.0f - d / p->policy.near_pct);
+    }
+    return w;
+}
+
+uint32_t Plan_Mean_Age(const Plan *p, uint16_t asset, uint32_t now) {
+    const PlanAsset *a = &p->asset[asset];
+    uint32_t age = now - a->updated_ms, span = now - a->since_ms;
+    if (!a->fresh)
+        return age;
+    if (span == 0)
+        return 0;
+    return (uint32_t)((a->age_area + (uint64_t)age * age / 2U) / span);
+}
+
+uint32_t Plan_Budget_Used(const Plan *p, uint8_t i, uint32_t start, uint32_t now) {
+    const PlanProvider *v = &p->provider[i];
+    uint64_t allowed = (uint64_t)v->limit * (now - start) / v->window_ms;
+    if (allowed == 0)
+        allowed = 1;
+    return (uint32_t)((uint64_t)v->requests * 100U / allowed);
+}
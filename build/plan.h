@@ -0,0 +1,127 @@
+//plan.h
+// Rate-budget fetch planner (portable C, built for the ESP32 and the Linux feeder).
+//
+// Hundreds of assets spread over a few providers do not fit the providers' request limits
+// one asset at a time. The planner packs assets into multi-id requests (up to a provider's
+// 'max_ids', as /simple/price takes them) and hands a batch to a provider only while that
+// provider's budget allows it. The budget is a token bucket holding 'burst' requests and
+// refilled at (limit - burst) per window, scaled by 'pct': in any window of 'window_ms' at
+// most 'limit' requests go out, however the provider counts its window (fixed or sliding).
+// A 429 answer empties the bucket and blocks the provider for the Retry-After time.
+//
+// Which assets go into a batch: the ones with the highest urgency, age^2 * weight, where age
+// is the time since the asset's last update and
+//   weight = 1 + vol_weight * volatility + near_weight * nearness
+// Volatility is a running mean of the absolute move between updates in percent; nearness
+// rises from 0 to 1 as the price comes within 'near_pct' percent of the asset's threshold.
+// Serving the most urgent asset first makes an asset's refresh interval settle at about
+// 1/sqrt(weight) of the others', which minimises the weighted mean age for a given budget.
+// Assets updated less than 'min_age_ms' ago are left out, so a light load leaves budget
+// unused instead of refetching unchanged prices.
+//
+// Freshness is reported per asset as the time-weighted mean and the largest age it had, and
+// budget use per provider as the requests sent against the requests allowed.
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLAN_MAX_PROVIDERS 8
+#define PLAN_MAX_IDS       100    // Most ids in one batch
+
+typedef struct {
+    uint32_t limit;               // Requests allowed per window
+    uint32_t window_ms;
+    uint16_t max_ids;             // Ids per request (at most PLAN_MAX_IDS)
+    uint16_t burst;               // Requests that may go out back to back (0: limit / 8, at least 1)
+    uint8_t pct;                  // Share of the limit to use, in percent (0: 100)
+    // State and statistics:
+    uint64_t credit;              // Token bucket, in 1/(window_ms * 100) of a request
+    uint32_t updated_ms;          // Time the credit was last brought up to date
+    uint32_t blocked_until;       // No request before this time (after a 429)
+    uint8_t blocked;              // 1 while blocked_until applies
+    uint8_t in_flight;            // Requests sent and not yet answered
+    uint32_t requests;            // Requests sent
+    uint32_t throttled;           // 429 answers
+    uint32_t failed;              // Other failures (no answer, bad status, bad body)
+    uint32_t ids;                 // Ids requested, all requests
+} PlanProvider;
+
+typedef struct {
+    uint32_t providers;           // Bit mask of the providers serving this asset
+    float threshold;              // Price of interest (0: none)
+    float price;                  // Last price (0: none yet)
+    float vol;                    // Mean absolute move between updates, percent
+    uint8_t fresh;                // 1 once the asset has been updated
+    uint8_t asked;                // 1 while it is in a batch that has not been answered
+    uint32_t updated_ms;          // Time of the last update (or of Plan_Init)
+    uint32_t updates;             // Updates received
+    uint32_t age_max;             // Longest time between updates, ms
+    uint64_t age_area;            // Integral of the age over time (ms^2), for the mean age
+    uint32_t since_ms;            // Start of the span age_area covers
+    float urgency;                // Scratch of Plan_Next
+} PlanAsset;
+
+typedef struct {
+    float vol_weight;             // Weight per percent of volatility
+    float near_weight;            // Weight of an asset at its threshold
+    float near_pct;               // Distance from the threshold (percent of the price) at which nearness starts
+    uint32_t min_age_ms;          // Assets younger than this are not fetched
+} PlanPolicy;
+
+typedef struct {
+    PlanPolicy policy;
+    PlanProvider provider[PLAN_MAX_PROVIDERS];
+    uint8_t n_providers;
+    PlanAsset *asset;             // Caller's storage
+    uint16_t n_assets;
+    uint16_t *order;              // Caller's scratch, n_assets entries (urgency order)
+} Plan;
+
+typedef struct {
+    uint8_t provider;
+    uint16_t n;                   // Assets in the batch
+    uint16_t asset[PLAN_MAX_IDS]; // Their indexes
+} PlanBatch;
+
+// Set up a plan for 'n' assets on 'assets' and 'order' (n entries each) at time 'now' (ms).
+// Assets start with no provider and no threshold; providers are added with Plan_Provider.
+void Plan_Init(Plan *p, PlanAsset *assets, uint16_t *order, uint16_t n, const PlanPolicy *policy, uint32_t now);
+
+// Add a provider (limit requests per window_ms, max_ids per request, burst and pct as in
+// PlanProvider, 0 for the defaults). Returns its index, or -1 if PLAN_MAX_PROVIDERS are in use.
+int Plan_Provider(Plan *p, uint32_t limit, uint32_t window_ms, uint16_t max_ids, uint16_t burst, uint8_t pct, uint32_t now);
+
+// The next request to send at 'now': fills 'b' and returns 1, or returns 0 when no provider
+// has budget or no asset is due. Call repeatedly until it returns 0. The batch's assets stay
+// out of later batches until Plan_Update / Plan_Failed is called for each of them.
+int Plan_Next(Plan *p, uint32_t now, PlanBatch *b);
+
+// Milliseconds until Plan_Next may have something to send (0: now), at most 'cap'.
+uint32_t Plan_Wait(Plan *p, uint32_t now, uint32_t cap);
+
+// A batch was answered. Call Plan_Update for each asset in the answer, Plan_Failed for each
+// asset missing from it, then Plan_Answered once for the batch ('status' is the HTTP status,
+// 0 when no answer came; retry_ms is the Retry-After time of a 429, 0 if none was given).
+void Plan_Update(Plan *p, uint16_t asset, float price, uint32_t now);
+void Plan_Failed(Plan *p, uint16_t asset);
+void Plan_Answered(Plan *p, const PlanBatch *b, int status, uint32_t retry_ms, uint32_t now);
+
+// Urgency weight of an asset (1 for a calm asset far from its threshold).
+float Plan_Weight(const Plan *p, uint16_t asset);
+
+// Time-weighted mean age of an asset up to 'now', ms.
+uint32_t Plan_Mean_Age(const Plan *p, uint16_t asset, uint32_t now);
+
+// Share of provider 'i''s limit used since 'start', percent.
+uint32_t Plan_Budget_Used(const Plan *p, uint8_t i, uint32_t start, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLAN_H
@@ -0,0 +1,37 @@
+//pt.c
+
+#include "pt.h"
+
+#ifndef PT_CLOCK
+#include "tracker.h"
+#define PT_CLOCK()      Cycles_Now()
+#define PT_TICKS_PER_MS (SystemCoreClock / 1000U)
+#endif
+
+PtStats pt_stats;
+
+void Pt_Sleep_Start(Pt *pt, uint32_t ms) {
+    pt->wake = PT_CLOCK() + ms * PT_TICKS_PER_MS;
+}
+
+int Pt_Sleep_Done(Pt *pt) {
+    uint32_t late = PT_CLOCK() - pt->wake;
+    if ((int32_t)late < 0)
+        return 0;                 // Deadline still ahead (the difference handles wrap-around).
+    pt->lat_last = late;
+    if (late > pt->lat_max)
+        pt->lat_max = late;
+    if (late > pt_stats.lat_max)
+        pt_stats.lat_max = late;
+    pt_stats.resumes++;
+    return 1;
+}
+
+void Pt_Timer_Set(PtTimer *t, uint32_t ms) {
+    t->start = PT_CLOCK();
+    t->span = ms * PT_TICKS_PER_MS;
+}
+
+int Pt_Timer_Expired(const PtTimer *t) {
+    return (uint32_t)(PT_CLOCK() - t->start) >= t->span;
+}
@@ -0,0 +1,89 @@
+//pt.h
+// Stackless coroutines ("protothreads") for the firmware's long sequential flows.
+//
+// A coroutine is an ordinary function, declared with PT_THREAD, whose body sits between
+// PT_BEGIN and PT_END. Every wait macro stores its source line in pt->lc and returns
+// PT_WAITING; the next call jumps straight back to that line through the switch opened by
+// PT_BEGIN. Nothing is kept on the stack between calls, so a coroutine costs one Pt
+// (16 bytes) and any number of them can be stepped round-robin from the main loop:
+//
+//   while (PT_SCHEDULE(Ui_Select(&pt_ui))) { Feed_Poll(Millis()); ... }
+//
+// Because the body is re-entered through a switch:
+//   - local variables do not survive a wait (keep such state in statics or a struct),
+//   - a wait must not sit inside a switch statement of the body,
+//   - only one wait macro may appear per source line.
+//
+// PT_SLEEP measures resume latency: the time from its deadline to the call that notices
+// it, kept per coroutine (last and worst) and across all coroutines in pt_stats. Time is
+// read in pt.c through PT_CLOCK() (default: the DWT cycle counter, 50 counts per us), so a
+// host build can define PT_CLOCK() and PT_TICKS_PER_MS when compiling pt.c and drive every
+// coroutine from a virtual clock. Sleeps must stay below 2^31 clock counts (42 s at 50 MHz).
+#ifndef PT_H
+#define PT_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint16_t lc;                  // Resume point: source line of the pending wait, 0 = start
+    uint16_t reserved;
+    uint32_t wake;                // PT_CLOCK() deadline of the pending PT_SLEEP
+    uint32_t lat_last;            // Resume latency of the last PT_SLEEP (clock counts)
+    uint32_t lat_max;             // Worst resume latency of this coroutine
+} Pt;
+
+typedef struct {
+    uint32_t resumes;             // PT_SLEEPs completed by all coroutines
+    uint32_t lat_max;             // Worst resume latency seen (clock counts)
+} PtStats;
+
+extern PtStats pt_stats;
+
+// Timeout that does not block (e.g. an inactivity limit spanning several waits).
+typedef struct {
+    uint32_t start;
+    uint32_t span;
+} PtTimer;
+
+// Wait macros fall through into their own case label on purpose.
+#if defined(__GNUC__) && __GNUC__ >= 7
+#define PT_FALLTHROUGH __attribute__((fallthrough))
+#else
+#define PT_FALLTHROUGH
+#endif
+
+#define PT_WAITING 0
+#define PT_EXITED  1
+
+#define PT_THREAD(name_args) int name_args
+#define PT_INIT(pt)    ((pt)->lc = 0)
+#define PT_BEGIN(pt)   switch ((pt)->lc) { case 0:
+#define PT_END(pt)     } PT_INIT(pt); return PT_EXITED
+
+// Return from the coroutine until 'cond' is true when re-entered.
+#define PT_WAIT_UNTIL(pt, cond) \
+    do { (pt)->lc = __LINE__; PT_FALLTHROUGH; case __LINE__: if (!(cond)) return PT_WAITING; } while (0)
+
+// Give the other coroutines one turn.
+#define PT_YIELD(pt) \
+    do { (pt)->lc = __LINE__; return PT_WAITING; case __LINE__: ; } while (0)
+
+// Wait 'ms' milliseconds without blocking.
+#define PT_SLEEP(pt, ms) \
+    do { Pt_Sleep_Start((pt), (ms)); PT_WAIT_UNTIL((pt), Pt_Sleep_Done(pt)); } while (0)
+
+// Run a child coroutine to completion, stepping it each time the parent is called.
+#define PT_SPAWN(pt, child, thread) \
+    do { PT_INIT(child); PT_WAIT_UNTIL((pt), (thread) != PT_WAITING); } while (0)
+
+// Step a coroutine once; true while it has not finished.
+#define PT_SCHEDULE(f) ((f) == PT_WAITING)
+
+// Helpers behind PT_SLEEP.
+void Pt_Sleep_Start(Pt *pt, uint32_t ms);
+int Pt_Sleep_Done(Pt *pt);
+
+void Pt_Timer_Set(PtTimer *t, uint32_t ms);
+int Pt_Timer_Expired(const PtTimer *t);
+
+#endif // PT_H
@@ -0,0 +1,353 @@
+//rules.c
+
+#include "tracker.h"
+#include "rules.h"
+#include "history.h"
+#include <string.h>
+
+#define RULES_MAGIC       0x454C5552U  // "RULE": an EEPROM set follows
+#define RULES_EEPROM_WORD 0U           // First EEPROM word of the stored set (blocks 0-3)
+#define RULES_SET_CYCLES  40U          // Worst case of Rules_Eval outside the rules (call, loop)
+#define RULES_RULE_CYCLES 24U          // ...and per rule (dispatch into Run, result test, fired bit)
+#define RULES_BENCH_RUNS  64U          // Evaluations of the benchmark rule timed at boot
+
+// EEPROM controller (TM4C123GH6PM datasheet, "EEPROM"): 16-word blocks, one word per access.
+#define EEDONE_WORKING    0x00000001U  // EEDONE: an access is in progress
+#define EESUPP_ERRORS     0x0000000CU  // EESUPP: PRETRY | ERETRY, the module could not recover
+#define EEPROM_BLOCK_WORDS 16U
+
+typedef char rules_assert_eeprom[((RULES_IMAGE_MAX + 3) / 4 + 2 <= 4 * EEPROM_BLOCK_WORDS) ? 1 : -1];
+typedef char rules_assert_record[(RULES_IMAGE_MAX <= 255) ? 1 : -1];
+
+// Per opcode: operand bytes, values popped (one is always pushed) and worst-case cycles
+// including the dispatch. 0 cycles marks an unused opcode. Keep tools/rules_compile.py in step.
+typedef struct {
+    uint8_t operand, pops, cycles;
+} RulesOp;
+
+static const RulesOp op_info[RULES_OPS] = {
+    { 0, 0, 0 },                  // 0: unused
+    { 1, 0, 14 },                 // LOAD
+    { 4, 0, 18 },                 // CONST
+    { 0, 2, 14 }, { 0, 2, 14 }, { 0, 2, 14 },  // ADD SUB MUL
+    { 0, 2, 30 },                 // DIV (VDIV.F32 alone is 14)
+    { 0, 2, 16 }, { 0, 2, 16 },   // MIN MAX
+    { 0, 2, 44 },                 // PCT (a divide and a multiply)
+    { 0, 1, 12 }, { 0, 1, 12 },   // NEG ABS
+    { 0, 1, 14 },                 // NOT
+    { 0, 2, 16 }, { 0, 2, 16 }, { 0, 2, 16 }, { 0, 2, 16 },  // LT LE GT GE
+    { 0, 2, 18 }, { 0, 2, 18 },   // AND OR
+};
+
+// A checked set: the image and where each rule's code starts.
+typedef struct {
+    uint8_t image[RULES_IMAGE_MAX];
+    uint8_t len;                  // Image bytes
+    uint8_t count;                // Rules
+    uint8_t start[RULES_MAX];     // Offset of each rule's code in image
+    uint8_t length[RULES_MAX];    // Its length
+    uint32_t ops;                 // Opcodes in all rules
+    uint32_t bound;               // Worst-case cycles of Rules_Eval
+    uint32_t inputs;              // Inputs read, bit per RULES_IN_*
+} RuleSet;
+
+// price < threshold
+static const uint8_t builtin[] = {
+    RULES_VERSION, 1,
+    5, RULES_OP_LOAD, RULES_IN_PRICE, RULES_OP_LOAD, RULES_IN_THRESHOLD, RULES_OP_LT,
+};
+
+// Every opcode once or more, timed at boot for rules_stats.op_ns_x10:
+//   abs(pct(price, prev)) > 2 and not (hour < 6)
+//   or max(price, threshold) / min(mean_24h, low_24h) * -1 * high_24h - high_1h + mean_1h >= 0
+//   or low_1h <= price
+static const uint8_t bench[] = {
+    RULES_VERSION, 1, 56,
+    RULES_OP_LOAD, RULES_IN_PRICE, RULES_OP_LOAD, RULES_IN_PREV, RULES_OP_PCT, RULES_OP_ABS,
+    RULES_OP_CONST, 0x00, 0x00, 0x00, 0x40, RULES_OP_GT,
+    RULES_OP_LOAD, RULES_IN_HOUR, RULES_OP_CONST, 0x00, 0x00, 0xC0, 0x40, RULES_OP_LT,
+    RULES_OP_NOT, RULES_OP_AND,
+    RULES_OP_LOAD, RULES_IN_PRICE, RULES_OP_LOAD, RULES_IN_THRESHOLD, RULES_OP_MAX,
+    RULES_OP_LOAD, RULES_IN_MEAN_24H, RULES_OP_LOAD, RULES_IN_LOW_24H, RULES_OP_MIN, RULES_OP_DIV,
+    RULES_OP_NEG, RULES_OP_LOAD, RULES_IN_HIGH_24H, RULES_OP_MUL, RULES_OP_LOAD, RULES_IN_HIGH_1H,
+    RULES_OP_SUB, RULES_OP_LOAD, RULES_IN_MEAN_1H, RULES_OP_ADD,
+    RULES_OP_CONST, 0x00, 0x00, 0x00, 0x00, RULES_OP_GE, RULES_OP_OR,
+    RULES_OP_LOAD, RULES_IN_LOW_1H, RULES_OP_LOAD, RULES_IN_PRICE, RULES_OP_LE, RULES_OP_OR,
+};
+
+RulesStats rules_stats;
+
+static RuleSet running;           // The set Rules_Eval runs
+static RuleSet scratch;           // A set being checked (kept off the stack)
+static int eeprom_ok;             // 1 once the EEPROM module is up
+
+// Inputs that need the history, bit per RULES_IN_*.
+#define INPUTS_1H  ((1U << RULES_IN_LOW_1H) | (1U << RULES_IN_HIGH_1H) | (1U << RULES_IN_MEAN_1H))
+#define INPUTS_24H ((1U << RULES_IN_LOW_24H) | (1U << RULES_IN_HIGH_24H) | (1U << RULES_IN_MEAN_24H))
+
+// Check an image and compute its bound. 'set' is filled in either way, but only a RULES_OK
+// set may run.
+static uint8_t Verify(const uint8_t *image, uint32_t len, RuleSet *set) {
+    uint32_t pos = 2, r;
+    memset(set, 0, sizeof(*set));
+    if (len < 3 || len > RULES_IMAGE_MAX)
+        return RULES_E_SIZE;
+    if (image[0] != RULES_VERSION)
+        return RULES_E_VERSION;
+    if (image[1] == 0 || image[1] > RULES_MAX)
+        return RULES_E_COUNT;
+    set->bound = RULES_SET_CYCLES;
+    for (r = 0; r < image[1]; r++) {
+        uint32_t end, depth = 0;
+        if (pos >= len || pos + 1U + image[pos] > len)
+            return RULES_E_SIZE;
+        end = pos + 1U + image[pos];
+        set->length[r] = image[pos++];
+        set->start[r] = (uint8_t)pos;
+        set->bound += RULES_RULE_CYCLES;
+        while (pos < end) {
+            uint8_t op = image[pos++];
+            if (op >= RULES_OPS || op_info[op].cycles == 0 || pos + op_info[op].operand > end)
+                return RULES_E_OPCODE;
+            if (op == RULES_OP_LOAD) {
+                if (image[pos] >= RULES_INPUTS)
+                    return RULES_E_OPCODE;
+                set->inputs |= 1U << image[pos];
+            }
+            if (depth < op_info[op].pops)
+                return RULES_E_STACK;
+            depth = depth - op_info[op].pops + 1U;
+            if (depth > RULES_STACK)
+                return RULES_E_STACK;
+            pos += op_info[op].operand;
+            set->ops++;
+            set->bound += op_info[op].cycles;
+        }
+        if (depth != 1)
+            return RULES_E_STACK;
+    }
+    if (pos != len)
+        return RULES_E_COUNT;
+    memcpy(set->image, image, len);
+    set->len = (uint8_t)len;
+    set->count = image[1];
+    return set->bound > CFG_RULES_BUDGET_CYCLES ? RULES_E_BUDGET : RULES_OK;
+}
+
+// One checked rule. No bounds checks here: Verify has made them for every path.
+// 'a' is the value under the top, 'b' the top, for the binary operators (which pop b).
+static float Run(const uint8_t *code, uint32_t len, const float *in) {
+    float stack[RULES_STACK];
+    uint32_t pc = 0, sp = 0;
+#define A stack[sp - 2]
+#define B stack[sp - 1]
+    while (pc < len) {
+        switch (code[pc++]) {
+        case RULES_OP_LOAD:  stack[sp++] = in[code[pc++]]; break;
+        case RULES_OP_CONST: memcpy(&stack[sp++], &code[pc], sizeof(float)); pc += 4; break;
+        case RULES_OP_ADD:   A += B; sp--; break;
+        case RULES_OP_SUB:   A -= B; sp--; break;
+        case RULES_OP_MUL:   A *= B; sp--; break;
+        case RULES_OP_DIV:   A = B != 0.0f ? A / B : 0.0f; sp--; break;
+        case RULES_OP_MIN:   if (B < A) A = B; sp--; break;
+        case RULES_OP_MAX:   if (B > A) A = B; sp--; break;
+        case RULES_OP_PCT:   A = B != 0.0f ? (A - B) / B * 100.0f : 0.0f; sp--; break;
+        case RULES_OP_NEG:   B = -B; break;
+        case RULES_OP_ABS:   if (B < 0.0f) B = -B; break;
+        case RULES_OP_NOT:   B = B == 0.0f ? 1.0f : 0.0f; break;
+        case RULES_OP_LT:    A = A < B ? 1.0f : 0.0f; sp--; break;
+        case RULES_OP_LE:    A = A <= B ? 1.0f : 0.0f; sp--; break;
+        case RULES_OP_GT:    A = A > B ? 1.0f : 0.0f; sp--; break;
+        case RULES_OP_GE:    A = A >= B ? 1.0f : 0.0f; sp--; break;
+        case RULES_OP_AND:   A = (A != 0.0f && B != 0.0f) ? 1.0f : 0.0f; sp--; break;
+        default:             A = (A != 0.0f || B != 0.0f) ? 1.0f : 0.0f; sp--; break;  // OR
+        }
+    }
+#undef A
+#undef B
+    return stack[0];
+}
+
+static uint32_t Eval_Set(const RuleSet *set, const float *in) {
+    uint32_t fired = 0, r;
+    for (r = 0; r < set->count; r++)
+        if (Run(&set->image[set->start[r]], set->length[r], in) != 0.0f)
+            fired |= 1U << r;
+    return fired;
+}
+
+uint32_t Rules_Eval(const float *in) {
+    return Eval_Set(&running, in);
+}
+
+// Low, high and mean of the history since time - span, or the price if there is none.
+static void Window(float *out, uint32_t time, uint32_t span, float price) {
+    HistStats s;
+    s.count = 0;
+    if (time > span)
+        History_Stats(time - span, &s);
+    if (s.count == 0) {
+        out[0] = out[1] = out[2] = price;
+        return;
+    }
+    out[0] = (float)s.min;
+    out[1] = (float)s.max;
+    out[2] = (float)s.mean;
+}
+
+uint32_t Rules_Tick(float price, float change, float threshold, uint32_t time) {
+    static float prev = 0.0f;
+    float in[RULES_INPUTS];
+    uint32_t t0 = Cycles_Now(), t1, t2;
+    in[RULES_IN_PRICE] = price;
+    in[RULES_IN_CHANGE] = change;
+    in[RULES_IN_THRESHOLD] = threshold;
+    in[RULES_IN_PREV] = prev > 0.0f ? prev : price;
+    in[RULES_IN_HOUR] = time ? (float)((time / 3600U) % 24U) : -1.0f;
+    if (running.inputs & INPUTS_1H)
+        Window(&in[RULES_IN_LOW_1H], time, 3600U, price);
+    if (running.inputs & INPUTS_24H)
+        Window(&in[RULES_IN_LOW_24H], time, 86400U, price);
+    prev = price;
+    t1 = Cycles_Now();
+    rules_stats.fired = Rules_Eval(in);
+    t2 = Cycles_Now();
+    rules_stats.last = t2 - t1;
+    if (rules_stats.last > rules_stats.max)
+        rules_stats.max = rules_stats.last;
+    if (rules_stats.last > rules_stats.bound)
+        rules_stats.overruns++;
+    if (t1 - t0 > rules_stats.inputs_max)
+        rules_stats.inputs_max = t1 - t0;
+    return rules_stats.fired;
+}
+
+uint8_t Rules_Load(const uint8_t *image, uint32_t len, uint8_t source) {
+    uint8_t status;
+    rules_stats.changes++;
+    if (len == 0) {
+        image = builtin;
+        len = sizeof(builtin);
+        source = RULES_BUILTIN;
+    }
+    status = Verify(image, len, &scratch);
+    rules_stats.status = status;
+    if (status != RULES_OK)
+        return status;               // The running set stays.
+    running = scratch;
+    rules_stats.source = source;
+    rules_stats.count = running.count;
+    rules_stats.bytes = running.len;
+    rules_stats.ops = running.ops;
+    rules_stats.bound = running.bound;
+    rules_stats.last = rules_stats.max = rules_stats.inputs_max = 0;
+    rules_stats.overruns = 0;
+    rules_stats.fired = 0;
+    return RULES_OK;
+}
+
+// EEPROM
+
+static int Eeprom_Init(void) {
+    SYSCTL->RCGCEEPROM |= 0x01;                 // Clock the EEPROM module.
+    while ((SYSCTL->PREEPROM & 0x01) == 0) { }
+    while (EEPROM->EEDONE & EEDONE_WORKING) { } // It finishes its power-on recovery first.
+    return (EEPROM->EESUPP & EESUPP_ERRORS) == 0;
+}
+
+static void Eeprom_Seek(uint32_t word) {
+    EEPROM->EEBLOCK = word / EEPROM_BLOCK_WORDS;
+    EEPROM->EEOFFSET = word % EEPROM_BLOCK_WORDS;
+}
+
+static uint32_t Eeprom_Read(uint32_t word) {
+    Eeprom_Seek(word);
+    return EEPROM->EERDWR;
+}
+
+static int Eeprom_Write(uint32_t word, uint32_t value) {
+    Eeprom_Seek(word);
+    EEPROM->EERDWR = value;
+    while (EEPROM->EEDONE & EEDONE_WORKING) { }
+    return EEPROM->EEDONE == 0;                 // Any other bit reports a failed write.
+}
+
+static uint16_t Checksum(const uint8_t *p, uint32_t n) {
+    uint32_t h = 0;
+    while (n--)
+        h = h * 31U + *p++;
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+// Stored layout: magic, then length | checksum << 16, then the image, four bytes per word
+// (little-endian). The magic is cleared first and written last, so a reset in the middle of
+// a store leaves no set rather than a damaged one.
+uint8_t Rules_Store(void) {
+    uint32_t i, w;
+    int ok = eeprom_ok;
+    rules_stats.changes++;
+    ok = ok && Eeprom_Write(RULES_EEPROM_WORD, 0);
+    if (rules_stats.source != RULES_BUILTIN) {
+        for (i = 0; ok && i < (running.len + 3U) / 4U; i++) {
+            const uint8_t *b = &running.image[4 * i];  // Bytes past len are zero (Verify).
+            w = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+            ok = Eeprom_Write(RULES_EEPROM_WORD + 2U + i, w);
+        }
+        ok = ok && Eeprom_Write(RULES_EEPROM_WORD + 1U,
+                                running.len | ((uint32_t)Checksum(running.image, running.len) << 16));
+        ok = ok && Eeprom_Write(RULES_EEPROM_WORD, RULES_MAGIC);
+        if (ok)
+            rules_stats.source = RULES_EEPROM;
+    }
+    rules_stats.status = ok ? RULES_OK : RULES_E_EEPROM;
+    return rules_stats.status;
+}
+
+// The stored set into 'image'. Returns its length, 0 if there is none or it is damaged.
+static uint32_t Eeprom_Load(uint8_t *image) {
+    uint32_t head, len, i, w;
+    if (!eeprom_ok || Eeprom_Read(RULES_EEPROM_WORD) != RULES_MAGIC)
+        return 0;
+    head = Eeprom_Read(RULES_EEPROM_WORD + 1U);
+    len = head & 0xFFFFU;
+    if (len == 0 || len > RULES_IMAGE_MAX)
+        return 0;
+    for (i = 0; i < (len + 3U) / 4U; i++) {
+        w = Eeprom_Read(RULES_EEPROM_WORD + 2U + i);
+        image[4 * i] = (uint8_t)w;
+        image[4 * i + 1] = (uint8_t)(w >> 8);
+        image[4 * i + 2] = (uint8_t)(w >> 16);
+        image[4 * i + 3] = (uint8_t)(w >> 24);
+    }
+    return Checksum(image, len) == (uint16_t)(head >> 16) ? len : 0;
+}
+
+// Time the benchmark rule on plausible inputs: mean cycles per opcode, in 0.1 ns.
+static void Bench(void) {
+    static const float in[RULES_INPUTS] = {
+        97000.0f, 1.5f, 90000.0f, 96500.0f, 14.0f, 96000.0f, 98000.0f, 97100.0f, 94000.0f, 99000.0f, 96800.0f
+    };
+    volatile uint32_t sink = 0;
+    uint32_t i, t;
+    if (Verify(bench, sizeof(bench), &scratch) != RULES_OK)
+        return;
+    t = Cycles_Now();
+    for (i = 0; i < RULES_BENCH_RUNS; i++)
+        sink += Eval_Set(&scratch, in);
+    t = Cycles_Now() - t;
+    rules_stats.op_ns_x10 = (uint32_t)((uint64_t)t * 10000000000ULL / SystemCoreClock / (RULES_BENCH_RUNS * scratch.ops));
+}
+
+void Rules_Init(void) {
+    static uint8_t image[RULES_IMAGE_MAX];
+    uint32_t len;
+    uint8_t status;
+    Bench();
+    eeprom_ok = Eeprom_Init();
+    len = Eeprom_Load(image);
+    if (len == 0 || (status = Rules_Load(image, len, RULES_EEPROM)) != RULES_OK) {
+        Rules_Load(NULL, 0, RULES_BUILTIN);
+        if (len)
+            rules_stats.status = status;     // Say why the stored set is not running.
+    }
+}
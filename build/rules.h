@@ -0,0 +1,116 @@
+//rules.h
+// Alert rules: a small stack machine on the TM4C that evaluates user-defined expressions over
+// the current tick and rolling statistics. tools/rules_compile.py compiles them from text, e.g.
+//   price < threshold
+//   pct(price, prev) < -2 or price < low_24h * 0.98
+//
+// A rule set image is
+//   u8 version (RULES_VERSION)  u8 rule count  then per rule: u8 code length, code
+// Code is a sequence of one-byte opcodes; RULES_OP_LOAD is followed by an input index and
+// RULES_OP_CONST by a little-endian float. Values are floats; comparisons and logic give 1 or
+// 0, and a rule fires when it leaves a nonzero value. There are no jumps ('and' and 'or'
+// evaluate both sides), so a rule always runs straight through and costs the sum of its
+// opcodes. Rules_Load checks an image completely before it replaces the running set
+// (opcodes, operands, stack depth, one result per rule) and adds up the worst-case cycles of
+// every opcode: a set whose bound exceeds CFG_RULES_BUDGET_CYCLES is refused, so the time the
+// rules take per tick is capped however they are written.
+//
+// The running set is the built-in one (price < threshold, the check main.c always made), the
+// set stored in the EEPROM (loaded at boot), or one sent over the USB command channel (feed.h).
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdint.h>
+
+#define RULES_VERSION   1
+#define RULES_MAX       8         // Rules in a set (one fired bit each)
+#define RULES_STACK     8         // Stack depth of the machine
+#define RULES_IMAGE_MAX 240       // Bytes of a set image (one USB record, 62 EEPROM words with the header)
+
+// Opcodes (operands follow LOAD and CONST). Keep tools/rules_compile.py in step.
+#define RULES_OP_LOAD   1         // Push input[u8]
+#define RULES_OP_CONST  2         // Push a float
+#define RULES_OP_ADD    3         // Binary operators pop b, then a, and push a op b
+#define RULES_OP_SUB    4
+#define RULES_OP_MUL    5
+#define RULES_OP_DIV    6         // a / b, 0 when b is 0
+#define RULES_OP_MIN    7
+#define RULES_OP_MAX    8
+#define RULES_OP_PCT    9         // Change from b to a in percent, (a - b) / b * 100; 0 when b is 0
+#define RULES_OP_NEG    10        // Unary operators replace the top value
+#define RULES_OP_ABS    11
+#define RULES_OP_NOT    12
+#define RULES_OP_LT     13
+#define RULES_OP_LE     14
+#define RULES_OP_GT     15
+#define RULES_OP_GE     16
+#define RULES_OP_AND    17
+#define RULES_OP_OR     18
+#define RULES_OPS       19
+
+// Inputs. The 1 h and 24 h statistics come from the RAM history (history.h) and are only
+// computed when a running rule reads them; without a clock or history they equal the price.
+#define RULES_IN_PRICE     0      // USD
+#define RULES_IN_CHANGE    1      // 24 h change reported by the API, percent
+#define RULES_IN_THRESHOLD 2      // Threshold selected at boot
+#define RULES_IN_PREV      3      // Price of the previous tick (the price itself on the first)
+#define RULES_IN_HOUR      4      // UTC hour of the tick, -1 before the ESP32's clock is set
+#define RULES_IN_LOW_1H    5
+#define RULES_IN_HIGH_1H   6
+#define RULES_IN_MEAN_1H   7
+#define RULES_IN_LOW_24H   8
+#define RULES_IN_HIGH_24H  9
+#define RULES_IN_MEAN_24H  10
+#define RULES_INPUTS       11
+
+// Outcome of a load or store
+#define RULES_OK        0
+#define RULES_E_SIZE    1         // Image shorter than its header says, or longer than RULES_IMAGE_MAX
+#define RULES_E_VERSION 2
+#define RULES_E_OPCODE  3         // Unknown opcode, or an operand cut off or out of range
+#define RULES_E_STACK   4         // Stack overflow or underflow, or not exactly one result
+#define RULES_E_COUNT   5         // No rules, more than RULES_MAX, or bytes after the last rule
+#define RULES_E_BUDGET  6         // Worst-case cycles over CFG_RULES_BUDGET_CYCLES
+#define RULES_E_EEPROM  7         // EEPROM write failed (or no EEPROM)
+
+#define RULES_BUILTIN   0         // Source of the running set
+#define RULES_EEPROM    1
+#define RULES_HOST      2
+
+typedef struct {
+    uint8_t status;               // RULES_OK or why the last load or store failed
+    uint8_t source;               // RULES_BUILTIN / _EEPROM / _HOST
+    uint8_t count;                // Rules in the running set
+    uint8_t bytes;                // Size of its image
+    uint32_t ops;                 // Opcodes executed per evaluation
+    uint32_t bound;               // Worst-case cycles of one evaluation
+    uint32_t last, max;           // Measured cycles of the last and the slowest evaluation
+    uint32_t inputs_max;          // Slowest preparation of the inputs (statistics), cycles
+    uint32_t overruns;            // Evaluations that took longer than 'bound'
+    uint32_t fired;               // Rules that fired at the last tick, bit per rule
+    uint32_t op_ns_x10;           // Mean time per opcode measured at boot, 0.1 ns
+    uint32_t changes;             // Loads and stores attempted (a status record follows each)
+} RulesStats;
+
+extern RulesStats rules_stats;
+
+// Load the set stored in the EEPROM, or the built-in one, and time the machine per opcode.
+void Rules_Init(void);
+
+// Replace the running set with 'image' (len bytes; len 0 restores the built-in set).
+// The running set is left alone unless the image passes every check. Returns RULES_OK or
+// RULES_E_*, also kept in rules_stats.status.
+uint8_t Rules_Load(const uint8_t *image, uint32_t len, uint8_t source);
+
+// Store the running set in the EEPROM, to be loaded at the next boot. Storing the built-in
+// set clears the stored one.
+uint8_t Rules_Store(void);
+
+// Evaluate the running set on prepared inputs. Returns the fired rules, bit per rule.
+uint32_t Rules_Eval(const float *in);
+
+// Evaluate the running set for a new tick ('time' is its Unix time, 0 if unknown), timing
+// the evaluation. Returns the fired rules, bit per rule.
+uint32_t Rules_Tick(float price, float change, float threshold, uint32_t time);
+
+#endif // RULES_H
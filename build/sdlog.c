@@ -0,0 +1,452 @@
+//sdlog.c
+
+#include "sdlog.h"
+#include "udma.h"
+#include "tracker.h"
+#include <string.h>
+
+#define SDLOG_MAGIC  0x474C4453U  // "SDLG"
+#define SDLOG_HDR    ((uint16_t)sizeof(SdLogHeader))
+
+#define SD_CS        0x20U        // PB5, card chip select (active low)
+#define SSI_SR_TNF   0x02U
+#define SSI_SR_RNE   0x04U
+#define SSI_SR_BSY   0x10U
+#define SSI_CR1_SSE  0x02U
+
+#define DMA_CH_RX    12U          // SSI2 RX, channel encoding 2
+#define DMA_CH_TX    13U          // SSI2 TX, channel encoding 2
+
+#define SCR_SLOW     (CFG_SYSTEM_CLOCK_HZ / (2U * 400000U))               // <= 400 kHz for card init
+#define SCR_FAST     (CFG_SYSTEM_CLOCK_HZ / (2U * CFG_SDLOG_SPI_HZ) - 1U)
+
+static const char log_name[11] = { 'T','I','C','K','L','O','G',' ','B','I','N' };  // 8.3 directory form
+
+typedef char sdlog_hdr_size[(sizeof(SdLogHeader) == 16) ? 1 : -1];
+
+SdLogStats sdlog_stats;
+
+static uint8_t sec[2][SDLOG_SECTOR];  // Sector buffers: one collects records, the other is written
+static uint16_t used[2];          // Bytes used in each buffer
+static uint8_t fill = 0;          // Buffer collecting records
+static uint8_t queued = 0;        // 1 when the other buffer waits for (or is in) a write
+static uint8_t advance = 0;       // 1: the queued sector is complete, move on once it is written
+static uint8_t dirty = 0;         // Records added since the last write of the current sector
+static uint32_t last_flush;       // Millis() of the last write of the current sector
+
+static uint8_t scratch[SDLOG_SECTOR];  // Mount-time reads (boot sector, directory, FAT)
+static uint8_t block_addr;        // SDHC/SDXC: commands take sector numbers, not byte offsets
+static uint32_t file_lba;         // First sector of TICKLOG.BIN
+static uint32_t base_seq;         // seq of sector 0 in the current pass
+static uint32_t write_start;      // Millis() when the write in flight was started
+static uint32_t retry_at;         // Millis() of the next mount attempt
+static volatile uint8_t dma_sink; // RX bytes clocked in during a sector write land here
+
+// SPI primitives
+
+static void Cs_Low(void) { GPIOB->DATA &= ~SD_CS; }
+static void Cs_High(void) { GPIOB->DATA |= SD_CS; }
+
+static uint8_t Spi_Xfer(uint8_t b) {
+    while ((SSI2->SR & SSI_SR_TNF) == 0) { }
+    SSI2->DR = b;
+    while ((SSI2->SR & SSI_SR_RNE) == 0) { }
+    return (uint8_t)SSI2->DR;
+}
+
+static void Spi_Clock(uint32_t scr) {
+    SSI2->CR1 &= ~SSI_CR1_SSE;
+    SSI2->CR0 = (scr << 8) | 0x07;            // SPI mode 0, 8-bit frames.
+    SSI2->CR1 |= SSI_CR1_SSE;
+}
+
+// Send a command and return its R1 response (0xFF if the card does not answer).
+static uint8_t Sd_Cmd(uint8_t cmd, uint32_t arg) {
+    uint8_t r, i;
+    Spi_Xfer(0xFF);
+    Spi_Xfer((uint8_t)(0x40 | cmd));
+    Spi_Xfer((uint8_t)(arg >> 24));
+    Spi_Xfer((uint8_t)(arg >> 16));
+    Spi_Xfer((uint8_t)(arg >> 8));
+    Spi_Xfer((uint8_t)arg);
+    Spi_Xfer(cmd == 0 ? 0x95 : (cmd == 8 ? 0x87 : 0x01));  // Only CMD0 and CMD8 need a real CRC.
+    for (i = 0; i < 10; i++) {
+        r = Spi_Xfer(0xFF);
+        if ((r & 0x80) == 0)
+            return r;
+    }
+    return 0xFF;
+}
+
+static uint32_t Sd_Addr(uint32_t lba) {
+    return block_addr ? lba : lba * SDLOG_SECTOR;
+}
+
+// Card power-up sequence (SD v1 and v2, SDSC and SDHC). Returns 1 when the card is ready.
+static int Sd_Card_Init(void) {
+    uint32_t t, i;
+    uint8_t r, v2 = 0, ocr[4];
+    Spi_Clock(SCR_SLOW);
+    Cs_High();
+    for (i = 0; i < 10; i++)
+        Spi_Xfer(0xFF);                       // At least 74 clocks with CS high.
+    Cs_Low();
+    if (Sd_Cmd(0, 0) != 0x01) {               // GO_IDLE_STATE: no answer means no card.
+        Cs_High();
+        return 0;
+    }
+    if (Sd_Cmd(8, 0x1AA) == 0x01) {           // SEND_IF_COND: v2 cards echo the pattern.
+        for (i = 0; i < 4; i++)
+            ocr[i] = Spi_Xfer(0xFF);
+        v2 = (ocr[3] == 0xAA);
+    }
+    t = Millis();
+    do {
+        Sd_Cmd(55, 0);
+        r = Sd_Cmd(41, v2 ? 0x40000000U : 0); // SD_SEND_OP_COND, HCS set for v2 cards.
+    } while (r == 0x01 && Millis() - t < 1000);
+    block_addr = 0;
+    if (r == 0 && v2 && Sd_Cmd(58, 0) == 0) { // READ_OCR: CCS tells the addressing mode.
+        for (i = 0; i < 4; i++)
+            ocr[i] = Spi_Xfer(0xFF);
+        block_addr = (ocr[0] & 0x40) != 0;
+    }
+    if (r == 0 && !block_addr)
+        r = Sd_Cmd(16, SDLOG_SECTOR);         // SET_BLOCKLEN for byte-addressed cards.
+    Cs_High();
+    Spi_Xfer(0xFF);
+    if (r != 0)
+        return 0;
+    Spi_Clock(SCR_FAST);
+    return 1;
+}
+
+// Read one sector into 'out' (blocking; only used while mounting).
+static int Sd_Read(uint32_t lba, uint8_t *out) {
+    uint32_t t, i;
+    uint8_t r;
+    Cs_Low();
+    if (Sd_Cmd(17, Sd_Addr(lba)) != 0) {
+        Cs_High();
+        return 0;
+    }
+    t = Millis();
+    while ((r = Spi_Xfer(0xFF)) == 0xFF && Millis() - t < 100) { }
+    if (r != 0xFE) {                          // Data start token.
+        Cs_High();
+        return 0;
+    }
+    for (i = 0; i < SDLOG_SECTOR; i++)
+        out[i] = Spi_Xfer(0xFF);
+    Spi_Xfer(0xFF);                           // CRC, ignored.
+    Spi_Xfer(0xFF);
+    Cs_High();
+    Spi_Xfer(0xFF);
+    return 1;
+}
+
+// FAT32 lookup of TICKLOG.BIN
+
+static uint16_t Get16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t Get32(const uint8_t *p) { return Get16(p) | ((uint32_t)Get16(p + 2) << 16); }
+
+typedef struct {
+    uint32_t fat_lba;             // First sector of the first FAT
+    uint32_t data_lba;            // First sector of cluster 2
+    uint32_t spc;                 // Sectors per cluster
+    uint32_t cached;              // FAT sector currently in 'scratch' (0xFFFFFFFF: none)
+} FatVolume;
+
+// Next cluster in the chain of 'c' (0 on a read error).
+static uint32_t Fat_Next(FatVolume *v, uint32_t c) {
+    uint32_t s = v->fat_lba + c / 128U;
+    if (v->cached != s) {
+        if (!Sd_Read(s, scratch))
+            return 0;
+        v->cached = s;
+    }
+    return Get32(&scratch[(c % 128U) * 4U]) & 0x0FFFFFFFU;
+}
+
+// Find the log file and check that it is contiguous. Sets file_lba and returns its length
+// in sectors (0 if missing, fragmented or not on a FAT32 volume).
+static uint32_t Fat_Find_Log(void) {
+    FatVolume v;
+    uint32_t part = 0, dir, first = 0, size = 0, c, n, i, s;
+    int end = 0;
+    if (!Sd_Read(0, scratch) || Get16(&scratch[510]) != 0xAA55)
+        return 0;
+    if (scratch[450] == 0x0B || scratch[450] == 0x0C)
+        part = Get32(&scratch[454]);          // First partition (otherwise: no partition table).
+    if (part && !Sd_Read(part, scratch))
+        return 0;
+    if (Get16(&scratch[11]) != SDLOG_SECTOR || Get16(&scratch[22]) != 0)
+        return 0;                             // Not 512-byte sectors or not FAT32.
+    v.spc = scratch[13];
+    v.fat_lba = part + Get16(&scratch[14]);
+    v.data_lba = v.fat_lba + scratch[16] * Get32(&scratch[36]);
+    v.cached = 0xFFFFFFFFU;
+    dir = Get32(&scratch[44]);                // Root directory cluster.
+
+    for (n = 0; dir >= 2 && dir < 0x0FFFFFF8U && n < 64 && !first && !end; n++) {
+        for (s = 0; s < v.spc && !first && !end; s++) {
+            if (!Sd_Read(v.data_lba + (dir - 2) * v.spc + s, scratch))
+                return 0;
+            for (i = 0; i < SDLOG_SECTOR; i += 32) {
+                if (scratch[i] == 0) {
+                    end = 1;                  // End of directory.
+                    break;
+                }
+                if (memcmp(&scratch[i], log_name, sizeof(log_name)) == 0 && (scratch[i + 11] & 0x18) == 0) {
+                    first = ((uint32_t)Get16(&scratch[i + 20]) << 16) | Get16(&scratch[i + 26]);
+                    size = Get32(&scratch[i + 28]);
+                    break;
+                }
+            }
+        }
+        v.cached = 0xFFFFFFFFU;
+        if (!first && !end)
+            dir = Fat_Next(&v, dir);
+    }
+    if (first < 2)
+        return 0;
+
+    for (c = first, n = 1; ; c++, n++) {      // Walk the chain: every link must be c -> c + 1.
+        uint32_t next = Fat_Next(&v, c);
+        if (next >= 0x0FFFFFF8U)
+            break;
+        if (next != c + 1)
+            return 0;                         // Fragmented: writes could land in another file.
+    }
+    file_lba = v.data_lba + (first - 2) * v.spc;
+    size /= SDLOG_SECTOR;
+    return (n * v.spc < size) ? n * v.spc : size;
+}
+
+// Header of log sector i: 1 and its seq if it is a valid log sector.
+static int Log_Seq(uint32_t i, uint32_t *seq) {
+    const SdLogHeader *h = (const SdLogHeader *)scratch;
+    if (!Sd_Read(file_lba + i, scratch))
+        return 0;
+    *seq = h->seq;
+    return h->magic == SDLOG_MAGIC && h->seq_inv == ~h->seq;
+}
+
+// Mount the card and find the write position: sectors [0, k) of the current pass carry
+// seq0 + i, so the first sector that does not is where writing resumes.
+static int SdLog_Mount(void) {
+    uint32_t n, seq0, seq, lo, hi;
+    uint32_t was_sectors = sdlog_stats.file_sectors, was_base = base_seq, was_next = sdlog_stats.next_sector;
+    if (!Sd_Card_Init())
+        return 0;
+    n = Fat_Find_Log();
+    if (n == 0)
+        return 0;
+    sdlog_stats.file_sectors = n;
+    if (!Log_Seq(0, &seq0)) {
+        base_seq = 0;
+        sdlog_stats.next_sector = 0;
+        return 1;
+    }
+    lo = 1;                                   // Invariant: sector lo-1 is in the current pass.
+    hi = n;                                   // Sector hi (if < n) is not.
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (Log_Seq(mid, &seq) && seq == seq0 + mid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    base_seq = seq0;
+    sdlog_stats.next_sector = lo;
+    if (lo == n) {                            // Whole file written in this pass: wrap.
+        base_seq += n;
+        sdlog_stats.next_sector = 0;
+    }
+    // Remount of the same card: if its last sector is a flushed copy of the sector still
+    // being filled in RAM, write that one again rather than repeat its records after it.
+    if (sdlog_stats.mounts && n == was_sectors && base_seq + sdlog_stats.next_sector == was_base + was_next + 1U) {
+        base_seq = was_base;
+        sdlog_stats.next_sector = was_next;
+    }
+    return 1;
+}
+
+static void SdLog_Fail(uint32_t now) {
+    Cs_High();
+    SSI2->DMACTL = 0;
+    sdlog_stats.errors++;
+    sdlog_stats.state = SDLOG_STATE_ABSENT;
+    retry_at = now + CFG_SDLOG_RETRY_MS;      // The queued sector is kept and written after a remount.
+}
+
+// Start writing the queued buffer to the current sector: command and start token by hand,
+// then the 512 data bytes by uDMA.
+static void Write_Start(uint32_t now) {
+    uint8_t *buf = sec[fill ^ 1];
+    SdLogHeader *h = (SdLogHeader *)buf;
+    h->magic = SDLOG_MAGIC;
+    h->seq = base_seq + sdlog_stats.next_sector;
+    h->seq_inv = ~h->seq;
+    h->used = used[fill ^ 1];
+    h->reserved = 0;
+    memset(buf + h->used, 0, SDLOG_SECTOR - h->used);
+
+    write_start = now;
+    Cs_Low();
+    if (Sd_Cmd(24, Sd_Addr(file_lba + sdlog_stats.next_sector)) != 0) {  // WRITE_BLOCK
+        SdLog_Fail(now);
+        return;
+    }
+    Spi_Xfer(0xFF);
+    Spi_Xfer(0xFE);                           // Start block token.
+    Udma_Start(DMA_CH_RX, &SSI2->DR, &dma_sink, SDLOG_SECTOR,
+               UDMA_SRC_NONE | UDMA_SRC_SIZE8 | UDMA_DST_NONE | UDMA_DST_SIZE8 | UDMA_ARB4);
+    Udma_Start(DMA_CH_TX, buf, &SSI2->DR, SDLOG_SECTOR,
+               UDMA_SRC_INC8 | UDMA_SRC_SIZE8 | UDMA_DST_NONE | UDMA_DST_SIZE8 | UDMA_ARB4);
+    SSI2->DMACTL = 0x03;                      // RXDMAE | TXDMAE
+    sdlog_stats.state = SDLOG_STATE_DMA;
+}
+
+// Data clocked out: send the CRC and check the card's data response.
+static void Write_Data_Done(uint32_t now) {
+    uint8_t r = 0xFF, i;
+    SSI2->DMACTL = 0;
+    Spi_Xfer(0xFF);                           // CRC, ignored in SPI mode.
+    Spi_Xfer(0xFF);
+    for (i = 0; i < 8 && r == 0xFF; i++)
+        r = Spi_Xfer(0xFF);
+    if ((r & 0x1F) != 0x05) {                 // Data accepted?
+        SdLog_Fail(now);
+        return;
+    }
+    sdlog_stats.state = SDLOG_STATE_BUSY;
+}
+
+// Card finished programming.
+static void Write_Done(uint32_t now) {
+    Cs_High();
+    Spi_Xfer(0xFF);
+    sdlog_stats.sectors++;
+    sdlog_stats.stall_last_ms = now - write_start;
+    if (sdlog_stats.stall_last_ms > sdlog_stats.stall_max_ms)
+        sdlog_stats.stall_max_ms = sdlog_stats.stall_last_ms;
+    if (advance) {
+        if (++sdlog_stats.next_sector == sdlog_stats.file_sectors) {
+            sdlog_stats.next_sector = 0;
+            base_seq += sdlog_stats.file_sectors;
+        }
+    }
+    queued = 0;
+    sdlog_stats.state = SDLOG_STATE_IDLE;
+}
+
+void SdLog_Init(void) {
+    SYSCTL->RCGCGPIO |= 0x02;     // Port B
+    SYSCTL->RCGCSSI |= 0x04;      // SSI2
+    while ((SYSCTL->PRGPIO & 0x02) == 0) { }
+    while ((SYSCTL->PRSSI & 0x04) == 0) { }
+    GPIOB->AFSEL |= 0xD0;         // PB4 SSI2Clk, PB6 SSI2Rx, PB7 SSI2Tx
+    GPIOB->PCTL = (GPIOB->PCTL & 0x00F0FFFF) | 0x22020000;
+    GPIOB->AFSEL &= ~SD_CS;       // PB5 is a plain output so CS can stay low across bytes.
+    GPIOB->DIR |= SD_CS;
+    GPIOB->PUR |= 0x40;           // MISO floats while no card is inserted.
+    GPIOB->DEN |= 0xF0;
+    GPIOB->AMSEL &= ~0xF0;
+    Cs_High();
+
+    SSI2->CR1 = 0;                // Master, disabled while configuring.
+    SSI2->CC = 0;                 // System clock
+    SSI2->CPSR = 2;
+    Spi_Clock(SCR_SLOW);
+
+    Udma_Init();
+    Udma_Assign(DMA_CH_RX, 2);
+    Udma_Assign(DMA_CH_TX, 2);
+
+    memset(&sdlog_stats, 0, sizeof(sdlog_stats));  // Empty buffers and counters, also when called again
+    used[0] = used[1] = SDLOG_HDR;
+    fill = queued = advance = dirty = 0;
+    sdlog_stats.state = SDLOG_STATE_ABSENT;
+    retry_at = Millis();
+}
+
+void SdLog_Record(uint8_t type, const uint8_t *payload, uint8_t len) {
+    uint8_t *p;
+    if (used[fill] + 2U + len > SDLOG_SECTOR) {
+        if (queued) {
+            sdlog_stats.dropped++;            // Previous sector not written yet (or no card).
+            return;
+        }
+        queued = 1;                           // Seal this sector and start a new one.
+        advance = 1;
+        fill ^= 1;
+        used[fill] = SDLOG_HDR;
+        dirty = 0;
+    }
+    p = &sec[fill][used[fill]];
+    p[0] = type;
+    p[1] = len;
+    memcpy(p + 2, payload, len);
+    used[fill] = (uint16_t)(used[fill] + 2U + len);
+    dirty = 1;
+    sdlog_stats.records++;
+}
+
+void SdLog_Tick(uint32_t time, int32_t price_cents, int16_t change_centi) {
+    uint8_t r[10];
+    memcpy(&r[0], &time, 4);                  // Little-endian target: fields are stored as-is.
+    memcpy(&r[4], &price_cents, 4);
+    memcpy(&r[8], &change_centi, 2);
+    SdLog_Record(SDLOG_TICK, r, sizeof(r));
+}
+
+void SdLog_Alarm(int on, int32_t price_cents, uint32_t time) {
+    uint8_t r[9];
+    r[0] = (uint8_t)(on != 0);
+    memcpy(&r[1], &price_cents, 4);
+    memcpy(&r[5], &time, 4);
+    SdLog_Record(SDLOG_ALARM, r, sizeof(r));
+}
+
+void SdLog_Poll(uint32_t now) {
+    switch (sdlog_stats.state) {
+    case SDLOG_STATE_ABSENT:
+        if ((int32_t)(now - retry_at) < 0)
+            return;
+        if (SdLog_Mount()) {
+            sdlog_stats.mounts++;
+            sdlog_stats.state = SDLOG_STATE_IDLE;
+            last_flush = now;
+        } else {
+            Cs_High();
+            retry_at = now + CFG_SDLOG_RETRY_MS;
+        }
+        return;
+    case SDLOG_STATE_IDLE:
+        if (!queued && dirty && now - last_flush >= CFG_SDLOG_FLUSH_S * 1000U) {
+            memcpy(sec[fill ^ 1], sec[fill], used[fill]);  // Snapshot the partial sector.
+            used[fill ^ 1] = used[fill];
+            queued = 1;
+            advance = 0;                      // Same sector again once it is complete.
+            dirty = 0;
+        }
+        if (queued) {
+            last_flush = now;
+            Write_Start(now);
+        }
+        return;
+    case SDLOG_STATE_DMA:
+        if (!Udma_Busy(DMA_CH_RX))            // RX done: every byte has been clocked out.
+            Write_Data_Done(now);
+        return;
+    case SDLOG_STATE_BUSY:
+        if (Spi_Xfer(0xFF) == 0xFF)
+            Write_Done(now);
+        else if (now - write_start > CFG_SDLOG_BUSY_TIMEOUT_MS)
+            SdLog_Fail(now);                  // Card pulled out mid-write, or dead.
+        return;
+    default:
+        return;
+    }
+}
@@ -0,0 +1,73 @@
+//sdlog.h
+// Long-term tick and event log on a microSD card in SPI mode (SSI2, uDMA).
+//
+// The card carries a FAT32 volume with a preallocated, contiguous file TICKLOG.BIN in its
+// root directory. At mount the FAT is read once to find the file's first sector and check
+// that its clusters are contiguous; from then on the log writes raw 512-byte sectors inside
+// the file and never touches the FAT or the directory. The file is used as a ring:
+//
+//   sector:  SdLogHeader (magic, seq, ~seq, bytes used) + records {type, len, payload}
+//
+// where seq = pass * file_sectors + sector index, so the write position is found again
+// with a binary search over the sector headers.
+//
+// Records collect in a RAM sector; a full sector is handed to the uDMA, which clocks it
+// out over SSI2 while the CPU carries on. SdLog_Poll() advances the write (data response,
+// busy wait) one non-blocking step at a time. A partly filled sector is rewritten every
+// CFG_SDLOG_FLUSH_S seconds, so a power cut loses at most that much. If the card stops
+// answering it is treated as removed: records keep collecting in RAM (then are dropped and
+// counted) and a remount is tried every CFG_SDLOG_RETRY_MS. A mount attempt blocks for
+// well under a millisecond when no card answers, and up to about a second while an
+// inserted card powers up.
+#ifndef SDLOG_H
+#define SDLOG_H
+
+#include <stdint.h>
+
+#define SDLOG_SECTOR 512U
+
+// Record types (the payloads match the USB feed records, see feed.h)
+#define SDLOG_TICK   'T'          // u32 time, i32 price (cents), i16 change (0.01 %)
+#define SDLOG_ALARM  'A'          // u8 on, i32 price (cents), u32 time
+
+typedef struct {
+    uint32_t magic;               // SDLOG_MAGIC
+    uint32_t seq;                 // pass * file_sectors + sector index
+    uint32_t seq_inv;             // ~seq, rejects torn or foreign sectors
+    uint16_t used;                // Bytes in use, header included
+    uint16_t reserved;
+} SdLogHeader;
+
+#define SDLOG_STATE_ABSENT 0      // No usable card (or no TICKLOG.BIN)
+#define SDLOG_STATE_IDLE   1      // Mounted, nothing in flight
+#define SDLOG_STATE_DMA    2      // Sector data moving out over SPI
+#define SDLOG_STATE_BUSY   3      // Card programming the sector
+
+typedef struct {
+    uint8_t state;                // SDLOG_STATE_*
+    uint32_t mounts;              // Successful mounts
+    uint32_t errors;              // Failed commands / timeouts (each one unmounts the card)
+    uint32_t file_sectors;        // Size of TICKLOG.BIN in sectors
+    uint32_t next_sector;         // Sector the next full buffer goes to
+    uint32_t sectors;             // Sector writes completed (rewrites included)
+    uint32_t records;             // Records accepted
+    uint32_t dropped;             // Records lost because both sector buffers were full
+    uint32_t stall_last_ms;       // Command to end of busy for the last write
+    uint32_t stall_max_ms;        // Worst write seen since boot
+} SdLogStats;
+
+extern SdLogStats sdlog_stats;
+
+// Configure SSI2, its pins and uDMA channels. The card itself is mounted by SdLog_Poll().
+// Calling it again drops whatever is buffered and starts over with a remount.
+void SdLog_Init(void);
+
+// Queue a record. Never blocks.
+void SdLog_Record(uint8_t type, const uint8_t *payload, uint8_t len);
+void SdLog_Tick(uint32_t time, int32_t price_cents, int16_t change_centi);
+void SdLog_Alarm(int on, int32_t price_cents, uint32_t time);
+
+// Advance mounting and sector writes. Call from the idle main loop; 'now' is Millis().
+void SdLog_Poll(uint32_t now);
+
+#endif // SDLOG_H
@@ -0,0 +1,130 @@
+//selftest.c
+
+#include "selftest.h"
+#include <string.h>
+
+// Frame sizes, each run at rising rates. The top rates are beyond the wire at 115200 baud,
+// so the last steps of each size measure the wire itself.
+static const uint8_t plan_size[] = { 32, 64, FRAME_MAX_LEN };
+static const uint16_t plan_rate[] = { 5, 10, 20, 50, 100, 200, 400 };
+
+#define PLAN_RATES (sizeof(plan_rate) / sizeof(plan_rate[0]))
+#define PLAN_STEPS (sizeof(plan_size) / sizeof(plan_size[0]) * PLAN_RATES)
+typedef char plan_fits[(PLAN_STEPS <= SELFTEST_MAX_STEPS) ? 1 : -1];
+
+int SelfTest_Plan(uint32_t i, uint32_t *size, uint32_t *rate) {
+    if (i >= PLAN_STEPS)
+        return 0;
+    *size = plan_size[i / PLAN_RATES];
+    *rate = plan_rate[i % PLAN_RATES];
+    return 1;
+}
+
+uint32_t SelfTest_Rate(const SelfTestStep *s) {
+    uint32_t span = s->last_us - s->first_us;
+    if (s->received < 2 || span == 0)
+        return s->received;
+    return (uint32_t)((uint64_t)(s->received - 1) * 1000000U / span);
+}
+
+// Summary of the closed steps.
+static void SelfTest_Finish(SelfTest *st) {
+    FrameTestResult *r = &st->result;
+    uint64_t best = 0, bps, span;
+    uint32_t i, rate;
+    memset(r, 0, sizeof(*r));
+    r->steps = st->steps;
+    for (i = 0; i < st->steps; i++) {
+        const SelfTestStep *s = &st->step[i];
+        rate = SelfTest_Rate(s);
+        r->lost += s->sent > s->received ? s->sent - s->received : 0;
+        if (s->sent > 0 && s->received == s->sent && s->bad == 0) {
+            bps = (uint64_t)rate * (s->size + 1);
+            if (bps > best) {
+                best = bps;
+                span = s->last_us - s->first_us;
+                r->best_rate = rate;
+                r->best_size = s->size;
+                r->best_bps = (uint32_t)bps;
+                r->cpu_pct = span ? (uint32_t)(((uint64_t)s->busy_us + s->draw_us) * 100U / span) : 0;
+                if (r->cpu_pct > 100)
+                    r->cpu_pct = 100;
+            }
+        }
+        if (r->parse_rate == 0 && s->backlog_max >= SELFTEST_PARSE_BACKLOG)  // Wire errors do not count.
+            r->parse_rate = rate;
+        if (r->display_rate == 0 && s->skipped)
+            r->display_rate = rate;
+    }
+}
+
+void SelfTest_Frame(SelfTest *st, const FrameTest *f, uint32_t us, uint32_t backlog) {
+    SelfTestStep *s;
+    if (f->size == 0 && f->rate == 0) {
+        if (f->step == 0 || st->state != SELFTEST_RUNNING)
+            return;                           // A start request, or a done frame out of turn.
+        SelfTest_Finish(st);
+        st->state = SELFTEST_DONE;
+        st->runs++;
+        return;
+    }
+    if (st->state != SELFTEST_RUNNING) {
+        memset(st->step, 0, sizeof(st->step));
+        st->steps = 0;
+        st->state = SELFTEST_RUNNING;
+    }
+    st->draw = 0;
+    if (f->step >= SELFTEST_MAX_STEPS) {
+        SelfTest_Bad(st);
+        return;
+    }
+    st->current = (uint8_t)f->step;
+    s = &st->step[f->step];
+    if (s->size == 0)
+        SelfTest_Plan(f->step, &s->size, &s->rate);
+    if (f->size == 0) {                       // End of step.
+        s->sent = f->seq;
+        if (f->step + 1 > st->steps)
+            st->steps = f->step + 1;
+        return;
+    }
+    if (f->seq < s->next_seq) {               // Repeated or out of order.
+        s->bad++;
+        return;
+    }
+    s->next_seq = f->seq + 1;                 // A gap shows up as sent > received at the end.
+    if (s->received == 0)
+        s->first_us = us;
+    s->last_us = us;
+    s->received++;
+    if (backlog > s->backlog_max)
+        s->backlog_max = backlog;
+    if (backlog < SELFTEST_DRAW_BACKLOG)
+        st->draw = 1;
+    else
+        s->skipped++;
+}
+
+void SelfTest_Bad(SelfTest *st) {
+    if (st->state == SELFTEST_RUNNING)
+        st->step[st->current].bad++;
+}
+
+void SelfTest_Busy(SelfTest *st, uint32_t us) {
+    if (st->state == SELFTEST_RUNNING)
+        st->step[st->current].busy_us += us;
+}
+
+void SelfTest_Drawn(SelfTest *st, uint32_t us) {
+    st->draw = 0;
+    if (st->state == SELFTEST_RUNNING) {
+        st->step[st->current].draw_us += us;
+        st->step[st->current].draws++;
+    }
+}
+
+void SelfTest_Skipped(SelfTest *st) {
+    st->draw = 0;
+    if (st->state == SELFTEST_RUNNING)
+        st->step[st->current].skipped++;
+}
@@ -0,0 +1,77 @@
+//selftest.h
+// Link throughput self-test (portable C, built for the TM4C, the ESP32 and fleetsim).
+//
+// Either side starts it: the TM4C sends a start request (USB feed command 'S'), or the
+// ESP32's BOOT button is pressed. The ESP32 then walks the plan: for each frame size it sends
+// '$X' test frames (frame.h) at rising rates for CFG_SELFTEST_STEP_MS per step, or as fast as
+// the wire allows, and closes each step with an end-of-step frame carrying the number sent.
+// The TM4C checks sequence, checksum and padding of every frame, times its own handling, and
+// redraws a progress row per frame as long as its UART backlog stays small, as the price path
+// would. On the done frame it summarises the steps, shows the result and sends it back as '$R'.
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <stdint.h>
+#include "frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SELFTEST_MAX_STEPS    24
+#define SELFTEST_DRAW_BACKLOG 128   // UART bytes pending above which a progress redraw is skipped
+#define SELFTEST_PARSE_BACKLOG 1024 // Half of UART_RX_RING_SIZE: line handling is falling behind
+
+typedef struct {
+    uint32_t size;                // Frame length (characters, newline excluded)
+    uint32_t rate;                // Frames per second asked for
+    uint32_t sent;                // Frames the ESP32 sent (from the end-of-step frame)
+    uint32_t received;            // Test frames that passed every check
+    uint32_t bad;                 // Lines rejected while the step ran (checksum, padding, receive errors)
+    uint32_t first_us, last_us;   // Arrival of the first and the last good frame
+    uint32_t busy_us;             // Time spent receiving and handling lines
+    uint32_t draw_us;             // Time spent redrawing the progress row, LCD bus time included
+    uint32_t draws, skipped;      // Progress redraws done / skipped (UART backlog or panel busy)
+    uint32_t backlog_max;         // Most UART bytes pending when a frame was handled
+    uint32_t next_seq;            // Sequence number expected next
+} SelfTestStep;
+
+#define SELFTEST_IDLE    0
+#define SELFTEST_RUNNING 1
+#define SELFTEST_DONE    2
+
+typedef struct {
+    uint8_t state;                // SELFTEST_IDLE / _RUNNING / _DONE
+    uint8_t current;              // Step the last frame belonged to
+    uint8_t draw;                 // 1 when the receiver should redraw the progress row
+    uint32_t runs;                // Tests completed since power-on
+    uint32_t steps;               // Steps closed by an end-of-step frame
+    SelfTestStep step[SELFTEST_MAX_STEPS];
+    FrameTestResult result;       // Valid once a test has completed
+} SelfTest;
+
+// Size and rate of step 'i' of the plan. Returns 0 past the last step.
+int SelfTest_Plan(uint32_t i, uint32_t *size, uint32_t *rate);
+
+// Handle a decoded '$X' frame that arrived at 'us' (a free-running microsecond clock) with
+// 'backlog' bytes still waiting in the UART ring. The first frame of a test resets 'st'.
+void SelfTest_Frame(SelfTest *st, const FrameTest *f, uint32_t us, uint32_t backlog);
+
+// A line lost to a receive error, or a '$' line that failed its checks, while a test runs.
+void SelfTest_Bad(SelfTest *st);
+
+// Time the receiver spent on a line, and on a progress redraw (counted in the current step).
+void SelfTest_Busy(SelfTest *st, uint32_t us);
+void SelfTest_Drawn(SelfTest *st, uint32_t us);
+
+// A progress redraw the receiver skipped because the display was still sending the last one.
+void SelfTest_Skipped(SelfTest *st);
+
+// Measured frame rate of a step (frames/s between its first and last good frame).
+uint32_t SelfTest_Rate(const SelfTestStep *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SELFTEST_H
@@ -0,0 +1,235 @@
+//tft.c
+
+#include "tft.h"
+#include "tft_render.h"
+#include "tracker.h"
+#include "history.h"
+#include "udma.h"
+
+#define TFT_CS       0x08U        // PA3, chip select (active low, held low)
+#define TFT_DC       0x01U        // PE0, low = command, high = data
+#define TFT_RST      0x40U        // PC6, reset (active low)
+#define SSI_SR_TNF   0x02U
+#define SSI_SR_BSY   0x10U
+#define SSI_CR1_SSE  0x02U
+
+#define DMA_CH_TX    11U          // SSI0 TX, channel encoding 0
+#define NO_TILE      0xFFFFFFFFU
+
+#define SCR          (CFG_SYSTEM_CLOCK_HZ / (2U * CFG_TFT_SPI_HZ) - 1U)
+
+// Controller commands (the same on the ST7735 and the ILI9341)
+#define CMD_SWRESET  0x01U
+#define CMD_SLPOUT   0x11U
+#define CMD_NORON    0x13U
+#define CMD_DISPON   0x29U
+#define CMD_CASET    0x2AU
+#define CMD_RASET    0x2BU
+#define CMD_RAMWR    0x2CU
+#define CMD_MADCTL   0x36U
+#define CMD_COLMOD   0x3AU
+
+#define WINDOW_BYTES 11U          // CASET + 4, RASET + 4, RAMWR
+
+// Tiles are sent as whole 16x16 windows, so the panel must be a multiple of the tile size.
+typedef char tft_tiles_fit[(TFT_WIDTH % TFT_TILE == 0 && TFT_HEIGHT % TFT_TILE == 0) ? 1 : -1];
+
+TftStats tft_stats;
+
+static TftScene scene;
+static uint8_t tile_buf[2][TFT_TILE_BYTES];  // One is rendered while the other is sent
+static uint32_t tile_hash[TFT_TILES];  // Hash of each tile as last sent
+static int32_t col_min[TFT_WIDTH], col_max[TFT_WIDTH];  // Chart rebuild scratch (USD)
+static uint8_t fill;              // Buffer the next tile renders into
+static uint32_t pending = NO_TILE;  // Rendered tile waiting for the SSI
+static uint8_t sending;           // 1 while a tile transfer has not been wound up
+static uint8_t ready;             // Controller configured
+static uint8_t repaint;           // Next pass sends every dirty tile regardless of its hash
+static uint8_t pass_on, pass_full;
+static uint32_t next;             // Next tile the pass looks at
+static uint32_t pass_start, pass_bytes, pass_tiles;
+static uint32_t chart_at, chart_newest;
+static uint32_t fps_at, fps_frames;
+static unsigned char cur_col, cur_row;
+
+static void Tft_Write(uint8_t b) {
+    while ((SSI0->SR & SSI_SR_TNF) == 0) { }
+    SSI0->DR = b;
+}
+
+// Send a command byte and its parameters. D/C may only change once the SSI has shifted
+// out everything queued before it.
+static void Tft_Command(uint8_t cmd, const uint8_t *args, uint32_t n) {
+    while (SSI0->SR & SSI_SR_BSY) { }
+    GPIOE->DATA &= ~TFT_DC;
+    Tft_Write(cmd);
+    while (SSI0->SR & SSI_SR_BSY) { }
+    GPIOE->DATA |= TFT_DC;
+    while (n--)
+        Tft_Write(*args++);
+}
+
+static void Tft_Command1(uint8_t cmd, uint8_t arg) {
+    Tft_Command(cmd, &arg, 1);
+}
+
+// Address window [x0, x1] x [y0, y1] followed by RAMWR: the pixel data comes next.
+static void Tft_Window(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    uint8_t a[4];
+    x0 += CFG_TFT_X_OFFSET; x1 += CFG_TFT_X_OFFSET;
+    y0 += CFG_TFT_Y_OFFSET; y1 += CFG_TFT_Y_OFFSET;
+    a[0] = (uint8_t)(x0 >> 8); a[1] = (uint8_t)x0; a[2] = (uint8_t)(x1 >> 8); a[3] = (uint8_t)x1;
+    Tft_Command(CMD_CASET, a, 4);
+    a[0] = (uint8_t)(y0 >> 8); a[1] = (uint8_t)y0; a[2] = (uint8_t)(y1 >> 8); a[3] = (uint8_t)y1;
+    Tft_Command(CMD_RASET, a, 4);
+    Tft_Command(CMD_RAMWR, 0, 0);
+}
+
+PT_THREAD(Tft_Init_Thread(Pt *pt)) {
+    PT_BEGIN(pt);
+    Tft_Scene_Init(&scene);
+    SYSCTL->RCGCGPIO |= 0x01 | 0x04 | 0x10;  // Ports A, C, E
+    SYSCTL->RCGCSSI |= 0x01;      // SSI0
+    while ((SYSCTL->PRGPIO & 0x15) != 0x15) { }
+    while ((SYSCTL->PRSSI & 0x01) == 0) { }
+    GPIOA->AFSEL |= 0x24;         // PA2 SSI0Clk, PA5 SSI0Tx
+    GPIOA->PCTL = (GPIOA->PCTL & 0xFF0FF0FF) | 0x00200200;
+    GPIOA->AFSEL &= ~TFT_CS;
+    GPIOA->DIR |= TFT_CS;
+    GPIOA->DEN |= 0x24 | TFT_CS;
+    GPIOA->AMSEL &= ~(0x24 | TFT_CS);
+    GPIOA->DATA &= ~TFT_CS;       // The panel is the only device on SSI0.
+    GPIOC->DIR |= TFT_RST;
+    GPIOC->DEN |= TFT_RST;
+    GPIOE->DIR |= TFT_DC;
+    GPIOE->DEN |= TFT_DC;
+
+    SSI0->CR1 = 0;                // Master, disabled while configuring.
+    SSI0->CC = 0;                 // System clock
+    SSI0->CPSR = 2;
+    SSI0->CR0 = (SCR << 8) | 0x07;  // SPI mode 0, 8-bit frames.
+    SSI0->CR1 = SSI_CR1_SSE;
+
+    Udma_Init();
+    Udma_Assign(DMA_CH_TX, 0);
+
+    GPIOC->DATA &= ~TFT_RST;      // Hardware reset.
+    PT_SLEEP(pt, 10);
+    GPIOC->DATA |= TFT_RST;
+    PT_SLEEP(pt, 120);
+    Tft_Command(CMD_SWRESET, 0, 0);
+    PT_SLEEP(pt, 150);
+    Tft_Command(CMD_SLPOUT, 0, 0);
+    PT_SLEEP(pt, 150);
+    Tft_Command1(CMD_COLMOD, CFG_TFT_CONTROLLER ? 0x55 : 0x05);  // 16 bits per pixel
+    Tft_Command1(CMD_MADCTL, CFG_TFT_MADCTL);
+    Tft_Command(CMD_NORON, 0, 0);
+    Tft_Command(CMD_DISPON, 0, 0);
+
+    repaint = 1;                  // Controller RAM holds noise until every tile is sent once.
+    chart_at = Millis();
+    fps_at = Millis();
+    ready = 1;
+    PT_END(pt);
+}
+
+void Tft_Clear(void) {
+    Tft_Scene_Clear_Text(&scene);
+    cur_col = cur_row = 0;
+}
+
+void Tft_Set_Cursor(unsigned char col, unsigned char row) {
+    cur_col = col;
+    cur_row = row;
+}
+
+void Tft_Put_Char(char c) {
+    Tft_Scene_Put(&scene, cur_col, cur_row, c);
+    if (cur_col < 0xFF)
+        cur_col++;                // Like the HD44780: past column 15 nothing is visible.
+}
+
+static void Tft_Chart(uint32_t now) {
+    uint32_t newest = History_Newest(), x;
+    for (x = 0; x < TFT_WIDTH; x++) {
+        col_min[x] = 0x7FFFFFFF;  // min > max: no data
+        col_max[x] = -0x7FFFFFFF;
+    }
+    if (newest)
+        History_Chart(newest > CFG_TFT_CHART_WINDOW_S ? newest - CFG_TFT_CHART_WINDOW_S : 0,
+                      TFT_WIDTH, col_min, col_max);
+    Tft_Scene_Chart(&scene, col_min, col_max);
+    chart_newest = newest;
+    chart_at = now;
+}
+
+// Put the rendered tile on the wire; the uDMA feeds the SSI from tile_buf[fill].
+static void Tft_Send(uint32_t t) {
+    uint32_t x = (t % TFT_TILES_X) * TFT_TILE, y = (t / TFT_TILES_X) * TFT_TILE;
+    Tft_Window(x, y, x + TFT_TILE - 1U, y + TFT_TILE - 1U);
+    Udma_Start(DMA_CH_TX, tile_buf[fill], &SSI0->DR, TFT_TILE_BYTES,
+               UDMA_SRC_INC8 | UDMA_SRC_SIZE8 | UDMA_DST_NONE | UDMA_DST_SIZE8 | UDMA_ARB4);
+    SSI0->DMACTL = 0x02;          // TXDMAE
+    fill ^= 1;
+    sending = 1;
+    pass_bytes += WINDOW_BYTES + TFT_TILE_BYTES;
+    pass_tiles++;
+    tft_stats.tiles_sent++;
+}
+
+void Tft_Poll(uint32_t now) {
+    uint32_t t, hash;
+    if (!ready)
+        return;
+    if (now - fps_at >= 1000U) {
+        tft_stats.fps = tft_stats.frames - fps_frames;
+        fps_frames = tft_stats.frames;
+        fps_at = now;
+    }
+    if (Udma_Busy(DMA_CH_TX))
+        return;                   // A tile is on the wire and the next one is already rendered.
+    if (sending) {
+        SSI0->DMACTL = 0;
+        sending = 0;
+    }
+    if (History_Newest() != chart_newest || now - chart_at >= CFG_TFT_CHART_MS)
+        Tft_Chart(now);
+    if (pending != NO_TILE) {
+        Tft_Send(pending);
+        pending = NO_TILE;
+    }
+
+    if (!pass_on) {
+        for (t = 0; t < TFT_TILES && !scene.dirty[t]; t++) { }
+        if (t == TFT_TILES)
+            return;               // Nothing changed.
+        pass_on = 1;
+        pass_full = repaint;
+        repaint = 0;
+        next = 0;
+        pass_start = Cycles_Now();
+        pass_bytes = pass_tiles = 0;
+    }
+    // Render the next changed tile into the free buffer while the other one is sent.
+    while (next < TFT_TILES) {
+        t = next++;
+        if (!scene.dirty[t])
+            continue;
+        scene.dirty[t] = 0;
+        hash = Tft_Render_Tile(&scene, t, tile_buf[fill]);
+        if (hash == tile_hash[t] && !pass_full) {
+            tft_stats.tiles_skipped++;
+            continue;
+        }
+        tile_hash[t] = hash;
+        pending = t;
+        return;
+    }
+    if (!sending) {               // Last tile out: the pass is complete.
+        pass_on = 0;
+        tft_stats.frames++;
+        tft_stats.tiles_last = pass_tiles;
+        tft_stats.bytes_last = pass_bytes;
+        tft_stats.pass_us_last = (Cycles_Now() - pass_start) / (CFG_SYSTEM_CLOCK_HZ / 1000000U);
+    }
+}
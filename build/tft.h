@@ -0,0 +1,45 @@
+//tft.h
+// SPI TFT (ST7735 or ILI9341 class, RGB565) in place of the HD44780, enabled with
+// CFG_TFT_ENABLE. It uses the LCD connector's pins: PA2 SSI0Clk, PA5 SSI0Tx, PA3 chip
+// select (held low, the panel is alone on the bus), PE0 data/command, PC6 reset.
+//
+// The LCD_* functions in tracker.c forward here, so every screen keeps writing 16x2 text;
+// the text grid and a chart of the last CFG_TFT_CHART_WINDOW_S seconds of RAM history are
+// drawn by tft_render.c. Nothing is sent from inside the LCD calls: Tft_Poll() walks the
+// dirty tiles, renders one into a tile buffer while the uDMA (channel 11) clocks the
+// previous one out over SSI0, and skips tiles whose pixel hash did not change. A price
+// update therefore costs a few tiles of text plus the chart columns that moved, not a
+// full-screen redraw (160x128: 40 KB, about 26 ms at 12.5 MHz).
+#ifndef TFT_H
+#define TFT_H
+
+#include <stdint.h>
+#include "pt.h"
+
+typedef struct {
+    uint32_t frames;              // Update passes completed
+    uint32_t fps;                 // Passes completed in the last whole second
+    uint32_t tiles_last;          // Tiles sent by the last pass
+    uint32_t bytes_last;          // SPI bytes (commands and pixels) of the last pass
+    uint32_t pass_us_last;        // Duration of the last pass
+    uint32_t tiles_sent;          // Tiles sent since boot
+    uint32_t tiles_skipped;       // Dirty tiles whose pixels turned out unchanged
+} TftStats;
+
+extern TftStats tft_stats;
+
+// Port and SSI0 setup, controller reset and configuration (as a coroutine: the reset and
+// sleep-out waits are 150 ms each). The first Tft_Poll() passes then paint the screen.
+PT_THREAD(Tft_Init_Thread(Pt *pt));
+
+// Character LCD emulation (see LCD_Clear, LCD_Set_Cursor and LCD_Send_Data).
+void Tft_Clear(void);
+void Tft_Set_Cursor(unsigned char col, unsigned char row);
+void Tft_Put_Char(char c);
+
+// Rebuild the chart when a tick arrived or every CFG_TFT_CHART_MS, then move the update
+// along by one tile. Returns at once while a tile transfer is in flight; call it from the
+// main loop. Does nothing before Tft_Init_Thread() has finished.
+void Tft_Poll(uint32_t now);
+
+#endif // TFT_H
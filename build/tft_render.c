@@ -0,0 +1,162 @@
+//tft_render.c
+
+#include "tft_render.h"
+#include <string.h>
+
+// 5x7 font, ASCII 0x20..0x7E: five columns per glyph, bit 0 = top row.
+static const uint8_t font[95][5] = {
+    {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},  //  !"#
+    {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00},  // $%&'
+    {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x14,0x08,0x3E,0x08,0x14}, {0x08,0x08,0x3E,0x08,0x08},  // ()*+
+    {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02},  // ,-./
+    {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31},  // 0123
+    {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},  // 4567
+    {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E}, {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00},  // 89:;
+    {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06},  // <=>?
+    {0x32,0x49,0x79,0x41,0x3E}, {0x7E,0x11,0x11,0x11,0x7E}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},  // @ABC
+    {0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x49,0x49,0x7A},  // DEFG
+    {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},  // HIJK
+    {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x0C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},  // LMNO
+    {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31},  // PQRS
+    {0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},  // TUVW
+    {0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00},  // XYZ[
+    {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},  // \]^_
+    {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20},  // `abc
+    {0x38,0x44,0x44,0x48,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7E,0x09,0x01,0x02}, {0x0C,0x52,0x52,0x52,0x3E},  // defg
+    {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x44,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},  // hijk
+    {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},  // lmno
+    {0x7C,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7C}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},  // pqrs
+    {0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},  // tuvw
+    {0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},  // xyz{
+    {0x00,0x00,0x7F,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08}                               // |}~
+};
+
+#define CELL_W (6U * TFT_SCALE)
+#define CELL_H (10U * TFT_SCALE)
+
+static void Mark(TftScene *s, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    uint32_t tx, ty;
+    for (ty = y0 / TFT_TILE; ty <= y1 / TFT_TILE && ty < TFT_TILES_Y; ty++)
+        for (tx = x0 / TFT_TILE; tx <= x1 / TFT_TILE && tx < TFT_TILES_X; tx++)
+            s->dirty[ty * TFT_TILES_X + tx] = 1;
+}
+
+void Tft_Scene_Init(TftScene *s) {
+    memset(s->text, ' ', sizeof(s->text));
+    memset(s->top, 0xFF, sizeof(s->top));        // top > bottom: empty column
+    memset(s->bottom, 0, sizeof(s->bottom));
+    s->chart_color = TFT_GREEN;
+    memset(s->dirty, 1, sizeof(s->dirty));
+}
+
+void Tft_Scene_Put(TftScene *s, uint32_t col, uint32_t row, char c) {
+    uint32_t x, y;
+    if (col >= CFG_LCD_COLS || row >= CFG_LCD_ROWS || s->text[row][col] == c)
+        return;
+    s->text[row][col] = c;
+    x = TFT_TEXT_LEFT + col * CELL_W;
+    y = TFT_TEXT_TOP + row * CELL_H;
+    Mark(s, x, y, x + CELL_W - 1U, y + CELL_H - 1U);
+}
+
+void Tft_Scene_Clear_Text(TftScene *s) {
+    uint32_t r, c;
+    for (r = 0; r < CFG_LCD_ROWS; r++)
+        for (c = 0; c < CFG_LCD_COLS; c++)
+            Tft_Scene_Put(s, c, r, ' ');
+}
+
+void Tft_Scene_Chart(TftScene *s, const int32_t *col_min, const int32_t *col_max) {
+    const uint32_t rows = TFT_CHART_BOTTOM - TFT_CHART_TOP;
+    int32_t lo = 0, hi = 0, first = 0, last = 0;
+    uint32_t x, scale, top, bottom, raw_top, raw_bottom, prev_top = 0, prev_bottom = 0;
+    int have = 0, prev = 0;
+    uint16_t color;
+
+    for (x = 0; x < TFT_WIDTH; x++) {
+        if (col_min[x] > col_max[x])
+            continue;
+        if (!have) {
+            lo = col_min[x];
+            hi = col_max[x];
+            first = col_min[x];
+            have = 1;
+        }
+        if (col_min[x] < lo) lo = col_min[x];
+        if (col_max[x] > hi) hi = col_max[x];
+        last = col_max[x];
+    }
+    // Rows per unit of price in 16.16 fixed point; a flat series sits mid-chart.
+    scale = (hi > lo) ? (uint32_t)(((uint64_t)rows << 16) / (uint32_t)(hi - lo)) : 0;
+    color = (last >= first) ? TFT_GREEN : TFT_RED;
+    if (color != s->chart_color) {
+        s->chart_color = color;
+        Mark(s, 0, TFT_CHART_TOP, TFT_WIDTH - 1U, TFT_CHART_BOTTOM);
+    }
+
+    for (x = 0; x < TFT_WIDTH; x++) {
+        if (!have || col_min[x] > col_max[x]) {
+            top = 0xFFFFU;
+            bottom = 0;
+            prev = 0;
+        } else {
+            raw_top = raw_bottom = TFT_CHART_TOP + rows / 2U;
+            if (scale) {
+                raw_top = TFT_CHART_TOP + (uint32_t)(((uint64_t)(uint32_t)(hi - col_max[x]) * scale) >> 16);
+                raw_bottom = TFT_CHART_TOP + (uint32_t)(((uint64_t)(uint32_t)(hi - col_min[x]) * scale) >> 16);
+            }
+            // Stretch the span to meet the previous column so the line has no gaps.
+            top = (prev && prev_bottom < raw_top) ? prev_bottom : raw_top;
+            bottom = (prev && prev_top > raw_bottom) ? prev_top : raw_bottom;
+            prev_top = raw_top;
+            prev_bottom = raw_bottom;
+            prev = 1;
+        }
+        if (s->top[x] != top || s->bottom[x] != bottom) {
+            s->top[x] = (uint16_t)top;
+            s->bottom[x] = (uint16_t)bottom;
+            Mark(s, x, TFT_CHART_TOP, x, TFT_CHART_BOTTOM);
+        }
+    }
+}
+
+// Colour of one pixel.
+static uint16_t Pixel(const TftScene *s, uint32_t x, uint32_t y) {
+    if (y >= TFT_TEXT_TOP && y < TFT_TEXT_BOTTOM && x >= TFT_TEXT_LEFT) {
+        uint32_t col = (x - TFT_TEXT_LEFT) / CELL_W, row = (y - TFT_TEXT_TOP) / CELL_H;
+        uint32_t gx = (x - TFT_TEXT_LEFT) % CELL_W / TFT_SCALE, gy = (y - TFT_TEXT_TOP) % CELL_H / TFT_SCALE;
+        unsigned char c;
+        if (col >= CFG_LCD_COLS || gx >= 5U || gy >= 7U)
+            return TFT_BLACK;
+        c = (unsigned char)s->text[row][col];
+        if (c < 0x20U || c > 0x7EU)
+            c = '?';
+        return ((font[c - 0x20U][gx] >> gy) & 1U) ? TFT_WHITE : TFT_BLACK;
+    }
+    if (y >= TFT_CHART_TOP && y <= TFT_CHART_BOTTOM) {
+        if (y >= s->top[x] && y <= s->bottom[x])
+            return s->chart_color;
+        return (y == TFT_CHART_BOTTOM) ? TFT_GREY : TFT_BLACK;   // Baseline
+    }
+    return TFT_BLACK;
+}
+
+uint32_t Tft_Render_Tile(const TftScene *s, uint32_t tile, uint8_t *out) {
+    uint32_t x0 = (tile % TFT_TILES_X) * TFT_TILE, y0 = (tile / TFT_TILES_X) * TFT_TILE;
+    uint32_t x, y, hash = 2166136261U;           // FNV-1a over the pixels
+    uint16_t c;
+
+    for (y = y0; y < y0 + TFT_TILE; y++) {
+        for (x = x0; x < x0 + TFT_TILE; x++) {
+            c = (x < TFT_WIDTH && y < TFT_HEIGHT) ? Pixel(s, x, y) : TFT_BLACK;
+            *out++ = (uint8_t)(c >> 8);
+            *out++ = (uint8_t)c;
+            hash = (hash ^ c) * 16777619U;
+        }
+    }
+    return hash;
+}
+
+uint32_t Tft_Scene_Size(void) {
+    return sizeof(TftScene);
+}
@@ -0,0 +1,83 @@
+//tft_render.h
+// Scene and tile renderer of the SPI TFT backend (portable C: the firmware's tft.c and the
+// host tool tools/tft_snapshot.py build the same code, so a snapshot shows exactly what
+// the panel gets).
+//
+// The scene is what the character LCD would show (CFG_LCD_ROWS x CFG_LCD_COLS characters,
+// drawn with a 5x7 font at an integer scale so the 16 columns fill the width) above a
+// price chart of the RAM history. The screen is cut into 16x16 tiles; a tile renders into
+// a 512-byte RGB565 buffer (big-endian, as the controllers expect on the wire) and yields
+// a hash of its pixels. Changing the scene marks only the tiles it touches as dirty, and
+// the driver sends a dirty tile only if its hash differs from the one last sent.
+#ifndef TFT_RENDER_H
+#define TFT_RENDER_H
+
+#include <stdint.h>
+#include "tracker_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TFT_WIDTH      CFG_TFT_WIDTH
+#define TFT_HEIGHT     CFG_TFT_HEIGHT
+#define TFT_TILE       16U
+#define TFT_TILES_X    ((TFT_WIDTH + TFT_TILE - 1U) / TFT_TILE)
+#define TFT_TILES_Y    ((TFT_HEIGHT + TFT_TILE - 1U) / TFT_TILE)
+#define TFT_TILES      (TFT_TILES_X * TFT_TILES_Y)
+#define TFT_TILE_BYTES (TFT_TILE * TFT_TILE * 2U)
+
+// Text layout: 6x10 pixel cells (5x7 glyph plus spacing) scaled by TFT_SCALE.
+#define TFT_SCALE      (TFT_WIDTH / (CFG_LCD_COLS * 6U))          // 1 at 160 px, 3 at 320 px
+#define TFT_TEXT_LEFT  ((TFT_WIDTH - CFG_LCD_COLS * 6U * TFT_SCALE) / 2U)
+#define TFT_TEXT_TOP   4U
+#define TFT_TEXT_BOTTOM (TFT_TEXT_TOP + CFG_LCD_ROWS * 10U * TFT_SCALE)
+
+// Chart area: the rest of the screen below the text.
+#define TFT_CHART_TOP    (TFT_TEXT_BOTTOM + 4U)
+#define TFT_CHART_BOTTOM (TFT_HEIGHT - 3U)             // Last chart row
+
+// RGB565 colours
+#define TFT_BLACK 0x0000U
+#define TFT_WHITE 0xFFFFU
+#define TFT_GREEN 0x07E0U
+#define TFT_RED   0xF800U
+#define TFT_GREY  0x4208U
+
+typedef char tft_fits[(TFT_SCALE >= 1 && TFT_CHART_TOP + 8U < TFT_HEIGHT) ? 1 : -1];
+
+typedef struct {
+    char text[CFG_LCD_ROWS][CFG_LCD_COLS];
+    uint16_t top[TFT_WIDTH];      // Chart span of each column (rows); top > bottom: no data
+    uint16_t bottom[TFT_WIDTH];
+    uint16_t chart_color;
+    uint8_t dirty[TFT_TILES];     // 1: tile may have changed since it was last rendered
+} TftScene;
+
+// Blank text, empty chart, every tile dirty.
+void Tft_Scene_Init(TftScene *s);
+
+// Set one character cell (outside the grid is ignored).
+void Tft_Scene_Put(TftScene *s, uint32_t col, uint32_t row, char c);
+
+// Blank the text.
+void Tft_Scene_Clear_Text(TftScene *s);
+
+// Replace the chart with TFT_WIDTH columns of prices (any unit) as produced by History_Chart();
+// a column with col_min > col_max has no data. Scaled to the range of the data, drawn
+// green if the last column is at or above the first, red otherwise. Marks only the chart
+// tiles whose spans changed.
+void Tft_Scene_Chart(TftScene *s, const int32_t *col_min, const int32_t *col_max);
+
+// Render tile 'tile' (row-major, 0..TFT_TILES-1) into 'out' (TFT_TILE_BYTES) and return
+// the hash of its pixels.
+uint32_t Tft_Render_Tile(const TftScene *s, uint32_t tile, uint8_t *out);
+
+// sizeof(TftScene), for callers that only hold it as an opaque buffer.
+uint32_t Tft_Scene_Size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TFT_RENDER_H
@@ -1,46 +1,147 @@
 //tracker.c
 
 #include "tracker.h"            
+#include "tft.h"                // SPI TFT that stands in for the LCD when CFG_TFT_ENABLE is set
 
 // Global variable definitions:
 float local_threshold = 0.0f;     // Initialize the threshold value used for comparisons to 0.0 (will be set later)
 int alarmStopped = 0;             // Initialize the alarm flag to 0 (alarm not stopped)
+volatile uint32_t uart_rx_dropped = 0;  // Count of received bytes lost to a full ring buffer
+volatile UartRxStats uart_rx_stats;     // Error flags from DR[11:8], counted by UART1_Handler
+volatile uint32_t ms_ticks = 0;         // Millisecond counter advanced by SysTick_Handler
+LcdStats lcd_stats;                     // Bytes, time and throughput of the LCD bus
+BootTimeline boot_timeline;             // Stage times of this boot (zero until reached)
+UartFlow uart_flow;                     // Receive flow control state (CFG_UART_FLOW)
+
+// PC4 (U1RTS, driven as a GPIO) and the LCD enable lines through the GPIO data address mask:
+// each write touches only its own pin, so the UART interrupt and the LCD code never undo
+// each other's read-modify-write.
+#define UART1_RTS_PIN (*((volatile uint32_t *)(GPIOC_BASE + (0x10U << 2))))
+
+// HD44780 panels on the shared bus (lcdbus.h). Enable lines: PC6 and PC7 for panels 0 and 1,
+// PE1 and PE2 for panels 2 and 3.
+static const uint8_t lcd_e_mask[LCDBUS_MAX_PANELS] = { 0x40, 0x80, 0x02, 0x04 };
+#define LCD_US_CYCLES   (SystemCoreClock / 1000000U)
+#define LCD_BYTE_US     5U        // Bus time of a byte: two nibbles, enable 1 us high and 1 us low each
+#define LCD_EXEC_CYCLES ((CFG_LCD_EXEC_US + LCD_BYTE_US) * LCD_US_CYCLES)
+#define LCD_POLL_CYCLES (CFG_LCD_POLL_US * LCD_US_CYCLES)
+
+typedef char lcd_panels_fit[(CFG_LCD_PANELS >= 1 && CFG_LCD_PANELS <= LCDBUS_MAX_PANELS) ? 1 : -1];
+
+static LcdBus lcd_bus;            // Shadows and timing of the panels
+static uint8_t lcd_sel = 0;       // Panel the LCD_* calls write to (LCD_Select)
+static uint8_t lcd_target = 0;    // Panel whose enable line LCD_Pulse_Enable pulses...
+static uint8_t lcd_all = 0;       // ...or 1: every panel (the power-up sequence goes to all at once)
+static uint32_t lcd_second;       // Millis() at the start of the second counted in bytes_per_s
+static uint32_t lcd_second_bytes; // lcd_stats.bytes at that time
+
+// UART1 receive ring buffer, filled by UART1_Handler and drained by UART1_Input_Character.
+static volatile char uart_rx_ring[UART_RX_RING_SIZE];
+static volatile uint32_t uart_rx_head = 0;  // Next slot the interrupt writes
+static volatile uint32_t uart_rx_tail = 0;  // Next slot the main loop reads
+static uint8_t uart_rx_lost = 0;            // 1 when bytes were dropped and no UART_RX_ERROR marks the gap yet
 
 // Delay routine: create a delay of 'ms' milliseconds.
+// SysTick is reserved for the free-running millisecond clock, so the delay counts CPU cycles instead.
 void DelayMs(uint32_t ms) {       
-    SysTick->LOAD = (SystemCoreClock / 1000U) - 1;  
-    // Calculation: Each millisecond delay requires (SystemCoreClock / 1000) ticks.
-    // For a 50 MHz clock: (50,000,000 / 1000) = 50,000 ticks per millisecond. Subtract 1 because the timer counts from LOAD down to 0.
-    SysTick->VAL = 0;           // Clear the current value register to start counting from LOAD value.
-    SysTick->CTRL = 5;          // Enable SysTick timer in processor clock mode (bit 0 = ENABLE, bit 2 = CLKSOURCE). No interrupt.
+    if ((DWT->CTRL & 1U) == 0)  // Make sure the cycle counter is running (CYCCNTENA).
+        Cycles_Init();
     while(ms--) {               // Loop for the number of milliseconds
-        while((SysTick->CTRL & (1 << 16)) == 0) { } // Wait until the COUNTFLAG (bit 16) is set, meaning one millisecond has passed.
+        uint32_t start = DWT->CYCCNT;
+        // Each millisecond is (SystemCoreClock / 1000) cycles: 50,000 cycles at 50 MHz.
+        while ((DWT->CYCCNT - start) < (SystemCoreClock / 1000U)) { }  // Unsigned subtraction handles wrap-around.
     }
-    SysTick->CTRL = 0;          // Disable the SysTick timer after the delay.
+}
+
+// Millisecond time base:
+
+void SysTick_Init(void) {
+    SysTick->LOAD = (SystemCoreClock / 1000U) - 1;  // One interrupt every millisecond (50,000 ticks at 50 MHz).
+    SysTick->VAL = 0;           // Clear the current value register to start counting from LOAD value.
+    SysTick->CTRL = 7;          // Enable SysTick with interrupt (bit 1 = TICKINT) in processor clock mode.
+}
+
+void SysTick_Handler(void) {
+    ms_ticks++;                 // One more millisecond has passed.
+}
+
+uint32_t Millis(void) {
+    return ms_ticks;
+}
+
+// Cycle counter functions:
+
+void Cycles_Init(void) {
+    CoreDebug->DEMCR |= (1U << 24);  // Set TRCENA to power up the DWT unit.
+    DWT->CYCCNT = 0;                 // Start counting from zero.
+    DWT->CTRL |= 1U;                 // Set CYCCNTENA to start the cycle counter.
+}
+
+uint32_t Cycles_Now(void) {
+    return DWT->CYCCNT;              // Current cycle count (50 counts per microsecond at 50 MHz).
+}
+
+// Boot helpers:
+
+void Clocks_Init(void) {
+    // Ports A-F and UART1 in one write: the modules come out of reset together, so the later
+    // *_Init functions find their PRGPIO bits already set instead of each waiting in turn.
+    SYSCTL->RCGCGPIO |= 0x3F;
+    SYSCTL->RCGCUART |= 0x02;
+    while ((SYSCTL->PRGPIO & 0x3F) != 0x3F) { }
+    while ((SYSCTL->PRUART & 0x02) == 0) { }
+}
+
+void Boot_Mark(uint8_t stage) {
+    // The cycle counter starts at 0 in Cycles_Init, the first thing main() does.
+    if (stage < BOOT_STAGES && boot_timeline.us[stage] == 0)
+        boot_timeline.us[stage] = Cycles_Now() / (SystemCoreClock / 1000000U) + 1U;  // +1: never 0 once reached
 }
 
 // LCD initialization functions:
 
+// Masked data address of panel 'panel''s enable line.
+static volatile uint32_t *LCD_E_Pin(uint8_t panel) {
+    return (volatile uint32_t *)((panel < 2 ? GPIOC_BASE : GPIOE_BASE) + ((uint32_t)lcd_e_mask[panel] << 2));
+}
+
+static void LCD_Wait_Cycles(uint32_t cycles) {
+    uint32_t start = Cycles_Now();
+    while (Cycles_Now() - start < cycles) { }
+}
+
 void LCD_Port_Init(void) {       
+    uint8_t pc = 0x40, pe = 0x01, i;  // PC6 (panel 0's enable) and PE0 (RS)
     SYSCTL->RCGCGPIO |= 0x01 | 0x04 | 0x10;  
     // Enable clock for GPIO Port A (0x01), Port C (0x04), and Port E (0x10)
     volatile unsigned long dummy = SYSCTL->RCGCGPIO;  
     // Dummy read to allow clock to stabilize.
     (void)dummy;                // Explicitly ignore the dummy variable.
 
+    for (i = 1; i < CFG_LCD_PANELS; i++) {
+        if (i < 2)
+            pc |= lcd_e_mask[i];
+        else
+            pe |= lcd_e_mask[i];
+    }
     GPIOA->DIR |= 0x3C;         // Set PA2-PA5 as output for LCD data (bits 2,3,4,5 -> 0x3C)
     GPIOA->DEN |= 0x3C;         // Enable digital function on PA2-PA5.
-    GPIOC->DIR |= 0x40;         // Set PC6 as output (used for LCD enable pulse).
-    GPIOC->DEN |= 0x40;         // Enable digital function on PC6.
-    GPIOE->DIR |= 0x01;         // Set PE0 as output (used for LCD RS, Register Select).
-    GPIOE->DEN |= 0x01;         // Enable digital function on PE0.
+    GPIOC->DIR |= pc;           // Enable lines on port C as outputs.
+    GPIOC->DEN |= pc;
+    GPIOE->DIR |= pe;           // PE0 (RS, Register Select) and the enable lines on port E.
+    GPIOE->DEN |= pe;
 }
 
 void LCD_Pulse_Enable(void) {
-    GPIOC->DATA = (GPIOC->DATA & ~0xFF) | 0x40;  // Set PC6 high to generate an enable pulse for the LCD.
-    DelayMs(1);                  // Wait for 1 millisecond for the pulse to be recognized.
-    GPIOC->DATA = (GPIOC->DATA & ~0xFF) & ~0x40;   // Set PC6 low to complete the pulse.
-    DelayMs(1);                  // Wait 1 millisecond for settling.
+    uint8_t i;
+    for (i = 0; i < CFG_LCD_PANELS; i++) {
+        if (!lcd_all && i != lcd_target)
+            continue;
+        *LCD_E_Pin(i) = lcd_e_mask[i];   // Enable high: at least 450 ns.
+        LCD_Wait_Cycles(LCD_US_CYCLES);
+        *LCD_E_Pin(i) = 0;               // The panel latches the nibble on the falling edge.
+        LCD_Wait_Cycles(LCD_US_CYCLES);  // Enable cycle of at least 1 us before the next nibble.
+    }
 }
 
 void LCD_Write_4_Bits(unsigned char nibble) {
@@ -49,48 +150,90 @@ void LCD_Write_4_Bits(unsigned char nibble) {
     LCD_Pulse_Enable();          // Pulse the enable signal to latch the data into the LCD.
 }
 
+// Add the time since 'start' (a Cycles_Now() value) to the LCD bus time.
+static void LCD_Bus_Time(uint32_t start) {
+    lcd_stats.busy_us += (Cycles_Now() - start) / (SystemCoreClock / 1000000U);
+}
+
+// One byte on the bus to the panel(s) LCD_Pulse_Enable selects: RS, then both nibbles.
+static void LCD_Write_Byte(unsigned char rs, unsigned char byte) {
+    if (rs)
+        GPIOE->DATA |= 0x01;    // Set RS (Register Select) on PE0 to indicate data.
+    else
+        GPIOE->DATA &= ~0x01;   // Clear RS to indicate a command.
+    LCD_Write_4_Bits(byte >> 4);    // High nibble first.
+    LCD_Write_4_Bits(byte & 0x0F);
+    lcd_stats.bytes++;
+}
+
 void LCD_Send_Command(unsigned char cmd) {
-    GPIOE->DATA &= ~0x01;       // Clear RS (Register Select) on PE0 to indicate a command.
-    LCD_Write_4_Bits(cmd >> 4);   // Send the high nibble (upper 4 bits) of the command.
-    LCD_Write_4_Bits(cmd & 0x0F); // Send the low nibble (lower 4 bits) of the command.
-    DelayMs(2);                  // Wait for 2 milliseconds for the command to process.
+    uint32_t start = Cycles_Now();
+    LCD_Write_Byte(0, cmd);
+    LCD_Wait_Cycles(LCD_EXEC_CYCLES);  // Let the command execute.
+    LCD_Bus_Time(start);
+}
+
+void LCD_Select(unsigned char panel) {
+    lcd_sel = panel;
 }
 
 void LCD_Send_Data(unsigned char data) {
-    GPIOE->DATA |= 0x01;        // Set RS (Register Select) on PE0 to indicate data.
-    LCD_Write_4_Bits(data >> 4);  // Send high nibble of data.
-    LCD_Write_4_Bits(data & 0x0F); // Send low nibble of data.
-    DelayMs(2);                  // Wait for 2 milliseconds to allow the data to be latched.
+    if (CFG_TFT_ENABLE) {       // TFT: the character goes into the text grid, Tft_Poll() draws it.
+        if (lcd_sel == 0)
+            Tft_Put_Char((char)data);
+        return;
+    }
+    LcdBus_Put(&lcd_bus, lcd_sel, (char)data);  // Into the panel's shadow; LCD_Poll() sends it.
 }
 
 void LCD_Set_Cursor(unsigned char col, unsigned char row) {
-    // Calculate the address based on the row (0 or 1) and column
-    unsigned char addr = (row == 0 ? 0x00 : 0x40) + (col & 0x0F);
-    // For row 0, start at 0x00; for row 1, start at 0x40. (col & 0x0F ensures column is within 0-15.)
-    LCD_Send_Command(0x80 | addr);  // Set DDRAM address command: bit 7 high, then address.
+    if (CFG_TFT_ENABLE) {
+        if (lcd_sel == 0)
+            Tft_Set_Cursor(col, row);
+        return;
+    }
+    LcdBus_Cursor(&lcd_bus, lcd_sel, col, row);
 }
 
-void LCD_Init(void) {
+PT_THREAD(LCD_Init_Thread(Pt *pt)) {
+    if (CFG_TFT_ENABLE)
+        return Tft_Init_Thread(pt);  // The TFT takes the LCD's pins and its place in the boot sequence.
+    PT_BEGIN(pt);
+    LcdBus_Init(&lcd_bus, CFG_LCD_PANELS, LCD_EXEC_CYCLES);
+    lcd_all = 1;                // Every panel takes the power-up sequence at once.
     LCD_Port_Init();            // Initialize the LCD GPIO ports.
-    DelayMs(40);                // Wait 40 ms for LCD power up.
+    PT_SLEEP(pt, 40);           // Wait 40 ms for LCD power up (other coroutines run meanwhile).
     LCD_Write_4_Bits(0x03);     // Send "0x03" to initialize in 8-bit mode (first step in initialization).
-    DelayMs(5);                 // Wait 5 ms.
+    PT_SLEEP(pt, 5);            // Wait 5 ms.
     LCD_Write_4_Bits(0x03);     // Repeat the 0x03 command.
-    DelayMs(1);                 // Wait 1 ms.
+    PT_SLEEP(pt, 1);            // Wait 1 ms.
     LCD_Write_4_Bits(0x03);     // Send 0x03 a third time.
-    DelayMs(1);                 // Wait 1 ms.
+    PT_SLEEP(pt, 1);            // Wait 1 ms.
     LCD_Write_4_Bits(0x02);     // Send 0x02 to set the LCD to 4-bit mode.
     LCD_Send_Command(0x28);     // Function set: 4-bit, 2-line, 5x8 dots (0x28 = 0010 1000).
     LCD_Send_Command(0x08);     // Display off command.
     LCD_Send_Command(0x01);     // Clear display command.
-    DelayMs(2);                 // Wait 2 ms for the clear command to complete.
+    PT_SLEEP(pt, 2);            // Wait 2 ms for the clear command to complete.
     LCD_Send_Command(0x06);     // Entry mode set: increment automatically, no display shift.
     LCD_Send_Command(0x0C);     // Display on, cursor off command.
+    lcd_all = 0;
+    LcdBus_Up(&lcd_bus, Cycles_Now());  // From here on LCD_Poll() sends what the screens write.
+    PT_END(pt);
+}
+
+void LCD_Init(void) {
+    Pt pt;                      // Only used until the sequence finishes, so it can live on the stack.
+    PT_INIT(&pt);
+    while (PT_SCHEDULE(LCD_Init_Thread(&pt))) { }  // Step the coroutine until the display is ready.
 }
 
 void LCD_Clear(void) {
-    LCD_Send_Command(0x01);     // Send the clear display command.
-    DelayMs(2);                 // Wait for 2 ms so that the display can clear.
+    if (CFG_TFT_ENABLE) {
+        if (lcd_sel == 0)
+            Tft_Clear();
+        return;
+    }
+    LcdBus_Clear(&lcd_bus, lcd_sel);  // Blanks the shadow: only the cells that were not blank are sent.
 }
 
 void LCD_Display_String(const char *str) {
@@ -99,6 +242,38 @@ void LCD_Display_String(const char *str) {
         LCD_Send_Data(*str++); // Send each character to the LCD and advance to the next.
 }
 
+int LCD_Poll(void) {
+    LcdBusOp op;
+    uint32_t start, now, wait, waited = 0;
+    if (CFG_TFT_ENABLE || !lcd_bus.up)
+        return 0;
+    if (Millis() - lcd_second >= 1000U) {
+        lcd_stats.bytes_per_s = lcd_stats.bytes - lcd_second_bytes;
+        if (lcd_stats.bytes_per_s > lcd_stats.peak_bytes_per_s)
+            lcd_stats.peak_bytes_per_s = lcd_stats.bytes_per_s;
+        lcd_second_bytes = lcd_stats.bytes;
+        lcd_second = Millis();
+    }
+    start = now = Cycles_Now();
+    for (;;) {
+        // Every panel that is ready gets its next byte; while one executes, the others are written.
+        while (LcdBus_Next(&lcd_bus, now, &op)) {
+            lcd_target = op.panel;
+            LCD_Write_Byte(op.rs, op.byte);
+            now = Cycles_Now();
+        }
+        wait = LcdBus_Wait(&lcd_bus, now);
+        if (wait == LCDBUS_IDLE || now - start + wait > LCD_POLL_CYCLES)
+            break;              // Done, or the rest goes out on the next pass of the main loop.
+        LCD_Wait_Cycles(wait);  // Every panel with changes is executing: wait for the first one.
+        waited += wait;
+        now = Cycles_Now();
+    }
+    lcd_stats.wait_us += waited / LCD_US_CYCLES;
+    LCD_Bus_Time(start);
+    return wait != LCDBUS_IDLE;
+}
+
 // UART functions:
 
 void UART1_Init(void) {
@@ -111,21 +286,136 @@ void UART1_Init(void) {
     // Equation: Baud Rate Divider = SystemClock / (16 * Baud Rate)
     // For a desired baud of 115200 and SystemClock = 50,000,000:
     // Divider = 50,000,000 / (16 * 115200)  27.1267; Integer part = 27, Fraction = 0.1267 * 64  8.11 -> FBRD = 8.
-    UART1->IBRD = 27;           // Set the integer baud rate divisor to 27.
-    UART1->FBRD = 8;            // Set the fractional baud rate divisor to 8.
+    UART1->IBRD = CFG_UART_IBRD;  // Set the integer baud rate divisor (27, derived by tools/gen_config.py).
+    UART1->FBRD = CFG_UART_FBRD;  // Set the fractional baud rate divisor (8).
     UART1->LCRH = (0x3 << 5) | (1 << 4);  
     // Set word length to 8 bits (0x3 << 5) and enable FIFOs (bit 4).
+    UART1->IFLS = (UART1->IFLS & ~0x38) | (0x2 << 3);  // Receive interrupt when the RX FIFO is half full (8 bytes).
+    UART1->IM |= (1 << 4) | (1 << 6);  // Enable the receive (RXIM) and receive time-out (RTIM) interrupts.
     UART1->CTL |= 0x0301;       // Enable UART1: set UARTEN (bit 0), TXE (bit 8), and RXE (bit 9).
 
     GPIOB->AFSEL |= 0x03;       // Enable alternate functions on PB0 and PB1 for UART.
     GPIOB->PCTL = (GPIOB->PCTL & ~0xFF) | 0x11;  
     // Configure PB0 and PB1 for UART (PCTL value 0x1 for each pin), preserving other bits.
     GPIOB->DEN |= 0x03;         // Enable digital functionality on PB0 and PB1.
+    GPIOB->PUR |= 0x01;         // Pull-up on PB0 (U1RX) keeps the line idle while the ESP32 sleeps.
+
+    if (CFG_UART_FLOW == FLOW_RTSCTS) {
+        // U1RTS is a plain output driven from the ring fill level (the UART's own RTSEN would
+        // follow the 16-byte FIFO); U1CTS (PC5, mux 8) holds our transmitter while the ESP32's
+        // receiver is full.
+        UART1_RTS_PIN = 0;      // Low: the ESP32 may send.
+        GPIOC->DIR |= 0x10;
+        GPIOC->AFSEL |= 0x20;
+        GPIOC->PCTL = (GPIOC->PCTL & ~0x00F00000) | 0x00800000;
+        GPIOC->DEN |= 0x30;
+        UART1->CTL |= 0x8000;   // CTSEN
+    } else if (CFG_UART_FLOW == FLOW_XONXOFF) {
+        UART1->DR = FLOW_XON;   // Release an ESP32 left waiting by an XOFF before our reset.
+    }
+    NVIC_EnableIRQ(UART1_IRQn); // Let the UART1 interrupt fill the ring buffer from now on.
+}
+
+// Carry out a Flow_Update()/Flow_Hold() decision on the RTS line or as XOFF/XON.
+static void UART1_Flow(int action) {
+    if (action == FLOW_KEEP)
+        return;
+    if (CFG_UART_FLOW == FLOW_RTSCTS) {
+        UART1_RTS_PIN = (action == FLOW_STOP) ? 0x10 : 0;
+    } else {
+        // Sent ahead of anything else the main loop queues next; at most one character time
+        // of waiting if the TX FIFO happens to be full.
+        while ((UART1->FR & 0x20) != 0) { }
+        UART1->DR = (action == FLOW_STOP) ? FLOW_XOFF : FLOW_XON;
+    }
+}
+
+// Append one character to the receive ring; returns 0 (and drops it) when the ring is full.
+static int UART1_Ring_Put(char c) {
+    uint32_t next = (uart_rx_head + 1) & (UART_RX_RING_SIZE - 1);
+    if (next == uart_rx_tail)
+        return 0;
+    uart_rx_ring[uart_rx_head] = c;
+    uart_rx_head = next;
+    return 1;
+}
+
+void UART1_Handler(void) {
+    // Drain the hardware FIFO into the ring so long LCD/flash operations in the main loop
+    // cannot overrun the 16-byte FIFO while a burst (e.g. the history backfill) arrives.
+    while ((UART1->FR & 0x10) == 0) {                 // While the Receive FIFO is not empty.
+        uint32_t dr = UART1->DR;                      // Data in bits 7:0, error flags in bits 11:8.
+        char c = (char)(dr & 0xFF);
+        uart_rx_stats.bytes++;
+        if (dr & 0x400) {                             // BE: the line was held low (break, FE is set too).
+            uart_rx_stats.breaks++;
+            c = UART_RX_BREAK;
+        } else if (dr & 0xB00) {                      // FE, PE or OE.
+            if (dr & 0x100) uart_rx_stats.framing++;
+            if (dr & 0x200) uart_rx_stats.parity++;
+            if (dr & 0x800) {                         // Overrun: this byte is fine but earlier ones were lost.
+                uart_rx_stats.overrun++;
+                uart_rx_lost = 1;
+            } else {
+                c = UART_RX_ERROR;                    // The byte itself is corrupt: replace it by the marker.
+            }
+        }
+        if (uart_rx_lost && c != UART_RX_BREAK && c != UART_RX_ERROR) {
+            if (UART1_Ring_Put(UART_RX_ERROR))        // Mark the gap before the next byte goes in.
+                uart_rx_lost = 0;
+        }
+        if (!UART1_Ring_Put(c)) {
+            uart_rx_dropped++;                        // Ring full: drop the byte and count it.
+            uart_rx_lost = 1;
+        } else if (c == UART_RX_BREAK || c == UART_RX_ERROR) {
+            uart_rx_lost = 0;                         // Either marker ends the damaged line anyway.
+        }
+    }
+    UART1->ICR = (1 << 4) | (1 << 6);                 // Clear the receive and time-out interrupt flags.
+    if (CFG_UART_FLOW != FLOW_NONE)
+        UART1_Flow(Flow_Update(&uart_flow, UART1_Pending()));  // Hold the ESP32 off near the high mark.
+}
+
+void UART1_Hold(int hold) {
+    if (CFG_UART_FLOW == FLOW_NONE)
+        return;
+    NVIC_DisableIRQ(UART1_IRQn);                      // The interrupt updates the same state.
+    UART1_Flow(Flow_Hold(&uart_flow, hold, UART1_Pending()));
+    NVIC_EnableIRQ(UART1_IRQn);
+    if (hold)
+        while ((UART1->FR & 0x08) != 0) { }           // BUSY: let an XOFF leave before the caller stalls the CPU.
+}
+
+int UART1_Char_Available(void) {
+    return uart_rx_head != uart_rx_tail;              // Non-zero when the ring holds unread bytes.
+}
+
+uint32_t UART1_Pending(void) {
+    return (uart_rx_head - uart_rx_tail) & (UART_RX_RING_SIZE - 1);
+}
+
+void UART1_Output_Character(char c) {
+    while ((UART1->FR & 0x20) != 0) { }               // Wait while the Transmit FIFO is full (TXFF).
+    UART1->DR = (uint8_t)c;
+}
+
+void UART1_Output_String(const char *str) {
+    while (*str)
+        UART1_Output_Character(*str++);               // A ~20-byte query waits at most a few character times.
 }
 
 char UART1_Input_Character(void) {
-    while (UART1->FR & 0x10) { }  // Wait while the Receive FIFO is empty (check bit 4 in FR register).
-    return (char)(UART1->DR & 0xFF);  // Read the received data (mask with 0xFF to get only the lower 8 bits) and return it.
+    char c;
+    while (uart_rx_head == uart_rx_tail) { }          // Wait while the ring buffer is empty.
+    c = uart_rx_ring[uart_rx_tail];                   // Take the oldest received character.
+    uart_rx_tail = (uart_rx_tail + 1) & (UART_RX_RING_SIZE - 1);
+    if (CFG_UART_FLOW != FLOW_NONE && uart_flow.stopped && !uart_flow.held &&
+        UART1_Pending() <= CFG_UART_FLOW_LOW) {
+        NVIC_DisableIRQ(UART1_IRQn);                  // Drained to the low mark: let the ESP32 go on.
+        UART1_Flow(Flow_Update(&uart_flow, UART1_Pending()));
+        NVIC_EnableIRQ(UART1_IRQn);
+    }
+    return c;
 }
 
 // Push Button functions:
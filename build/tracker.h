@@ -4,14 +4,63 @@
 
 #include "TM4C123GH6PM.h"         // Include the microcontroller-specific header containing register definitions
 #include <stdio.h>                // Include the standard I/O library (needed for sprintf, etc.)
+#include "tracker_config.h"       // Generated configuration tables and constants (see tracker_config.cfg)
+#include "pt.h"                   // Stackless coroutines used by the LCD power-up sequence and the UI screens
+#include "flow.h"                 // Receive flow control on the ESP32 link (RTS/CTS or XON/XOFF)
+#include "lcdbus.h"               // HD44780 panels sharing the LCD bus, one enable line each
 
-#define SystemCoreClock 50000000U  // Define the system core clock as 50,000,000 cycles per second (50 MHz)
+#define SystemCoreClock CFG_SYSTEM_CLOCK_HZ  // System core clock in cycles per second (50 MHz, from tracker_config.cfg)
 // Explanation: The system clock is set in hardware. Here, 50e6 cycles/second is used for timing functions.
-#define BUFFER_SIZE 128           // Define the size of the UART input buffer as 128 bytes
+#define BUFFER_SIZE CFG_UART_BUFFER_SIZE     // Size of the UART input buffer (128 bytes, from tracker_config.cfg)
+#define UART_RX_RING_SIZE 2048    // Bytes buffered by the UART1 receive interrupt (power of two; holds a full backfill burst)
+#define UART_RX_ERROR 0x18        // Put in the ring in place of a byte received with a framing/parity error or after an overrun/drop
+#define UART_RX_BREAK 0x02        // Put in the ring for a line break: the ESP32 sends one before every line (frame start)
+
+// Receive error counters kept by UART1_Handler from the flags in DR[11:8].
+typedef struct {
+    uint32_t bytes;               // Characters taken from the FIFO (breaks included)
+    uint32_t framing;             // Missing stop bit (FE without BE)
+    uint32_t parity;              // Parity errors (only with parity enabled in LCRH)
+    uint32_t overrun;             // FIFO overruns: characters lost before the flagged one
+    uint32_t breaks;              // Line breaks (BE)
+} UartRxStats;
+
+// Character LCD bus: what the panels were sent and the CPU time it took (LCD_Poll writes the
+// panels in turn and only waits when every panel with changes is still executing).
+typedef struct {
+    uint32_t bytes;               // Commands and characters sent, all panels
+    uint32_t busy_us;             // Time spent in LCD_Poll and LCD_Send_Command
+    uint32_t wait_us;             // Part of it spent waiting for a busy panel
+    uint32_t bytes_per_s;         // Bytes sent in the last whole second, all panels
+    uint32_t peak_bytes_per_s;    // Highest bytes_per_s since boot
+} LcdStats;
+
+// Boot timeline: microseconds from reset (cycle counter) at which each stage of main()'s boot
+// ended; 0 for a stage not reached yet. The UART is armed first, so lines that arrive while
+// the LCD and the boot screens run are ingested (logged, stored, answered) on the spot.
+#define BOOT_CLOCKS      0        // Every GPIO port and UART1 clocked, in one step
+#define BOOT_UART        1        // UART1 receiving into its ring
+#define BOOT_PERIPH      2        // Remaining peripherals set up (encoder, LEDs, flash log, USB, microSD)
+#define BOOT_LCD         3        // LCD (or TFT) power-up sequence finished
+#define BOOT_UI          4        // Threshold selection and banner finished: the price screen takes over
+#define BOOT_FIRST_LINE  5        // First complete line received
+#define BOOT_FIRST_PRICE 6        // First price on the display
+#define BOOT_STAGES      7
+typedef struct {
+    uint32_t us[BOOT_STAGES];     // Stage end times
+    uint32_t early_lines;         // Lines ingested before BOOT_UI
+    uint32_t ring_peak;           // Most bytes waiting in the UART ring during the boot
+} BootTimeline;
 
 // Declaration of global variables used across modules:
 extern float local_threshold;     // 'local_threshold' holds the selected threshold value for price comparison
 extern int alarmStopped;          // 'alarmStopped' is a flag indicating if the alarm has been stopped
+extern volatile uint32_t uart_rx_dropped;  // Bytes lost because the UART1 receive ring was full
+extern volatile UartRxStats uart_rx_stats; // Per-byte error flags seen by the UART1 interrupt
+extern volatile uint32_t ms_ticks;         // Milliseconds since SysTick_Init (incremented by SysTick_Handler)
+extern LcdStats lcd_stats;                 // LCD bus time and throughput, e.g. to compare display policies
+extern BootTimeline boot_timeline;         // Stage times of the last boot (see BOOT_*)
+extern UartFlow uart_flow;                 // Receive flow control: stops and peak ring fill
 
 // Function prototype declarations:
 
@@ -19,20 +68,43 @@ extern int alarmStopped;          // 'alarmStopped' is a flag indicating if the
 // 'ms' is the number of milliseconds to delay.
 void DelayMs(uint32_t ms);      
 
-// LCD (Liquid Crystal Display) related function prototypes:
-void LCD_Port_Init(void);         // Initialize the GPIO ports used by the LCD
-void LCD_Pulse_Enable(void);      // Generate an enable pulse to latch data into the LCD
+// Millisecond time base: SysTick runs free with a 1 ms interrupt.
+void SysTick_Init(void);          // Start the 1 ms SysTick interrupt
+void SysTick_Handler(void);       // SysTick interrupt: advance ms_ticks
+uint32_t Millis(void);            // Milliseconds since SysTick_Init (wraps after ~49 days)
+
+// Cycle counter (DWT CYCCNT) used for timing measurements; wraps every ~86 s at 50 MHz.
+void Cycles_Init(void);           // Enable the free-running cycle counter
+uint32_t Cycles_Now(void);        // Read the current cycle count
+
+// Boot helpers:
+void Clocks_Init(void);           // Clock every GPIO port and UART1 at once and wait for them together
+void Boot_Mark(uint8_t stage);    // Record the end of a BOOT_* stage (only the first call counts)
+
+// LCD (Liquid Crystal Display) related function prototypes. The screens write into a shadow
+// of the selected panel (LCD_Select, panel 0 unless changed); LCD_Poll() sends the changes.
+void LCD_Port_Init(void);         // Initialize the GPIO ports used by the LCD panels (CFG_LCD_PANELS enable lines)
+void LCD_Pulse_Enable(void);      // Generate an enable pulse to latch data into the panel being written
 void LCD_Write_4_Bits(unsigned char nibble);  // Write a 4-bit nibble to the LCD data bus
-void LCD_Send_Command(unsigned char cmd);     // Send a command byte to the LCD
-void LCD_Send_Data(unsigned char data);       // Send a data byte (character) to the LCD
-void LCD_Set_Cursor(unsigned char col, unsigned char row);  // Set the cursor to a specific column and row on the LCD
-void LCD_Init(void);              // Initialize the LCD (4-bit mode, clear display, etc.)
-void LCD_Clear(void);             // Clear the LCD display
-void LCD_Display_String(const char *str);  // Display a null-terminated string on the LCD
+void LCD_Send_Command(unsigned char cmd);     // Send a command byte now and wait for it (power-up sequence)
+void LCD_Select(unsigned char panel);         // Panel the following LCD_* calls write to
+void LCD_Send_Data(unsigned char data);       // Write a character at the cursor of the selected panel
+void LCD_Set_Cursor(unsigned char col, unsigned char row);  // Set the cursor to a specific column and row on the selected panel
+void LCD_Init(void);              // Initialize the LCD panels (4-bit mode, clear display, etc.), blocking until done
+PT_THREAD(LCD_Init_Thread(Pt *pt));  // The same power-up sequence as a coroutine that yields during its waits
+void LCD_Clear(void);             // Clear the selected panel
+void LCD_Display_String(const char *str);  // Display a null-terminated string on the selected panel
+int LCD_Poll(void);               // Send pending changes for up to CFG_LCD_POLL_US; returns 1 while some remain
 
 // UART (Universal Asynchronous Receiver/Transmitter) function prototypes:
 void UART1_Init(void);            // Initialize UART1 for serial communication
 char UART1_Input_Character(void); // Retrieve a single character from the UART1 receive buffer
+int UART1_Char_Available(void);   // Return non-zero if a received character is waiting in the buffer
+uint32_t UART1_Pending(void);     // Number of received characters waiting in the buffer
+void UART1_Output_Character(char c);  // Send one character to the ESP32 (waits while the TX FIFO is full)
+void UART1_Output_String(const char *str);  // Send a null-terminated string to the ESP32
+void UART1_Handler(void);         // UART1 interrupt: move received bytes from the FIFO into the ring buffer
+void UART1_Hold(int hold);        // Hold the ESP32 off (1) around a stretch without interrupts, e.g. a flash erase; 0 releases it
 
 // Push Button function prototypes:
 void PushButton_Init(void);       // Initialize the push button (set direction, enable pull-up resistor)
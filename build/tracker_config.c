@@ -0,0 +1,53 @@
+// GENERATED by tools/gen_config.py from tracker_config.cfg - do not edit by hand.
+#include "tracker_config.h"
+#include <string.h>
+
+// Compile-time size checks: a failed check declares an array of size -1.
+#define CFG_STATIC_ASSERT(cond, name) typedef char cfg_assert_##name[(cond) ? 1 : -1]
+
+CFG_STATIC_ASSERT(CFG_UART_BUFFER_SIZE >= 2 && CFG_UART_BUFFER_SIZE <= 255, uart_buffer_fits_uint8);
+CFG_STATIC_ASSERT(CFG_THRESHOLD_COUNT <= 255, threshold_index_fits_uint8);
+CFG_STATIC_ASSERT(CFG_ASSET_COUNT <= 255, asset_slot_fits_uint8);
+CFG_STATIC_ASSERT(CFG_THRESHOLD_DEFAULT < CFG_THRESHOLD_COUNT, threshold_default_in_range);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_SET_MIN) - 1 <= CFG_LCD_COLS, str_set_min_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_SAVED) - 1 <= CFG_LCD_COLS, str_saved_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_PRICE_LABEL) - 1 <= CFG_LCD_COLS, str_price_label_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_ALARM) - 1 <= CFG_LCD_COLS, str_alarm_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_LOADING) - 1 <= CFG_LCD_COLS, str_loading_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_STALE) - 1 <= CFG_LCD_COLS, str_stale_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_NOISY) - 1 <= CFG_LCD_COLS, str_noisy_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_FAIL_WIFI) - 1 <= CFG_LCD_COLS, str_fail_wifi_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_FAIL_DNS) - 1 <= CFG_LCD_COLS, str_fail_dns_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_FAIL_TLS) - 1 <= CFG_LCD_COLS, str_fail_tls_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_FAIL_HTTP) - 1 <= CFG_LCD_COLS, str_fail_http_fits_row);
+CFG_STATIC_ASSERT(sizeof(CFG_STR_FAIL_API) - 1 <= CFG_LCD_COLS, str_fail_api_fits_row);
+// Each numeric field of the price frame expands to at most 12 characters.
+CFG_STATIC_ASSERT(sizeof(CFG_PROTO_PRICE_TX) + 3 * 12 < CFG_UART_BUFFER_SIZE, price_frame_fits_buffer);
+
+const CfgAsset cfg_assets[CFG_ASSET_COUNT] = {
+    { "BTC", "bitcoin" },  // slot 0
+};
+
+const CfgAssetIndex cfg_asset_index[CFG_ASSET_COUNT] = {
+    { "BTC", 0 },
+};
+
+const int32_t cfg_thresholds[CFG_THRESHOLD_COUNT] = {
+    10000, 20000, 30000, 40000, 50000, 60000,
+    70000, 80000, 90000, 100000, 110000, 120000,
+};
+
+int Config_Asset_Slot(const char *symbol) {
+    int lo = 0, hi = CFG_ASSET_COUNT - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(symbol, cfg_asset_index[mid].symbol);
+        if (cmp == 0)
+            return cfg_asset_index[mid].slot;
+        if (cmp < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+    return -1;
+}
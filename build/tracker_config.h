@@ -0,0 +1,171 @@
+// GENERATED by tools/gen_config.py from tracker_config.cfg - do not edit by hand.
+#ifndef TRACKER_CONFIG_H
+#define TRACKER_CONFIG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// System / link
+#define CFG_SYSTEM_CLOCK_HZ      50000000U
+#define CFG_UART_BUFFER_SIZE     128
+#define CFG_UART_BAUD            115200U
+#define CFG_UART_IBRD            27U             // 50000000 / (16 * 115200), integer part
+#define CFG_UART_FBRD            8U              // fractional part * 64, rounded
+#define CFG_POLL_INTERVAL_MS     20000U
+#define CFG_LCD_COLS             16
+#define CFG_LCD_ROWS             2
+
+// Timing (milliseconds)
+#define CFG_THRESHOLD_SELECT_MS  4000U
+#define CFG_BUTTON_DEBOUNCE_MS   300U
+#define CFG_INPUT_POLL_MS        10U
+#define CFG_SAVED_BANNER_MS      3000U
+#define CFG_ALARM_BLINK_MS       150U
+#define CFG_STATUS_HOLD_MS       10000U
+#define CFG_LOADING_TIMEOUT_MS   600000U
+
+// Module parameters
+#define CFG_LCD_PANELS           1U
+#define CFG_LCD_EXEC_US          50U
+#define CFG_LCD_POLL_US          500U
+#define CFG_FLASHLOG_BASE        0x20000U
+#define CFG_FLASHLOG_SEGMENTS    128U
+#define CFG_FLASHLOG_SECTOR_SIZE 1024U
+#define CFG_FLASHLOG_BATCH       16U
+#define CFG_FLASHLOG_FLUSH_S     300U
+#define CFG_BACKFILL_DAYS        1U
+#define CFG_BACKFILL_MAX_POINTS  288U
+#define CFG_BACKFILL_TIMEOUT_MS  10000U
+#define CFG_POWER_MODE           0U
+#define CFG_POWER_STALE_GRACE_MS 10000U
+#define CFG_ENCODER_COUNTS_PER_DETENT 4U
+#define CFG_ENCODER_VELOCITY_MS  500U
+#define CFG_ENCODER_FINE_STEP    100U
+#define CFG_ENCODER_MID_STEP     1000U
+#define CFG_ENCODER_COARSE_STEP  10000U
+#define CFG_ENCODER_MID_SPEED    4U
+#define CFG_ENCODER_FAST_SPEED   12U
+#define CFG_FEED_BUFFER_SIZE     512U
+#define CFG_FEED_COUNTERS_MS     1000U
+#define CFG_FEED_DUMP_CHUNK      8U
+#define CFG_SDLOG_SPI_HZ         12500000U
+#define CFG_SDLOG_FLUSH_S        60U
+#define CFG_SDLOG_RETRY_MS       5000U
+#define CFG_SDLOG_BUSY_TIMEOUT_MS 500U
+#define CFG_TFT_ENABLE           0U
+#define CFG_TFT_CONTROLLER       0U
+#define CFG_TFT_WIDTH            160U
+#define CFG_TFT_HEIGHT           128U
+#define CFG_TFT_MADCTL           0x60U
+#define CFG_TFT_X_OFFSET         0U
+#define CFG_TFT_Y_OFFSET         0U
+#define CFG_TFT_SPI_HZ           12500000U
+#define CFG_TFT_CHART_WINDOW_S   86400U
+#define CFG_TFT_CHART_MS         5000U
+#define CFG_UART_BREAK_US        200U
+#define CFG_UART_QUALITY_WINDOW_S 60U
+#define CFG_UART_NOISY_PER_KB    4U
+#define CFG_UART_FLOW            0U
+#define CFG_UART_FLOW_HIGH       1536U
+#define CFG_UART_FLOW_LOW        512U
+#define CFG_ARCHIVE_T0_BUCKET_S  60U
+#define CFG_ARCHIVE_T0_BUCKETS   1440U
+#define CFG_ARCHIVE_T1_BUCKET_S  900U
+#define CFG_ARCHIVE_T1_BUCKETS   672U
+#define CFG_ARCHIVE_T2_BUCKET_S  7200U
+#define CFG_ARCHIVE_T2_BUCKETS   1080U
+#define CFG_ARCHIVE_SHORT_WINDOW_S 86400U
+#define CFG_ARCHIVE_LONG_WINDOW_S 604800U
+#define CFG_ARCHIVE_QUERY_MS     60000U
+#define CFG_ARCHIVE_TIMEOUT_MS   2000U
+#define CFG_ARCHIVE_LISTEN_MS    300U
+#define CFG_ARCHIVE_PAGE_MS      4000U
+#define CFG_TELEMETRY_EVERY_POLLS 3U
+#define CFG_ALARM_NOTIFY         1U
+#define CFG_ALARM_FORWARD_TRIES  3U
+#define CFG_ALARM_MQTT_PORT      1883U
+#define CFG_ALARM_ACK_MS         2000U
+#define CFG_ALARM_RETRIES        5U
+#define CFG_SELFTEST_STEP_MS     1000U
+#define CFG_SELFTEST_GAP_MS      200U
+#define CFG_METRICS_HTTP_PORT    9100U
+#define CFG_METRICS_SERIAL_S     0U
+#define CFG_PLAN_LIMIT           30U
+#define CFG_PLAN_WINDOW_S        60U
+#define CFG_PLAN_MAX_IDS         50U
+#define CFG_PLAN_PCT             90U
+#define CFG_PLAN_MIN_AGE_MS      5000U
+#define CFG_PLAN_VOL_WEIGHT      4U
+#define CFG_PLAN_NEAR_WEIGHT     8U
+#define CFG_PLAN_NEAR_PCT        2U
+#define CFG_RULES_BUDGET_CYCLES  4000U
+
+// Assets (slot numbers index cfg_assets[])
+#define CFG_ASSET_COUNT          1
+#define CFG_ASSET_BTC            0
+#define CFG_ASSET_BTC_API_ID     "bitcoin"
+
+// Threshold ladder (sorted ascending in cfg_thresholds[])
+#define CFG_THRESHOLD_COUNT      12
+#define CFG_THRESHOLD_DEFAULT    0               // index of the default entry
+
+// LCD strings
+#define CFG_STR_SET_MIN          "Set min val:"
+#define CFG_STR_SAVED            "Threshold Saved"
+#define CFG_STR_PRICE_LABEL      "BTC Price:"
+#define CFG_STR_ALARM            "BUY NOW"
+#define CFG_STR_LOADING          "Loading..."
+#define CFG_STR_STALE            "STALE"
+#define CFG_STR_NOISY            "NOISY"
+#define CFG_STR_FAIL_WIFI        "WIFI"
+#define CFG_STR_FAIL_DNS         "DNS"
+#define CFG_STR_FAIL_TLS         "TLS"
+#define CFG_STR_FAIL_HTTP        "HTTP"
+#define CFG_STR_FAIL_API         "API"
+
+// Protocol
+#define CFG_PROTO_PRICE_TX       "BTC Price: $%.2f, 24h Change: %.2f%%, T: %lu"
+#define CFG_PROTO_PRICE_RX       "BTC Price: $%f, 24h Change: %f%%, T: %lu"
+#define CFG_PROTO_PRICE_URL      "https://api.coingecko.com/api/v3/coins/bitcoin?localization=false&tickers=false&market_data=true"
+#define CFG_PROTO_CHART_URL      "https://api.coingecko.com/api/v3/coins/bitcoin/market_chart?vs_currency=usd&days="
+#define CFG_PROTO_SIMPLE_URL     "https://api.coingecko.com/api/v3/simple/price?vs_currencies=usd&include_24hr_change=true&ids="
+#define CFG_PROTO_ALARM_URL      "http://192.168.1.10:8080/alarm"
+#define CFG_PROTO_ALARM_MQTT_HOST "192.168.1.10"
+#define CFG_PROTO_ALARM_MQTT_TOPIC "tracker/alarm"
+#define CFG_FRAME_BACKFILL       'B'
+#define CFG_FRAME_HEARTBEAT      'H'
+#define CFG_FRAME_QUERY          'Q'
+#define CFG_FRAME_WINDOW         'W'
+#define CFG_FRAME_TELEMETRY      'T'
+#define CFG_FRAME_TEST           'X'
+#define CFG_FRAME_RESULT         'R'
+#define CFG_FRAME_ALARM          'A'
+#define CFG_FRAME_ALARM_ACK      'K'
+
+// Flash-resident tables (defined in tracker_config.c):
+typedef struct {
+    const char *symbol;           // Ticker symbol shown on the display, e.g. "BTC"
+    const char *api_id;           // Identifier used by the price API, e.g. "bitcoin"
+} CfgAsset;
+
+typedef struct {
+    const char *symbol;           // Ticker symbol (index is sorted by this field)
+    uint8_t slot;                 // Slot into cfg_assets[]
+} CfgAssetIndex;
+
+extern const CfgAsset cfg_assets[CFG_ASSET_COUNT];
+extern const CfgAssetIndex cfg_asset_index[CFG_ASSET_COUNT];
+extern const int32_t cfg_thresholds[CFG_THRESHOLD_COUNT];
+
+// Look up an asset slot by ticker symbol (binary search over cfg_asset_index).
+// Returns the slot number, or -1 if the symbol is unknown.
+int Config_Asset_Slot(const char *symbol);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACKER_CONFIG_H
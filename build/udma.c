@@ -0,0 +1,54 @@
+//udma.c
+
+#include "udma.h"
+#include "tracker.h"
+
+typedef struct {
+    uint32_t src_end;             // Address of the last source item
+    uint32_t dst_end;             // Address of the last destination item
+    uint32_t ctl;                 // Channel control word
+    uint32_t unused;
+} UdmaEntry;
+
+// Primary control structures of all 32 channels; the controller requires 1 KB alignment.
+static UdmaEntry udma_table[32] __attribute__((aligned(1024)));
+
+void Udma_Init(void) {
+    if (SYSCTL->RCGCDMA & 0x01)
+        return;                   // Already running (several drivers share it).
+    SYSCTL->RCGCDMA |= 0x01;
+    while ((SYSCTL->PRDMA & 0x01) == 0) { }
+    UDMA->CFG = 0x01;             // MASTEN
+    UDMA->CTLBASE = (uint32_t)(uintptr_t)udma_table;
+}
+
+void Udma_Assign(uint32_t channel, uint32_t encoding) {
+    volatile uint32_t *map = &UDMA->CHMAP0 + channel / 8;
+    uint32_t shift = (channel % 8) * 4;
+    uint32_t bit = 1U << channel;
+    *map = (*map & ~(0xFU << shift)) | (encoding << shift);
+    UDMA->ALTCLR = bit;           // Primary control structure
+    UDMA->USEBURSTCLR = bit;      // Accept single and burst requests
+    UDMA->PRIOCLR = bit;
+    UDMA->REQMASKCLR = bit;       // Let the peripheral request transfers
+}
+
+// Address of the last item touched, for an incrementing or fixed address.
+static uint32_t End_Of(const volatile void *start, uint32_t items, uint32_t inc_field) {
+    uint32_t a = (uint32_t)(uintptr_t)start;
+    if (inc_field == 3U)
+        return a;                                     // Fixed (e.g. a data register).
+    return a + ((items - 1U) << inc_field);
+}
+
+void Udma_Start(uint32_t channel, const volatile void *src, volatile void *dst, uint32_t items, uint32_t ctl) {
+    UdmaEntry *e = &udma_table[channel];
+    e->src_end = End_Of(src, items, (ctl >> 26) & 3U);
+    e->dst_end = End_Of(dst, items, (ctl >> 30) & 3U);
+    e->ctl = ctl | ((items - 1U) << 4) | UDMA_MODE_BASIC;
+    UDMA->ENASET = 1U << channel;
+}
+
+int Udma_Busy(uint32_t channel) {
+    return (UDMA->ENASET & (1U << channel)) != 0;    // The controller clears the enable when done.
+}
@@ -0,0 +1,39 @@
+//udma.h
+// Shared uDMA controller setup: one channel control table for the whole firmware and
+// helpers for basic-mode peripheral transfers.
+#ifndef UDMA_H
+#define UDMA_H
+
+#include <stdint.h>
+
+// Channel control word fields (basic mode).
+#define UDMA_DST_INC8    (0U << 30)
+#define UDMA_DST_INC16   (1U << 30)
+#define UDMA_DST_NONE    (3U << 30)
+#define UDMA_DST_SIZE8   (0U << 28)
+#define UDMA_DST_SIZE16  (1U << 28)
+#define UDMA_SRC_INC8    (0U << 26)
+#define UDMA_SRC_INC16   (1U << 26)
+#define UDMA_SRC_NONE    (3U << 26)
+#define UDMA_SRC_SIZE8   (0U << 24)
+#define UDMA_SRC_SIZE16  (1U << 24)
+#define UDMA_ARB4        (2U << 14)   // Re-arbitrate after 4 items (half an SSI FIFO)
+#define UDMA_MODE_BASIC  1U
+
+#define UDMA_MAX_ITEMS   1024U        // Largest single transfer
+
+// Enable the controller and point it at the control table (idempotent).
+void Udma_Init(void);
+
+// Route 'channel' to peripheral 'encoding' (CHMAPn) and reset its attributes.
+void Udma_Assign(uint32_t channel, uint32_t encoding);
+
+// Start a basic transfer of 'items' (1..UDMA_MAX_ITEMS) on 'channel'. 'src' and 'dst' are
+// the first source and destination addresses; 'ctl' holds the UDMA_* increment and size
+// flags. The peripheral's DMA requests then move the data.
+void Udma_Start(uint32_t channel, const volatile void *src, volatile void *dst, uint32_t items, uint32_t ctl);
+
+// Non-zero while the channel still has items to move.
+int Udma_Busy(uint32_t channel);
+
+#endif // UDMA_H
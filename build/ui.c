@@ -0,0 +1,238 @@
+//ui.c
+
+#include "ui.h"
+#include "tracker.h"
+#include "encoder.h"
+#include "link.h"
+
+// Coroutine state that has to survive a wait (locals do not, see pt.h).
+static int32_t selected;          // Threshold being edited (USD); the encoder can leave the ladder
+static int32_t turn;              // USD reported by the encoder at the last poll
+static PtTimer idle;              // Inactivity limit of the selection screen
+static Pt banner;                 // Child coroutine for the "Threshold Saved" banner
+static float alarm_price;         // Latest price while the alarm runs
+static int alarm_drawn;           // 1 once alarm_price is on the display
+static int alarm_firing;          // 1 while the latest tick fired an alert rule
+
+static void Ui_Show_Threshold(void) {
+    char threshStr[17];
+    // "$%-7d" pads to 7 characters so a shorter value overwrites the previous one.
+    sprintf(threshStr, "$%-7d", (int)selected);
+    LCD_Set_Cursor(0, 1);
+    LCD_Display_String(threshStr);
+}
+
+PT_THREAD(Ui_Select(Pt *pt)) {
+    int i;
+    PT_BEGIN(pt);
+    selected = cfg_thresholds[CFG_THRESHOLD_DEFAULT];
+    LCD_Clear();
+    LCD_Set_Cursor(0, 0);
+    LCD_Display_String(CFG_STR_SET_MIN);
+    Ui_Show_Threshold();
+
+    Pt_Timer_Set(&idle, CFG_THRESHOLD_SELECT_MS);
+    while (!Pt_Timer_Expired(&idle)) {
+        if (Encoder_Switch_Pressed())
+            break;                // The encoder's push switch commits the threshold immediately.
+        turn = Encoder_Read();
+        if (turn != 0) {
+            selected += turn;     // Stay within the range of the configured ladder.
+            if (selected < cfg_thresholds[0]) selected = cfg_thresholds[0];
+            if (selected > cfg_thresholds[CFG_THRESHOLD_COUNT - 1]) selected = cfg_thresholds[CFG_THRESHOLD_COUNT - 1];
+        } else if (PushButton_Pressed()) {
+            // Next ladder entry above the current value, wrapping to the lowest one.
+            for (i = 0; i < CFG_THRESHOLD_COUNT; i++) {
+                if (cfg_thresholds[i] > selected) break;
+            }
+            selected = cfg_thresholds[i % CFG_THRESHOLD_COUNT];
+        } else {
+            PT_SLEEP(pt, CFG_INPUT_POLL_MS);
+            continue;
+        }
+        Ui_Show_Threshold();
+        Pt_Timer_Set(&idle, CFG_THRESHOLD_SELECT_MS);  // Any input restarts the inactivity limit.
+        if (turn == 0)
+            PT_SLEEP(pt, CFG_BUTTON_DEBOUNCE_MS);  // Button hold-off against rapid cycling.
+    }
+
+    local_threshold = (float)selected;
+    PT_SPAWN(pt, &banner, Ui_Banner(&banner, CFG_STR_SAVED, CFG_SAVED_BANNER_MS));
+    PT_END(pt);
+}
+
+PT_THREAD(Ui_Banner(Pt *pt, const char *text, uint32_t ms)) {
+    PT_BEGIN(pt);
+    LCD_Clear();
+    LCD_Set_Cursor(0, 0);
+    LCD_Display_String(text);
+    PT_SLEEP(pt, ms);
+    LCD_Clear();
+    PT_END(pt);
+}
+
+void Ui_Alarm_Price(float price, int firing) {
+    alarm_price = price;
+    alarm_firing = firing;
+    alarm_drawn = 0;
+}
+
+PT_THREAD(Ui_Alarm(Pt *pt)) {
+    char priceStr[17];
+    int intPrice;
+    PT_BEGIN(pt);
+    while (alarm_firing && !PushButton_Pressed()) {
+        if (!alarm_drawn) {
+            // Redraw only when a new tick arrived; the text does not change between blinks.
+            intPrice = (int)alarm_price;
+            sprintf(priceStr, "$%d,%03d", intPrice / 1000, intPrice % 1000);
+            LCD_Clear();
+            LCD_Set_Cursor(0, 0);
+            LCD_Display_String(priceStr);
+            LCD_Set_Cursor(0, 1);
+            LCD_Display_String(CFG_STR_ALARM);
+            alarm_drawn = 1;
+        }
+        RGB_LED_Flash_Yellow();
+        Buzzer_Toggle();
+        PT_SLEEP(pt, CFG_ALARM_BLINK_MS);
+    }
+    Buzzer_Off();
+    PT_END(pt);
+}
+
+// Price in cents as thousands of USD with one decimal ("97.4k").
+static int Ui_Kilo(char *out, int32_t cents) {
+    int32_t tenths = (cents + 5000) / 10000;   // Tenths of a thousand USD, rounded.
+    return sprintf(out, "%ld.%ldk", (long)(tenths / 10), (long)(tenths % 10));
+}
+
+// One statistics row, e.g. "24h 95.1k-97.4k" or "7d  --" before the first answer.
+static void Ui_Show_Window(unsigned char row, const LinkWindow *w) {
+    char text[24];
+    int n;
+    if (w->window_s < 2 * 86400U)
+        n = sprintf(text, "%luh", (unsigned long)(w->window_s / 3600U));
+    else
+        n = sprintf(text, "%lud", (unsigned long)(w->window_s / 86400U));
+    while (n < 4)
+        text[n++] = ' ';
+    if (w->count == 0) {
+        text[n++] = '-';
+        text[n++] = '-';
+    } else {
+        n += Ui_Kilo(text + n, w->low);
+        text[n++] = '-';
+        n += Ui_Kilo(text + n, w->high);
+    }
+    text[n < CFG_LCD_COLS ? n : CFG_LCD_COLS] = '\0';
+    LCD_Set_Cursor(0, row);
+    LCD_Display_String(text);
+}
+
+void Ui_Side_Panel(void) {
+    LCD_Select(1);
+    LCD_Clear();                  // Only the cells that change are sent (lcdbus.h).
+    Ui_Show_Window(0, &link_windows[0]);
+    Ui_Show_Window(1, &link_windows[1]);
+    LCD_Select(0);
+}
+
+// One text row, cut to the display width.
+static void Ui_Show_Row(unsigned char row, char *text, int n) {
+    text[n < CFG_LCD_COLS ? n : CFG_LCD_COLS] = '\0';
+    LCD_Set_Cursor(0, row);
+    LCD_Display_String(text);
+}
+
+// ESP32 network screen: "-67dB r3 H200" (RSSI, Wi-Fi reconnects, HTTP status or the failing
+// phase) above the phases of the last fetch, "12/840/310/45ms" (DNS/connect+TLS/first byte/body).
+static void Ui_Show_Network(const FrameTelemetry *t) {
+    char text[48];
+    const char *fail = Link_Fail_Text((uint8_t)t->fail);
+    int n = sprintf(text, "%lddB r%lu ", (long)t->rssi, (unsigned long)t->reconnects);
+    if (fail == NULL || t->fail == FRAME_FAIL_HTTP)
+        n += sprintf(text + n, "H%ld", (long)t->http_status);
+    else
+        n += sprintf(text + n, "%s", fail);
+    Ui_Show_Row(0, text, n);
+    n = sprintf(text, "%lu/%lu/%lu/%lums", (unsigned long)t->dns_ms, (unsigned long)t->connect_ms,
+                (unsigned long)t->ttfb_ms, (unsigned long)t->body_ms);
+    Ui_Show_Row(1, text, n);
+}
+
+// ESP32 system screen: "Heap 120k/96k" (free / largest block) above "Up 4h07 F2/123"
+// (uptime, failed / total fetches).
+static void Ui_Show_System(const FrameTelemetry *t) {
+    char text[48];
+    int n = sprintf(text, "Heap %luk/%luk", (unsigned long)(t->heap_free / 1024U),
+                    (unsigned long)(t->heap_block / 1024U));
+    Ui_Show_Row(0, text, n);
+    n = sprintf(text, "Up %luh%02lu F%lu/%lu", (unsigned long)(t->uptime_s / 3600U),
+                (unsigned long)(t->uptime_s / 60U % 60U), (unsigned long)t->failures,
+                (unsigned long)t->fetches);
+    Ui_Show_Row(1, text, n);
+}
+
+void Ui_Test_Progress(const SelfTest *st) {
+    const SelfTestStep *s = &st->step[st->current];
+    char text[40];                // Three 10-digit counts fit
+    int n = sprintf(text, "%luB %lu/s %lu", (unsigned long)s->size, (unsigned long)s->rate,
+                    (unsigned long)s->received);
+    while (n < CFG_LCD_COLS)
+        text[n++] = ' ';          // Erase the rest of the previous row.
+    Ui_Show_Row(1, text, n);
+}
+
+PT_THREAD(Ui_Test_Result(Pt *pt)) {
+    const FrameTestResult *r = &link_self_test.result;
+    char text[32];
+    int n;
+    PT_BEGIN(pt);
+    LCD_Clear();
+    if (r->best_rate == 0) {
+        n = sprintf(text, "No clean step");
+        Ui_Show_Row(0, text, n);
+    } else {
+        n = sprintf(text, "Max %lu/s %luB", (unsigned long)r->best_rate, (unsigned long)r->best_size);
+        Ui_Show_Row(0, text, n);
+        n = sprintf(text, "%lu.%lukB/s cpu%lu%%", (unsigned long)(r->best_bps / 1000U),
+                    (unsigned long)(r->best_bps / 100U % 10U), (unsigned long)r->cpu_pct);
+        Ui_Show_Row(1, text, n);
+    }
+    PT_SLEEP(pt, CFG_ARCHIVE_PAGE_MS);
+    LCD_Clear();
+    if (r->parse_rate)
+        n = sprintf(text, "Parse lag %lu/s", (unsigned long)r->parse_rate);
+    else
+        n = sprintf(text, "Parse ok L%lu", (unsigned long)r->lost);
+    Ui_Show_Row(0, text, n);
+    if (r->display_rate)
+        n = sprintf(text, "Disp lag %lu/s", (unsigned long)r->display_rate);
+    else
+        n = sprintf(text, "Disp ok");
+    Ui_Show_Row(1, text, n);
+    PT_SLEEP(pt, CFG_ARCHIVE_PAGE_MS);
+    PT_END(pt);
+}
+
+PT_THREAD(Ui_Stats(Pt *pt)) {
+    PT_BEGIN(pt);
+    LCD_Clear();
+    Ui_Show_Window(0, &link_windows[0]);
+    Ui_Show_Window(1, &link_windows[1]);
+    PT_SLEEP(pt, CFG_ARCHIVE_PAGE_MS);
+    LCD_Clear();
+    if (link_telemetry.received == 0) {
+        LCD_Set_Cursor(0, 0);
+        LCD_Display_String("ESP32 --");  // Older ESP32 build, or none received yet.
+        PT_SLEEP(pt, CFG_ARCHIVE_PAGE_MS);
+    } else {
+        Ui_Show_Network(&link_telemetry.last);
+        PT_SLEEP(pt, CFG_ARCHIVE_PAGE_MS);
+        LCD_Clear();
+        Ui_Show_System(&link_telemetry.last);
+        PT_SLEEP(pt, CFG_ARCHIVE_PAGE_MS);
+    }
+    PT_END(pt);
+}
@@ -0,0 +1,42 @@
+//ui.h
+// The TM4C's interactive screens, written as coroutines (see pt.h) that keep the shape of
+// the old straight-line code but yield at every wait instead of calling DelayMs(): the boot
+// threshold selection with its "Threshold Saved" banner, the alarm blink/beep pattern and
+// the long-horizon statistics page. The main loop steps them, so the USB feed, the microSD
+// writer and UART input keep being served while a screen is up.
+#ifndef UI_H
+#define UI_H
+
+#include <stdint.h>
+#include "pt.h"
+#include "selftest.h"
+
+// Threshold selection: encoder and button edits until CFG_THRESHOLD_SELECT_MS pass without
+// input (or the encoder switch is pressed); then sets local_threshold and shows the banner.
+PT_THREAD(Ui_Select(Pt *pt));
+
+// Show 'text' on the first row of a cleared display for 'ms', then clear it again.
+PT_THREAD(Ui_Banner(Pt *pt, const char *text, uint32_t ms));
+
+// Alarm: show the price, blink the LED and beep every CFG_ALARM_BLINK_MS while the
+// latest tick fires an alert rule (rules.h) and the push button is not pressed. Feed every
+// new tick through Ui_Alarm_Price() (the first call before the coroutine is started).
+void Ui_Alarm_Price(float price, int firing);
+PT_THREAD(Ui_Alarm(Pt *pt));
+
+// Statistics page: low-high range of the short and long windows answered by the ESP32's
+// archive (link_windows), one per row, for CFG_ARCHIVE_PAGE_MS; then the ESP32's latest
+// telemetry (link_telemetry) on a network and a system screen, each for CFG_ARCHIVE_PAGE_MS.
+PT_THREAD(Ui_Stats(Pt *pt));
+
+// Second HD44780 panel (CFG_LCD_PANELS > 1): the same two windows, kept up to date.
+void Ui_Side_Panel(void);
+
+// Link self-test (selftest.h): the progress row, "64B 200/s 183" (frame size, rate asked for,
+// frames received in the step), drawn on the second row; and the result, two screens of
+// CFG_ARCHIVE_PAGE_MS each: best error-free rate and its CPU load, then where line handling
+// and the display fell behind.
+void Ui_Test_Progress(const SelfTest *st);
+PT_THREAD(Ui_Test_Result(Pt *pt));
+
+#endif // UI_H
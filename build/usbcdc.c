@@ -0,0 +1,370 @@
+//usbcdc.c
+
+#include "usbcdc.h"
+#include "tracker.h"
+#include <stddef.h>
+
+#define USB_VID 0x1CBE            // Texas Instruments
+#define USB_PID 0x0002            // TI virtual COM port
+
+// USB0 register bits (device mode)
+#define POWER_SOFTCONN 0x40
+#define IS_RESET       0x04
+#define IS_DISCON      0x20
+#define CSRL0_RXRDY    0x01
+#define CSRL0_TXRDY    0x02
+#define CSRL0_STALLED  0x04
+#define CSRL0_DATAEND  0x08
+#define CSRL0_SETEND   0x10
+#define CSRL0_STALL    0x20
+#define CSRL0_RXRDYC   0x40
+#define CSRL0_SETENDC  0x80
+#define TXCSRL_TXRDY   0x01
+#define TXCSRL_FLUSH   0x08
+#define TXCSRL_CLRDT   0x40
+#define TXCSRH_MODE    0x20       // Endpoint FIFO used for IN transfers
+#define RXCSRL_RXRDY   0x01
+#define RXCSRL_CLRDT   0x80
+#define FIFOSZ_DPB     0x10       // Double-packet buffering
+#define FIFOSZ_16      0x01
+#define FIFOSZ_64      0x03
+
+#define EP_FIFO8(ep)   (*(volatile uint8_t *)(&USB0->FIFO0 + (ep)))  // Byte access to an endpoint FIFO
+
+// Standard and CDC requests handled on EP0
+#define REQ_GET_STATUS         0x00
+#define REQ_SET_ADDRESS        0x05
+#define REQ_GET_DESCRIPTOR     0x06
+#define REQ_GET_CONFIGURATION  0x08
+#define REQ_SET_CONFIGURATION  0x09
+#define REQ_SET_LINE_CODING    0x20
+#define REQ_GET_LINE_CODING    0x21
+#define REQ_SET_CONTROL_LINE   0x22
+
+#define EP0_IDLE   0
+#define EP0_TX     1              // Sending a data stage to the host
+#define EP0_RX     2              // Receiving a data stage (SET_LINE_CODING)
+#define EP0_STATUS 3              // Waiting for the status stage of SET_ADDRESS
+
+#define CDC_RX_RING 64            // Command bytes buffered from EP1 OUT (power of two)
+
+static const uint8_t device_desc[18] = {
+    18, 1, 0x00, 0x02,            // Device descriptor, USB 2.0
+    0x02, 0x00, 0x00, 64,         // Class CDC, EP0 packet size 64
+    USB_VID & 0xFF, USB_VID >> 8, USB_PID & 0xFF, USB_PID >> 8,
+    0x00, 0x01, 1, 2, 3, 1        // Release 1.00, strings 1-3, one configuration
+};
+
+static const uint8_t config_desc[67] = {
+    9, 2, 67, 0, 2, 1, 0, 0x80, 50,               // Configuration: 2 interfaces, bus powered, 100 mA
+    9, 4, 0, 0, 1, 0x02, 0x02, 0x01, 0,           // Interface 0: CDC communication, ACM, AT commands
+    5, 0x24, 0x00, 0x10, 0x01,                    // Header functional descriptor, CDC 1.10
+    5, 0x24, 0x01, 0x00, 1,                       // Call management: data interface 1
+    4, 0x24, 0x02, 0x02,                          // ACM: SET_LINE_CODING / SET_CONTROL_LINE_STATE
+    5, 0x24, 0x06, 0, 1,                          // Union: master 0, slave 1
+    7, 5, 0x82, 0x03, 16, 0, 255,                 // EP2 IN, interrupt, 16 bytes
+    9, 4, 1, 0, 2, 0x0A, 0x00, 0x00, 0,           // Interface 1: CDC data
+    7, 5, 0x01, 0x02, CDC_PACKET_SIZE, 0, 0,      // EP1 OUT, bulk
+    7, 5, 0x81, 0x02, CDC_PACKET_SIZE, 0, 0       // EP1 IN, bulk
+};
+
+static const char *const strings[] = { "Bitcoin Tracker", "TM4C123 tick feed", "0001" };
+
+CdcStats cdc_stats;
+
+static CdcTxDone tx_done_cb;
+static volatile uint8_t configured;
+static uint8_t line_coding[7] = { 0x00, 0xC2, 0x01, 0x00, 0, 0, 8 };  // 115200 8N1 (ignored)
+
+static uint8_t ep0_state = EP0_IDLE;
+static uint8_t pending_address;
+static const uint8_t *ep0_data;   // Remaining data stage
+static uint32_t ep0_left;
+static uint8_t ep0_scratch[2 + 2 * 20];  // String descriptors and short replies are built here
+
+static const uint8_t *volatile tx_ptr;   // Bulk IN transfer in progress
+static volatile uint32_t tx_left;
+static volatile uint8_t tx_zlp;          // The transfer ended on a full packet: send a ZLP
+static volatile uint8_t tx_busy;
+
+static uint8_t rx_ring[CDC_RX_RING];
+static volatile uint32_t rx_head, rx_tail;
+
+// Power up the PLL (the PHY runs from it) and the USB PHY, leaving the system clock alone.
+static void Usb_Clock_Init(void) {
+    SYSCTL->RCC &= ~0x00002000U;              // PWRDN
+    SYSCTL->RCC2 &= ~(0x00002000U | 0x00004000U);  // PWRDN2, USBPWRDN
+    while ((SYSCTL->PLLSTAT & 0x01) == 0) { } // Wait for PLL lock.
+}
+
+void Cdc_Init(CdcTxDone tx_done) {
+    tx_done_cb = tx_done;
+    Usb_Clock_Init();
+    SYSCTL->RCGCGPIO |= 0x08;     // Port D: PD4/PD5 carry USB0DM/USB0DP.
+    SYSCTL->RCGCUSB |= 0x01;
+    while ((SYSCTL->PRGPIO & 0x08) == 0) { }
+    while ((SYSCTL->PRUSB & 0x01) == 0) { }
+    GPIOD->DEN &= ~0x30;
+    GPIOD->AMSEL |= 0x30;         // Analog function for the USB data lines.
+
+    USB0->GPCS = 0x03;            // Force device mode (no OTG/ID pin).
+    USB0->IE = IS_RESET | IS_DISCON;
+    USB0->TXIE = 0x01 | 0x02;     // EP0, EP1 IN
+    USB0->RXIE = 0x02;            // EP1 OUT
+    NVIC_EnableIRQ(USB0_IRQn);
+    USB0->POWER |= POWER_SOFTCONN;  // Pull up D+: the host starts enumeration.
+}
+
+int Cdc_Ready(void) {
+    return configured;
+}
+
+int Cdc_Busy(void) {
+    return tx_busy;
+}
+
+// Load the next bulk IN packet (called with the EP1 IN buffer free).
+static void Tx_Load(void) {
+    uint32_t n = tx_left > CDC_PACKET_SIZE ? CDC_PACKET_SIZE : tx_left;
+    uint32_t i;
+    if (n == 0 && !tx_zlp) {
+        tx_busy = 0;
+        if (tx_done_cb)
+            tx_done_cb();                     // May start the next transfer.
+        return;
+    }
+    for (i = 0; i < n; i++)
+        EP_FIFO8(1) = tx_ptr[i];
+    tx_ptr += n;
+    tx_left -= n;
+    tx_zlp = (n == CDC_PACKET_SIZE && tx_left == 0);  // A full last packet needs a ZLP after it.
+    USB0->EPIDX = 1;
+    USB0->TXCSRL1 |= TXCSRL_TXRDY;
+    cdc_stats.packets_in++;
+    cdc_stats.bytes_in += n;
+}
+
+int Cdc_Send(const uint8_t *p, uint32_t len) {
+    if (!configured || tx_busy || len == 0)
+        return 0;
+    NVIC_DisableIRQ(USB0_IRQn);
+    tx_ptr = p;
+    tx_left = len;
+    tx_zlp = 0;
+    tx_busy = 1;
+    if ((USB0->TXCSRL1 & TXCSRL_TXRDY) == 0)
+        Tx_Load();                            // Later packets are loaded from the interrupt.
+    NVIC_EnableIRQ(USB0_IRQn);
+    return 1;
+}
+
+uint32_t Cdc_Receive(uint8_t *out, uint32_t max) {
+    uint32_t n = 0;
+    while (n < max && rx_tail != rx_head) {
+        out[n++] = rx_ring[rx_tail];
+        rx_tail = (rx_tail + 1) & (CDC_RX_RING - 1);
+    }
+    return n;
+}
+
+static void Ep0_Send_Chunk(void) {
+    uint32_t n = ep0_left > 64 ? 64 : ep0_left, i;
+    for (i = 0; i < n; i++)
+        EP_FIFO8(0) = ep0_data[i];
+    ep0_data += n;
+    ep0_left -= n;
+    if (ep0_left == 0) {
+        USB0->CSRL0 = CSRL0_TXRDY | CSRL0_DATAEND;
+        ep0_state = EP0_IDLE;
+    } else {
+        USB0->CSRL0 = CSRL0_TXRDY;
+        ep0_state = EP0_TX;
+    }
+}
+
+static void Ep0_Reply(const uint8_t *data, uint32_t len, uint16_t wlength) {
+    ep0_data = data;
+    ep0_left = len < wlength ? len : wlength;
+    USB0->CSRL0 = CSRL0_RXRDYC;               // Acknowledge the setup packet, then send the data stage.
+    Ep0_Send_Chunk();
+}
+
+static void Ep0_Stall(void) {
+    USB0->CSRL0 = CSRL0_RXRDYC | CSRL0_STALL;
+    ep0_state = EP0_IDLE;
+}
+
+// Build a UTF-16LE string descriptor in ep0_scratch.
+static uint32_t String_Desc(const char *s) {
+    uint32_t n = 2;
+    while (*s && n + 2 <= sizeof(ep0_scratch)) {
+        ep0_scratch[n++] = (uint8_t)*s++;
+        ep0_scratch[n++] = 0;
+    }
+    ep0_scratch[0] = (uint8_t)n;
+    ep0_scratch[1] = 3;
+    return n;
+}
+
+static void Endpoints_Configure(void) {
+    USB0->EPIDX = 1;
+    USB0->TXFIFOSZ = FIFOSZ_64 | FIFOSZ_DPB;  // 2 x 64 bytes at 64: one packet loads while one is sent.
+    USB0->TXFIFOADD = 64 / 8;
+    USB0->RXFIFOSZ = FIFOSZ_64;               // 64 bytes at 192
+    USB0->RXFIFOADD = 192 / 8;
+    USB0->EPIDX = 2;
+    USB0->TXFIFOSZ = FIFOSZ_16;               // 16 bytes at 256
+    USB0->TXFIFOADD = 256 / 8;
+
+    USB0->TXMAXP1 = CDC_PACKET_SIZE;
+    USB0->TXCSRH1 = TXCSRH_MODE;
+    USB0->TXCSRL1 = TXCSRL_CLRDT | TXCSRL_FLUSH;
+    USB0->RXMAXP1 = CDC_PACKET_SIZE;
+    USB0->RXCSRL1 = RXCSRL_CLRDT;
+    USB0->TXMAXP2 = 16;
+    USB0->TXCSRH2 = TXCSRH_MODE;
+    USB0->TXCSRL2 = TXCSRL_CLRDT;
+}
+
+static void Ep0_Setup(void) {
+    uint8_t setup[8];
+    uint16_t value, length;
+    uint32_t i;
+    for (i = 0; i < 8; i++)
+        setup[i] = EP_FIFO8(0);
+    value = (uint16_t)(setup[2] | (setup[3] << 8));
+    length = (uint16_t)(setup[6] | (setup[7] << 8));
+
+    switch (setup[1]) {
+    case REQ_GET_DESCRIPTOR:
+        if (setup[0] != 0x80) break;
+        if ((value >> 8) == 1) {
+            Ep0_Reply(device_desc, sizeof(device_desc), length);
+        } else if ((value >> 8) == 2) {
+            Ep0_Reply(config_desc, sizeof(config_desc), length);
+        } else if ((value >> 8) == 3 && (value & 0xFF) == 0) {
+            ep0_scratch[0] = 4;
+            ep0_scratch[1] = 3;
+            ep0_scratch[2] = 0x09;            // English (US)
+            ep0_scratch[3] = 0x04;
+            Ep0_Reply(ep0_scratch, 4, length);
+        } else if ((value >> 8) == 3 && (value & 0xFF) <= 3) {
+            Ep0_Reply(ep0_scratch, String_Desc(strings[(value & 0xFF) - 1]), length);
+        } else {
+            break;
+        }
+        return;
+    case REQ_SET_ADDRESS:
+        pending_address = (uint8_t)(value & 0x7F);
+        USB0->CSRL0 = CSRL0_RXRDYC | CSRL0_DATAEND;
+        ep0_state = EP0_STATUS;               // FADDR is written once the status stage is done.
+        return;
+    case REQ_SET_CONFIGURATION:
+        if (value > 1) break;
+        if (value == 1)
+            Endpoints_Configure();
+        configured = (uint8_t)value;
+        tx_busy = 0;
+        USB0->CSRL0 = CSRL0_RXRDYC | CSRL0_DATAEND;
+        return;
+    case REQ_GET_CONFIGURATION:
+        ep0_scratch[0] = configured;
+        Ep0_Reply(ep0_scratch, 1, length);
+        return;
+    case REQ_GET_STATUS:
+        ep0_scratch[0] = 0;                   // Bus powered, no remote wake-up, endpoint not halted
+        ep0_scratch[1] = 0;
+        Ep0_Reply(ep0_scratch, 2, length);
+        return;
+    case REQ_SET_LINE_CODING:
+        if (setup[0] != 0x21) break;
+        USB0->CSRL0 = CSRL0_RXRDYC;
+        ep0_state = EP0_RX;                   // 7 bytes follow in the data stage.
+        return;
+    case REQ_GET_LINE_CODING:
+        if (setup[0] != 0xA1) break;
+        Ep0_Reply(line_coding, sizeof(line_coding), length);
+        return;
+    case REQ_SET_CONTROL_LINE:
+        if (setup[0] != 0x21) break;
+        USB0->CSRL0 = CSRL0_RXRDYC | CSRL0_DATAEND;  // DTR/RTS are not needed: the feed runs regardless.
+        return;
+    default:
+        break;
+    }
+    Ep0_Stall();
+}
+
+static void Ep0_Handler(void) {
+    uint8_t csr = USB0->CSRL0;
+    uint32_t i, n;
+    if (csr & CSRL0_STALLED) {
+        USB0->CSRL0 = 0;
+        ep0_state = EP0_IDLE;
+        return;
+    }
+    if (csr & CSRL0_SETEND) {
+        USB0->CSRL0 = CSRL0_SETENDC;          // Host aborted the transfer.
+        ep0_state = EP0_IDLE;
+    }
+    if (ep0_state == EP0_STATUS) {
+        USB0->FADDR = pending_address;
+        ep0_state = EP0_IDLE;
+    } else if (ep0_state == EP0_TX) {
+        Ep0_Send_Chunk();
+        return;
+    }
+    if ((csr & CSRL0_RXRDY) == 0)
+        return;
+    if (ep0_state == EP0_RX) {
+        n = USB0->COUNT0;
+        for (i = 0; i < n; i++) {
+            uint8_t b = EP_FIFO8(0);
+            if (i < sizeof(line_coding))
+                line_coding[i] = b;
+        }
+        USB0->CSRL0 = CSRL0_RXRDYC | CSRL0_DATAEND;
+        ep0_state = EP0_IDLE;
+        return;
+    }
+    Ep0_Setup();
+}
+
+static void Ep1_Out_Handler(void) {
+    uint32_t n, i;
+    USB0->EPIDX = 1;
+    if ((USB0->RXCSRL1 & RXCSRL_RXRDY) == 0)
+        return;
+    n = USB0->RXCOUNT1;
+    for (i = 0; i < n; i++) {
+        uint8_t b = EP_FIFO8(1);
+        uint32_t next = (rx_head + 1) & (CDC_RX_RING - 1);
+        if (next == rx_tail) {
+            cdc_stats.rx_dropped++;
+            continue;
+        }
+        rx_ring[rx_head] = b;
+        rx_head = next;
+    }
+    USB0->RXCSRL1 &= ~RXCSRL_RXRDY;           // Release the packet buffer.
+}
+
+void USB0_Handler(void) {
+    uint8_t is = USB0->IS;                    // Reading clears the flags.
+    uint16_t txis = USB0->TXIS;
+    uint16_t rxis = USB0->RXIS;
+
+    if (is & (IS_RESET | IS_DISCON)) {
+        configured = 0;
+        tx_busy = 0;
+        ep0_state = EP0_IDLE;
+        if (is & IS_RESET)
+            cdc_stats.resets++;
+    }
+    if (txis & 0x01)
+        Ep0_Handler();
+    if ((txis & 0x02) && tx_busy)
+        Tx_Load();                            // A packet buffer became free.
+    if (rxis & 0x02)
+        Ep1_Out_Handler();
+}
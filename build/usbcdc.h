@@ -0,0 +1,52 @@
+//usbcdc.h
+// Minimal USB device stack for the TM4C123's USB0 controller: one CDC-ACM serial port.
+//
+// Endpoints: EP0 control, EP1 bulk IN (device -> host data, double-packet buffered),
+// EP1 bulk OUT (host -> device commands) and EP2 interrupt IN (CDC notifications, unused).
+// Everything runs in USB0_Handler: enumeration, the CDC line-coding requests and the
+// packetising of a transfer started with Cdc_Send(), so a transfer proceeds while the main
+// loop is busy elsewhere. Nothing in here ever waits for the host; with no cable plugged in
+// Cdc_Send() simply reports that the port is not ready.
+//
+// D- / D+ are PD4 / PD5. The USB PHY needs the PLL, which is powered up by Cdc_Init()
+// without changing the system clock source.
+#ifndef USBCDC_H
+#define USBCDC_H
+
+#include <stdint.h>
+
+#define CDC_PACKET_SIZE 64        // Bulk endpoint packet size (full speed)
+
+// Called from USB0_Handler when a Cdc_Send() transfer has been fully handed to the host.
+typedef void (*CdcTxDone)(void);
+
+// Bring up the controller and connect to the bus. 'tx_done' may be NULL.
+void Cdc_Init(CdcTxDone tx_done);
+
+// Non-zero once the host has selected the configuration (enumeration finished).
+int Cdc_Ready(void);
+
+// Start sending 'len' bytes from 'p'; the buffer must stay untouched until the transfer
+// completes. Returns 0 (and sends nothing) if the port is not ready or a transfer is
+// still in progress.
+int Cdc_Send(const uint8_t *p, uint32_t len);
+
+// Non-zero while a Cdc_Send() transfer is in progress.
+int Cdc_Busy(void);
+
+// Copy up to 'max' received command bytes into 'out'. Returns the number copied.
+uint32_t Cdc_Receive(uint8_t *out, uint32_t max);
+
+// Bus statistics.
+typedef struct {
+    uint32_t resets;              // Bus resets seen
+    uint32_t packets_in;          // Bulk IN packets loaded (ZLPs included)
+    uint32_t bytes_in;            // Bulk IN payload bytes
+    uint32_t rx_dropped;          // Command bytes lost because the receive ring was full
+} CdcStats;
+
+extern CdcStats cdc_stats;
+
+void USB0_Handler(void);          // USB0 interrupt
+
+#endif // USBCDC_H
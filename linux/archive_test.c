@@ -0,0 +1,193 @@
+//archive_test.c
+// Host test of the ESP32's multi-resolution price archive (build/archive.c) and of the
+// $Q / $W exchange that carries its windows to the TM4C (build/frame.c).
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Ibuild -o archive_test linux/archive_test.c build/archive.c build/frame.c && ./archive_test
+//
+// Checked: a query is answered from the finest tier that covers its window, with the start
+// rounded down to that tier's buckets; buckets skipped by a gap are emptied, and a gap
+// longer than a tier's span empties all of it; a sample older than a tier's newest bucket
+// is left out of that tier only; the mean is exact to the cent over 360-sample buckets and
+// whole windows; a query and its answer survive the frame encoding as the sketch and
+// link.c use it.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "archive.h"
+#include "frame.h"
+#include "check.h"
+
+#define DAY 86400U
+#define T0  1760000400U           // Start of a 2-hour bucket (and so of the finer ones)
+
+static ArchiveBucket store[ARCHIVE_BUCKETS];
+static Archive a;
+
+static void Check_Tiers(void) {
+    // 'inside': the window's first bucket is still in the ring, so the start is checked.
+    static const struct { uint32_t window_s, res_s; int inside; } cases[] = {
+        { 60, CFG_ARCHIVE_T0_BUCKET_S, 1 },
+        { 3600 + 30, CFG_ARCHIVE_T0_BUCKET_S, 1 },
+        { CFG_ARCHIVE_T0_BUCKETS * CFG_ARCHIVE_T0_BUCKET_S, CFG_ARCHIVE_T0_BUCKET_S, 0 },
+        { CFG_ARCHIVE_T0_BUCKETS * CFG_ARCHIVE_T0_BUCKET_S + 1, CFG_ARCHIVE_T1_BUCKET_S, 1 },
+        { CFG_ARCHIVE_T1_BUCKETS * CFG_ARCHIVE_T1_BUCKET_S, CFG_ARCHIVE_T1_BUCKET_S, 0 },
+        { CFG_ARCHIVE_T1_BUCKETS * CFG_ARCHIVE_T1_BUCKET_S + 1, CFG_ARCHIVE_T2_BUCKET_S, 1 },
+        { 365U * DAY, CFG_ARCHIVE_T2_BUCKET_S, 0 },       // Longer than any tier: the coarsest
+    };
+    ArchiveWindow w;
+    uint32_t i, t;
+    Archive_Init(&a, store);
+    CHECK(Archive_Query(&a, DAY, &w) == 0 && w.res_s == CFG_ARCHIVE_T0_BUCKET_S, "empty archive: %u samples",
+          w.count);
+    for (t = T0; t < T0 + 10U * DAY; t += 60)           // Ten days, one sample a minute
+        Archive_Add(&a, t, 100000 + (int32_t)((t - T0) / 60U));
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint32_t since = a.newest - cases[i].window_s;
+        Archive_Query(&a, cases[i].window_s, &w);
+        CHECK(w.res_s == cases[i].res_s, "window %u s answered at %u s, not %u", cases[i].window_s, w.res_s,
+              cases[i].res_s);
+        if (cases[i].inside)
+            CHECK(w.start == since - since % w.res_s, "window %u s starts at %u, not %u", cases[i].window_s,
+                  w.start, since - since % w.res_s);
+    }
+    Archive_Query(&a, DAY, &w);                          // The whole of tier 0: 1440 samples
+    CHECK(w.count == 1440 && w.close == 100000 + 14399 && w.open == 100000 + 14399 - 1439 && w.low == w.open &&
+          w.high == w.close, "24 h window: %u samples, open %d close %d", w.count, (int)w.open, (int)w.close);
+}
+
+static void Check_Gaps(void) {
+    ArchiveWindow w;
+    Archive_Init(&a, store);
+    Archive_Add(&a, T0, 500);
+    Archive_Add(&a, T0 + 3U * 60U, 700);                 // Two empty minutes between
+    Archive_Query(&a, 600, &w);
+    CHECK(w.count == 2 && w.open == 500 && w.close == 700 && w.mean == 600, "gap of two buckets: %u samples, "
+          "mean %d", w.count, (int)w.mean);
+
+    // More than a whole ring later: nothing older may show up in tier 0.
+    Archive_Add(&a, T0 + 3U * 60U + CFG_ARCHIVE_T0_BUCKETS * 60U + 1800U, 900);
+    Archive_Query(&a, DAY, &w);
+    CHECK(w.res_s == 60 && w.count == 1 && w.open == 900 && w.low == 900 && w.high == 900,
+          "gap longer than tier 0: %u samples, low %d", w.count, (int)w.low);
+    Archive_Query(&a, 7U * DAY, &w);                     // Tier 1 still holds all three
+    CHECK(w.res_s == 900 && w.count == 3 && w.low == 500 && w.high == 900, "tier 1 after the gap: %u samples",
+          w.count);
+
+    // Wrap tier 0 many times over with one sample per bucket; only the last day remains.
+    {
+        uint32_t t, start = T0 + 20U * DAY;
+        for (t = start; t < start + 5U * DAY; t += 60)
+            Archive_Add(&a, t, (int32_t)((t - start) / 60U));
+        Archive_Query(&a, DAY, &w);
+        CHECK(w.count == CFG_ARCHIVE_T0_BUCKETS + 1 || w.count == CFG_ARCHIVE_T0_BUCKETS,
+              "after five days: %u samples in 24 h", w.count);
+        CHECK(w.close == 5 * 1440 - 1 && w.low == w.close - (int32_t)w.count + 1, "after five days: %d..%d",
+              (int)w.low, (int)w.close);
+    }
+}
+
+static void Check_Out_Of_Order(void) {
+    ArchiveWindow w;
+    Archive_Init(&a, store);
+    Archive_Add(&a, T0 + 120 + 30, 300);
+    Archive_Add(&a, T0 + 120 + 10, 100);                 // Earlier, same minute: counted
+    Archive_Query(&a, 60, &w);
+    CHECK(w.count == 2 && w.mean == 200 && w.close == 100, "same bucket, earlier time: %u samples, close %d",
+          w.count, (int)w.close);
+    Archive_Add(&a, T0 + 30, 5000);                      // Two minutes older: not in tier 0
+    Archive_Add(&a, 0, 7000);                            // Clock not set: ignored everywhere
+    Archive_Query(&a, DAY, &w);
+    CHECK(w.count == 2 && w.high == 300, "older sample in tier 0: %u samples, high %d", w.count, (int)w.high);
+    Archive_Query(&a, 7U * DAY, &w);                     // Same 15-minute bucket: counted in tier 1
+    CHECK(w.count == 3 && w.high == 5000 && w.close == 5000, "older sample in tier 1: %u samples, high %d",
+          w.count, (int)w.high);
+    CHECK(a.samples == 3 && a.newest == T0 + 150, "%u samples accepted, newest %u", a.samples, a.newest);
+}
+
+static void Check_Mean(void) {
+    ArchiveWindow w;
+    uint32_t i;
+    int64_t sum = 100;
+    Archive_Init(&a, store);
+    // One 2-hour bucket: 100 then 359 ticks of 199 (20 s apart). The exact mean is 198.725.
+    Archive_Add(&a, T0, 100);
+    for (i = 1; i < 360; i++)
+        Archive_Add(&a, T0 + i * 20U, 199);
+    Archive_Query(&a, 30U * DAY, &w);
+    CHECK(w.res_s == 7200 && w.count == 360 && w.mean == 198, "360-sample bucket: mean %d, not 198",
+          (int)w.mean);
+    Archive_Query(&a, 7200, &w);
+    CHECK(w.res_s == 60 && w.count == 360 && w.mean == 198, "the same in 1-minute buckets: mean %d", (int)w.mean);
+
+    // A week of BTC-sized prices across all tiers, against the exact mean of what each window holds.
+    Archive_Init(&a, store);
+    for (i = 0; i < 7U * DAY / 20U; i++) {
+        int32_t cents = 9700000 + (int32_t)((i * 7919U) % 200000U) - 100000;
+        Archive_Add(&a, T0 + i * 20U, cents);
+        if (i >= 7U * DAY / 20U - 3U * 360U) {           // The last six hours
+            if (i == 7U * DAY / 20U - 3U * 360U)
+                sum = 0;
+            sum += cents;
+        }
+    }
+    Archive_Query(&a, 6U * 3600U - 20U, &w);
+    CHECK(w.count == 3U * 360U && w.mean == (int32_t)(sum / w.count), "six hours: %u samples, mean %d, exact %lld",
+          w.count, (int)w.mean, (long long)(sum / 1080));
+}
+
+// The TM4C's query, the sketch's answer (answerQuery) and link.c's decoding of it.
+static void Check_Query_Answer(void) {
+    static const uint32_t windows[] = { CFG_ARCHIVE_SHORT_WINDOW_S, CFG_ARCHIVE_LONG_WINDOW_S, 60, 90U * DAY };
+    char line[CFG_UART_BUFFER_SIZE + 1], tag;
+    const char *payload;
+    size_t len;
+    FrameQuery q = { 0, CFG_ASSET_BTC, 0 }, qb;
+    FrameWindow fw, got;
+    ArchiveWindow r;
+    uint32_t i, t;
+    Archive_Init(&a, store);
+    for (t = T0; t < T0 + 8U * DAY; t += 20)
+        Archive_Add(&a, t, 9700000 + (int32_t)((t / 20U * 2654435761U) >> 16) % 300000 - 150000);
+    for (i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+        q.id = (uint8_t)(200 + i);
+        q.window_s = windows[i];
+        CHECK(Frame_Encode_Query(line, sizeof(line), &q) && Frame_Open(line, &tag, &payload, &len) &&
+              tag == CFG_FRAME_QUERY && Frame_Decode_Query(payload, len, &qb) && qb.id == q.id &&
+              qb.asset == q.asset && qb.window_s == q.window_s, "query %s", line);
+
+        Archive_Query(&a, qb.window_s, &r);
+        memset(&fw, 0, sizeof(fw));
+        fw.id = qb.id;
+        fw.asset = qb.asset;
+        fw.window_s = qb.window_s;
+        fw.service_us = 1234;
+        fw.res_s = r.res_s;
+        fw.count = r.count;
+        fw.open = r.open;
+        fw.high = r.high;
+        fw.low = r.low;
+        fw.close = r.close;
+        fw.mean = r.mean;
+        memset(&got, 0x5A, sizeof(got));
+        CHECK(Frame_Encode_Window(line, sizeof(line), &fw) && strlen(line) <= FRAME_MAX_LEN &&
+              Frame_Open(line, &tag, &payload, &len) && tag == CFG_FRAME_WINDOW &&
+              Frame_Decode_Window(payload, len, &got), "window %u s: %s", windows[i], line);
+        CHECK(got.id == fw.id && got.asset == fw.asset && got.service_us == 1234 && got.window_s == fw.window_s &&
+              got.res_s == fw.res_s && got.count == fw.count && got.open == fw.open && got.high == fw.high &&
+              got.low == fw.low && got.close == fw.close && got.mean == fw.mean,
+              "window %u s: decoded differently from %s", windows[i], line);
+        CHECK(r.count > 0 && r.low <= r.mean && r.mean <= r.high, "window %u s: mean %d outside %d..%d",
+              windows[i], (int)r.mean, (int)r.low, (int)r.high);
+    }
+}
+
+int main(void) {
+    Check_Tiers();
+    Check_Gaps();
+    Check_Out_Of_Order();
+    Check_Mean();
+    Check_Query_Answer();
+    return Check_Done("archive");
+}
@@ -0,0 +1,27 @@
+//check.h
+// Assertions of the host tests in linux/*_test.c. A failed CHECK prints its location and
+// message and the test goes on; main() ends with Check_Done(), which prints the totals and
+// returns the exit status (1 if anything failed).
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static unsigned check_count, check_failed;
+
+#define CHECK(cond, ...) do {                                          \
+        check_count++;                                                 \
+        if (!(cond)) {                                                 \
+            check_failed++;                                            \
+            printf("%s:%d: FAIL %s: ", __FILE__, __LINE__, #cond);     \
+            printf(__VA_ARGS__);                                       \
+            printf("\n");                                              \
+        }                                                              \
+    } while (0)
+
+static int Check_Done(const char *name) {
+    printf("%s: %u checks, %u failed\n", name, check_count, check_failed);
+    return check_failed != 0;
+}
+
+#endif // CHECK_H
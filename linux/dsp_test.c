@@ -0,0 +1,223 @@
+//dsp_test.c
+// Host test of the history kernels (build/dsp.c) against naive loops: every length from 0 to
+// 67 (so both odd and even tails), arrays starting on and off a word boundary, and data at
+// the int16 and int32 extremes as well as random walks.
+//
+// Build and run (from the repository root), once with the plain C kernels and once with the
+// Cortex-M4 kernels over the shim's C versions of the DSP intrinsics (qemu/TM4C123GH6PM.h):
+//   cc -O2 -Wall -Ibuild -o dsp_test linux/dsp_test.c build/dsp.c && ./dsp_test
+//   cc -O2 -Wall -Iqemu -Ibuild -DDSP_USE_SIMD=1 -DDSP_BENCHMARK -o dsp_test linux/dsp_test.c
+//      build/dsp.c && ./dsp_test [-b]
+//
+// -b (DSP_BENCHMARK builds) runs Dsp_Benchmark() with the cycle counter read as host
+// nanoseconds. It only shows that the benchmark runs; the cycle counts come from the board
+// (feed_decode.py --dsp).
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dsp.h"
+#include "check.h"
+
+#define MAX_N    67U
+#define PATTERNS 6U
+
+static int16_t data[MAX_N + 2] __attribute__((aligned(4)));
+static int16_t out[MAX_N + 2] __attribute__((aligned(4)));
+static int16_t col_min[MAX_N * 2], col_max[MAX_N * 2];
+static uint32_t rng = 1;
+
+static uint32_t Rand(void) {
+    rng = rng * 1664525U + 1013904223U;
+    return rng;
+}
+
+// Fill x[0..n-1] with pattern k: the int16 extremes in blocks and alternating, small and
+// full-range random values, and a random walk like a block of price deltas.
+static void Fill(int16_t *x, uint32_t n, uint32_t k) {
+    uint32_t i;
+    int32_t v = 0;
+    for (i = 0; i < n; i++) {
+        switch (k) {
+        case 0: x[i] = 32767; break;
+        case 1: x[i] = -32768; break;
+        case 2: x[i] = (i & 1U) ? 32767 : -32768; break;
+        case 3: x[i] = (int16_t)(Rand() >> 16); break;
+        case 4: x[i] = (int16_t)((int32_t)(Rand() >> 28) - 8); break;
+        default:
+            v += (int32_t)(Rand() >> 25) - 64;
+            x[i] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+        }
+    }
+}
+
+static int16_t Ref_Sat16(int32_t v) {
+    return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+static void Check_Sums(const int16_t *x, uint32_t n, const char *what) {
+    int64_t sum = 0;
+    uint64_t sq = 0;
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        sum += x[i];
+        sq += (uint64_t)((int64_t)x[i] * x[i]);
+    }
+    CHECK(Dsp_Sum16(x, n) == sum, "%s n %u: sum %d, want %lld", what, n, Dsp_Sum16(x, n), (long long)sum);
+    CHECK(Dsp_SumSquares16(x, n) == sq, "%s n %u: sum of squares %llu, want %llu", what, n,
+          (unsigned long long)Dsp_SumSquares16(x, n), (unsigned long long)sq);
+}
+
+static void Check_MinMax(const int16_t *x, uint32_t n, const char *what) {
+    int16_t lo = x[0], hi = x[0], got_lo = 1, got_hi = -1;
+    uint32_t i;
+    for (i = 1; i < n; i++) {
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+    }
+    Dsp_MinMax16(x, n, &got_lo, &got_hi);
+    CHECK(got_lo == lo && got_hi == hi, "%s n %u: min/max %d/%d, want %d/%d", what, n, got_lo, got_hi, lo, hi);
+}
+
+// Every alignment of input and output against each other.
+static void Check_Offset(const int16_t *x, uint32_t n, const char *what) {
+    static const int16_t offsets[] = { 0, 1, -1, 12345, 32767, -32768 };
+    uint32_t i, j, o;
+    for (o = 0; o < 2; o++) {
+        for (j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+            int bad = 0;
+            memset(out, 0x5A, sizeof(out));
+            Dsp_Offset16(x, n, offsets[j], out + o);
+            for (i = 0; i < n; i++)
+                bad += out[o + i] != Ref_Sat16((int32_t)x[i] + offsets[j]);
+            bad += out[o + n] != 0x5A5A;          // Nothing written past the end
+            CHECK(bad == 0, "%s n %u: offset %d into out+%u, %d wrong", what, n, offsets[j], o, bad);
+        }
+    }
+}
+
+static void Check_Mean(const int16_t *x, uint32_t n, const char *what) {
+    uint32_t w, i, got;
+    for (w = 0; w <= n + 1; w++) {
+        int bad = 0;
+        got = Dsp_WindowMean16(x, n, w, out);
+        if (w == 0 || w > n) {
+            CHECK(got == 0, "%s n %u: window %u gave %u outputs", what, n, w, got);
+            continue;
+        }
+        CHECK(got == n - w + 1, "%s n %u: window %u gave %u outputs", what, n, w, got);
+        for (i = 0; i + w <= n; i++) {
+            int64_t s = 0;
+            uint32_t k;
+            for (k = 0; k < w; k++)
+                s += x[i + k];
+            s = s >= 0 ? s / w : -((-s + w - 1) / w);   // Floor
+            bad += out[i] != s;
+        }
+        CHECK(bad == 0, "%s n %u: window %u, %d means wrong", what, n, w, bad);
+    }
+}
+
+static void Check_Resample(const int16_t *x, uint32_t n, const char *what) {
+    static const uint32_t widths[] = { 1, 2, 3, 7, 32, 101 };
+    uint32_t j, c, i;
+    for (j = 0; j < sizeof(widths) / sizeof(widths[0]); j++) {
+        uint32_t width = widths[j];
+        int bad = 0;
+        Dsp_Resample16(x, n, width, col_min, col_max);
+        for (c = 0; c < width; c++) {           // Column c: samples [c*n/width, (c+1)*n/width), at least one
+            uint32_t s = c * n / width, e = (c + 1) * n / width;
+            int16_t lo, hi;
+            if (e <= s)
+                e = s + 1;
+            lo = hi = x[s];
+            for (i = s + 1; i < e; i++) {
+                if (x[i] < lo) lo = x[i];
+                if (x[i] > hi) hi = x[i];
+            }
+            bad += col_min[c] != lo || col_max[c] != hi;
+        }
+        CHECK(bad == 0, "%s n %u: width %u, %d columns wrong", what, n, width, bad);
+    }
+}
+
+static void Check_32(void) {
+    static int32_t x[MAX_N];
+    uint32_t n, i, k;
+    for (k = 0; k < 3; k++) {
+        for (i = 0; i < MAX_N; i++)
+            x[i] = k == 0 ? INT32_MAX : k == 1 ? INT32_MIN : (int32_t)Rand();
+        for (n = 1; n <= MAX_N; n++) {
+            int64_t sum = 0;
+            int32_t lo = x[0], hi = x[0], got_lo, got_hi;
+            for (i = 0; i < n; i++) {
+                sum += x[i];
+                if (x[i] < lo) lo = x[i];
+                if (x[i] > hi) hi = x[i];
+            }
+            Dsp_MinMax32(x, n, &got_lo, &got_hi);
+            CHECK(Dsp_Sum32(x, n) == sum, "int32 pattern %u n %u: sum", k, n);
+            CHECK(got_lo == lo && got_hi == hi, "int32 pattern %u n %u: min/max", k, n);
+        }
+    }
+}
+
+#ifdef DSP_BENCHMARK
+uint32_t Cycles_Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+static void Benchmark(void) {
+    DspBench b;
+    Dsp_Benchmark(&b);
+    printf("benchmark over %u samples (host ns, kernel / plain C): sum %u/%u, min/max %u/%u, "
+           "mean %u/%u, resample %u/%u\n", b.samples, b.sum_simd, b.sum_scalar, b.minmax_simd,
+           b.minmax_scalar, b.mean_simd, b.mean_scalar, b.resample_simd, b.resample_scalar);
+}
+#endif
+
+int main(int argc, char **argv) {
+    static int16_t big[65536] __attribute__((aligned(4)));
+    char what[48];
+    uint32_t k, n, a;
+
+    printf("dsp kernels: %s\n", DSP_USE_SIMD ? "Cortex-M4 (shim intrinsics)" : "plain C");
+    for (k = 0; k < PATTERNS; k++) {
+        for (a = 0; a < 2; a++) {               // a = 1: the array starts half a word in
+            Fill(data, MAX_N + 1, k);
+            for (n = 0; n <= MAX_N; n++) {
+                snprintf(what, sizeof(what), "pattern %u start %u", k, a);
+                Check_Sums(data + a, n, what);
+                Check_Offset(data + a, n, what);
+                Check_Mean(data + a, n, what);
+                if (n == 0)
+                    continue;
+                Check_MinMax(data + a, n, what);
+                Check_Resample(data + a, n, what);
+            }
+        }
+    }
+
+    // Sum16 is exact up to 65536 samples, also at the extremes.
+    for (k = 0; k < 2; k++) {
+        for (n = 0; n < 65536; n++)
+            big[n] = k ? -32768 : 32767;
+        CHECK(Dsp_Sum16(big, 65536) == (k ? INT32_MIN : 65536 * 32767), "65536 x %d", big[0]);
+        CHECK(Dsp_Sum16(big + 1, 65535) == (k ? -32768 * 65535 : 32767 * 65535), "65535 x %d, off a word",
+              big[0]);
+    }
+    Check_32();
+
+#ifdef DSP_BENCHMARK
+    if (argc > 1 && strcmp(argv[1], "-b") == 0)
+        Benchmark();
+#else
+    (void)argv;
+#endif
+    (void)argc;
+    return Check_Done("dsp");
+}
@@ -0,0 +1,158 @@
+//encoder_test.c
+// Host test of the rotary encoder (build/encoder.c) against a model of QEI0 in the board
+// shim: the test moves POS by the edges the knob makes and sets SPEED to the edges of the
+// last velocity period, as the hardware does.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Iqemu -Ibuild -o encoder_test linux/encoder_test.c build/encoder.c qemu/board.c && ./encoder_test
+//
+// Register level: partial detents carry over between reads in both directions, a negative
+// partial detent truncates toward zero (and its remainder is kept), POS wrapping past 2^32
+// makes no difference, and each step is selected from exactly the SPEED its configured
+// detents per second give. Turning: the knob is turned at a steady rate for 20 s, one detent
+// being four edges 2 ms apart, with SPEED latched every velocity period and Encoder_Read()
+// polled every input_poll_ms as the selection loop does; most detents must get the step of
+// that rate.
+#include <stdint.h>
+#include <stdio.h>
+
+#include "tracker.h"
+#include "encoder.h"
+#include "check.h"
+
+#define CPD   ((int32_t)CFG_ENCODER_COUNTS_PER_DETENT)
+
+// Lowest SPEED (edges per velocity period) at which 'dps' detents per second are reached.
+#define SPEED_FOR(dps) (((dps) * CFG_ENCODER_COUNTS_PER_DETENT * CFG_ENCODER_VELOCITY_MS + 999U) / 1000U)
+
+static void Turn(int32_t edges, uint32_t speed) {
+    QEI0->POS += (uint32_t)edges;
+    QEI0->SPEED = speed;
+}
+
+static void Check_Carry(void) {
+    int32_t step = CFG_ENCODER_FINE_STEP, k, sum;
+
+    Encoder_Init();
+    Turn(CPD - 1, 0);
+    CHECK(Encoder_Read() == 0, "3/4 detent reads 0");
+    Turn(1, 0);
+    CHECK(Encoder_Read() == step, "the last edge completes the detent");
+    CHECK(Encoder_Read() == 0, "nothing left over");
+
+    Turn(2 * CPD + 1, 0);
+    CHECK(Encoder_Read() == 2 * step, "2 1/4 detents read 2");
+    Turn(CPD - 1, 0);
+    CHECK(Encoder_Read() == step, "the carried quarter completes the third");
+
+    // Counter-clockwise: a partial detent truncates toward zero and is kept, signed.
+    Encoder_Init();
+    Turn(-(CPD - 1), 0);
+    CHECK(Encoder_Read() == 0, "-3/4 detent reads 0, not -1");
+    Turn(-1, 0);
+    CHECK(Encoder_Read() == -step, "the last edge completes -1");
+    Turn(-(CPD + 1), 0);
+    CHECK(Encoder_Read() == -step, "-1 1/4 reads -1");
+    Turn(1, 0);
+    CHECK(Encoder_Read() == 0, "the carried -1/4 is cancelled by one edge back");
+    Turn(CPD - 1, 0);
+    CHECK(Encoder_Read() == 0, "3/4 forward after the cancel is still partial");
+    Turn(1, 0);
+    CHECK(Encoder_Read() == step, "a full detent forward");
+
+    // Back and forth within a detent never moves the threshold.
+    Encoder_Init();
+    for (k = 0, sum = 0; k < 100; k++) {
+        Turn((k & 1) ? -(CPD - 1) : CPD - 1, 0);
+        sum += Encoder_Read();
+    }
+    CHECK(sum == 0, "jitter within a detent moved the threshold by %d", sum);
+
+    // POS is free-running: reads across its wrap-around see the difference only.
+    Encoder_Init();
+    Turn(-CPD, 0);                             // POS at 2^32 - CPD
+    CHECK(Encoder_Read() == -step, "a detent back from 0");
+    Turn(CPD + 1, 0);
+    CHECK(Encoder_Read() == step, "a detent forward across the POS wrap");
+    Turn(-(2 * CPD + 1), 0);
+    CHECK(Encoder_Read() == -2 * step, "back across the wrap with the carried edge");
+}
+
+static void Check_Steps(void) {
+    static const struct { uint32_t speed; int32_t step; const char *what; } cases[] = {
+        { 0, CFG_ENCODER_FINE_STEP, "still" },
+        { SPEED_FOR(CFG_ENCODER_MID_SPEED) - 1U, CFG_ENCODER_FINE_STEP, "just under mid_speed" },
+        { SPEED_FOR(CFG_ENCODER_MID_SPEED), CFG_ENCODER_MID_STEP, "at mid_speed" },
+        { SPEED_FOR(CFG_ENCODER_FAST_SPEED) - 1U, CFG_ENCODER_MID_STEP, "just under fast_speed" },
+        { SPEED_FOR(CFG_ENCODER_FAST_SPEED), CFG_ENCODER_COARSE_STEP, "at fast_speed" },
+        { 0xFFFFU, CFG_ENCODER_COARSE_STEP, "flat out" },
+    };
+    uint32_t i;
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Encoder_Init();
+        Turn(3 * CPD, cases[i].speed);
+        CHECK(Encoder_Read() == 3 * cases[i].step, "%s (SPEED %u): want %d per detent", cases[i].what,
+              cases[i].speed, cases[i].step);
+        Turn(-CPD, cases[i].speed);
+        CHECK(Encoder_Read() == -cases[i].step, "%s counter-clockwise", cases[i].what);
+    }
+    // SPEED only matters once a detent is complete: a partial detent at any speed reads 0.
+    Encoder_Init();
+    Turn(CPD - 1, 0xFFFFU);
+    CHECK(Encoder_Read() == 0, "fast partial detent");
+}
+
+// Turn at 'dps' detents per second for 20 s; returns the share of detents read with 'step'.
+static double Turn_Steady(double dps, int32_t step) {
+    uint32_t t, edges = 0, total = 0, detents = 0, right = 0, next_edge = 0, pending = 0, d;
+    double next_click = 0.0;
+    Encoder_Init();
+    QEI0->SPEED = 0;
+    for (t = 0; t < 20000U; t++) {
+        if (t >= next_click) {
+            pending += CPD;                    // A click: CPD edges, 2 ms apart
+            next_click += 1000.0 / dps;
+        }
+        if (pending && t >= next_edge) {
+            QEI0->POS++;
+            edges++;
+            total++;
+            pending--;
+            next_edge = t + 2U;
+        }
+        if ((t + 1U) % CFG_ENCODER_VELOCITY_MS == 0) {
+            QEI0->SPEED = edges;
+            edges = 0;
+        }
+        if (t % CFG_INPUT_POLL_MS == 0) {
+            int32_t v = Encoder_Read();
+            d = total / CPD - detents;         // Detents completed since the last read
+            if (d && v == (int32_t)d * step)
+                right += d;
+            detents += d;
+        }
+    }
+    return detents ? (double)right / detents : 0.0;
+}
+
+static void Check_Turning(void) {
+    static const struct { double dps; int32_t step; } turns[] = {
+        { CFG_ENCODER_MID_SPEED / 2.0, CFG_ENCODER_FINE_STEP },
+        { (CFG_ENCODER_MID_SPEED + CFG_ENCODER_FAST_SPEED) / 2.0, CFG_ENCODER_MID_STEP },
+        { CFG_ENCODER_FAST_SPEED * 2.0, CFG_ENCODER_COARSE_STEP },
+    };
+    uint32_t i;
+    for (i = 0; i < sizeof(turns) / sizeof(turns[0]); i++) {
+        double share = Turn_Steady(turns[i].dps, turns[i].step);
+        printf("  %5.1f detents/s: %3.0f%% of detents at %d USD\n", turns[i].dps, share * 100.0, turns[i].step);
+        CHECK(share >= 0.8, "%.1f detents/s: only %.0f%% of detents at %d USD", turns[i].dps, share * 100.0,
+              turns[i].step);
+    }
+}
+
+int main(void) {
+    Check_Carry();
+    Check_Steps();
+    Check_Turning();
+    return Check_Done("encoder");
+}
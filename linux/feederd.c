@@ -0,0 +1,757 @@
+//feederd.c
+// Linux feeder daemon: fetches prices for many assets from one or more HTTP(S) providers and
+// writes TM4C price lines (the same ones the ESP32 sends) to serial ports or ptys, for
+// displays wired straight to a server.
+//
+// Build (from the repository root):
+//   cc -O2 -Wall -Ibuild -o feederd linux/feederd.c build/fetch.c build/plan.c
+//   cc -O2 -Wall -Ibuild -DFEEDERD_TLS -o feederd linux/feederd.c build/fetch.c build/plan.c -lssl -lcrypto
+//
+// Usage:
+//   feederd [-i min_age_ms] [-b ids_per_request] [-t timeout_ms] [-s stats_s]
+//           -u provider_url [-r limit/window_s[:ids]] -a id[@threshold][,...] [-u provider_url ...]
+//           [-o /dev/ttyUSB0[=id]] [-P id]
+//
+//   -u  /simple/price style URL ending in "ids=" (default CFG_PROTO_SIMPLE_URL); every -r and -a
+//       after it belongs to that provider. Without FEEDERD_TLS only http:// works.
+//   -r  the provider's request limit (default [plan] in tracker_config.cfg) and ids per request
+//   -a  assets the provider serves; an asset listed under several providers may be fetched
+//       from any of them. '@threshold' marks a price whose neighbourhood is watched closely.
+//   -i  shortest refresh interval of an asset (default [plan] min_age_ms)
+//   -o  serial port or existing pty; gets the price line of 'id' (default: the first asset)
+//   -P  create a pty for asset 'id' and print its slave path
+//
+// What to fetch, and from where, is decided by the rate-budget planner (build/plan.h): it packs
+// the most urgent assets into one request for a provider that has budget left, favouring
+// volatile assets and assets near their threshold. Everything runs in one epoll loop: each
+// request is a non-blocking connection, and each output has a byte queue drained on EPOLLOUT,
+// so a slow port never delays fetching. Statistics (per-asset freshness and fetch latency,
+// per-provider budget use, frames written, queue depth) go to stderr every -s seconds and on
+// SIGUSR1.
+//
+// tools/feederd_test.py builds feederd and checks it against stand-in providers on localhost.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef FEEDERD_TLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+#include "tracker_config.h"
+#include "fetch.h"
+#include "plan.h"
+
+#define MAX_PROVIDERS PLAN_MAX_PROVIDERS
+#define MAX_ASSETS    1024
+#define MAX_BATCHES   64          // Requests in flight at once
+#define MAX_OUTPUTS   64
+#define OUT_QUEUE     8192        // Bytes queued per output before lines are dropped
+#define RESP_MAX      (1 << 20)   // Largest accepted HTTP response
+
+enum { EV_CONN, EV_OUTPUT };
+enum { C_IDLE, C_CONNECTING, C_HANDSHAKE, C_SENDING, C_RECEIVING };
+
+typedef struct {
+    char url[512];                // Prefix; the ids are appended
+    char host[256];
+    char port[8];
+    char path[512];
+    int tls;
+    struct sockaddr_storage addr; // Resolved once at startup
+    socklen_t addrlen;
+    uint32_t limit, window_ms;    // Request budget (-r)
+    int max_ids;
+} Provider;
+
+typedef struct {
+    char id[64];
+    double price, change;
+    uint64_t fetches, errors;
+    double lat_last, lat_max, lat_sum;  // Milliseconds
+} Asset;
+
+typedef struct {
+    int kind;                     // EV_CONN (first member: epoll data points here)
+    PlanBatch plan;               // Provider and assets of the request
+    int state;                    // C_*
+    int fd;
+#ifdef FEEDERD_TLS
+    SSL *ssl;
+#endif
+    char req[4096];
+    size_t req_len, req_sent;
+    char *resp;
+    size_t resp_len, resp_cap;
+    double t_start;               // Monotonic ms
+} Batch;
+
+typedef struct {
+    int kind;                     // EV_OUTPUT
+    char path[256];
+    int fd;
+    int asset;
+    int pty;
+    char q[OUT_QUEUE];
+    size_t q_head, q_len;         // Ring buffer
+    size_t q_max;                 // Deepest the queue has been
+    uint64_t frames, bytes, dropped;
+} Output;
+
+static Provider providers[MAX_PROVIDERS];
+static int n_providers;
+static Asset assets[MAX_ASSETS];
+static int n_assets;
+static Batch batches[MAX_BATCHES];
+static Output outputs[MAX_OUTPUTS];
+static int n_outputs;
+static Plan plan;
+static PlanAsset plan_assets[MAX_ASSETS];
+static uint16_t plan_order[MAX_ASSETS];
+static uint32_t plan_start;       // Plan clock at startup
+
+static int epfd;
+static int min_age_ms = CFG_PLAN_MIN_AGE_MS;
+static int batch_ids = CFG_PLAN_MAX_IDS;
+static int timeout_ms = 10000;
+static int stats_s = 10;
+static volatile sig_atomic_t want_stats;
+#ifdef FEEDERD_TLS
+static SSL_CTX *tls_ctx;
+#endif
+
+static double Now_Ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// The planner's clock: milliseconds, wrapping.
+static uint32_t Plan_Ms(void) {
+    return (uint32_t)(uint64_t)Now_Ms();
+}
+
+static void Die(const char *what) {
+    perror(what);
+    exit(1);
+}
+
+// Providers
+
+static int Provider_Add(const char *url) {
+    Provider *p;
+    const char *h, *slash, *colon;
+    struct addrinfo hints, *res;
+    if (n_providers == MAX_PROVIDERS) {
+        fprintf(stderr, "feederd: too many providers\n");
+        exit(2);
+    }
+    p = &providers[n_providers];
+    snprintf(p->url, sizeof(p->url), "%s", url);
+    if (strncmp(url, "http://", 7) == 0) {
+        h = url + 7;
+        p->tls = 0;
+    } else if (strncmp(url, "https://", 8) == 0) {
+        h = url + 8;
+        p->tls = 1;
+#ifndef FEEDERD_TLS
+        fprintf(stderr, "feederd: %s needs TLS; rebuild with -DFEEDERD_TLS\n", url);
+        exit(2);
+#endif
+    } else {
+        fprintf(stderr, "feederd: unsupported URL %s\n", url);
+        exit(2);
+    }
+    slash = strchr(h, '/');
+    if (slash == NULL)
+        slash = h + strlen(h);
+    colon = memchr(h, ':', (size_t)(slash - h));
+    snprintf(p->host, sizeof(p->host), "%.*s", (int)((colon ? colon : slash) - h), h);
+    snprintf(p->port, sizeof(p->port), "%.*s", colon ? (int)(slash - colon - 1) : 3,
+             colon ? colon + 1 : (p->tls ? "443" : "80"));
+    snprintf(p->path, sizeof(p->path), "%s", *slash ? slash : "/");
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(p->host, p->port, &hints, &res) != 0) {
+        fprintf(stderr, "feederd: cannot resolve %s\n", p->host);
+        exit(2);
+    }
+    memcpy(&p->addr, res->ai_addr, res->ai_addrlen);
+    p->addrlen = res->ai_addrlen;
+    freeaddrinfo(res);
+    p->limit = CFG_PLAN_LIMIT;
+    p->window_ms = CFG_PLAN_WINDOW_S * 1000U;
+    p->max_ids = 0;                               // -b unless -r says otherwise
+    return n_providers++;
+}
+
+// -r limit/window_s[:ids] for the last provider.
+static void Provider_Budget(int provider, const char *spec) {
+    Provider *p = &providers[provider];
+    double window_s = 0;
+    int limit = 0, ids = 0;
+    if (sscanf(spec, "%d/%lf:%d", &limit, &window_s, &ids) < 2 || limit <= 0 || window_s <= 0) {
+        fprintf(stderr, "feederd: bad budget %s (limit/window_s[:ids])\n", spec);
+        exit(2);
+    }
+    p->limit = (uint32_t)limit;
+    p->window_ms = (uint32_t)(window_s * 1000.0);
+    p->max_ids = ids;
+}
+
+static int Asset_Lookup(const char *id) {
+    int i;
+    for (i = 0; i < n_assets; i++)
+        if (strcmp(assets[i].id, id) == 0)
+            return i;
+    return -1;
+}
+
+static int Asset_Find(const char *id) {
+    int i = Asset_Lookup(id);
+    if (i < 0) {
+        fprintf(stderr, "feederd: unknown asset %s\n", id);
+        exit(2);
+    }
+    return i;
+}
+
+// Assets of -a for 'provider'. The plan is set up before the options are read, so the
+// assets can be registered with it as they come.
+static void Assets_Add(const char *list, int provider) {
+    char *buf = strdup(list), *tok, *save, *at;
+    int a;
+    if (buf == NULL)
+        Die("strdup");
+    for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        at = strchr(tok, '@');
+        if (at)
+            *at++ = '\0';
+        a = Asset_Lookup(tok);
+        if (a < 0) {
+            if (n_assets == MAX_ASSETS) {
+                fprintf(stderr, "feederd: too many assets\n");
+                exit(2);
+            }
+            a = n_assets++;
+            snprintf(assets[a].id, sizeof(assets[a].id), "%s", tok);
+        }
+        plan_assets[a].providers |= 1UL << provider;
+        if (at)
+            plan_assets[a].threshold = (float)atof(at);
+    }
+    free(buf);
+}
+
+// Register the providers with the planner once their budgets are known.
+static void Plan_Setup(void) {
+    int i;
+    for (i = 0; i < n_providers; i++) {
+        Provider *p = &providers[i];
+        int ids = p->max_ids ? p->max_ids : batch_ids;
+        Plan_Provider(&plan, p->limit, p->window_ms, (uint16_t)(ids < PLAN_MAX_IDS ? ids : PLAN_MAX_IDS),
+                      0, CFG_PLAN_PCT, Plan_Ms());
+    }
+    plan.n_assets = (uint16_t)n_assets;
+    plan.policy.min_age_ms = (uint32_t)min_age_ms;
+}
+
+// Build the HTTP request of a planned batch. Returns 0 if the ids do not fit.
+static int Batch_Request(Batch *b) {
+    const Provider *p = &providers[b->plan.provider];
+    size_t len = (size_t)snprintf(b->req, sizeof(b->req), "GET %s", p->path);
+    int j;
+    for (j = 0; j < b->plan.n && len < sizeof(b->req); j++)
+        len += (size_t)snprintf(b->req + len, sizeof(b->req) - len, "%s%s", j ? "," : "", assets[b->plan.asset[j]].id);
+    if (len < sizeof(b->req))
+        len += (size_t)snprintf(b->req + len, sizeof(b->req) - len,
+                                " HTTP/1.0\r\nHost: %s\r\nUser-Agent: feederd\r\nAccept: application/json\r\n\r\n",
+                                p->host);
+    if (len >= sizeof(b->req))
+        return 0;
+    b->req_len = len;
+    return 1;
+}
+
+// Outputs
+
+static speed_t Baud_Code(unsigned baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    default: return B115200;
+    }
+}
+
+static void Output_Register(Output *o) {
+    struct epoll_event ev;
+    struct termios tio;
+    if (tcgetattr(o->fd, &tio) == 0) {            // Serial port or pty: raw bytes at the link rate.
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, Baud_Code(CFG_UART_BAUD));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(o->fd, TCSANOW, &tio);
+    }
+    o->kind = EV_OUTPUT;
+    ev.events = 0;                                // EPOLLOUT only while data is queued.
+    ev.data.ptr = o;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, o->fd, &ev) < 0)
+        Die("epoll_ctl output");
+}
+
+static Output *Output_New(void) {
+    if (n_outputs == MAX_OUTPUTS) {
+        fprintf(stderr, "feederd: too many outputs\n");
+        exit(2);
+    }
+    return &outputs[n_outputs++];
+}
+
+static void Output_Open(const char *spec) {
+    Output *o = Output_New();
+    const char *eq = strchr(spec, '=');
+    snprintf(o->path, sizeof(o->path), "%.*s", (int)(eq ? eq - spec : (long)strlen(spec)), spec);
+    o->asset = eq ? Asset_Find(eq + 1) : 0;
+    o->fd = open(o->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (o->fd < 0)
+        Die(o->path);
+    Output_Register(o);
+}
+
+static void Output_Pty(const char *id) {
+    Output *o = Output_New();
+    o->asset = Asset_Find(id);
+    o->pty = 1;
+    o->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (o->fd < 0 || grantpt(o->fd) < 0 || unlockpt(o->fd) < 0)
+        Die("posix_openpt");
+    snprintf(o->path, sizeof(o->path), "%s", ptsname(o->fd));
+    if (open(o->path, O_RDWR | O_NOCTTY | O_CLOEXEC) < 0)  // Hold the slave open: no EPOLLHUP spin while
+        Die(o->path);                                      // no reader is attached.
+    printf("%s %s\n", id, o->path);
+    fflush(stdout);
+    Output_Register(o);
+}
+
+static void Output_Arm(Output *o, int want_out) {
+    struct epoll_event ev;
+    ev.events = want_out ? EPOLLOUT : 0;
+    ev.data.ptr = o;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, o->fd, &ev);
+}
+
+// Write as much of the queue as the port takes.
+static void Output_Drain(Output *o) {
+    while (o->q_len) {
+        size_t chunk = o->q_len;
+        ssize_t n;
+        if (o->q_head + chunk > OUT_QUEUE)
+            chunk = OUT_QUEUE - o->q_head;
+        n = write(o->fd, o->q + o->q_head, chunk);
+        if (n <= 0)
+            break;                                // EAGAIN (or a vanished pty reader): retry on EPOLLOUT.
+        o->q_head = (o->q_head + (size_t)n) % OUT_QUEUE;
+        o->q_len -= (size_t)n;
+        o->bytes += (uint64_t)n;
+    }
+    Output_Arm(o, o->q_len != 0);
+}
+
+static void Output_Line(Output *o, const char *line, size_t len) {
+    size_t tail, i;
+    if (o->q_len + len > OUT_QUEUE) {
+        o->dropped++;                             // Port not keeping up: drop whole lines only.
+        return;
+    }
+    tail = (o->q_head + o->q_len) % OUT_QUEUE;
+    for (i = 0; i < len; i++)
+        o->q[(tail + i) % OUT_QUEUE] = line[i];
+    o->q_len += len;
+    if (o->q_len > o->q_max)
+        o->q_max = o->q_len;
+    o->frames++;
+    Output_Drain(o);
+}
+
+static void Asset_Updated(int a) {
+    char line[CFG_UART_BUFFER_SIZE];
+    size_t len = Fetch_Format_Price(line, sizeof(line), assets[a].price, assets[a].change,
+                                    (unsigned long)time(NULL));
+    int i;
+    if (len == 0)
+        return;
+    for (i = 0; i < n_outputs; i++)
+        if (outputs[i].asset == a)
+            Output_Line(&outputs[i], line, len);
+}
+
+// HTTP requests
+
+static void Conn_Close(Batch *b) {
+#ifdef FEEDERD_TLS
+    if (b->ssl) {
+        SSL_free(b->ssl);
+        b->ssl = NULL;
+    }
+#endif
+    if (b->fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, b->fd, NULL);
+        close(b->fd);
+        b->fd = -1;
+    }
+    b->state = C_IDLE;
+}
+
+// The batch is over: 'status' is the HTTP status (0: no answer), 'retry_ms' a 429's Retry-After.
+static void Conn_Fail_Status(Batch *b, int status, uint32_t retry_ms) {
+    int i;
+    for (i = 0; i < b->plan.n; i++) {
+        assets[b->plan.asset[i]].errors++;
+        Plan_Failed(&plan, b->plan.asset[i]);
+    }
+    Plan_Answered(&plan, &b->plan, status, retry_ms, Plan_Ms());
+    Conn_Close(b);
+}
+
+static void Conn_Fail(Batch *b) {
+    Conn_Fail_Status(b, 0, 0);
+}
+
+static void Conn_Wait(Batch *b, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = b;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, b->fd, &ev);
+}
+
+static void Conn_Start(Batch *b) {
+    Provider *p = &providers[b->plan.provider];
+    struct epoll_event ev;
+    b->kind = EV_CONN;
+    if (!Batch_Request(b)) {
+        fprintf(stderr, "feederd: request too long; lower -b\n");
+        exit(2);
+    }
+    b->fd = socket(p->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (b->fd < 0) {
+        Conn_Fail(b);
+        return;
+    }
+    b->t_start = Now_Ms();
+    b->req_sent = 0;
+    b->resp_len = 0;
+    b->state = C_CONNECTING;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = b;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, b->fd, &ev);
+    if (connect(b->fd, (struct sockaddr *)&p->addr, p->addrlen) < 0 && errno != EINPROGRESS)
+        Conn_Fail(b);
+}
+
+// Response complete: check the status, then parse every asset of the batch.
+static void Conn_Done(Batch *b) {
+    double lat = Now_Ms() - b->t_start;
+    uint32_t now = Plan_Ms();
+    char *body, *retry;
+    int status = 0, i;
+    if (b->resp_len == 0 || sscanf(b->resp, "HTTP/%*d.%*d %d", &status) != 1 || status != 200 ||
+        (body = strstr(b->resp, "\r\n\r\n")) == NULL) {
+        retry = status == 429 ? strcasestr(b->resp, "\r\nRetry-After:") : NULL;
+        Conn_Fail_Status(b, status, retry ? (uint32_t)atoi(retry + 14) * 1000U : 0);
+        return;
+    }
+    body += 4;
+    for (i = 0; i < b->plan.n; i++) {
+        int k = b->plan.asset[i];
+        Asset *a = &assets[k];
+        if (!Fetch_Parse_Simple(body, (size_t)(b->resp + b->resp_len - body), a->id, &a->price, &a->change)) {
+            a->errors++;
+            Plan_Failed(&plan, (uint16_t)k);
+            continue;
+        }
+        a->fetches++;
+        a->lat_last = lat;
+        a->lat_sum += lat;
+        if (lat > a->lat_max)
+            a->lat_max = lat;
+        Plan_Update(&plan, (uint16_t)k, (float)a->price, now);
+        Asset_Updated(k);
+    }
+    Plan_Answered(&plan, &b->plan, status, 0, now);
+    Conn_Close(b);
+}
+
+// Raw or TLS I/O: returns bytes moved, 0 on EOF, -1 on error, -2 when it would block
+// (the connection has then been re-armed for the direction TLS asked for).
+static ssize_t Conn_Io(Batch *b, char *buf, size_t len, int writing) {
+#ifdef FEEDERD_TLS
+    if (b->ssl) {
+        int n = writing ? SSL_write(b->ssl, buf, (int)len) : SSL_read(b->ssl, buf, (int)len);
+        int err;
+        if (n > 0)
+            return n;
+        err = SSL_get_error(b->ssl, n);
+        if (err == SSL_ERROR_WANT_READ) { Conn_Wait(b, EPOLLIN); return -2; }
+        if (err == SSL_ERROR_WANT_WRITE) { Conn_Wait(b, EPOLLOUT); return -2; }
+        return err == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+    }
+#endif
+    {
+        ssize_t n = writing ? write(b->fd, buf, len) : read(b->fd, buf, len);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            Conn_Wait(b, writing ? EPOLLOUT : EPOLLIN);
+            return -2;
+        }
+        return n;
+    }
+}
+
+static void Conn_Event(Batch *b) {
+    int err = 0;
+    socklen_t elen = sizeof(err);
+    ssize_t n;
+    if (b->state == C_CONNECTING) {
+        if (getsockopt(b->fd, SOL_SOCKET, SO_ERROR, &err, &elen) < 0 || err) {
+            Conn_Fail(b);
+            return;
+        }
+        b->state = C_SENDING;
+#ifdef FEEDERD_TLS
+        if (providers[b->plan.provider].tls) {
+            b->ssl = SSL_new(tls_ctx);
+            SSL_set_fd(b->ssl, b->fd);
+            SSL_set_tlsext_host_name(b->ssl, providers[b->plan.provider].host);
+            SSL_set1_host(b->ssl, providers[b->plan.provider].host);
+            b->state = C_HANDSHAKE;
+        }
+#endif
+    }
+#ifdef FEEDERD_TLS
+    if (b->state == C_HANDSHAKE) {
+        int r = SSL_connect(b->ssl);
+        if (r <= 0) {
+            int e = SSL_get_error(b->ssl, r);
+            if (e == SSL_ERROR_WANT_READ) Conn_Wait(b, EPOLLIN);
+            else if (e == SSL_ERROR_WANT_WRITE) Conn_Wait(b, EPOLLOUT);
+            else Conn_Fail(b);
+            return;
+        }
+        b->state = C_SENDING;
+    }
+#endif
+    while (b->state == C_SENDING) {
+        n = Conn_Io(b, b->req + b->req_sent, b->req_len - b->req_sent, 1);
+        if (n == -2)
+            return;
+        if (n <= 0) {
+            Conn_Fail(b);
+            return;
+        }
+        b->req_sent += (size_t)n;
+        if (b->req_sent == b->req_len) {
+            b->state = C_RECEIVING;
+            Conn_Wait(b, EPOLLIN);
+        }
+    }
+    while (b->state == C_RECEIVING) {
+        if (b->resp_cap - b->resp_len < 4096) {
+            char *grown;
+            if (b->resp_cap >= RESP_MAX) {
+                Conn_Fail(b);
+                return;
+            }
+            grown = realloc(b->resp, b->resp_cap ? b->resp_cap * 2 : 16384);
+            if (grown == NULL) {
+                Conn_Fail(b);
+                return;
+            }
+            b->resp = grown;
+            b->resp_cap = b->resp_cap ? b->resp_cap * 2 : 16384;
+        }
+        n = Conn_Io(b, b->resp + b->resp_len, b->resp_cap - b->resp_len - 1, 0);
+        if (n == -2)
+            return;
+        if (n < 0) {
+            Conn_Fail(b);
+            return;
+        }
+        if (n == 0) {                             // HTTP/1.0: the server closes after the body.
+            b->resp[b->resp_len] = '\0';
+            Conn_Done(b);
+            return;
+        }
+        b->resp_len += (size_t)n;
+    }
+}
+
+static void Conn_Timeouts(double now) {
+    int i;
+    for (i = 0; i < MAX_BATCHES; i++)
+        if (batches[i].state != C_IDLE && now - batches[i].t_start > timeout_ms)
+            Conn_Fail(&batches[i]);
+}
+
+// Start every request the planner has budget and due assets for, while connections are free.
+static void Plan_Run(void) {
+    int i;
+    for (i = 0; i < MAX_BATCHES; i++) {
+        if (batches[i].state != C_IDLE)
+            continue;
+        if (!Plan_Next(&plan, Plan_Ms(), &batches[i].plan))
+            break;
+        Conn_Start(&batches[i]);
+    }
+}
+
+// Statistics
+
+static void Stats_Print(int all) {
+    double lat_min = 1e12, lat_max = 0, lat_sum = 0, age_sum = 0;
+    uint64_t fetches = 0, errors = 0;
+    uint32_t now = Plan_Ms(), age_max = 0;
+    int i, with = 0;
+    for (i = 0; i < n_assets; i++) {
+        Asset *a = &assets[i];
+        const PlanAsset *f = &plan_assets[i];
+        uint32_t age = Plan_Mean_Age(&plan, (uint16_t)i, now);
+        fetches += a->fetches;
+        errors += a->errors;
+        age_sum += age;
+        if (f->age_max > age_max) age_max = f->age_max;
+        if (a->fetches) {
+            double mean = a->lat_sum / (double)a->fetches;
+            with++;
+            lat_sum += mean;
+            if (mean < lat_min) lat_min = mean;
+            if (a->lat_max > lat_max) lat_max = a->lat_max;
+        }
+        if (all)
+            fprintf(stderr, "  %-24s $%-12.2f %+6.2f%%  fetches %llu errors %llu  age mean %.1f max %.1f s  weight %.1f"
+                            "  latency last %.1f mean %.1f max %.1f ms\n",
+                    a->id, a->price, a->change, (unsigned long long)a->fetches, (unsigned long long)a->errors,
+                    age / 1000.0, f->age_max / 1000.0, Plan_Weight(&plan, (uint16_t)i),
+                    a->lat_last, a->fetches ? a->lat_sum / (double)a->fetches : 0.0, a->lat_max);
+    }
+    fprintf(stderr, "feederd: %d assets, %llu fetches, %llu errors, age mean %.1f s (max %.1f s), "
+                    "latency mean %.1f ms (best asset %.1f, worst %.1f max)\n",
+            n_assets, (unsigned long long)fetches, (unsigned long long)errors,
+            n_assets ? age_sum / n_assets / 1000.0 : 0.0, age_max / 1000.0,
+            with ? lat_sum / with : 0.0, with ? lat_min : 0.0, lat_max);
+    for (i = 0; i < plan.n_providers; i++) {
+        const PlanProvider *v = &plan.provider[i];
+        fprintf(stderr, "  %-40.40s %u/%.0fs  requests %u (%.1f ids each)  budget used %u%%  429 %u  failed %u\n",
+                providers[i].url, v->limit, v->window_ms / 1000.0, v->requests,
+                v->requests ? (double)v->ids / v->requests : 0.0, Plan_Budget_Used(&plan, (uint8_t)i, plan_start, now),
+                v->throttled, v->failed);
+    }
+    for (i = 0; i < n_outputs; i++) {
+        Output *o = &outputs[i];
+        fprintf(stderr, "  %-24s %-16s frames %llu bytes %llu dropped %llu queue %zu (max %zu)\n",
+                o->path, assets[o->asset].id, (unsigned long long)o->frames, (unsigned long long)o->bytes,
+                (unsigned long long)o->dropped, o->q_len, o->q_max);
+    }
+}
+
+static void On_Usr1(int sig) {
+    (void)sig;
+    want_stats = 1;
+}
+
+int main(int argc, char **argv) {
+    static const PlanPolicy policy = { CFG_PLAN_VOL_WEIGHT, CFG_PLAN_NEAR_WEIGHT, CFG_PLAN_NEAR_PCT, CFG_PLAN_MIN_AGE_MS };
+    struct epoll_event events[64];
+    double next_stats;
+    int provider = -1, opt, i;
+    const char *pending_out[MAX_OUTPUTS], *pending_pty[MAX_OUTPUTS];
+    int n_out = 0, n_pty = 0;
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGUSR1, On_Usr1);
+#ifdef FEEDERD_TLS
+    tls_ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_default_verify_paths(tls_ctx);
+    SSL_CTX_set_verify(tls_ctx, SSL_VERIFY_PEER, NULL);
+#endif
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0)
+        Die("epoll_create1");
+
+    plan_start = Plan_Ms();
+    Plan_Init(&plan, plan_assets, plan_order, MAX_ASSETS, &policy, plan_start);
+    while ((opt = getopt(argc, argv, "i:b:t:s:u:r:a:o:P:")) != -1) {
+        switch (opt) {
+        case 'i': min_age_ms = atoi(optarg); break;
+        case 'b': batch_ids = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 't': timeout_ms = atoi(optarg); break;
+        case 's': stats_s = atoi(optarg); break;
+        case 'u': provider = Provider_Add(optarg); break;
+        case 'r':
+            if (provider < 0)
+                provider = Provider_Add(CFG_PROTO_SIMPLE_URL);
+            Provider_Budget(provider, optarg);
+            break;
+        case 'a':
+            if (provider < 0)
+                provider = Provider_Add(CFG_PROTO_SIMPLE_URL);
+            Assets_Add(optarg, provider);
+            break;
+        case 'o': if (n_out < MAX_OUTPUTS) pending_out[n_out++] = optarg; break;
+        case 'P': if (n_pty < MAX_OUTPUTS) pending_pty[n_pty++] = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-i min_age_ms] [-b ids] [-t timeout_ms] [-s stats_s] "
+                            "-u url [-r limit/window_s[:ids]] -a id[@threshold][,...] [-o port[=id]] [-P id]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (n_assets == 0) {
+        fprintf(stderr, "feederd: no assets (-a)\n");
+        return 2;
+    }
+    for (i = 0; i < n_out; i++)                   // Outputs refer to assets, so open them last.
+        Output_Open(pending_out[i]);
+    for (i = 0; i < n_pty; i++)
+        Output_Pty(pending_pty[i]);
+    Plan_Setup();
+    next_stats = Now_Ms() + stats_s * 1000.0;
+
+    for (;;) {
+        int n, k;
+        double now;
+        Plan_Run();
+        n = epoll_wait(epfd, events, 64, (int)Plan_Wait(&plan, Plan_Ms(), 100));
+        if (n < 0 && errno != EINTR)
+            Die("epoll_wait");
+        for (k = 0; k < n; k++) {
+            int kind = *(int *)events[k].data.ptr;
+            if (kind == EV_CONN) {
+                Conn_Event((Batch *)events[k].data.ptr);
+            } else {
+                Output_Drain((Output *)events[k].data.ptr);
+            }
+        }
+        now = Now_Ms();
+        Conn_Timeouts(now);
+        if (want_stats || (stats_s > 0 && now >= next_stats)) {
+            Stats_Print(want_stats || n_assets <= 20);
+            want_stats = 0;
+            next_stats = now + stats_s * 1000.0;
+        }
+    }
+}
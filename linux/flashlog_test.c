@@ -0,0 +1,324 @@
+//flashlog_test.c
+// Host test of the flash tick log (build/flashlog.c) against the flash model of the board shim
+// (qemu/board.c): a RAM image of the TM4C's flash that the controller registers program and
+// erase, and that can lose power in the middle of any operation.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Iqemu -Ibuild -o flashlog_test linux/flashlog_test.c build/flashlog.c
+//      qemu/board.c build/tracker_config.c && ./flashlog_test [-b]
+//
+// Power-cut sweep: a run of ticks (full batches, partial batches flushed by time gaps, and a
+// stretch that uses up a segment's commit slots before its records) is repeated once for
+// every word programmed and every sector erased, and power fails on that operation. The
+// operation is either lost, torn (a random part of its bits done) or complete. After each
+// cut the log is booted again from the flash image, and FlashLog_Read must return exactly the
+// committed prefix: every tick whose commit word was fully programmed, nothing after it. The
+// log then takes the rest of the run and must hold the prefix followed by it after another
+// boot. The same is done across the ring's wrap-around, where the oldest segment is erased
+// for reuse; there every operation is cut either before it starts or once it is done (how a
+// real erase leaves a sector when cut short is not modelled).
+//
+// -b adds the append and scan timings: host time per tick appended, flash operations per
+// tick, boot scan of a full log, and reads and min/max over a day and over the whole log.
+#define _POSIX_C_SOURCE 199309L
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tracker.h"
+#include "flashlog.h"
+#include "check.h"
+
+#define FLASHLOG_MAGIC 0x464C4F47U
+#define NO_CUT         0xFFFFFFFFU
+#define T0             1700000000U
+#define RUN_TICKS      420U                      // About 4 segments
+#define WRAP_TICKS     (CFG_FLASHLOG_SEGMENTS * FLASHLOG_RECORDS_PER_SEG + 300U)
+#define MAX_TICKS      (WRAP_TICKS + RUN_TICKS)
+
+static FlashLogRecord ticks[MAX_TICKS];         // The run: tick k is appended k-th
+static FlashLogRecord got[MAX_TICKS], want[MAX_TICKS];
+static jmp_buf power;
+static uint32_t rng = 1;
+
+// flashlog.c holds the ESP32 off around flash operations; there is no link here.
+void UART1_Hold(int hold) {
+    (void)hold;
+}
+
+static void Power_Cut(void) {
+    longjmp(power, 1);
+}
+
+static uint32_t Rand(void) {
+    rng = rng * 1664525U + 1013904223U;
+    return rng;
+}
+
+// Ticks 20 s apart with a 400 s gap (longer than flush_s, so a partial batch is committed)
+// every 37 ticks, then from tick 200 a gap every 5 ticks: 16 commits of 5 records use up a
+// segment's commit slots long before its 116 records.
+static void Make_Ticks(uint32_t n, uint32_t t) {
+    uint32_t k;
+    for (k = 0; k < n; k++) {
+        t += (k % 37U == 36U || (k >= 200U && k < RUN_TICKS && k % 5U == 4U)) ? 400U : 20U;
+        ticks[k].time = t;
+        ticks[k].price = (int32_t)(9000000U + (k * 7919U) % 200000U) - 100000;
+    }
+}
+
+static void Flash_Reset(void) {
+    memset(board_flash, 0xFF, sizeof(board_flash));
+    board_flash_ops = 0;
+    board_flash_cut = NO_CUT;
+}
+
+static const FlashLogHeader *Seg(uint32_t i) {
+    return (const FlashLogHeader *)&board_flash[(CFG_FLASHLOG_BASE + i * CFG_FLASHLOG_SECTOR_SIZE) / 4U];
+}
+
+static const FlashLogRecord *Seg_Rec(uint32_t i) {
+    return (const FlashLogRecord *)(Seg(i) + 1);
+}
+
+// Records made durable by fully programmed commit words, per segment, read from the image by
+// the rule in flashlog.h (not by flashlog.c): a valid header, then commit words holding a
+// count and its complement, up to the first erased or damaged one.
+static uint32_t Seg_Committed(uint32_t i) {
+    const FlashLogHeader *h = Seg(i);
+    uint32_t count = 0, j, w;
+    if (h->magic != FLASHLOG_MAGIC || h->seq_inv != ~h->seq)
+        return 0;
+    for (j = 0; j < FLASHLOG_COMMIT_SLOTS; j++) {
+        w = h->commit[j];
+        if ((w >> 16) != (~w & 0xFFFFU) || (w & 0xFFFFU) > FLASHLOG_RECORDS_PER_SEG)
+            break;
+        count = w & 0xFFFFU;
+    }
+    return count;
+}
+
+// Time of the newest committed record in the image, 0 if none.
+static uint32_t Newest_Committed(void) {
+    uint32_t i, c, t = 0;
+    for (i = 0; i < CFG_FLASHLOG_SEGMENTS; i++)
+        if ((c = Seg_Committed(i)) != 0 && Seg_Rec(i)[c - 1].time > t)
+            t = Seg_Rec(i)[c - 1].time;
+    return t;
+}
+
+static int Same(const FlashLogRecord *a, const FlashLogRecord *b, uint32_t n) {
+    return n == 0 || memcmp(a, b, n * sizeof(*a)) == 0;
+}
+
+// Reads over the whole log and over a few windows, min/max and the time span, against the
+// records the log should hold ('want', 'n' of them).
+static void Check_Log(const char *what, uint32_t k, uint32_t n) {
+    static const uint32_t spans[][2] = { { 0, 900 }, { 2000, 6000 }, { 7777, 7777 + 20 }, { 5000, 100000 } };
+    uint32_t got_n = FlashLog_Read(0, 0xFFFFFFFFU, got, MAX_TICKS), s, j, m, count;
+    int32_t lo, hi, min, max;
+
+    CHECK(got_n == n && Same(got, want, n), "%s, cut at op %u: read %u records, want %u", what, k, got_n, n);
+    CHECK(FlashLog_Newest() == (n ? want[n - 1].time : 0), "%s, cut at op %u: newest %u", what, k, FlashLog_Newest());
+    CHECK(FlashLog_Oldest() == (n ? want[0].time : 0), "%s, cut at op %u: oldest %u", what, k, FlashLog_Oldest());
+    for (s = 0; s < sizeof(spans) / sizeof(spans[0]) && n; s++) {
+        uint32_t from = want[0].time + spans[s][0], to = want[0].time + spans[s][1];
+        m = 0;
+        min = 0x7FFFFFFF;
+        max = (int32_t)0x80000000;
+        for (j = 0; j < n; j++)
+            if (want[j].time >= from && want[j].time <= to) {
+                if (want[j].price < min) min = want[j].price;
+                if (want[j].price > max) max = want[j].price;
+                m++;
+            }
+        got_n = FlashLog_Read(from, to, got, MAX_TICKS);
+        CHECK(got_n == m, "%s, cut at op %u: window %u: %u records, want %u", what, k, s, got_n, m);
+        count = FlashLog_MinMax(from, to, &lo, &hi);
+        CHECK(count == m && (m == 0 || (lo == min && hi == max)),
+              "%s, cut at op %u: window %u min/max over %u records", what, k, s, count);
+    }
+}
+
+// Append ticks [from, to) with power failing on operation 'cut'. Returns the tick the cut
+// interrupted, or 'to' if the run finished (and was flushed) first.
+static uint32_t Run(uint32_t from, uint32_t to, uint32_t cut) {
+    static volatile uint32_t k;
+    board_flash_cut = cut;
+    if (setjmp(power) == 0) {
+        for (k = from; k < to; k++)
+            FlashLog_Append(ticks[k].time, ticks[k].price);
+        FlashLog_Flush();                         // A cut here interrupts the last tick's batch.
+        k = to;
+    } else if (k == to) {
+        k = to - 1;
+    }
+    board_flash_cut = NO_CUT;
+    return k;
+}
+
+// One power cut on operation 'cut' of the run [0, n) from an erased log, with the operation
+// done as far as 'torn' says: boot, check the committed prefix, finish the run, boot, check.
+static uint32_t Cut(uint32_t n, uint32_t cut, uint32_t torn) {
+    uint32_t at, d = 0, i;
+    Flash_Reset();
+    FlashLog_Init();
+    board_flash_torn = torn;
+    at = Run(0, n, cut);
+    if (at == n)
+        return 0;                                 // The run needs fewer operations.
+
+    for (i = 0; i < CFG_FLASHLOG_SEGMENTS; i++)
+        d += Seg_Committed(i);
+    CHECK(d <= at + 1, "cut at op %u: %u records committed, only %u appended", cut, d, at + 1);
+    memcpy(want, ticks, d * sizeof(*want));
+    FlashLog_Init();
+    Check_Log("after the cut", cut, d);
+
+    // Ticks between the prefix and the cut were in RAM or in a torn batch: lost (the tick
+    // being appended is in the prefix if the cut came after its commit). The rest of the run
+    // follows the prefix.
+    Run(at + 1, n, NO_CUT);
+    memcpy(&want[d], &ticks[at + 1], (n - at - 1) * sizeof(*want));
+    FlashLog_Init();
+    Check_Log("after the rest of the run", cut, d + n - at - 1);
+    return 1;
+}
+
+// The run across the ring's wrap-around: a boot must read the newest 'n' of the surviving
+// ticks in 'want' (all of them up to the newest committed one), and the ring may only be
+// short of full by the segment being reused.
+static void Check_Wrap(const char *what, uint32_t k, uint32_t n) {
+    uint32_t newest = Newest_Committed(), got_n, min = (CFG_FLASHLOG_SEGMENTS - 2U) * FLASHLOG_RECORDS_PER_SEG / 2U;
+    while (n && want[n - 1].time > newest)
+        n--;
+    FlashLog_Init();
+    got_n = FlashLog_Read(0, 0xFFFFFFFFU, got, MAX_TICKS);
+    CHECK(got_n >= min && got_n <= n && Same(got, &want[n - got_n], got_n),
+          "%s, cut at op %u: read %u records, newest %u, want the newest of %u up to %u",
+          what, k, got_n, got_n ? got[got_n - 1].time : 0, n, newest);
+}
+
+static void Wrap_Sweep(void) {
+    uint32_t fill = CFG_FLASHLOG_SEGMENTS * FLASHLOG_RECORDS_PER_SEG, end = fill + FLASHLOG_RECORDS_PER_SEG + 20U;
+    uint32_t ops, k, at, variant, n;
+
+    // Fill the ring once, then count the operations of the next segment (erase included).
+    Flash_Reset();
+    FlashLog_Init();
+    memcpy(want, ticks, WRAP_TICKS * sizeof(*want));
+    Run(0, fill, NO_CUT);
+    Check_Wrap("ring full", NO_CUT, fill);
+    ops = board_flash_ops;
+    Run(fill, end, NO_CUT);
+    Check_Wrap("ring wrapped", NO_CUT, end);
+    ops = board_flash_ops - ops;
+
+    for (k = 0; k < ops; k++)
+        for (variant = 0; variant < 2; variant++) {
+            Flash_Reset();
+            FlashLog_Init();
+            Run(0, fill, NO_CUT);
+            board_flash_torn = variant ? 0xFFFFFFFFU : 0;
+            at = Run(fill, end, board_flash_ops + k);
+            if (at == end)
+                continue;
+            memcpy(want, ticks, (at + 1) * sizeof(*want));
+            Check_Wrap("wrap, after the cut", k, at + 1);
+            n = 0;
+            while (n <= at && want[n].time <= FlashLog_Newest())
+                n++;
+            Run(at + 1, WRAP_TICKS, NO_CUT);
+            memcpy(&want[n], &ticks[at + 1], (WRAP_TICKS - at - 1) * sizeof(*want));
+            Check_Wrap("wrap, after the rest", k, n + WRAP_TICKS - at - 1);
+        }
+}
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void Benchmark(void) {
+    uint32_t fill = CFG_FLASHLOG_SEGMENTS * FLASHLOG_RECORDS_PER_SEG, k, reps = 200, n = 0;
+    int32_t lo, hi;
+    double t;
+
+    Make_Ticks(MAX_TICKS, T0);
+    for (k = 0; k < fill; k++) {
+        ticks[k].time = T0 + 20U * k;                 // Steady ticks: full batches only
+    }
+    Flash_Reset();
+    FlashLog_Init();
+    t = Now();
+    Run(0, fill, NO_CUT);
+    t = Now() - t;
+    printf("append: %u ticks in %.2f ms, %.0f ns per tick on the host; %.2f flash words programmed and "
+           "%.4f sectors erased per tick\n", fill, t * 1e3, t * 1e9 / fill,
+           (double)(board_flash_ops - CFG_FLASHLOG_SEGMENTS) / fill, (double)CFG_FLASHLOG_SEGMENTS / fill);
+
+    t = Now();
+    for (k = 0; k < reps; k++)
+        FlashLog_Init();
+    t = Now() - t;
+    printf("boot scan: %u segments, %.1f us per FlashLog_Init on the host\n", CFG_FLASHLOG_SEGMENTS, t * 1e6 / reps);
+
+    t = Now();
+    for (k = 0; k < reps; k++)
+        n = FlashLog_Read(T0 + 20U * fill - 86400U, 0xFFFFFFFFU, got, MAX_TICKS);
+    t = Now() - t;
+    printf("read, last day: %u records, %.1f us (%.1f M records/s)\n", n, t * 1e6 / reps, n * reps / t / 1e6);
+
+    t = Now();
+    for (k = 0; k < reps; k++)
+        n = FlashLog_Read(0, 0xFFFFFFFFU, got, MAX_TICKS);
+    t = Now() - t;
+    printf("read, whole log: %u records, %.1f us (%.1f M records/s)\n", n, t * 1e6 / reps, n * reps / t / 1e6);
+
+    t = Now();
+    for (k = 0; k < reps; k++)
+        n = FlashLog_MinMax(T0 + 20U * fill - 3600U, 0xFFFFFFFFU, &lo, &hi);
+    t = Now() - t;
+    printf("min/max, last hour: %u records, %.2f us\n", n, t * 1e6 / reps);
+}
+
+int main(int argc, char **argv) {
+    uint32_t k, cuts = 0, ops;
+
+    board_power_cut = Power_Cut;
+    Make_Ticks(MAX_TICKS, T0);
+
+    // Reference run: no cut. Every tick comes back, across a reboot too.
+    Flash_Reset();
+    FlashLog_Init();
+    Run(0, RUN_TICKS, NO_CUT);
+    ops = board_flash_ops;
+    memcpy(want, ticks, RUN_TICKS * sizeof(*want));
+    Check_Log("reference run", NO_CUT, RUN_TICKS);
+    FlashLog_Init();
+    Check_Log("reference run, rebooted", NO_CUT, RUN_TICKS);
+
+    // Out-of-order and unknown times are refused.
+    FlashLog_Append(ticks[10].time, 1);
+    FlashLog_Append(0, 1);
+    FlashLog_Append(0xFFFFFFFFU, 1);
+    FlashLog_Flush();
+    Check_Log("stale ticks refused", NO_CUT, RUN_TICKS);
+
+    for (k = 0; k < ops; k++) {
+        cuts += Cut(RUN_TICKS, k, 0);             // The operation never started
+        cuts += Cut(RUN_TICKS, k, Rand());        // Torn
+        cuts += Cut(RUN_TICKS, k, 0xFFFFFFFFU);   // Done, power lost right after
+    }
+    printf("power cuts: %u flash operations in the run, %u cuts checked\n", ops, cuts);
+
+    Wrap_Sweep();
+
+    if (argc > 1 && strcmp(argv[1], "-b") == 0)
+        Benchmark();
+    return Check_Done("flashlog_test");
+}
@@ -0,0 +1,1305 @@
+//fleetsim.c
+// Fleet simulator: thousands of virtual displays (models of the TM4C firmware) fed through
+// ESP32 bridges, either one ESP32 per display subscribed to an MQTT broker, or one ESP32
+// per RS-485 bus driving several displays. Used to size a deployment: it reports update
+// throughput, the distribution of fetch-to-LCD latency per display, query round trips and
+// the load on the broker or the buses.
+//
+// Build (from the repository root):
+//   cc -O2 -Wall -pthread -Ibuild -o fleetsim linux/fleetsim.c build/frame.c build/archive.c build/fetch.c
+//      build/selftest.c build/flow.c build/lcdbus.c build/history.c build/dsp.c -lm
+//
+// Usage:
+//   fleetsim [-n units] [-m mqtt|rs485] [-k units_per_bus] [-d seconds] [-j threads]
+//            [-e epoch_ms] [-i poll_ms] [-r bus_baud] [-b broker_us] [-E byte_error_rate]
+//            [-A] [-s seed] [-B [-U select_s]] [-T] [-F [-W line_ms]] [-L panels] [-H]
+//
+//   -k  displays per RS-485 bus (default 32); MQTT always has one ESP32 per display
+//   -b  broker service time per delivered message (default 10 us)
+//   -E  probability that a byte is damaged on the wire; the line carrying it is dropped
+//   -A  no ESP32 history archive (76.6 KB each) and no window queries, for huge fleets
+//   -B  boot timeline instead: the fleet powers up at once (see Boot_Report()); -U is the
+//       time spent on the threshold screen (default: nobody touches it)
+//   -T  link self-test co-simulation instead (see Test_Report()); -E applies
+//   -F  UART flow control instead (see Flow_Report()): a bulk burst into a TM4C that needs
+//       -W ms per line (default 20), without flow control, with RTS/CTS and with XON/XOFF
+//   -L  shared LCD bus instead (see Lcd_Report()): price updates on 1..panels HD44780s
+//   -H  history backfill instead (see Hist_Report()): bytes, transfer, decode and ingest time
+//
+// Each display runs the firmware's line handling on the real text: the price line from
+// Fetch_Format_Price() is parsed with CFG_PROTO_PRICE_RX, and the '$Q' / '$W' history
+// queries go through frame.c on both ends and archive.c on the ESP32. Wire time comes
+// from the baud rates, and a price redraw keeps the HD44780 busy for 170 ms, as measured
+// from the LCD routines. The fetch, Wi-Fi and broker delays are random but seeded, so a
+// run is reproducible and does not depend on the number of threads.
+//
+// A bridge with its displays is one segment with its own event queue. The virtual clock
+// advances in epochs of -e ms (idle stretches are skipped). At the start of an epoch each
+// worker thread queues the segments of its shard that have events before the epoch end.
+// It then runs them, stealing queued segments from other workers once its own queue is
+// empty. Segments never exchange events within an epoch: the broker fan-out is computed
+// between epochs, from the publisher's schedule.
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracker_config.h"
+#include "frame.h"
+#include "archive.h"
+#include "fetch.h"
+#include "selftest.h"
+#include "flow.h"
+#include "lcdbus.h"
+#include "history.h"
+
+#define HB             464        // Latency histogram buckets (16 per octave of microseconds)
+#define LCD_PRICE_US   170000U    // Clear + two rows: 28 bytes at 6 ms plus the 2 ms clear wait (blocking driver; see -L)
+#define ESP_SERVICE_US 300U       // ESP32 time to parse a query and build the answer
+#define EPOCH0_TIME    1760000000UL  // Unix time at virtual time 0
+#define ALL_UNITS      0xFFFFFFFFU
+
+enum { EV_FETCH, EV_DELIVER, EV_RX_PRICE, EV_QUERY, EV_RX_WINDOW };
+
+typedef struct {
+    uint64_t t;                   // Virtual time (us)
+    uint64_t origin;              // Fetch done / query sent, for latency
+    uint32_t arg;                 // Poll index
+    uint32_t unit;                // Index within the segment, or ALL_UNITS
+    uint8_t type;
+} Event;
+
+typedef struct {
+    uint64_t lcd_free;            // HD44780 busy until
+    uint32_t hist[HB];            // Fetch-to-LCD latency of this display
+    uint32_t updates;
+    uint8_t q_id, q_window;
+    char reply[FRAME_MAX_LEN + 1];  // '$W' line in flight to this display
+} Unit;
+
+typedef struct {
+    Event *ev;                    // Min-heap on t
+    uint32_t n_ev, cap_ev;
+    Unit *unit;
+    uint32_t n_unit;
+    Archive archive;              // The bridge's ESP32 archive
+    ArchiveBucket *store;
+    uint64_t link_free;           // RS-485 bus, or the ESP32 -> TM4C UART line, busy until
+    uint64_t link_busy_us;        // Time that line carried data
+    uint32_t rng;
+} Segment;
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t *item;               // Segment indices
+    uint32_t head, tail;          // Thieves take at head, the owner at tail
+} Deque;
+
+typedef struct {
+    pthread_t thread;
+    uint32_t id;
+    uint32_t first, count;        // Shard: segments scanned by this worker each epoch
+    Deque dq;
+    uint64_t next_min;            // Earliest pending event in the segments it touched
+    uint64_t events, steals, runs;
+    uint64_t lines, dropped, bad, windows;
+    uint32_t rtt[HB];
+} Worker;
+
+static int mqtt = 1;
+static uint32_t n_units = 1000, per_bus = 32, n_threads, n_segs, n_polls;
+static uint64_t duration_us = 3600ULL * 1000000, epoch_us = 10000, poll_us = CFG_POLL_INTERVAL_MS * 1000ULL;
+static uint32_t bus_baud = CFG_UART_BAUD, broker_us = 10, seed = 1, use_archive = 1;
+static double byte_error_rate = 0.0;
+
+static Segment *segs;
+static Worker *workers;
+static double *price;             // Price of each poll (shared series)
+static pthread_barrier_t bar;
+static uint64_t g_start, g_end, epochs;
+static int g_done;
+
+// Broker (MQTT only), run by worker 0 between epochs.
+static uint32_t pub_p, pub_rng;
+static uint64_t pub_t;            // When the publisher's fetch of poll pub_p completes
+static uint64_t broker_free, broker_busy_us, deliveries, spread_max_us;
+
+static uint32_t Rand(uint32_t *s) {
+    uint32_t x = *s;              // xorshift32
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *s = x;
+}
+
+// Exponentially distributed delay with the given mean (us).
+static uint64_t Rand_Exp(uint32_t *s, double mean) {
+    double u = (Rand(s) + 1.0) / 4294967297.0;
+    double d = -mean * log(u);
+    return d > mean * 20 ? (uint64_t)(mean * 20) : (uint64_t)d;
+}
+
+static uint32_t Hist_Index(uint64_t v) {
+    uint32_t b;
+    if (v < 16)
+        return (uint32_t)v;
+    b = 63 - (uint32_t)__builtin_clzll(v);
+    if (b > 31)
+        return HB - 1;
+    return 16 + (b - 4) * 16 + (uint32_t)((v >> (b - 4)) & 15);
+}
+
+// Middle of bucket i.
+static uint64_t Hist_Value(uint32_t i) {
+    uint32_t b;
+    if (i < 16)
+        return i;
+    b = (i - 16) / 16 + 4;
+    return ((uint64_t)(32 + (i - 16) % 16 * 2 + 1) << (b - 4)) / 2;
+}
+
+static uint64_t Hist_Pct(const uint32_t *h, double pct) {
+    uint64_t total = 0, run = 0, want;
+    uint32_t i;
+    for (i = 0; i < HB; i++)
+        total += h[i];
+    if (total == 0)
+        return 0;
+    want = (uint64_t)(total * pct / 100.0);
+    if (want >= total)
+        want = total - 1;         // 100: the highest sample
+    for (i = 0; i < HB; i++) {
+        run += h[i];
+        if (run > want)
+            return Hist_Value(i);
+    }
+    return Hist_Value(HB - 1);
+}
+
+static void Push(Segment *s, uint64_t t, uint64_t origin, uint8_t type, uint32_t unit, uint32_t arg) {
+    uint32_t i;
+    if (s->n_ev == s->cap_ev) {
+        s->cap_ev = s->cap_ev ? s->cap_ev * 2 : 16;
+        s->ev = realloc(s->ev, s->cap_ev * sizeof(Event));
+        if (!s->ev) {
+            perror("fleetsim");
+            exit(1);
+        }
+    }
+    i = s->n_ev++;
+    while (i > 0 && s->ev[(i - 1) / 2].t > t) {
+        s->ev[i] = s->ev[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->ev[i] = (Event){ t, origin, arg, unit, type };
+}
+
+static Event Pop(Segment *s) {
+    Event top = s->ev[0], last = s->ev[--s->n_ev];
+    uint32_t i = 0, c;
+    while ((c = 2 * i + 1) < s->n_ev) {
+        if (c + 1 < s->n_ev && s->ev[c + 1].t < s->ev[c].t)
+            c++;
+        if (last.t <= s->ev[c].t)
+            break;
+        s->ev[i] = s->ev[c];
+        i = c;
+    }
+    if (s->n_ev)
+        s->ev[i] = last;
+    return top;
+}
+
+static uint64_t Seg_Next(const Segment *s) {
+    return s->n_ev ? s->ev[0].t : UINT64_MAX;
+}
+
+// Wire time of 'bytes' characters (8N1) plus the break that precedes every line.
+static uint64_t Wire_Us(size_t bytes, uint32_t baud) {
+    return (uint64_t)bytes * 10 * 1000000 / baud + CFG_UART_BREAK_US;
+}
+
+// Put a line on the segment's shared line (RS-485 bus, or the ESP32's UART to its TM4C);
+// returns when its last byte has arrived.
+static uint64_t Link_Send(Segment *s, uint64_t t, size_t bytes) {
+    uint64_t start = t > s->link_free ? t : s->link_free;
+    uint64_t d = Wire_Us(bytes, mqtt ? CFG_UART_BAUD : bus_baud);
+    s->link_free = start + d;
+    s->link_busy_us += d;
+    return start + d;
+}
+
+// Does a line of 'len' bytes survive the wire?
+static int Line_Survives(Segment *s, size_t len) {
+    size_t i;
+    if (byte_error_rate <= 0.0)
+        return 1;
+    for (i = 0; i < len; i++) {
+        if (Rand(&s->rng) < byte_error_rate * 4294967296.0)
+            return 0;
+    }
+    return 1;
+}
+
+static size_t Price_Line(char *buf, size_t cap, uint32_t p) {
+    double change = (price[p] / price[0] - 1.0) * 100.0;
+    return Fetch_Format_Price(buf, cap, price[p], change, EPOCH0_TIME + (unsigned long)(p * (poll_us / 1000000)));
+}
+
+// Fetch-to-display latency model of the ESP32 HTTP request.
+static uint64_t Fetch_Us(uint32_t *rng) {
+    return 200000 + Rand_Exp(rng, 150000);
+}
+
+// The TM4C receives a price line: the firmware's sscanf, then the LCD redraw.
+static void Unit_Price(Worker *w, Segment *s, Unit *u, uint64_t t, uint64_t origin, const char *line, size_t len) {
+    float p = 0.0f, change = 0.0f;
+    unsigned long stamp = 0;
+    uint64_t start;
+    w->lines++;
+    if (!Line_Survives(s, len + 1)) {
+        w->dropped++;
+        return;
+    }
+    if (sscanf(line, CFG_PROTO_PRICE_RX, &p, &change, &stamp) < 2) {
+        w->bad++;
+        return;
+    }
+    start = t > u->lcd_free ? t : u->lcd_free;
+    u->lcd_free = start + LCD_PRICE_US;
+    u->hist[Hist_Index(u->lcd_free - origin)]++;
+    u->updates++;
+}
+
+static void Seg_Event(Worker *w, Segment *s, const Event *e) {
+    char line[FRAME_MAX_LEN + 1];
+    size_t len;
+    uint32_t k;
+    Unit *u;
+
+    switch (e->type) {
+    case EV_FETCH:                // RS-485 bridge: its own fetch finished, broadcast the line.
+        if (use_archive)
+            Archive_Add(&s->archive, EPOCH0_TIME + (uint32_t)(e->arg * (poll_us / 1000000)),
+                        (int32_t)(price[e->arg] * 100.0 + 0.5));
+        len = Price_Line(line, sizeof(line), e->arg);
+        Push(s, Link_Send(s, e->t, len + 1), e->t, EV_RX_PRICE, ALL_UNITS, e->arg);
+        if (e->arg + 1 < n_polls)
+            Push(s, (e->arg + 1) * poll_us + (s->rng % 1000) * 1000 + Fetch_Us(&s->rng), 0, EV_FETCH, 0, e->arg + 1);
+        break;
+    case EV_DELIVER:              // MQTT: the broker delivered the price to this ESP32.
+        if (use_archive)
+            Archive_Add(&s->archive, EPOCH0_TIME + (uint32_t)(e->arg * (poll_us / 1000000)),
+                        (int32_t)(price[e->arg] * 100.0 + 0.5));
+        len = Price_Line(line, sizeof(line), e->arg);
+        Push(s, Link_Send(s, e->t, len + 1), e->origin, EV_RX_PRICE, 0, e->arg);
+        break;
+    case EV_RX_PRICE:
+        len = Price_Line(line, sizeof(line), e->arg);
+        if (e->unit == ALL_UNITS) {
+            for (k = 0; k < s->n_unit; k++)
+                Unit_Price(w, s, &s->unit[k], e->t, e->origin, line, len);
+        } else {
+            Unit_Price(w, s, &s->unit[e->unit], e->t, e->origin, line, len);
+        }
+        break;
+    case EV_QUERY: {              // The TM4C asks for the next window; the ESP32 answers.
+        FrameQuery q = { 0, 0, 0 };
+        FrameWindow win;
+        ArchiveWindow a;
+        const char *payload;
+        size_t plen;
+        char tag;
+        uint64_t at;
+        u = &s->unit[e->unit];
+        q.id = ++u->q_id;
+        q.window_s = u->q_window ? CFG_ARCHIVE_LONG_WINDOW_S : CFG_ARCHIVE_SHORT_WINDOW_S;
+        u->q_window ^= 1;
+        len = Frame_Encode_Query(line, sizeof(line), &q);
+        at = mqtt ? e->t + Wire_Us(len + 1, CFG_UART_BAUD)   // Own TX wire to the ESP32
+                  : Link_Send(s, e->t, len + 1);            // Shared half-duplex bus
+        w->lines++;
+        if (Line_Survives(s, len + 1) && Frame_Open(line, &tag, &payload, &plen)
+            && Frame_Decode_Query(payload, plen, &q)) {
+            Archive_Query(&s->archive, q.window_s, &a);
+            memset(&win, 0, sizeof(win));
+            win.id = q.id;
+            win.service_us = ESP_SERVICE_US;
+            win.window_s = q.window_s;
+            win.res_s = a.res_s;
+            win.count = a.count;
+            if (a.count) {
+                win.open = a.open; win.high = a.high; win.low = a.low;
+                win.close = a.close; win.mean = a.mean;
+            }
+            len = Frame_Encode_Window(u->reply, sizeof(u->reply), &win);
+            Push(s, Link_Send(s, at + ESP_SERVICE_US, len + 1), e->t, EV_RX_WINDOW, e->unit, 0);
+        } else {
+            w->dropped++;
+        }
+        Push(s, e->t + CFG_ARCHIVE_QUERY_MS * 500ULL, 0, EV_QUERY, e->unit, 0);  // Two windows per period
+        break;
+    }
+    case EV_RX_WINDOW: {
+        FrameWindow win;
+        const char *payload;
+        size_t plen;
+        char tag;
+        u = &s->unit[e->unit];
+        len = strlen(u->reply);
+        w->lines++;
+        if (!Line_Survives(s, len + 1)) {
+            w->dropped++;
+        } else if (Frame_Open(u->reply, &tag, &payload, &plen) && tag == CFG_FRAME_WINDOW
+                   && Frame_Decode_Window(payload, plen, &win) && win.id == u->q_id) {
+            w->windows++;
+            w->rtt[Hist_Index(e->t - e->origin)]++;
+        } else {
+            w->bad++;
+        }
+        break;
+    }
+    }
+}
+
+// Run a segment's events up to the epoch end.
+static void Seg_Run(Worker *w, Segment *s, uint64_t end) {
+    Event e;
+    uint64_t next;
+    while (s->n_ev && s->ev[0].t < end) {
+        e = Pop(s);
+        Seg_Event(w, s, &e);
+        w->events++;
+    }
+    next = Seg_Next(s);
+    if (next < w->next_min)
+        w->next_min = next;
+    w->runs++;
+}
+
+static int Take(Worker *w, uint32_t *seg) {
+    uint32_t k;
+    pthread_mutex_lock(&w->dq.lock);
+    if (w->dq.tail > w->dq.head) {
+        *seg = w->dq.item[--w->dq.tail];
+        pthread_mutex_unlock(&w->dq.lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&w->dq.lock);
+    for (k = 1; k < n_threads; k++) {        // Own queue empty: steal the oldest entry of another.
+        Worker *v = &workers[(w->id + k) % n_threads];
+        pthread_mutex_lock(&v->dq.lock);
+        if (v->dq.tail > v->dq.head) {
+            *seg = v->dq.item[v->dq.head++];
+            pthread_mutex_unlock(&v->dq.lock);
+            w->steals++;
+            return 1;
+        }
+        pthread_mutex_unlock(&v->dq.lock);
+    }
+    return 0;                     // Nothing left anywhere: no work is added during an epoch.
+}
+
+// Worker 0, between epochs: pick the next epoch and run the broker up to its end.
+static void Epoch_Next(void) {
+    uint64_t next = UINT64_MAX, tp, at, spread;
+    uint32_t k;
+    for (k = 0; k < n_threads; k++)
+        if (workers[k].next_min < next)
+            next = workers[k].next_min;
+    if (mqtt && pub_p < n_polls && pub_t < next)
+        next = pub_t;
+    g_start = next > g_end ? next : g_end;
+    if (g_start >= duration_us) {
+        g_done = 1;
+        return;
+    }
+    g_end = g_start + epoch_us;
+    epochs++;
+    while (mqtt && pub_p < n_polls && pub_t < g_end) {
+        // One publish, delivered to every subscriber in turn; the broker serves them back to back.
+        tp = pub_t;
+        for (k = 0; k < n_segs; k++) {
+            at = tp + 2000 + Rand_Exp(&pub_rng, 2000);      // Publisher -> broker over the network
+            broker_free = (at > broker_free ? at : broker_free) + broker_us;
+            broker_busy_us += broker_us;
+            deliveries++;
+            at = broker_free + 3000 + Rand_Exp(&pub_rng, 4000);  // Broker -> ESP32 over Wi-Fi
+            Push(&segs[k], at, tp, EV_DELIVER, 0, pub_p);
+            spread = broker_free - tp;
+            if (spread > spread_max_us)
+                spread_max_us = spread;
+        }
+        pub_p++;
+        pub_t = pub_p * poll_us + Fetch_Us(&pub_rng);
+    }
+}
+
+static void *Worker_Main(void *arg) {
+    Worker *w = arg;
+    uint32_t k, seg;
+    uint64_t t;
+    for (;;) {
+        pthread_barrier_wait(&bar);          // Epoch bounds (and broker deliveries) are ready.
+        if (g_done)
+            break;
+        w->next_min = UINT64_MAX;
+        w->dq.head = w->dq.tail = 0;
+        for (k = w->first; k < w->first + w->count; k++) {
+            t = Seg_Next(&segs[k]);
+            if (t < g_end)
+                w->dq.item[w->dq.tail++] = k;
+            else if (t < w->next_min)
+                w->next_min = t;
+        }
+        pthread_barrier_wait(&bar);          // Every queue is filled before anyone steals.
+        while (Take(w, &seg))
+            Seg_Run(w, &segs[seg], g_end);
+        pthread_barrier_wait(&bar);          // Epoch done everywhere.
+        if (w->id == 0)
+            Epoch_Next();
+    }
+    return NULL;
+}
+
+static double Now_S(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int Cmp_U64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void Report(double wall) {
+    static uint32_t all[HB], rtt[HB];
+    uint64_t lines = 0, dropped = 0, bad = 0, windows = 0, events = 0, steals = 0, runs = 0, updates = 0;
+    uint64_t *p99 = malloc(n_units * sizeof(uint64_t)), busy_max = 0, busy_sum = 0;
+    double virt = duration_us / 1e6;
+    uint32_t k, i, n = 0;
+
+    for (k = 0; k < n_threads; k++) {
+        Worker *w = &workers[k];
+        lines += w->lines; dropped += w->dropped; bad += w->bad; windows += w->windows;
+        events += w->events; steals += w->steals; runs += w->runs;
+        for (i = 0; i < HB; i++)
+            rtt[i] += w->rtt[i];
+    }
+    for (k = 0; k < n_segs; k++) {
+        Segment *s = &segs[k];
+        for (i = 0; i < s->n_unit; i++) {
+            Unit *u = &s->unit[i];
+            uint32_t b;
+            for (b = 0; b < HB; b++)
+                all[b] += u->hist[b];
+            updates += u->updates;
+            p99[n++] = Hist_Pct(u->hist, 99.0);
+        }
+        busy_sum += s->link_busy_us;
+        if (s->link_busy_us > busy_max)
+            busy_max = s->link_busy_us;
+    }
+    qsort(p99, n, sizeof(uint64_t), Cmp_U64);
+
+    printf("fleetsim: %u units, %s, %.0f s virtual in %.2f s wall (%.0fx real time), %u threads\n",
+           n_units, mqtt ? "MQTT (one ESP32 per display)" : "RS-485", virt, wall, virt / wall, n_threads);
+    printf("  updates %llu (%.1f/s virtual, %.0f/s wall), lines %llu, dropped %llu, unparsed %llu, windows %llu\n",
+           (unsigned long long)updates, updates / virt, updates / wall, (unsigned long long)lines,
+           (unsigned long long)dropped, (unsigned long long)bad, (unsigned long long)windows);
+    printf("  update latency (fetch done to LCD written), ms: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+           Hist_Pct(all, 50) / 1e3, Hist_Pct(all, 90) / 1e3, Hist_Pct(all, 99) / 1e3, Hist_Pct(all, 100) / 1e3);
+    if (n)
+        printf("  per-display p99, ms: best %.1f  median %.1f  p90 %.1f  worst %.1f\n",
+               p99[0] / 1e3, p99[n / 2] / 1e3, p99[n * 9 / 10] / 1e3, p99[n - 1] / 1e3);
+    if (windows)
+        printf("  query round trip, ms: p50 %.1f  p99 %.1f  max %.1f\n",
+               Hist_Pct(rtt, 50) / 1e3, Hist_Pct(rtt, 99) / 1e3, Hist_Pct(rtt, 100) / 1e3);
+    if (mqtt)
+        printf("  broker: %u publishes, %llu deliveries (%.1f/s), busy %.2f%%, fan-out spread max %.1f ms\n",
+               pub_p, (unsigned long long)deliveries, deliveries / virt, 100.0 * broker_busy_us / duration_us,
+               spread_max_us / 1e3);
+    else
+        printf("  buses: %u at %u baud, utilisation mean %.2f%% max %.2f%%\n", n_segs, bus_baud,
+               100.0 * busy_sum / n_segs / duration_us, 100.0 * busy_max / duration_us);
+    printf("  executor: %llu epochs, %llu events (%.0f/s wall), %llu segment runs, %llu steals\n",
+           (unsigned long long)epochs, (unsigned long long)events, events / wall,
+           (unsigned long long)runs, (unsigned long long)steals);
+    free(p99);
+}
+
+// Boot model (-B): every display powers up together with its ESP32, as after a power cut.
+// The ESP32 side replays setup() on the wire: the start-up delay, the Wi-Fi progress text,
+// the history backfill (the real frames from Frame_Encode_Backfill()) and the first price.
+// The TM4C side has the stage times of main(), in the old order (peripherals one by one,
+// the UART ring drained only after the boot screens) and in the overlapped one (all clocks
+// at once, UART first, lines ingested between the boot screens' waits). The HD44780 writes
+// block, so the select screen and the banner are drawn in one piece while bytes pile up.
+#define BOOT_ESP_START_US   2300000U  // ROM boot, then the sketch's delay(2000)
+#define BOOT_OLD_UART_US    40U       // UART1 armed after the GPIO drivers gated their ports
+#define BOOT_NEW_CLOCKS_US  3U        // One RCGCGPIO/RCGCUART write and the PRGPIO wait
+#define BOOT_NEW_UART_US    6U
+#define BOOT_PERIPH_US      2500U     // Flash index scan, USB and SSI2 set-up
+#define BOOT_LCD_US         50000U    // LCD_Init_Thread(): 40 + 5 + 1 + 1 + 2 ms of waits plus commands
+#define BOOT_BANNER_DRAW_US 92000U    // Clear plus the 15 characters of the banner
+#define BOOT_RING_BYTES     2048U     // UART_RX_RING_SIZE in tracker.h
+#define BOOT_MAX_LINES      64
+
+enum { BL_TEXT, BL_FRAME, BL_PRICE };
+
+typedef struct {
+    uint64_t start, end;          // Wire time of the line (us since power-up)
+    uint32_t bytes;
+    uint8_t kind;
+} BootLine;
+
+static uint32_t boot_mode;
+static uint64_t select_us = CFG_THRESHOLD_SELECT_MS * 1000ULL;  // Time on the threshold screen (-U)
+
+// Bytes of lines[] that arrive in [a, b).
+static uint64_t Boot_Bytes(const BootLine *l, uint32_t n, uint64_t a, uint64_t b) {
+    uint64_t sum = 0, lo, hi;
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        lo = l[i].start > a ? l[i].start : a;
+        hi = l[i].end < b ? l[i].end : b;
+        if (hi > lo)
+            sum += l[i].bytes * (hi - lo) / (l[i].end - l[i].start);
+    }
+    return sum;
+}
+
+// Queue a line the ESP32 prints once it is ready at 't'; returns when it has been sent.
+static uint64_t Boot_Send(BootLine *l, uint32_t *n, uint64_t t, uint32_t bytes, uint8_t kind) {
+    BootLine *x = &l[*n];
+    uint64_t start = *n && l[*n - 1].end > t ? l[*n - 1].end : t;
+    if (*n >= BOOT_MAX_LINES)
+        return t;
+    x->start = start;
+    x->end = start + Wire_Us(bytes, CFG_UART_BAUD);
+    x->bytes = bytes + 1;         // With the newline
+    x->kind = kind;
+    (*n)++;
+    return x->end;
+}
+
+// Lengths of the backfill frames for a day of points of the price series.
+static uint32_t Boot_Backfill(uint32_t *len, uint32_t max) {
+    static int32_t p[CFG_BACKFILL_MAX_POINTS];
+    char frame[CFG_UART_BUFFER_SIZE + 1];
+    FrameBackfill hdr;
+    uint32_t n = 0, i, rng = seed | 1;
+    uint16_t off;
+    p[0] = (int32_t)price[0];
+    for (i = 1; i < CFG_BACKFILL_MAX_POINTS; i++)
+        p[i] = p[i - 1] + (int32_t)(Rand(&rng) % 121) - 60;
+    for (off = 0; off < CFG_BACKFILL_MAX_POINTS && n < max; off += hdr.n) {
+        hdr.seq = (uint16_t)n;
+        hdr.total = 9;            // One digit, as in the sketch's settled header
+        hdr.t0 = EPOCH0_TIME + off * 300U;
+        hdr.dt = 300;
+        len[n] = (uint32_t)Frame_Encode_Backfill(frame, sizeof(frame), &hdr, p + off,
+                                                 (uint16_t)(CFG_BACKFILL_MAX_POINTS - off));
+        if (len[n] == 0 || hdr.n == 0)
+            break;
+        n++;
+    }
+    return n;
+}
+
+// Percentiles of one stage over the fleet, in ms ('scale' 1000) or in bytes ('scale' 1).
+static void Boot_Row(const char *name, uint64_t *v, uint32_t n, double scale) {
+    qsort(v, n, sizeof(uint64_t), Cmp_U64);
+    printf("    %-12s p50 %9.*f  p99 %9.*f  max %9.*f\n", name, scale > 1 ? 3 : 0, v[n / 2] / scale,
+           scale > 1 ? 3 : 0, v[n * 99 / 100] / scale, scale > 1 ? 3 : 0, v[n - 1] / scale);
+}
+
+static void Boot_Report(void) {
+    static const char *stage[] = { "clocks", "uart", "periph", "lcd", "ui", "first_line", "first_price", "ring peak B" };
+    uint32_t frame_len[32], n_frames = Boot_Backfill(frame_len, 32), frame_bytes = 0;
+    uint64_t *v[2][8];
+    uint32_t lost_units[2] = { 0, 0 }, cold[2] = { 0, 0 }, k, i, m, s;
+    char text[160];
+
+    for (i = 0; i < n_frames; i++)
+        frame_bytes += frame_len[i] + 1;
+    for (m = 0; m < 2; m++)
+        for (s = 0; s < 8; s++)
+            v[m][s] = malloc(n_units * sizeof(uint64_t));
+
+    for (k = 0; k < n_units; k++) {
+        BootLine l[BOOT_MAX_LINES];
+        uint32_t n = 0, rng = (seed + k) * 2654435761U | 1, dots, price_i, first_frame, p;
+        uint64_t t = BOOT_ESP_START_US + Rand(&rng) % 200000, wifi = 1500000 + Rand_Exp(&rng, 1000000);
+
+        // ESP32 setup() on the wire.
+        t = Boot_Send(l, &n, t, 22, BL_TEXT);                       // "Connecting to WiFi..."
+        for (dots = 0; dots < wifi / 500000; dots++)
+            Boot_Send(l, &n, t + (dots + 1) * 500000ULL, 1, BL_TEXT);
+        t += wifi;
+        t = Boot_Send(l, &n, t, 18, BL_TEXT);                       // "\nWiFi connected!"
+        t = Boot_Send(l, &n, t, 26, BL_TEXT);                       // "IP Address: ..."
+        t = Boot_Send(l, &n, t, (uint32_t)snprintf(text, sizeof(text),
+                      "History archive: %u bytes per asset, %u per day of retention",
+                      (unsigned)ARCHIVE_BYTES_PER_ASSET,
+                      (unsigned)(ARCHIVE_BYTES_PER_ASSET * 86400ULL /
+                                 ((uint64_t)CFG_ARCHIVE_T2_BUCKETS * CFG_ARCHIVE_T2_BUCKET_S))), BL_TEXT);
+        t += Fetch_Us(&rng) + 300000;                               // market_chart is the larger request
+        first_frame = n;
+        for (i = 0; i < n_frames; i++)
+            t = Boot_Send(l, &n, t, frame_len[i], BL_FRAME);
+        price_i = n;
+        for (p = 0; p < BOOT_MAX_LINES && t < select_us + 20000000; p++, t += poll_us)
+            Boot_Send(l, &n, t + Fetch_Us(&rng), (uint32_t)Price_Line(text, sizeof(text), p), BL_PRICE);
+
+        for (m = 0; m < 2; m++) {
+            uint64_t uart = m ? BOOT_NEW_UART_US : BOOT_OLD_UART_US;
+            uint64_t lcd = uart + BOOT_LCD_US;
+            uint64_t sel = lcd + LCD_PRICE_US + select_us;          // Select screen drawn, then held
+            uint64_t ui = sel + BOOT_BANNER_DRAW_US + CFG_SAVED_BANNER_MS * 1000ULL + 2000;
+            uint64_t peak, first_line = 0, first_price = 0, fill = 0;
+            uint32_t lost = 0;
+            v[m][0][k] = m ? BOOT_NEW_CLOCKS_US : 0;
+            v[m][1][k] = uart;
+            v[m][2][k] = uart + BOOT_PERIPH_US;
+            v[m][3][k] = lcd;
+            v[m][4][k] = ui;
+            if (!m) {
+                // Nothing leaves the ring before the boot screens end: whatever does not fit
+                // is dropped, and with it every line it belonged to.
+                peak = Boot_Bytes(l, n, uart, ui);
+                for (i = 0; i < n; i++) {
+                    if (l[i].start < ui) {
+                        fill += l[i].bytes;
+                        if (fill > BOOT_RING_BYTES - 1) {
+                            lost++;
+                            if (i >= first_frame && i < price_i)
+                                cold[m]++;
+                            continue;
+                        }
+                    }
+                    if (!first_line)
+                        first_line = l[i].end > ui ? l[i].end : ui;
+                    if (!first_price && l[i].kind == BL_PRICE)
+                        first_price = l[i].end > ui ? l[i].end : ui;
+                }
+                if (peak > BOOT_RING_BYTES - 1)
+                    peak = BOOT_RING_BYTES - 1;
+            } else {
+                // Lines are ingested between the waits; only the blocking draws let bytes pile up.
+                uint64_t b1 = Boot_Bytes(l, n, lcd, lcd + LCD_PRICE_US);
+                uint64_t b2 = Boot_Bytes(l, n, sel, sel + BOOT_BANNER_DRAW_US);
+                peak = b1 > b2 ? b1 : b2;
+                first_line = l[0].end;
+                if (first_line >= lcd && first_line < lcd + LCD_PRICE_US)
+                    first_line = lcd + LCD_PRICE_US;
+                else if (first_line >= sel && first_line < sel + BOOT_BANNER_DRAW_US)
+                    first_line = sel + BOOT_BANNER_DRAW_US;
+                first_price = l[price_i].end > ui ? l[price_i].end : ui;
+            }
+            v[m][5][k] = first_line;
+            v[m][6][k] = first_price;
+            v[m][7][k] = peak;
+            if (lost)
+                lost_units[m]++;
+        }
+    }
+
+    printf("fleetsim boot: %u units power up with their ESP32s, threshold screen held %.1f s\n",
+           n_units, select_us / 1e6);
+    printf("  backfill: %u frames, %u bytes; UART ring %u bytes\n", n_frames, frame_bytes, BOOT_RING_BYTES);
+    for (m = 0; m < 2; m++) {
+        printf("  %s boot, stage reached at (ms since power-up):\n", m ? "overlapped" : "sequential");
+        for (s = 0; s < 8; s++)
+            Boot_Row(stage[s], v[m][s], n_units, s < 7 ? 1000.0 : 1.0);
+        printf("    ring overflowed on %u units, backfill frames lost %u\n", lost_units[m], cold[m]);
+    }
+    for (m = 0; m < 2; m++)
+        for (s = 0; s < 8; s++)
+            free(v[m][s]);
+}
+
+// Self-test co-simulation (-T): one ESP32 runs the link self-test plan (selftest.c) against one
+// TM4C over the UART model, with the firmware's frame codec and self-test accounting on the real
+// text. The ESP32 paces each step as the sketch does and waits for the wire before every line.
+// The TM4C handles one line at a time: its cost per character covers the receive interrupt,
+// line assembly, checksum and decode at 50 MHz, and a progress redraw keeps the HD44780 busy
+// for a cursor command and 16 characters. Bytes that arrive while the 2 KB ring is full are
+// lost, and so is the line they belong to.
+#define TEST_US_PER_CHAR 3U           // Line handling per character
+#define TEST_DRAW_US     (17U * 6000U)  // Progress row: set cursor plus 16 characters at 6 ms
+#define TEST_MAX_LINES   20000
+
+typedef struct {
+    uint64_t start, end;              // Wire time (us)
+    uint32_t len;                     // Characters, newline excluded
+    uint8_t damaged;                  // A byte was hit on the wire or dropped by a full ring
+    char text[FRAME_MAX_LEN + 2];
+} TestLine;
+
+static uint32_t test_mode;
+
+// Queue a test frame on the wire at 't' (or when the previous line is out); returns its start.
+static uint64_t Test_Send(TestLine *l, uint32_t *n, uint64_t t, const FrameTest *f, uint32_t *rng) {
+    TestLine *x = &l[*n];
+    uint64_t start = *n && l[*n - 1].end > t ? l[*n - 1].end : t;
+    uint32_t i;
+    if (*n >= TEST_MAX_LINES)
+        return start;
+    x->len = (uint32_t)Frame_Encode_Test(x->text, sizeof(x->text), f);
+    x->start = start;
+    x->end = start + Wire_Us(x->len + 1, CFG_UART_BAUD);
+    x->damaged = 0;
+    for (i = 0; byte_error_rate > 0.0 && i <= x->len; i++) {
+        if (Rand(rng) < byte_error_rate * 4294967296.0)
+            x->damaged = 1;
+    }
+    (*n)++;
+    return start;
+}
+
+static void Test_Report(void) {
+    static SelfTest st;
+    TestLine *l = malloc(TEST_MAX_LINES * sizeof(TestLine));
+    uint32_t n = 0, i, j, rng = seed * 2654435761U | 1, size, rate;
+    uint64_t t = 0, start, next, p, busy_until = 0, backlog, fill;
+    FrameTest f;
+    char frame[64];
+    const char *payload;
+    size_t plen;
+    char tag;
+
+    // The ESP32 side of runSelfTest().
+    for (f.step = 0; SelfTest_Plan(f.step, &size, &rate); f.step++) {
+        start = next = t;
+        f.rate = rate;
+        f.size = size;
+        for (f.seq = 0;; f.seq++) {
+            uint64_t at = n && l[n - 1].end > next ? l[n - 1].end : next;
+            if (at - start >= CFG_SELFTEST_STEP_MS * 1000ULL)
+                break;
+            Test_Send(l, &n, next, &f, &rng);
+            next += 1000000U / rate;
+        }
+        f.size = 0;
+        Test_Send(l, &n, next, &f, &rng);
+        t = l[n - 1].end + CFG_SELFTEST_GAP_MS * 1000ULL;
+    }
+    f.seq = f.rate = f.size = 0;
+    Test_Send(l, &n, t, &f, &rng);
+
+    // The TM4C side: one line at a time, in arrival order.
+    for (i = 0; i < n; i++) {
+        p = l[i].end > busy_until ? l[i].end : busy_until;
+        backlog = 0;
+        fill = 0;
+        for (j = i + 1; j < n && l[j].start < p; j++) {
+            uint64_t got = l[j].end <= p ? l[j].len + 1 : (l[j].len + 1) * (p - l[j].start) / (l[j].end - l[j].start);
+            backlog += got;
+            fill += l[j].len + 1;
+            if (fill > BOOT_RING_BYTES - 1)
+                l[j].damaged = 1;                 // Arrived while the ring was full.
+        }
+        busy_until = p + (uint64_t)TEST_US_PER_CHAR * (l[i].len + 1);
+        if (l[i].damaged) {
+            SelfTest_Bad(&st);                    // Read_Line() drops it (Link_Line_Dropped()).
+        } else if (Frame_Open(l[i].text, &tag, &payload, &plen) && tag == CFG_FRAME_TEST &&
+                   Frame_Decode_Test(payload, plen, &f)) {
+            SelfTest_Frame(&st, &f, (uint32_t)p, (uint32_t)(backlog > BOOT_RING_BYTES - 1 ? BOOT_RING_BYTES - 1 : backlog));
+        } else {
+            SelfTest_Bad(&st);
+        }
+        SelfTest_Busy(&st, (uint32_t)(busy_until - p));
+        if (st.draw) {
+            SelfTest_Drawn(&st, TEST_DRAW_US);
+            busy_until += TEST_DRAW_US;
+        }
+    }
+
+    printf("fleetsim self-test: %u lines over %.1f s at %u baud, byte error rate %g\n",
+           n, l[n - 1].end / 1e6, CFG_UART_BAUD, byte_error_rate);
+    printf("  step  size  rate   sent   recv  bad  meas/s  cpu%%  draws  skipped  backlog\n");
+    for (i = 0; i < st.steps; i++) {
+        const SelfTestStep *s = &st.step[i];
+        uint32_t span = s->last_us - s->first_us;
+        uint32_t cpu = span ? (uint32_t)(((uint64_t)s->busy_us + s->draw_us) * 100U / span) : 0;
+        printf("  %4u  %4u  %4u  %5u  %5u  %3u  %6u  %4u  %5u  %7u  %7u\n", i, s->size, s->rate, s->sent,
+               s->received, s->bad, SelfTest_Rate(s),
+               cpu > 100 ? 100 : cpu, s->draws, s->skipped, s->backlog_max);
+    }
+    if (st.state == SELFTEST_DONE && Frame_Encode_Test_Result(frame, sizeof(frame), &st.result))
+        printf("  result: best %u frames/s of %u bytes (%u B/s, cpu %u%%), parsing fell behind at %u/s, "
+               "display at %u/s, %u lost\n  sent back as %s\n",
+               st.result.best_rate, st.result.best_size, st.result.best_bps, st.result.cpu_pct,
+               st.result.parse_rate, st.result.display_rate, st.result.lost, frame);
+    else
+        printf("  result: the done frame was lost\n");
+    free(l);
+}
+
+// UART flow control model, one character time per step. The ESP32 sends the backfill frames
+// of FLOW_ASSETS assets back to back (a multi-asset snapshot), each line after a break that
+// puts one marker byte in the ring. It honours the TM4C's flow state with a lag: RTS/CTS
+// stops it before the next character; an XOFF first waits behind a full TX FIFO, then takes
+// a character time on the wire and one more for the ESP32 to finish the character it is
+// sending. The sketch's flush before a break waits for the line, but the break itself
+// ignores flow control. The TM4C takes a whole line out of the 2 KB ring when it is free and
+// then spends -W ms on it; the receive interrupt and the main loop run the firmware's
+// Flow_Update() on the fill level. Bytes arriving at a full ring are dropped and their line
+// is lost.
+#define FLOW_ASSETS    16
+#define FLOW_RTS_LAG   1U             // Characters from the decision until the sender stops or goes
+#define FLOW_XOFF_LAG  (16U + 1U + 1U)
+#define FLOW_MAX_LINES 512
+
+static uint32_t flow_mode, flow_line_us = 20000;
+
+typedef struct {
+    uint64_t us;                      // Until the last line was handled
+    uint32_t stalled;                 // Character times the sender waited
+    uint32_t dropped, lost;           // Bytes dropped at the full ring, lines lost with them
+    UartFlow flow;
+} FlowResult;
+
+static void Flow_Run(int mode, const uint32_t *len, uint32_t n, FlowResult *r) {
+    uint8_t hist[64];                 // Flow state at the end of the last 64 character times
+    uint16_t stored[FLOW_MAX_LINES];  // Bytes of each line that made it into the ring
+    uint32_t lag = mode == FLOW_RTSCTS ? FLOW_RTS_LAG : FLOW_XOFF_LAG;
+    uint32_t brk_slots = (uint32_t)(((uint64_t)CFG_UART_BREAK_US * CFG_UART_BAUD + 9999999U) / 10000000U);
+    uint32_t first = CFG_UART_BREAK_US ? 0 : 1;  // Byte 0 of a line is the break marker
+    uint32_t sl = 0, pos = first, brk = 0, complete = 0, cons = 0, pending = 0;
+    uint64_t k, tk, busy = 0;
+
+    memset(r, 0, sizeof(*r));
+    memset(hist, 0, sizeof(hist));
+    memset(stored, 0, sizeof(stored));
+    for (k = 0; cons < n && k < 100000000ULL; k++) {
+        tk = k * 10000000ULL / CFG_UART_BAUD;
+        if (sl < n) {
+            int put = 0;
+            if (pos == 0) {
+                if (brk == 0)
+                    brk = brk_slots;
+                put = --brk == 0;     // The marker comes in at the end of the break.
+            } else if (mode == FLOW_NONE || k < lag || !hist[(k - lag) & 63]) {
+                put = 1;
+            } else {
+                r->stalled++;
+            }
+            if (put) {
+                if (pending >= BOOT_RING_BYTES - 1) {
+                    r->dropped++;
+                } else {
+                    pending++;
+                    stored[sl]++;
+                }
+                if (++pos == len[sl] + 2) {
+                    complete++;
+                    sl++;
+                    pos = first;
+                }
+                if (mode != FLOW_NONE)
+                    Flow_Update(&r->flow, pending);
+            }
+        }
+        if (cons < complete && tk >= busy) {
+            pending -= stored[cons];
+            if (stored[cons] != len[cons] + 2 - first)
+                r->lost++;
+            busy = tk + (uint64_t)TEST_US_PER_CHAR * (len[cons] + 1) + flow_line_us;
+            cons++;
+            if (mode != FLOW_NONE)
+                Flow_Update(&r->flow, pending);
+        }
+        if (mode == FLOW_NONE && pending > r->flow.peak)
+            r->flow.peak = pending;
+        hist[k & 63] = r->flow.stopped;
+    }
+    r->us = busy;
+}
+
+static void Flow_Report(void) {
+    static const char *name[] = { "none", "RTS/CTS", "XON/XOFF" };
+    uint32_t asset_len[32], per = Boot_Backfill(asset_len, 32), len[FLOW_MAX_LINES], n = 0, bytes = 0, i;
+    FlowResult r;
+    int mode;
+
+    for (i = 0; i < FLOW_ASSETS * per && n < FLOW_MAX_LINES; i++, n++) {
+        len[n] = asset_len[i % per];
+        bytes += len[n] + 1;
+    }
+    printf("fleetsim flow control: %u backfill frames of %u assets (%u bytes) at %u baud, "
+           "%.1f ms per line on the TM4C, marks %u/%u of %u bytes\n",
+           n, FLOW_ASSETS, bytes, CFG_UART_BAUD, flow_line_us / 1000.0, CFG_UART_FLOW_LOW, CFG_UART_FLOW_HIGH,
+           BOOT_RING_BYTES);
+    printf("  %-9s %8s %8s %9s %6s %10s %9s %10s\n", "mode", "time s", "B/s", "stalled%", "stops",
+           "ring peak", "dropped B", "lines lost");
+    for (mode = FLOW_NONE; mode <= FLOW_XONXOFF; mode++) {
+        Flow_Run(mode, len, n, &r);
+        printf("  %-9s %8.2f %8.0f %9.1f %6u %10u %9u %10u\n", name[mode], r.us / 1e6,
+               (double)bytes * 1e6 / (double)r.us,
+               100.0 * r.stalled * 10000000.0 / CFG_UART_BAUD / (double)r.us, r.flow.stops, r.flow.peak,
+               r.dropped, r.lost);
+    }
+}
+
+// Shared LCD bus: lcdbus.c schedules the writes of 1..-L HD44780 panels on one data bus, as
+// LCD_Poll() does on the TM4C, and a model of each panel checks them. Every round puts a new
+// price of a different asset on each panel and runs the bus until all of them show it. The
+// schedule is run twice: one byte at a time, each waiting out its execution time, and
+// interleaved, writing the other panels while one executes. The old blocking driver (6 ms
+// per byte, clear and both rows redrawn) is given for scale.
+#define LCD_BYTE_US    5U             // Bus time of one byte (LCD_BYTE_US in tracker.c)
+#define LCD_ROUNDS     1000U
+#define LCD_OLD_US     (35U * 6000U + 2000U)  // Blocking redraw: clear, two cursor moves, 32 characters
+
+static uint32_t lcd_panels;
+
+// Host model of one HD44780 in 4-bit mode with R/W tied low: a byte that arrives while the
+// controller still executes the previous one is lost (it would be garbled on the real part).
+typedef struct {
+    char ddram[0x80];
+    uint8_t addr;
+    uint64_t busy_until;
+    uint32_t bytes, lost;
+} Hd44780;
+
+static void Hd_Write(Hd44780 *h, uint64_t t, uint8_t rs, uint8_t byte) {
+    h->bytes++;
+    if (t < h->busy_until) {
+        h->lost++;
+        return;
+    }
+    if (rs) {
+        h->ddram[h->addr & 0x7F] = (char)byte;
+        h->addr++;
+    } else if (byte & 0x80) {
+        h->addr = byte & 0x7F;
+    }
+    h->busy_until = t + CFG_LCD_EXEC_US;
+}
+
+// Cells of the model that differ from what the shadow says it shows.
+static uint32_t Hd_Mismatch(const Hd44780 *h, const LcdPanel *p) {
+    uint32_t r, c, n = 0;
+    for (r = 0; r < CFG_LCD_ROWS; r++)
+        for (c = 0; c < CFG_LCD_COLS; c++)
+            n += h->ddram[(r ? 0x40 : 0x00) + c] != p->want[r][c];
+    return n;
+}
+
+typedef struct {
+    uint64_t us;                      // Bus time of all rounds
+    uint64_t round_max;               // Longest round
+    uint32_t bytes, lost, mismatch;
+} LcdResult;
+
+static void Lcd_Run(uint32_t panels, int interleave, LcdResult *r) {
+    static Hd44780 hd[LCDBUS_MAX_PANELS];
+    static LcdBus bus;
+    double value[LCDBUS_MAX_PANELS];
+    uint32_t rng = seed * 2654435761U | 1, k, i;
+    uint64_t t = 0, start;
+    LcdBusOp op;
+    const char *s;
+    char text[24];
+
+    memset(r, 0, sizeof(*r));
+    memset(hd, 0, sizeof(hd));
+    LcdBus_Init(&bus, (uint8_t)panels, CFG_LCD_EXEC_US + LCD_BYTE_US);
+    LcdBus_Up(&bus, 0);
+    for (i = 0; i < panels; i++) {
+        memset(hd[i].ddram, ' ', sizeof(hd[i].ddram));
+        value[i] = 97000.0 / (i + 1);
+    }
+    for (k = 0; k < LCD_ROUNDS; k++) {
+        for (i = 0; i < panels; i++) {    // Show_Price on each panel: a new price and change.
+            int whole;
+            double change = ((double)(Rand(&rng) % 2001) - 1000.0) * 0.005;
+            value[i] *= 1.0 + change * 1e-3;
+            whole = (int)value[i];
+            LcdBus_Clear(&bus, (uint8_t)i);
+            snprintf(text, sizeof(text), "Asset %u", i);
+            for (s = text; *s; s++)
+                LcdBus_Put(&bus, (uint8_t)i, *s);
+            LcdBus_Cursor(&bus, (uint8_t)i, 0, 1);
+            snprintf(text, sizeof(text), "$%d,%03d  %+.2f%%", whole / 1000, whole % 1000, change);
+            for (s = text; *s; s++)
+                LcdBus_Put(&bus, (uint8_t)i, *s);
+        }
+        start = t;
+        for (;;) {
+            uint32_t wait;
+            if (LcdBus_Next(&bus, (uint32_t)t, &op)) {
+                Hd_Write(&hd[op.panel], t + LCD_BYTE_US, op.rs, op.byte);
+                t += interleave ? LCD_BYTE_US : CFG_LCD_EXEC_US + LCD_BYTE_US;
+                continue;
+            }
+            wait = LcdBus_Wait(&bus, (uint32_t)t);
+            if (wait == LCDBUS_IDLE)
+                break;
+            t += wait;
+        }
+        if (t - start > r->round_max)
+            r->round_max = t - start;
+    }
+    r->us = t;
+    for (i = 0; i < panels; i++) {
+        r->bytes += hd[i].bytes;
+        r->lost += hd[i].lost;
+        r->mismatch += Hd_Mismatch(&hd[i], &bus.panel[i]);
+    }
+}
+
+static void Lcd_Report(void) {
+    LcdResult r[2];
+    uint32_t n, m;
+
+    printf("fleetsim LCD bus: %u rounds of a new price on every panel, %u us per byte on the bus, "
+           "%u us execution\n", LCD_ROUNDS, LCD_BYTE_US, CFG_LCD_EXEC_US);
+    printf("  %-6s %-11s %10s %10s %11s %12s %5s %9s\n", "panels", "schedule", "bytes/s", "updates/s",
+           "round ms", "max round ms", "lost", "mismatch");
+    for (n = 1; n <= lcd_panels; n++) {
+        printf("  %-6u %-11s %10.0f %10.1f %11.2f %12.2f %5s %9s\n", n, "blocking", 35e6 / LCD_OLD_US,
+               1e6 / LCD_OLD_US, LCD_OLD_US / 1000.0 * n, LCD_OLD_US / 1000.0 * n, "-", "-");
+        for (m = 0; m < 2; m++) {
+            Lcd_Run(n, (int)m, &r[m]);
+            printf("  %-6u %-11s %10.0f %10.1f %11.2f %12.2f %5u %9u\n", n, m ? "interleaved" : "serial",
+                   r[m].bytes * 1e6 / (double)r[m].us, (double)LCD_ROUNDS * n * 1e6 / (double)r[m].us,
+                   r[m].us / 1000.0 / LCD_ROUNDS, r[m].round_max / 1000.0, r[m].lost, r[m].mismatch);
+        }
+    }
+}
+
+// History backfill: the ESP32 packs a day of 5-minute points into '$B' frames as
+// encodeBackfill() in the sketch does (a counting pass, then the frames with their total),
+// and the TM4C decodes them with frame.c and ingests the series with history.c, behind
+// live ticks that arrived first. The frames go out back to back at the UART baud rate and
+// each line costs TEST_US_PER_CHAR per character on the TM4C. The decode and ingest times
+// are measured on this machine; the ingest runs once, as on the TM4C, which has no way to
+// reset its history.
+#define HIST_LIVE_TICKS 3U            // Live prices received before the backfill completes
+#define HIST_MAX_FRAMES 32U
+#define HIST_DECODES    10000U        // Decode passes timed (decoding has no side effects)
+
+static uint32_t hist_mode;
+
+static uint16_t Hist_Encode(char (*line)[CFG_UART_BUFFER_SIZE + 1], uint32_t *len, const int32_t *p, uint16_t total) {
+    FrameBackfill hdr;
+    uint16_t n = 0, off;
+    for (off = 0; off < CFG_BACKFILL_MAX_POINTS && n < HIST_MAX_FRAMES; off += hdr.n, n++) {
+        hdr.seq = n;
+        hdr.total = total;
+        hdr.t0 = EPOCH0_TIME + off * 300U;
+        hdr.dt = 300;
+        len[n] = (uint32_t)Frame_Encode_Backfill(line[n], sizeof(line[n]), &hdr, p + off,
+                                                 (uint16_t)(CFG_BACKFILL_MAX_POINTS - off));
+        if (len[n] == 0 || hdr.n == 0)
+            return 0;
+    }
+    return n;
+}
+
+// Decode the frames into 'got' as Backfill_Frame() in link.c does; returns the points, 0 on a bad frame.
+static uint32_t Hist_Decode(char (*line)[CFG_UART_BUFFER_SIZE + 1], uint16_t n, int32_t *got) {
+    FrameBackfill hdr;
+    const char *payload;
+    size_t plen;
+    uint32_t points = 0;
+    uint16_t i;
+    char tag;
+    for (i = 0; i < n; i++) {
+        if (!Frame_Open(line[i], &tag, &payload, &plen) || tag != CFG_FRAME_BACKFILL ||
+            !Frame_Decode_Backfill(payload, plen, &hdr, got + points, (uint16_t)(CFG_BACKFILL_MAX_POINTS - points)) ||
+            hdr.seq != i || hdr.total != n || hdr.t0 != EPOCH0_TIME + points * 300U)
+            return 0;
+        points += hdr.n;
+    }
+    return points;
+}
+
+static void Hist_Report(void) {
+    static int32_t p[CFG_BACKFILL_MAX_POINTS], got[CFG_BACKFILL_MAX_POINTS];
+    static char line[HIST_MAX_FRAMES][CFG_UART_BUFFER_SIZE + 1];
+    uint32_t len[HIST_MAX_FRAMES], bytes = 0, json = 0, rng = seed | 1, i, points = 0, ingested, same = 0;
+    uint32_t t_live = EPOCH0_TIME + CFG_BACKFILL_MAX_POINTS * 300U;
+    uint64_t wire = 0;
+    double t, decode_s, ingest_s;
+    char pair[64];
+    HistStats day;
+    uint16_t n;
+
+    p[0] = (int32_t)price[0];
+    for (i = 1; i < CFG_BACKFILL_MAX_POINTS; i++)
+        p[i] = p[i - 1] + (int32_t)(Rand(&rng) % 121) - 60;
+    for (i = 0; i < CFG_BACKFILL_MAX_POINTS; i++)  // market_chart body: [ms, price] pairs
+        json += (uint32_t)snprintf(pair, sizeof(pair), "[%llu,%.10g],",
+                                   (unsigned long long)(EPOCH0_TIME + i * 300ULL) * 1000ULL,
+                                   p[i] + (Rand(&rng) % 100000) / 100000.0);
+    json += (uint32_t)strlen("{\"prices\":[]}") - 1;
+
+    n = Hist_Encode(line, len, p, 0);
+    if (n == 0 || Hist_Encode(line, len, p, n) != n) {
+        fprintf(stderr, "fleetsim: backfill encoding failed\n");
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        bytes += len[i] + 1;
+        wire += Wire_Us(len[i] + 1, CFG_UART_BAUD);
+    }
+
+    t = Now_S();
+    for (i = 0; i < HIST_DECODES; i++)
+        points = Hist_Decode(line, n, got);
+    decode_s = (Now_S() - t) / HIST_DECODES;
+    for (i = 0; i < points; i++)
+        same += got[i] == p[i];
+
+    for (i = 0; i < HIST_LIVE_TICKS; i++)
+        History_Add(t_live + i * HIST_SPACING_S, (int32_t)price[1 + i]);
+    t = Now_S();
+    ingested = History_Ingest(EPOCH0_TIME, 300, got, points);
+    ingest_s = Now_S() - t;
+    History_Stats(0, &day);
+
+    printf("fleetsim backfill: %u points of %u s at %u baud, %u live ticks first\n",
+           CFG_BACKFILL_MAX_POINTS, 300U, CFG_UART_BAUD, HIST_LIVE_TICKS);
+    printf("  frames %u, %u bytes on the wire (%.2f per point); market_chart JSON %u bytes (%.1fx)\n",
+           n, bytes, (double)bytes / CFG_BACKFILL_MAX_POINTS, json, (double)json / bytes);
+    printf("  transfer %.1f ms on the wire, last line handled %.1f ms after the first byte\n",
+           wire / 1000.0, (wire + (uint64_t)TEST_US_PER_CHAR * (len[n - 1] + 1)) / 1000.0);
+    printf("  decode %.2f us per series (host), %u of %u points match\n", decode_s * 1e6, same,
+           CFG_BACKFILL_MAX_POINTS);
+    printf("  ingest %.2f us (host, one run), %u points stored; history %u samples, "
+           "oldest %+d s, newest %+d s, live ticks %s\n",
+           ingest_s * 1e6, ingested, History_Count(), (int)(History_Oldest() - EPOCH0_TIME),
+           (int)(History_Newest() - t_live),
+           History_Newest() + HIST_SPACING_S > t_live + (HIST_LIVE_TICKS - 1) * HIST_SPACING_S && day.count == points + HIST_LIVE_TICKS
+               ? "kept" : "LOST");
+}
+
+int main(int argc, char **argv) {
+    uint32_t k, i, per, u0 = 0, rng;
+    int opt;
+    double t0;
+
+    n_threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "n:m:k:d:j:e:i:r:b:E:As:BU:TFW:L:H")) != -1) {
+        switch (opt) {
+        case 'n': n_units = (uint32_t)atoi(optarg); break;
+        case 'm': mqtt = strcmp(optarg, "rs485") != 0; break;
+        case 'k': per_bus = (uint32_t)atoi(optarg); break;
+        case 'd': duration_us = (uint64_t)(atof(optarg) * 1e6); break;
+        case 'j': n_threads = (uint32_t)atoi(optarg); break;
+        case 'e': epoch_us = (uint64_t)(atof(optarg) * 1e3); break;
+        case 'i': poll_us = (uint64_t)atoi(optarg) * 1000; break;
+        case 'r': bus_baud = (uint32_t)atoi(optarg); break;
+        case 'b': broker_us = (uint32_t)atoi(optarg); break;
+        case 'E': byte_error_rate = atof(optarg); break;
+        case 'A': use_archive = 0; break;
+        case 's': seed = (uint32_t)atoi(optarg); break;
+        case 'B': boot_mode = 1; break;
+        case 'U': select_us = (uint64_t)(atof(optarg) * 1e6); break;
+        case 'T': test_mode = 1; break;
+        case 'F': flow_mode = 1; break;
+        case 'W': flow_line_us = (uint32_t)(atof(optarg) * 1e3); break;
+        case 'L': lcd_panels = (uint32_t)atoi(optarg); break;
+        case 'H': hist_mode = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-n units] [-m mqtt|rs485] [-k units_per_bus] [-d seconds] [-j threads] "
+                            "[-e epoch_ms] [-i poll_ms] [-r bus_baud] [-b broker_us] [-E byte_error_rate] [-A] [-s seed] "
+                            "[-B [-U select_s]] [-T] [-F [-W line_ms]] [-L panels] [-H]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (n_units == 0 || per_bus == 0 || n_threads == 0 || epoch_us == 0 || poll_us < 1000000 || bus_baud == 0) {
+        fprintf(stderr, "fleetsim: bad arguments\n");
+        return 2;
+    }
+    per = mqtt ? 1 : per_bus;
+    n_segs = (n_units + per - 1) / per;
+    if (n_threads > n_segs)
+        n_threads = n_segs;
+    n_polls = (uint32_t)(duration_us / poll_us) + 1;
+
+    // Shared price series: a random walk around 97k USD.
+    price = malloc(n_polls * sizeof(double));
+    rng = seed * 2654435761U | 1;
+    price[0] = 97000.0;
+    for (k = 1; k < n_polls; k++)
+        price[k] = price[k - 1] * (1.0 + ((double)(Rand(&rng) % 2001) - 1000.0) * 1e-6);
+    pub_rng = rng;
+    pub_t = Fetch_Us(&pub_rng);
+    if (boot_mode) {
+        Boot_Report();
+        return 0;
+    }
+    if (test_mode) {
+        Test_Report();
+        return 0;
+    }
+    if (flow_mode) {
+        Flow_Report();
+        return 0;
+    }
+    if (hist_mode) {
+        Hist_Report();
+        return 0;
+    }
+    if (lcd_panels) {
+        if (lcd_panels > LCDBUS_MAX_PANELS) {
+            fprintf(stderr, "fleetsim: at most %u panels\n", LCDBUS_MAX_PANELS);
+            return 2;
+        }
+        Lcd_Report();
+        return 0;
+    }
+
+    segs = calloc(n_segs, sizeof(Segment));
+    for (k = 0; k < n_segs; k++) {
+        Segment *s = &segs[k];
+        s->rng = (seed + k) * 2654435761U | 1;
+        s->n_unit = (n_units - u0 < per) ? n_units - u0 : per;
+        s->unit = calloc(s->n_unit, sizeof(Unit));
+        u0 += s->n_unit;
+        if (use_archive) {
+            s->store = malloc(ARCHIVE_BYTES_PER_ASSET);
+            if (!s->store) {
+                fprintf(stderr, "fleetsim: out of memory for archives; try -A\n");
+                return 1;
+            }
+            Archive_Init(&s->archive, s->store);
+            for (i = 0; i < s->n_unit; i++)  // Stagger the displays' query timers.
+                Push(s, (uint64_t)(Rand(&s->rng) % (CFG_ARCHIVE_QUERY_MS / 2)) * 1000, 0, EV_QUERY, i, 0);
+        }
+        if (!mqtt)
+            Push(s, (s->rng % 1000) * 1000 + Fetch_Us(&s->rng), 0, EV_FETCH, 0, 0);
+    }
+
+    workers = calloc(n_threads, sizeof(Worker));
+    for (k = 0; k < n_threads; k++) {
+        Worker *w = &workers[k];
+        w->id = k;
+        w->first = (uint32_t)((uint64_t)n_segs * k / n_threads);
+        w->count = (uint32_t)((uint64_t)n_segs * (k + 1) / n_threads) - w->first;
+        w->dq.item = malloc((w->count ? w->count : 1) * sizeof(uint32_t));
+        pthread_mutex_init(&w->dq.lock, NULL);
+        w->next_min = 0;          // The first epoch starts at time 0.
+    }
+    pthread_barrier_init(&bar, NULL, n_threads);
+    Epoch_Next();
+
+    t0 = Now_S();
+    for (k = 1; k < n_threads; k++)
+        pthread_create(&workers[k].thread, NULL, Worker_Main, &workers[k]);
+    Worker_Main(&workers[0]);
+    for (k = 1; k < n_threads; k++)
+        pthread_join(workers[k].thread, NULL);
+    Report(Now_S() - t0);
+    return 0;
+}
@@ -0,0 +1,330 @@
+//frame_test.c
+// Host test of the telemetry frame (build/frame.c): Frame_Encode_Telemetry() and
+// Frame_Decode_Telemetry(), through Frame_Open() as link.c receives it; and of the delta
+// symbols, backfill and window frames against damaged and hostile input.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Ibuild -o frame_test linux/frame_test.c build/frame.c && ./frame_test
+//
+// Checked: every field survives a round trip, including negative RSSI and HTTP status, the
+// int32/uint32 extremes and 20000 random records (or the encoder refuses a record whose
+// frame would not fit the TM4C's line buffer); any changed checksum digit or payload
+// character is rejected; a line cut off anywhere is rejected, and so is a correctly sealed
+// frame missing fields; extra fields, trailing characters, values past 32 bits and signs or
+// blanks inside a number are rejected. Deltas round-trip over the whole int32 range and a
+// symbol sequence past 32 bits is refused; backfill and window frames round-trip, and one
+// whose first value or any delta sum leaves the int32 range is refused.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "frame.h"
+#include "check.h"
+
+static uint32_t rng = 11;
+
+static uint32_t Rand(void) {
+    rng = rng * 1664525U + 1013904223U;
+    return rng;
+}
+
+// A value of 1 to 10 digits.
+static uint32_t Rand_Digits(void) {
+    static const uint32_t pow10[] = { 10U, 100U, 1000U, 10000U, 100000U, 1000000U, 10000000U,
+                                      100000000U, 1000000000U, 0xFFFFFFFFU };
+    return Rand() % pow10[(Rand() >> 8) % 10U];
+}
+
+// Open 'line' as link.c does and decode it; 1 if both succeed with tag 'T'.
+static int Receive(const char *line, FrameTelemetry *t) {
+    const char *payload;
+    size_t len;
+    char tag;
+    if (!Frame_Open(line, &tag, &payload, &len) || tag != CFG_FRAME_TELEMETRY)
+        return 0;
+    return Frame_Decode_Telemetry(payload, len, t);
+}
+
+// Same as Receive() for a payload that is sealed with a correct checksum first, so only the
+// decoder can refuse it.
+static int Receive_Payload(const char *payload) {
+    char line[256];
+    FrameTelemetry t;
+    size_t n = (size_t)snprintf(line, sizeof(line), "$%c%s", CFG_FRAME_TELEMETRY, payload);
+    if (Frame_Seal(line, n, sizeof(line)) == 0)
+        return 0;
+    return Receive(line, &t);
+}
+
+static int Same(const FrameTelemetry *a, const FrameTelemetry *b) {
+    return a->uptime_s == b->uptime_s && a->rssi == b->rssi && a->reconnects == b->reconnects &&
+           a->http_status == b->http_status && a->fail == b->fail && a->dns_ms == b->dns_ms &&
+           a->connect_ms == b->connect_ms && a->ttfb_ms == b->ttfb_ms && a->body_ms == b->body_ms &&
+           a->heap_free == b->heap_free && a->heap_block == b->heap_block && a->fetches == b->fetches &&
+           a->failures == b->failures;
+}
+
+// Encode 't', check the round trip and that every damaged copy of the line is refused.
+// Returns 0 if the encoder refused it.
+static int Check_Record(const FrameTelemetry *t, const char *what) {
+    char line[256], bad[256];
+    FrameTelemetry got;
+    size_t n = Frame_Encode_Telemetry(line, sizeof(line), t), i, k;
+    if (n == 0)
+        return 0;
+    CHECK(n <= FRAME_MAX_LEN && n == strlen(line), "%s: frame of %u characters", what, (unsigned)n);
+    memset(&got, 0x5A, sizeof(got));
+    CHECK(Receive(line, &got) && Same(&got, t), "%s: round trip of %s", what, line);
+
+    // Each checksum digit replaced by every other hex digit.
+    for (i = n - 2; i < n; i++) {
+        for (k = 0; k < 16; k++) {
+            memcpy(bad, line, n + 1);
+            bad[i] = "0123456789ABCDEF"[k];
+            if (bad[i] != line[i])
+                CHECK(!Receive(bad, &got), "%s: checksum digit %u changed to %c accepted", what,
+                      (unsigned)(i - (n - 2)), bad[i]);
+        }
+    }
+    // Any one payload character with one bit flipped.
+    for (i = 2; i < n - 3; i++) {
+        for (k = 0; k < 7; k++) {
+            memcpy(bad, line, n + 1);
+            bad[i] ^= (char)(1 << k);
+            if (bad[i] != '*')
+                CHECK(!Receive(bad, &got), "%s: bit %u of character %u flipped accepted", what,
+                      (unsigned)k, (unsigned)i);
+        }
+    }
+    // Cut off anywhere (a lost tail, as Read_Line would hand it over).
+    for (i = 0; i < n; i++) {
+        memcpy(bad, line, i);
+        bad[i] = '\0';
+        CHECK(!Receive(bad, &got), "%s: line cut to %u characters accepted", what, (unsigned)i);
+    }
+    return 1;
+}
+
+static void Check_Round_Trips(void) {
+    static const FrameTelemetry fixed[] = {
+        { 3725, -67, 3, 200, FRAME_FAIL_NONE, 12, 840, 310, 45, 123456, 98304, 1200, 17 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 86400, -95, 12, -1, FRAME_FAIL_HTTP, 5, 0, 0, 0, 40000, 36000, 5, 5 },
+        { 10, 0, 0, -11, FRAME_FAIL_TLS, 20, 10000, 0, 0, 180000, 110592, 1, 1 },
+        { 99, -1, 1, 429, FRAME_FAIL_HTTP, 1, 2, 3, 4, 5, 6, 7, 8 },
+        { 7, 0, 0, 200, FRAME_FAIL_API, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 1, INT32_MIN, 0, INT32_MIN, FRAME_FAIL_WIFI, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 1, INT32_MAX, 0, INT32_MAX, FRAME_FAIL_DNS, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 0xFFFFFFFFU, -128, 0xFFFFFFFFU, -32768, 0, 0xFFFFFFFFU, 0, 0, 0, 0xFFFFFFFFU, 0, 0xFFFFFFFFU, 0 },
+    };
+    FrameTelemetry t;
+    char what[32], line[256];
+    uint32_t i, encoded = 0, refused = 0;
+    for (i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) {
+        snprintf(what, sizeof(what), "record %u", i);
+        CHECK(Check_Record(&fixed[i], what), "record %u refused by the encoder", i);
+    }
+
+    // All fields at their widest: over FRAME_MAX_LEN, so the encoder refuses it.
+    memset(&t, 0xFF, sizeof(t));
+    t.rssi = t.http_status = INT32_MIN;
+    CHECK(Frame_Encode_Telemetry(line, sizeof(line), &t) == 0, "a %u-character frame was encoded",
+          (unsigned)strlen(line));
+    t = fixed[0];
+    CHECK(Frame_Encode_Telemetry(line, 40, &t) == 0, "encoded into a 40-byte buffer");
+
+    for (i = 0; i < 20000; i++) {
+        int32_t *s;
+        uint32_t *u = &t.uptime_s;
+        uint32_t k;
+        for (k = 0; k < sizeof(t) / sizeof(uint32_t); k++)
+            u[k] = Rand_Digits();
+        s = &t.rssi;
+        *s = -(int32_t)(Rand() % 120U);
+        s = &t.http_status;
+        *s = (Rand() & 1) ? -(int32_t)(Rand() % 20U) : (int32_t)(Rand() % 600U);
+        t.fail = Rand() % 6U;
+        snprintf(what, sizeof(what), "random %u", i);
+        if (i % 64U != 0) {       // The damaged copies of a few hundred are enough
+            char buf[256];
+            FrameTelemetry got;
+            size_t n = Frame_Encode_Telemetry(buf, sizeof(buf), &t);
+            if (n == 0) {
+                refused++;
+                continue;
+            }
+            encoded++;
+            CHECK(Receive(buf, &got) && Same(&got, &t), "%s: round trip of %s", what, buf);
+        } else if (Check_Record(&t, what)) {
+            encoded++;
+        } else {
+            refused++;
+        }
+    }
+    printf("  random: %u encoded, %u refused as longer than %u characters\n", encoded, refused, FRAME_MAX_LEN);
+    CHECK(encoded > 10000, "only %u random records encoded", encoded);
+}
+
+static void Check_Malformed(void) {
+    static const char *bad[] = {
+        "",                                                  // Empty
+        "3725,-67,3,200,0,12,840,310,45,123456,98304,1200",  // 12 fields
+        "3725,-67,3,200,0,12,840,310,45,123456,98304",       // 11 fields
+        "3725",                                              // 1 field
+        "3725,-67,3,200,0,12,840,310,45,123456,98304,1200,", // Last field empty
+        "3725,-67,3,200,0,12,840,310,45,123456,98304,1200,17,5",    // 14 fields
+        "3725,-67,3,200,0,12,840,310,45,123456,98304,1200,17,",     // Trailing separator
+        "3725,-67,3,200,0,12,840,310,45,123456,98304,1200,17 ",     // Trailing blank
+        "3725,-67,3,200,0,12,840,310,45,123456,98304,1200,17x",     // Trailing garbage
+        "4294967296,-67,3,200,0,12,840,310,45,123456,98304,1200,17",  // Past 32 bits
+        "3725,-67,3,200,0,12,840,310,45,99999999999,98304,1200,17",   // Far past 32 bits
+        "3725,-2147483649,3,200,0,12,840,310,45,123456,98304,1200,17",  // Past int32
+        "3725,2147483648,3,200,0,12,840,310,45,123456,98304,1200,17",   // Past int32
+        "3725,+67,3,200,0,12,840,310,45,123456,98304,1200,17",  // Plus sign
+        "3725,--67,3,200,0,12,840,310,45,123456,98304,1200,17", // Double minus
+        "3725,-,3,200,0,12,840,310,45,123456,98304,1200,17",    // Sign alone
+        "3725,-67,-3,200,0,12,840,310,45,123456,98304,1200,17", // Minus on an unsigned field
+        "3725, -67,3,200,0,12,840,310,45,123456,98304,1200,17", // Blank before a number
+        "3725,-67,,200,0,12,840,310,45,123456,98304,1200,17",   // Empty field
+        "3725;-67,3,200,0,12,840,310,45,123456,98304,1200,17",  // Wrong separator
+    };
+    FrameTelemetry t;
+    uint32_t i;
+    CHECK(Receive_Payload("3725,-67,3,200,0,12,840,310,45,123456,98304,1200,17"), "the well-formed payload");
+    CHECK(Receive_Payload("4294967295,-2147483648,3,2147483647,0,12,840,310,45,123456,98304,1200,17"),
+          "the 32-bit extremes");
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        CHECK(!Receive_Payload(bad[i]), "accepted '%s'", bad[i]);
+
+    // Around the checksum: lower-case digits, one digit, three digits, characters after it.
+    CHECK(!Receive("$T1,0,0,0,0,0,0,0,0,0,0,0,0*1", &t), "one checksum digit");
+    {
+        char line[64];
+        size_t n;
+        memset(&t, 0, sizeof(t));
+        n = Frame_Encode_Telemetry(line, sizeof(line), &t);
+        CHECK(Receive(line, &t), "zero record");
+        line[n] = 'A';
+        line[n + 1] = '\0';
+        CHECK(!Receive(line, &t), "a third checksum digit accepted");
+        line[n] = '\0';
+        if (line[n - 1] >= 'A') {
+            line[n - 1] = (char)(line[n - 1] - 'A' + 'a');
+            CHECK(!Receive(line, &t), "a lower-case checksum digit accepted");
+        }
+        line[1] = 'H';            // Another frame type sealed with the same payload
+        Frame_Seal(line, n - 3, sizeof(line));
+        CHECK(!Receive(line, &t), "a heartbeat tag accepted as telemetry");
+    }
+}
+
+// Seal 'payload' under 'tag' and open it again: 1 with the payload span if that works.
+static int Seal_Open(char tag, const char *payload, char *line, const char **pl, size_t *len) {
+    size_t n = (size_t)snprintf(line, 256, "$%c%s", tag, payload);
+    char got;
+    return Frame_Seal(line, n, 256) != 0 && Frame_Open(line, &got, pl, len) && got == tag;
+}
+
+static int Backfill_Payload(const char *payload, int32_t *p) {
+    char line[256];
+    const char *pl;
+    size_t len;
+    FrameBackfill hdr;
+    return Seal_Open(CFG_FRAME_BACKFILL, payload, line, &pl, &len) && Frame_Decode_Backfill(pl, len, &hdr, p, 8);
+}
+
+static int Window_Payload(const char *payload, FrameWindow *w) {
+    char line[256];
+    const char *pl;
+    size_t len;
+    return Seal_Open(CFG_FRAME_WINDOW, payload, line, &pl, &len) && Frame_Decode_Window(pl, len, w);
+}
+
+static void Check_Deltas(void) {
+    static const int32_t fixed[] = { 0, 1, -1, 15, -16, 16, 1023, -1024, INT32_MAX, INT32_MIN, INT32_MAX - 1,
+                                     INT32_MIN + 1 };
+    static const char *bad[] = {
+        "",              // Nothing
+        "o",             // Continuation with nothing after it
+        "p",             // Past the symbol alphabet
+        "/",             // Below it
+        "oooooo4",       // Seventh symbol with bit 32 set
+        "oooooo7",       // Seventh symbol with bits 32 to 34 set
+        "oooooo@",       // Seventh symbol asking for an eighth
+        "ooooooo0",      // Eight symbols
+    };
+    char sym[8];
+    const char *p;
+    int32_t d;
+    uint32_t i;
+    size_t n;
+    for (i = 0; i < sizeof(fixed) / sizeof(fixed[0]) + 20000; i++) {
+        int32_t v = i < sizeof(fixed) / sizeof(fixed[0]) ? fixed[i] : (int32_t)Rand();
+        n = Frame_Put_Delta(sym, v);
+        p = sym;
+        CHECK(n >= 1 && n <= 7 && Frame_Get_Delta(&p, sym + n, &d) && d == v && p == sym + n,
+              "delta %ld: %u symbols, got %ld", (long)v, (unsigned)n, (long)d);
+    }
+    p = "oooooo3";                       // Seven symbols, all 32 bits set: zig-zag of INT32_MIN
+    CHECK(Frame_Get_Delta(&p, p + 7, &d) && d == INT32_MIN, "widest delta read as %ld", (long)d);
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        p = bad[i];
+        CHECK(!Frame_Get_Delta(&p, bad[i] + strlen(bad[i]), &d), "accepted delta '%s' as %ld", bad[i], (long)d);
+    }
+}
+
+static void Check_Backfill_Window(void) {
+    static const char *bad_backfill[] = {
+        "0/1,1000,300,1,-2147483649,",   // First value past int32
+        "0/1,1000,300,1,2147483648,",
+        "0/1,1000,300,1,4294967295,",    // Wrapped to -1 before
+        "0/1,1000,300,1,--5,",
+        "0/1,1000,300,2,2147483647,2",   // +1 past INT32_MAX
+        "0/1,1000,300,2,-2147483648,1",  // -1 past INT32_MIN
+        "0/1,1000,300,3,2147483000,oooooo2", // Sum of two valid deltas leaves int32
+        "0/1,1000,300,2,5,oooooo4",      // Over-long delta
+    };
+    static const char *bad_window[] = {
+        "1,0,10,3600,60,5,2147483648,0000",     // Open past int32
+        "1,0,10,3600,60,5,-2147483649,0000",
+        "1,0,10,3600,60,5,4294967295,0000",
+        "1,0,10,3600,60,5,2147483647,2000",     // High one past INT32_MAX
+        "1,0,10,3600,60,5,-2147483648,0100",    // Low one below INT32_MIN
+        "1,0,10,3600,60,5,100,000oooooo4",      // Over-long mean delta
+    };
+    static const int32_t series[] = { 9731250, 9731251, 9730000, 9800000, 5, INT32_MAX - 3, INT32_MAX, 0 };
+    int32_t got[8];
+    char line[256], tag;
+    const char *pl;
+    size_t len, n;
+    FrameBackfill hdr = { 0, 1, 1760000000U, 300, 0 }, back;
+    FrameWindow w = { 7, 2, 123, 86400, 300, 288, 0, INT32_MAX, INT32_MIN, 100, -1 }, wb;
+    uint32_t i;
+
+    n = Frame_Encode_Backfill(line, sizeof(line), &hdr, series, 8);
+    CHECK(n > 0 && hdr.n == 8, "backfill of 8 points: %u packed", hdr.n);
+    memset(got, 0, sizeof(got));
+    CHECK(Frame_Open(line, &tag, &pl, &len) && tag == CFG_FRAME_BACKFILL && Frame_Decode_Backfill(pl, len, &back, got, 8) &&
+          back.n == 8 && back.t0 == hdr.t0 && back.dt == 300 && memcmp(got, series, sizeof(series)) == 0,
+          "backfill round trip of %s", line);
+    CHECK(Backfill_Payload("0/1,1000,300,1,-2147483648,", got) && got[0] == INT32_MIN, "backfill from INT32_MIN");
+    for (i = 0; i < sizeof(bad_backfill) / sizeof(bad_backfill[0]); i++)
+        CHECK(!Backfill_Payload(bad_backfill[i], got), "accepted backfill '%s'", bad_backfill[i]);
+
+    n = Frame_Encode_Window(line, sizeof(line), &w);
+    memset(&wb, 0, sizeof(wb));
+    CHECK(n > 0 && Frame_Open(line, &tag, &pl, &len) && tag == CFG_FRAME_WINDOW && Frame_Decode_Window(pl, len, &wb) &&
+          wb.id == 7 && wb.asset == 2 && wb.count == 288 && wb.open == w.open && wb.high == w.high &&
+          wb.low == w.low && wb.close == w.close && wb.mean == w.mean, "window round trip of %s", line);
+    CHECK(Window_Payload("1,0,10,3600,60,0,0,", &wb) && wb.count == 0 && wb.high == 0, "empty window");
+    for (i = 0; i < sizeof(bad_window) / sizeof(bad_window[0]); i++)
+        CHECK(!Window_Payload(bad_window[i], &wb), "accepted window '%s'", bad_window[i]);
+}
+
+int main(void) {
+    Check_Round_Trips();
+    Check_Malformed();
+    Check_Deltas();
+    Check_Backfill_Window();
+    return Check_Done("frame");
+}
@@ -0,0 +1,94 @@
+//history_test.c
+// Host test of the RAM price history (build/history.c): live ticks averaged into 5-minute
+// samples, the boot backfill, and the 24 h window the alert rules, the TFT chart and the
+// statistics page read.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Ibuild -o history_test linux/history_test.c build/history.c build/dsp.c && ./history_test
+//
+// Checked: ticks in one slot give one sample at the slot's start holding their mean; late
+// ticks are ignored; after a backfilled day and then one and three days of live ticks every
+// 20 s the ring still holds the last 24 h, and History_Stats over it sees a day of samples
+// with the day's lowest and highest tick.
+#include <stdint.h>
+#include <stdio.h>
+
+#include "history.h"
+#include "check.h"
+
+#define DAY   86400U
+#define TICK  20U                 // CFG_POLL_INTERVAL_MS: one price line every 20 s
+#define T0    1700000100U         // A slot start
+
+// The live price at 't': a slow ramp with a wiggle, so each slot's mean is known.
+static int32_t Price(uint32_t t) {
+    return 40000 + (int32_t)((t - T0) / 60U) % 5000 + (int32_t)((t / TICK) % 3U);
+}
+
+// Ticks around the slot starting at 't0', later than anything held.
+static void Check_Slots(uint32_t t0) {
+    HistStats s;
+    History_Add(t0 + 5, 100);
+    History_Add(t0 + 25, 200);
+    History_Add(t0 + 299, 300);
+    CHECK(History_Newest() == t0, "sample stamped %u, not the slot start %u", History_Newest(), t0);
+    History_Stats(t0, &s);
+    CHECK(s.count == 1 && s.mean == 200 && s.min == 200 && s.max == 200, "%u samples, slot mean %d (%d..%d)",
+          s.count, (int)s.mean, (int)s.min, (int)s.max);
+
+    History_Add(t0 + 300, 1000);       // Next slot
+    History_Add(t0 + 250, 5000);       // Late tick for the previous slot: ignored
+    History_Add(0, 5000);              // No time: ignored
+    History_Stats(t0, &s);
+    CHECK(s.count == 2 && History_Newest() == t0 + 300, "%u samples, newest %u", s.count, History_Newest());
+    CHECK(s.max == 1000 && s.min == 200, "late tick changed a closed slot (%d..%d)", (int)s.min, (int)s.max);
+}
+
+// A day of live ticks after 'from'; returns the lowest and highest tick of its last 24 h.
+static void Live(uint32_t from, uint32_t days, int32_t *lo, int32_t *hi) {
+    uint32_t t, end = from + days * DAY;
+    *lo = 0x7FFFFFFF;
+    *hi = (int32_t)0x80000000;
+    for (t = from; t < end; t += TICK) {
+        int32_t p = Price(t);
+        History_Add(t, p);
+        if (t >= end - TICK - DAY) {
+            if (p < *lo) *lo = p;
+            if (p > *hi) *hi = p;
+        }
+    }
+}
+
+// A backfilled day at 'start' - 1 day, then 'days' of live ticks from 'start'.
+static void Check_Day_Window(uint32_t start, uint32_t days) {
+    static int32_t backfill[288];
+    HistStats s;
+    int32_t lo, hi;
+    uint32_t newest, since, i;
+    for (i = 0; i < 288; i++)
+        backfill[i] = 30000 + (int32_t)i;
+    History_Ingest(start - DAY, 300, backfill, 288);   // At boot only: dropped later, when older samples are held
+    Live(start, days, &lo, &hi);
+
+    newest = History_Newest();
+    since = start + days * DAY - TICK - DAY;   // 24 h before the last tick, as the alert rules ask
+    CHECK(newest + HIST_SPACING_S >= start + days * DAY, "newest sample %u, ticks ended %u", newest,
+          start + days * DAY);
+    CHECK(History_Oldest() <= since, "%u day(s) live: oldest sample %u s after the 24 h window start",
+          days, History_Oldest() - since);
+    History_Stats(since, &s);
+    CHECK(s.count == DAY / HIST_SPACING_S, "%u day(s) live: %u samples in 24 h", days, s.count);
+    // Slot means stay within the day's ticks and reach within a slot's spread of its extremes.
+    CHECK(s.min >= lo && s.min <= lo + 25 && s.max <= hi && s.max >= hi - 25,
+          "%u day(s) live: 24 h range %d..%d, ticks %d..%d", days, (int)s.min, (int)s.max, (int)lo, (int)hi);
+    CHECK(s.min >= 40000, "%u day(s) live: the backfilled day is still in the 24 h window", days);
+    printf("  %u day(s) live: %u samples held, oldest %.1f h before the newest\n", days, History_Count(),
+           (newest - History_Oldest()) / 3600.0);
+}
+
+int main(void) {
+    Check_Day_Window(T0 + 10U * DAY, 1);
+    Check_Day_Window(T0 + 20U * DAY, 3);   // The ring has wrapped
+    Check_Slots(T0 + 30U * DAY);
+    return Check_Done("history");
+}
@@ -0,0 +1,253 @@
+//lcdbus_test.c
+// Host test of the shared LCD bus scheduler (build/lcdbus.c) against a model of the HD44780
+// on each enable line: its DDRAM, its address counter (which runs from 0x27 on to 0x40 and
+// from 0x67 back to 0x00, as in two-line mode), the row map of 1-, 2- and 4-row panels, and
+// the time after each byte during which it ignores the bus.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Ibuild -o lcdbus_test linux/lcdbus_test.c && ./lcdbus_test
+// With -DLCDBUS_TEST_20X4 lcdbus.c is built for 20x4 panels instead of tracker_config.h's.
+//
+// Checked: random screen writes (clears, cursor moves inside, past and below the rows, text
+// running past the end of a row, writes to missing panels) on 1 to 4 panels, sent while the
+// writes go on and drained at the end, leave every panel showing its shadow and the screen
+// the same writes give on a plain character array; no byte reaches a panel inside its busy
+// window and only set-address commands and characters are sent; a run of changes goes out
+// without set-address commands, and rewriting what is shown sends nothing.
+#ifdef LCDBUS_TEST_20X4
+#define TRACKER_CONFIG_H          // lcdbus.c needs only the geometry
+#define CFG_LCD_ROWS 4
+#define CFG_LCD_COLS 20
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lcdbus.c"
+#include "check.h"
+
+#define BYTE_US 5U                // Bus time of one byte (4-bit transfers)
+#define EXEC_US 50U               // LcdBus exec: from the start of a byte to the next one
+
+// An HD44780 as the bus sees it.
+typedef struct {
+    char ddram[0x80];
+    uint8_t ac;                   // Address counter
+    uint32_t busy_until;
+    uint32_t lost;                // Bytes that arrived while it was busy
+    uint32_t bad;                 // Commands other than set-DDRAM-address, addresses off the DDRAM
+    uint32_t bytes;
+} Hd44780;
+
+static Hd44780 lcd[LCDBUS_MAX_PANELS];
+
+// DDRAM address of a cell: rows 0 and 1 start at 0x00 and 0x40, rows 2 and 3 continue them.
+static uint8_t Model_Addr(uint32_t row, uint32_t col) {
+    return (uint8_t)((row & 1U ? 0x40U : 0x00U) + (row >= 2U ? CFG_LCD_COLS : 0U) + col);
+}
+
+static int Model_Valid(uint8_t addr) {
+    return addr <= 0x27U || (addr >= 0x40U && addr <= 0x67U);
+}
+
+static void Model_Reset(void) {
+    uint32_t i;
+    for (i = 0; i < LCDBUS_MAX_PANELS; i++) {
+        memset(&lcd[i], 0, sizeof(lcd[i]));
+        memset(lcd[i].ddram, ' ', sizeof(lcd[i].ddram));
+    }
+}
+
+static void Model_Write(const LcdBusOp *op, uint32_t now) {
+    Hd44780 *m = &lcd[op->panel];
+    m->bytes++;
+    if ((int32_t)(now - m->busy_until) < 0) {
+        m->lost++;
+        return;
+    }
+    m->busy_until = now + EXEC_US;
+    if (op->rs) {
+        m->ddram[m->ac] = (char)op->byte;
+        m->ac = m->ac == 0x27U ? 0x40U : (m->ac == 0x67U ? 0x00U : (uint8_t)(m->ac + 1U));
+    } else if ((op->byte & 0x80U) && Model_Valid(op->byte & 0x7FU)) {
+        m->ac = op->byte & 0x7FU;
+    } else {
+        m->bad++;
+    }
+}
+
+// Run the bus from 'now' for 'span' us (until it is idle if span is 0); returns the new time.
+static uint32_t Run(LcdBus *b, uint32_t now, uint32_t span) {
+    uint32_t end = now + span, wait;
+    LcdBusOp op;
+    while (span == 0 || (int32_t)(now - end) < 0) {
+        if (LcdBus_Next(b, now, &op)) {
+            CHECK(op.panel < b->n, "byte for panel %u of %u", op.panel, b->n);
+            Model_Write(&op, now);
+            now += BYTE_US;
+            continue;
+        }
+        wait = LcdBus_Wait(b, now);
+        if (wait == LCDBUS_IDLE) {
+            if (span == 0)
+                break;
+            wait = end - now;
+        }
+        now += wait ? wait : 1U;
+    }
+    return now;
+}
+
+// The screens as the writes leave them, on plain arrays.
+static char screen[LCDBUS_MAX_PANELS][CFG_LCD_ROWS][CFG_LCD_COLS];
+static uint32_t at_row[LCDBUS_MAX_PANELS], at_col[LCDBUS_MAX_PANELS];
+
+static void Screen_Clear(uint32_t p) {
+    memset(screen[p], ' ', sizeof(screen[p]));
+    at_row[p] = at_col[p] = 0;
+}
+
+static void Screen_Put(uint32_t p, char c) {
+    if (at_row[p] < CFG_LCD_ROWS && at_col[p] < CFG_LCD_COLS)
+        screen[p][at_row[p]][at_col[p]] = c;
+    at_col[p]++;
+}
+
+// Every panel shows its shadow and the screen the writes give.
+static void Check_Panels(const LcdBus *b, const char *what) {
+    uint32_t p, r, c;
+    for (p = 0; p < b->n; p++) {
+        uint32_t wrong = 0;
+        for (r = 0; r < CFG_LCD_ROWS; r++)
+            for (c = 0; c < CFG_LCD_COLS; c++) {
+                char shows = lcd[p].ddram[Model_Addr(r, c)];
+                if (shows != b->panel[p].want[r][c] || shows != screen[p][r][c])
+                    wrong++;
+            }
+        CHECK(wrong == 0, "%s: panel %u of %u has %u wrong cells", what, p, b->n, wrong);
+        CHECK(lcd[p].lost == 0 && lcd[p].bad == 0, "%s: panel %u: %u bytes sent while busy, %u bad commands",
+              what, p, lcd[p].lost, lcd[p].bad);
+    }
+}
+
+static uint32_t rng = 1;
+
+static uint32_t Rand(uint32_t n) {
+    rng = rng * 1103515245U + 12345U;
+    return (rng >> 8) % n;
+}
+
+static void Check_Random(uint8_t panels, uint32_t steps) {
+    static const char chars[] = "  0123456789$,.%+-ABCDEFGHIJKLMNOPQRSTUVWXYZ?!";
+    LcdBus b;
+    uint32_t i, k, now = 1000000U - 12345U * panels;   // Any start, the clock wraps freely
+    char what[48];
+    Model_Reset();
+    LcdBus_Init(&b, panels, EXEC_US);
+    for (i = 0; i < LCDBUS_MAX_PANELS; i++)
+        Screen_Clear(i);
+    LcdBus_Put(&b, 0, 'X');                           // Before power-up: kept, not sent
+    Screen_Put(0, 'X');
+    CHECK(Run(&b, now, 1000) == now + 1000 && lcd[0].bytes == 0, "bytes sent before LcdBus_Up");
+    LcdBus_Up(&b, now);
+
+    for (i = 0; i < steps; i++) {
+        uint32_t p = Rand(panels + 1U);              // Now and then a panel that is not there
+        switch (Rand(8)) {
+        case 0:
+            LcdBus_Clear(&b, (uint8_t)p);
+            if (p < panels)
+                Screen_Clear(p);
+            break;
+        case 1: case 2: {
+            uint32_t row = Rand(CFG_LCD_ROWS + 1U), col = Rand(CFG_LCD_COLS + 3U);
+            LcdBus_Cursor(&b, (uint8_t)p, (uint8_t)col, (uint8_t)row);
+            if (p < panels) {
+                at_row[p] = row;
+                at_col[p] = row < CFG_LCD_ROWS ? col : CFG_LCD_COLS;
+            }
+            break;
+        }
+        default:                                     // Text, often past the end of the row
+            for (k = Rand(CFG_LCD_COLS + 6U); k > 0; k--) {
+                char c = chars[Rand(sizeof(chars) - 1U)];
+                LcdBus_Put(&b, (uint8_t)p, c);
+                if (p < panels)
+                    Screen_Put(p, c);
+            }
+            break;
+        }
+        if (Rand(4) == 0)                            // Part of the changes goes out meanwhile
+            now = Run(&b, now, Rand(400));
+    }
+    now = Run(&b, now, 0);
+    snprintf(what, sizeof(what), "%u panel(s), %u writes", panels, steps);
+    CHECK(LcdBus_Wait(&b, now) == LCDBUS_IDLE, "%s: bus not idle after draining", what);
+    Check_Panels(&b, what);
+}
+
+// Byte counts of simple updates on one panel.
+static void Check_Bytes(void) {
+    LcdBus b;
+    uint32_t now = 0, before;
+    const char *s;
+    Model_Reset();
+    Screen_Clear(0);
+    LcdBus_Init(&b, 1, EXEC_US);
+    LcdBus_Up(&b, now);
+    for (s = "$97,123"; *s; s++) {
+        LcdBus_Put(&b, 0, *s);
+        Screen_Put(0, *s);
+    }
+    now = Run(&b, now, 0);
+    CHECK(lcd[0].bytes == 7, "7 characters from the home position: %u bytes", lcd[0].bytes);
+
+    LcdBus_Cursor(&b, 0, 3, CFG_LCD_ROWS - 1);         // One cell on the last row: address + character
+    LcdBus_Put(&b, 0, '!');
+    at_row[0] = CFG_LCD_ROWS - 1;
+    at_col[0] = 3;
+    Screen_Put(0, '!');
+    before = lcd[0].bytes;
+    now = Run(&b, now, 0);
+    CHECK(lcd[0].bytes - before == 2, "one cell elsewhere: %u bytes", lcd[0].bytes - before);
+
+    before = lcd[0].bytes;                             // The same text again: nothing to send
+    LcdBus_Cursor(&b, 0, 0, 0);
+    for (s = "$97,123"; *s; s++)
+        LcdBus_Put(&b, 0, *s);
+    now = Run(&b, now, 0);
+    CHECK(lcd[0].bytes == before, "unchanged text: %u bytes", lcd[0].bytes - before);
+
+    LcdBus_Clear(&b, 0);                               // A clear costs the cells that were set
+    Screen_Clear(0);
+    now = Run(&b, now, 0);
+    CHECK(lcd[0].bytes - before <= 8 + 2 + 1, "clear: %u bytes", lcd[0].bytes - before);
+    Check_Panels(&b, "byte counts");
+
+    // A full row past its end, then the next row: the counter is moved, not left to run on.
+    LcdBus_Cursor(&b, 0, 0, 0);
+    at_row[0] = at_col[0] = 0;
+    for (before = 0; before < CFG_LCD_COLS * 2U; before++) {
+        LcdBus_Put(&b, 0, (char)('a' + before % 26U));
+        Screen_Put(0, (char)('a' + before % 26U));
+    }
+    LcdBus_Cursor(&b, 0, 0, 1);
+    at_row[0] = 1;
+    at_col[0] = 0;
+    LcdBus_Put(&b, 0, '#');
+    Screen_Put(0, '#');
+    now = Run(&b, now, 0);
+    Check_Panels(&b, "row past its end");
+}
+
+int main(void) {
+    uint8_t panels;
+    Check_Bytes();
+    for (panels = 1; panels <= LCDBUS_MAX_PANELS; panels++) {
+        Check_Random(panels, 50);
+        Check_Random(panels, 5000);
+    }
+    printf("  %ux%u panels\n", CFG_LCD_COLS, CFG_LCD_ROWS);
+    return Check_Done("lcdbus");
+}
@@ -0,0 +1,261 @@
+//pt_test.c
+// Host test of the coroutines (build/pt.c) and the screens written with them (build/ui.c),
+// stepped against a virtual clock: pt.c is compiled into this file with PT_CLOCK() reading
+// 'ticks' at the board's 50 MHz (PT_TICKS_PER_MS 50000), and the LCD calls draw into a
+// two-row text model.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Iqemu -Ibuild -o pt_test linux/pt_test.c build/ui.c build/tracker_config.c && ./pt_test
+//
+// Checked: the order in which round-robin coroutines resume from PT_SLEEP, PT_YIELD and a
+// PT_SPAWNed child; lat_last, lat_max and pt_stats for deadlines noticed late by known
+// amounts; sleeps and PtTimers that span the wrap-around of the 32-bit clock; Ui_Banner's
+// screens and timing; and Ui_Select committing a threshold and running the banner as a child.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t ticks;
+#define PT_CLOCK()      ticks
+#define PT_TICKS_PER_MS 50000U
+#include "pt.c"
+
+#include "tracker.h"
+#include "encoder.h"
+#include "link.h"
+#include "ui.h"
+#include "check.h"
+
+#define MS(ms) ((uint32_t)(ms) * PT_TICKS_PER_MS)
+
+// Stand-ins for the board and the link.
+
+static char screen[2][CFG_LCD_COLS + 1];
+static unsigned char cur_col, cur_row;
+static int32_t enc_turn;
+static int enc_switch;
+
+float local_threshold;
+LinkWindow link_windows[LINK_WINDOWS];
+LinkTelemetry link_telemetry;
+SelfTest link_self_test;
+
+void LCD_Select(unsigned char panel) { (void)panel; }
+void LCD_Set_Cursor(unsigned char col, unsigned char row) { cur_col = col; cur_row = row; }
+void LCD_Clear(void) {
+    memset(screen, ' ', sizeof(screen));
+    screen[0][CFG_LCD_COLS] = screen[1][CFG_LCD_COLS] = '\0';
+    cur_col = cur_row = 0;
+}
+void LCD_Display_String(const char *str) {
+    while (*str && cur_col < CFG_LCD_COLS && cur_row < 2)
+        screen[cur_row][cur_col++] = *str++;
+}
+int32_t Encoder_Read(void) { int32_t t = enc_turn; enc_turn = 0; return t; }
+int Encoder_Switch_Pressed(void) { return enc_switch; }
+int PushButton_Pressed(void) { return 0; }
+void RGB_LED_Flash_Yellow(void) {}
+void Buzzer_Toggle(void) {}
+void Buzzer_Off(void) {}
+const char *Link_Fail_Text(uint8_t fail) { (void)fail; return NULL; }
+
+// Row 'row' without its trailing blanks.
+static const char *Row(int row) {
+    static char text[CFG_LCD_COLS + 1];
+    int n = CFG_LCD_COLS;
+    memcpy(text, screen[row], sizeof(text));
+    while (n > 0 && text[n - 1] == ' ')
+        text[--n] = '\0';
+    return text;
+}
+
+// Round-robin coroutines that log when they resume.
+
+static char order[128];
+static Pt child;
+
+static void Log(const char *what) {
+    size_t n = strlen(order);
+    snprintf(order + n, sizeof(order) - n, "%s%s@%lu", n ? " " : "", what, (unsigned long)(ticks / MS(1)));
+}
+
+static PT_THREAD(Sleeper(Pt *pt, const char *name, uint32_t ms, int times)) {
+    static int done[2];
+    int *d = &done[name[0] - 'A'];
+    PT_BEGIN(pt);
+    for (*d = 0; *d < times; (*d)++) {
+        PT_SLEEP(pt, ms);
+        Log(name);
+    }
+    PT_END(pt);
+}
+
+static PT_THREAD(Child(Pt *pt)) {
+    PT_BEGIN(pt);
+    Log("c0");
+    PT_SLEEP(pt, 2);
+    Log("c1");
+    PT_END(pt);
+}
+
+static PT_THREAD(Parent(Pt *pt)) {
+    PT_BEGIN(pt);
+    Log("P0");
+    PT_YIELD(pt);
+    Log("P1");
+    PT_SPAWN(pt, &child, Child(&child));  // The child's first step is in the same pass
+    Log("P2");                    // Same pass as the child's exit
+    PT_END(pt);
+}
+
+static void Check_Order(void) {
+    Pt a, b, p;
+    int run_a = 1, run_b = 1, run_p = 1, pass;
+    PT_INIT(&a);
+    PT_INIT(&b);
+    PT_INIT(&p);
+    ticks = 0;
+    order[0] = '\0';
+    for (pass = 0; pass < 20 && (run_a || run_b || run_p); pass++) {
+        if (run_a) run_a = PT_SCHEDULE(Sleeper(&a, "A", 3, 3));
+        if (run_b) run_b = PT_SCHEDULE(Sleeper(&b, "B", 5, 2));
+        if (run_p) run_p = PT_SCHEDULE(Parent(&p));
+        ticks += MS(1);
+    }
+    CHECK(strcmp(order, "P0@0 P1@1 c0@1 A@3 c1@3 P2@3 B@5 A@6 A@9 B@10") == 0, "resume order: %s", order);
+    CHECK(pass == 11, "all three finished after %d passes, want 11", pass);
+    CHECK(a.lc == 0 && b.lc == 0 && p.lc == 0, "PT_END re-initialises");
+}
+
+// Deadlines noticed late by known amounts.
+static void Check_Latency(void) {
+    Pt a, b;
+    memset(&pt_stats, 0, sizeof(pt_stats));
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    ticks = 1000;
+
+    Pt_Sleep_Start(&a, 5);
+    Pt_Sleep_Start(&b, 2);
+    ticks += MS(3);                                  // b is 1 ms late
+    CHECK(!Pt_Sleep_Done(&a), "a woke 2 ms early");
+    CHECK(Pt_Sleep_Done(&b) && b.lat_last == MS(1), "b: lat_last %lu, want 1 ms", (unsigned long)b.lat_last);
+    ticks += MS(2) - 1;                              // One count before a's deadline
+    CHECK(!Pt_Sleep_Done(&a), "a woke one count early");
+    ticks += 1;
+    CHECK(Pt_Sleep_Done(&a) && a.lat_last == 0, "a on its deadline: lat_last %lu", (unsigned long)a.lat_last);
+
+    Pt_Sleep_Start(&a, 5);
+    ticks += MS(8);                                  // 3 ms late
+    CHECK(Pt_Sleep_Done(&a) && a.lat_last == MS(3), "a: lat_last %lu, want 3 ms", (unsigned long)a.lat_last);
+    Pt_Sleep_Start(&a, 5);
+    ticks += MS(5) + 7;
+    CHECK(Pt_Sleep_Done(&a) && a.lat_last == 7, "a: lat_last %lu, want 7 counts", (unsigned long)a.lat_last);
+    CHECK(a.lat_max == MS(3), "a: lat_max %lu, want the 3 ms", (unsigned long)a.lat_max);
+    CHECK(b.lat_max == MS(1), "b: lat_max %lu is its own", (unsigned long)b.lat_max);
+    CHECK(pt_stats.resumes == 4, "pt_stats.resumes %lu, want 4", (unsigned long)pt_stats.resumes);
+    CHECK(pt_stats.lat_max == MS(3), "pt_stats.lat_max %lu", (unsigned long)pt_stats.lat_max);
+}
+
+// Sleeps and timers across the wrap of the 32-bit clock (86 s at 50 MHz).
+static void Check_Wrap(void) {
+    Pt p;
+    PtTimer t;
+    uint32_t ms;
+    memset(&p, 0, sizeof(p));
+    ticks = 0xFFFFFFFFU - MS(2) + 1;                 // 2 ms before the wrap
+    Pt_Sleep_Start(&p, 5);
+    Pt_Timer_Set(&t, 4);
+    CHECK(p.wake < ticks, "the deadline wraps (wake %lu)", (unsigned long)p.wake);
+    for (ms = 1; ms < 5; ms++) {
+        ticks += MS(1);
+        CHECK(!Pt_Sleep_Done(&p), "woke %lu ms into a 5 ms sleep across the wrap", (unsigned long)ms);
+        CHECK(Pt_Timer_Expired(&t) == (ms >= 4), "timer at %lu ms across the wrap", (unsigned long)ms);
+    }
+    ticks += MS(1) + 11;
+    CHECK(Pt_Sleep_Done(&p) && p.lat_last == 11, "after the wrap: lat_last %lu, want 11", (unsigned long)p.lat_last);
+
+    // The longest sleep pt.h allows, started just before the wrap.
+    ticks = 0xFFFFFFF0U;
+    Pt_Sleep_Start(&p, 0x7FFFFFFFU / PT_TICKS_PER_MS);
+    ticks += 0x7FFFFFFFU / PT_TICKS_PER_MS * PT_TICKS_PER_MS - 1;
+    CHECK(!Pt_Sleep_Done(&p), "longest sleep woke early");
+    ticks += 1;
+    CHECK(Pt_Sleep_Done(&p) && p.lat_last == 0, "longest sleep missed its deadline");
+}
+
+// Step 'f' every 'step_ms' until it exits; returns the virtual ms it took.
+#define RUN(f, step_ms, limit_ms, ms)                                           \
+    do {                                                                        \
+        for ((ms) = 0; (ms) <= (limit_ms) && PT_SCHEDULE(f); (ms) += (step_ms)) \
+            ticks += MS(step_ms);                                               \
+    } while (0)
+
+static void Check_Banner(void) {
+    Pt p;
+    uint32_t ms;
+    PT_INIT(&p);
+    ticks = 0xFFFFFFFFU - MS(100);                   // Also across the wrap
+    memset(&pt_stats, 0, sizeof(pt_stats));
+    LCD_Clear();
+    LCD_Display_String("old");
+    CHECK(Ui_Banner(&p, "Hello", 250) == PT_WAITING, "banner exits at once");
+    CHECK(strcmp(Row(0), "Hello") == 0 && Row(1)[0] == '\0', "banner rows '%s' '%s'", Row(0), Row(1));
+    ticks += MS(249);
+    CHECK(Ui_Banner(&p, "Hello", 250) == PT_WAITING, "banner gone 1 ms early");
+    CHECK(strcmp(Row(0), "Hello") == 0, "banner text still up");
+    ticks += MS(4);
+    CHECK(Ui_Banner(&p, "Hello", 250) == PT_EXITED, "banner still up 3 ms late");
+    CHECK(Row(0)[0] == '\0', "banner cleared: '%s'", Row(0));
+    CHECK(p.lat_last == MS(3) && pt_stats.resumes == 1, "banner: lat_last %lu", (unsigned long)p.lat_last);
+
+    // Stepped every 10 ms, as the main loop might: ends at the first step past 'ms'.
+    RUN(Ui_Banner(&p, CFG_STR_SAVED, 95), 10, 1000, ms);
+    CHECK(ms == 100 && p.lat_last == MS(5), "95 ms banner stepped every 10 ms took %lu ms, late %lu",
+          (unsigned long)ms, (unsigned long)p.lat_last);
+}
+
+static void Check_Select(void) {
+    Pt p;
+    uint32_t ms;
+
+    // The encoder switch commits the default threshold at once; the banner runs as a child.
+    PT_INIT(&p);
+    ticks = 12345;
+    enc_switch = 1;
+    local_threshold = 0;
+    CHECK(Ui_Select(&p) == PT_WAITING, "select exits before its banner");
+    enc_switch = 0;
+    CHECK(local_threshold == (float)cfg_thresholds[CFG_THRESHOLD_DEFAULT], "committed %.0f",
+          (double)local_threshold);
+    CHECK(strcmp(Row(0), CFG_STR_SAVED) == 0, "banner '%s' under select", Row(0));
+    RUN(Ui_Select(&p), 1, CFG_SAVED_BANNER_MS + 10, ms);
+    CHECK(ms == CFG_SAVED_BANNER_MS, "select's banner took %lu ms, want %u", (unsigned long)ms,
+          CFG_SAVED_BANNER_MS);
+    CHECK(Row(0)[0] == '\0' && p.lc == 0, "select finished with the banner cleared");
+
+    // A turn, then no input: commits CFG_THRESHOLD_SELECT_MS after the turn, then the banner.
+    PT_INIT(&p);
+    CHECK(Ui_Select(&p) == PT_WAITING, "select waits for input");
+    CHECK(strcmp(Row(0), CFG_STR_SET_MIN) == 0, "select title '%s'", Row(0));
+    ticks += MS(500);
+    enc_turn = 25;
+    Ui_Select(&p);
+    RUN(Ui_Select(&p), 1, CFG_THRESHOLD_SELECT_MS + CFG_SAVED_BANNER_MS + 100, ms);
+    CHECK(ms >= CFG_THRESHOLD_SELECT_MS + CFG_SAVED_BANNER_MS &&
+          ms <= CFG_THRESHOLD_SELECT_MS + CFG_SAVED_BANNER_MS + CFG_INPUT_POLL_MS,
+          "select after a turn took %lu ms", (unsigned long)ms);
+    CHECK(local_threshold == (float)(cfg_thresholds[CFG_THRESHOLD_DEFAULT] + 25 > cfg_thresholds[CFG_THRESHOLD_COUNT - 1]
+                                     ? cfg_thresholds[CFG_THRESHOLD_COUNT - 1]
+                                     : cfg_thresholds[CFG_THRESHOLD_DEFAULT] + 25),
+          "turned threshold %.0f", (double)local_threshold);
+}
+
+int main(void) {
+    Check_Order();
+    Check_Latency();
+    Check_Wrap();
+    Check_Banner();
+    Check_Select();
+    return Check_Done("pt");
+}
@@ -0,0 +1,433 @@
+//rules_test.c
+// Host test of the alert rule machine (build/rules.c): the verifier that guards every image
+// arriving over USB or from the EEPROM, the interpreter that relies on it, the EEPROM store
+// and load against the board shim's EEPROM model, and tools/rules_compile.py's images.
+// rules.c is compiled into this file, so Verify() and Run() are tested directly.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Iqemu -Ibuild -o rules_test linux/rules_test.c build/history.c build/dsp.c qemu/board.c -lm
+//   ./rules_test
+//
+// Checked: each RULES_E_* rejection (short and long images, a rule cut off by the image end,
+// an operand past the end of its rule, LOAD of an input past RULES_INPUTS, stack underflow
+// and overflow, a rule leaving other than one value, bytes after the last rule, a bound one
+// pair of opcodes over the budget), and that a refused image leaves the running set alone;
+// every opcode's result against the same C expression; a stored set survives Rules_Init,
+// and a damaged store (payload, checksum, length, magic) or a failed write falls back to the
+// built-in set; Rules_Tick's prev, hour and 24 h inputs; and eight compiled rules verify with
+// the compiler's bound and evaluate like their C counterparts on random inputs.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rules.c"
+#include "check.h"
+
+static uint32_t cycles;
+
+// Like the shim's DWT: every read is a millisecond later, so Bench() measures a nonzero time.
+uint32_t Cycles_Now(void) {
+    return cycles += SystemCoreClock / 1000U;
+}
+
+static uint32_t rng = 5;
+
+static uint32_t Rand(void) {
+    rng = rng * 1664525U + 1013904223U;
+    return rng;
+}
+
+// A float in [lo, hi).
+static float Uniform(float lo, float hi) {
+    return lo + (hi - lo) * (float)(Rand() >> 8) / 16777216.0f;
+}
+
+#define LOAD(i) RULES_OP_LOAD, (i)
+#define CONST_2 RULES_OP_CONST, 0x00, 0x00, 0x00, 0x40   // 2.0f
+
+// price > 2: the set a refused image must leave running.
+static const uint8_t good[] = { RULES_VERSION, 1, 8, LOAD(RULES_IN_PRICE), CONST_2, RULES_OP_GT };
+
+static void Check_Running_Unchanged(const char *what) {
+    float in[RULES_INPUTS] = { 0 };
+    CHECK(rules_stats.source == RULES_HOST && rules_stats.count == 1 && rules_stats.bytes == sizeof(good),
+          "%s: running set changed (%u rules, %u bytes)", what, rules_stats.count, rules_stats.bytes);
+    in[RULES_IN_PRICE] = 3.0f;
+    CHECK(Rules_Eval(in) == 1, "%s: price > 2 no longer fires", what);
+    in[RULES_IN_PRICE] = 1.0f;
+    CHECK(Rules_Eval(in) == 0, "%s: price > 2 fires at 1", what);
+}
+
+static void Expect(const uint8_t *image, uint32_t len, uint8_t status, const char *what) {
+    uint8_t got;
+    CHECK(Rules_Load(good, sizeof(good), RULES_HOST) == RULES_OK, "the good set refused");
+    got = Rules_Load(image, len, RULES_HOST);
+    CHECK(got == status && rules_stats.status == status, "%s: status %u, not %u", what, got, status);
+    if (status != RULES_OK)
+        Check_Running_Unchanged(what);
+}
+
+static void Check_Verify(void) {
+    static const uint8_t version[] = { 2, 1, 2, LOAD(0) };
+    static const uint8_t no_rules[] = { RULES_VERSION, 0, 0 };
+    static const uint8_t nine[] = { RULES_VERSION, 9, 2, LOAD(0), 2, LOAD(0), 2, LOAD(0), 2, LOAD(0), 2, LOAD(0),
+                                    2, LOAD(0), 2, LOAD(0), 2, LOAD(0), 2, LOAD(0) };
+    static const uint8_t eight[] = { RULES_VERSION, 8, 2, LOAD(0), 2, LOAD(1), 2, LOAD(2), 2, LOAD(3), 2, LOAD(4),
+                                     2, LOAD(5), 2, LOAD(6), 2, LOAD(10) };
+    static const uint8_t cut_rule[] = { RULES_VERSION, 1, 5, LOAD(0), LOAD(1) };         // 4 of 5 bytes
+    static const uint8_t cut_second[] = { RULES_VERSION, 2, 2, LOAD(0) };               // Rule 1 missing
+    static const uint8_t trailing[] = { RULES_VERSION, 1, 2, LOAD(0), 0 };
+    static const uint8_t op_zero[] = { RULES_VERSION, 1, 1, 0 };
+    static const uint8_t op_past[] = { RULES_VERSION, 1, 1, RULES_OPS };
+    static const uint8_t op_ff[] = { RULES_VERSION, 1, 1, 0xFF };
+    static const uint8_t load_cut[] = { RULES_VERSION, 1, 1, RULES_OP_LOAD };
+    static const uint8_t load_next[] = { RULES_VERSION, 2, 1, RULES_OP_LOAD, 2, LOAD(0) }; // Operand in rule 1
+    static const uint8_t const_cut[] = { RULES_VERSION, 1, 4, RULES_OP_CONST, 0, 0, 0 };
+    static const uint8_t load_11[] = { RULES_VERSION, 1, 2, LOAD(RULES_INPUTS) };
+    static const uint8_t load_255[] = { RULES_VERSION, 1, 2, LOAD(255) };
+    static const uint8_t under_bin[] = { RULES_VERSION, 1, 3, LOAD(0), RULES_OP_ADD };
+    static const uint8_t under_un[] = { RULES_VERSION, 1, 1, RULES_OP_NEG };
+    static const uint8_t under_late[] = { RULES_VERSION, 1, 7, LOAD(0), LOAD(1), RULES_OP_LT, RULES_OP_OR, LOAD(0) };
+    static const uint8_t two_left[] = { RULES_VERSION, 1, 4, LOAD(0), LOAD(1) };
+    static const uint8_t empty_rule[] = { RULES_VERSION, 1, 0 };
+    static uint8_t image[RULES_IMAGE_MAX + 1];
+    uint32_t i, k, len;
+
+    Expect(image, 0, RULES_OK, "empty image (built-in set)");
+    CHECK(rules_stats.source == RULES_BUILTIN && rules_stats.count == 1, "empty image: not the built-in set");
+    Expect(good, 2, RULES_E_SIZE, "two bytes");
+    Expect(version, sizeof(version), RULES_E_VERSION, "version 2");
+    Expect(no_rules, sizeof(no_rules), RULES_E_COUNT, "no rules");
+    Expect(nine, sizeof(nine), RULES_E_COUNT, "nine rules");
+    Expect(eight, sizeof(eight), RULES_OK, "eight rules");
+    Expect(cut_rule, sizeof(cut_rule), RULES_E_SIZE, "rule cut off by the image end");
+    Expect(cut_second, sizeof(cut_second), RULES_E_SIZE, "second rule missing");
+    Expect(trailing, sizeof(trailing), RULES_E_COUNT, "byte after the last rule");
+    Expect(op_zero, sizeof(op_zero), RULES_E_OPCODE, "opcode 0");
+    Expect(op_past, sizeof(op_past), RULES_E_OPCODE, "opcode RULES_OPS");
+    Expect(op_ff, sizeof(op_ff), RULES_E_OPCODE, "opcode 255");
+    Expect(load_cut, sizeof(load_cut), RULES_E_OPCODE, "LOAD without its operand");
+    Expect(load_next, sizeof(load_next), RULES_E_OPCODE, "LOAD operand in the next rule");
+    Expect(const_cut, sizeof(const_cut), RULES_E_OPCODE, "CONST with three bytes");
+    Expect(load_11, sizeof(load_11), RULES_E_OPCODE, "LOAD of input RULES_INPUTS");
+    Expect(load_255, sizeof(load_255), RULES_E_OPCODE, "LOAD of input 255");
+    Expect(under_bin, sizeof(under_bin), RULES_E_STACK, "ADD on one value");
+    Expect(under_un, sizeof(under_un), RULES_E_STACK, "NEG on an empty stack");
+    Expect(under_late, sizeof(under_late), RULES_E_STACK, "OR on one value");
+    Expect(two_left, sizeof(two_left), RULES_E_STACK, "two values left");
+    Expect(empty_rule, sizeof(empty_rule), RULES_E_STACK, "empty rule");
+
+    // RULES_STACK values fit, one more does not.
+    for (k = RULES_STACK; k <= RULES_STACK + 1U; k++) {
+        len = 0;
+        image[len++] = RULES_VERSION;
+        image[len++] = 1;
+        image[len++] = (uint8_t)(3 * k - 1);
+        for (i = 0; i < k; i++) {
+            image[len++] = RULES_OP_LOAD;
+            image[len++] = (uint8_t)(i % RULES_INPUTS);
+        }
+        for (i = 1; i < k; i++)
+            image[len++] = RULES_OP_ADD;
+        Expect(image, len, k == RULES_STACK ? RULES_OK : RULES_E_STACK, k == RULES_STACK ? "full stack" : "stack overflow");
+    }
+
+    // price, then n times (price, PCT): the bound is 40 + 24 + 14 + 58 n cycles. 67 pairs fit
+    // the 4000-cycle budget (3964), 68 do not (4022).
+    for (k = 66; k <= 68; k++) {
+        len = 0;
+        image[len++] = RULES_VERSION;
+        image[len++] = 1;
+        image[len++] = (uint8_t)(2 + 3 * k);
+        image[len++] = RULES_OP_LOAD;
+        image[len++] = RULES_IN_PRICE;
+        for (i = 0; i < k; i++) {
+            image[len++] = RULES_OP_LOAD;
+            image[len++] = RULES_IN_PREV;
+            image[len++] = RULES_OP_PCT;
+        }
+        Expect(image, len, 64U + 14U + 58U * k <= CFG_RULES_BUDGET_CYCLES ? RULES_OK : RULES_E_BUDGET, "budget");
+        CHECK(Verify(image, len, &scratch) != RULES_E_STACK && scratch.bound == 64U + 14U + 58U * k,
+              "%u pairs: bound %u, not %u", k, scratch.bound, 64U + 14U + 58U * k);
+    }
+    CHECK(CFG_RULES_BUDGET_CYCLES >= 3964U && CFG_RULES_BUDGET_CYCLES < 4022U, "budget moved: update the 67/68 pairs");
+
+    // One byte longer than RULES_IMAGE_MAX, otherwise well formed: price, (price, ADD)..., NEGs.
+    len = 0;
+    image[len++] = RULES_VERSION;
+    image[len++] = 1;
+    image[len++] = RULES_IMAGE_MAX + 1U - 3U;
+    image[len++] = RULES_OP_LOAD;
+    image[len++] = RULES_IN_PRICE;
+    while (len + 3U <= RULES_IMAGE_MAX + 1U) {
+        image[len++] = RULES_OP_LOAD;
+        image[len++] = RULES_IN_PRICE;
+        image[len++] = RULES_OP_ADD;
+    }
+    while (len < RULES_IMAGE_MAX + 1U)
+        image[len++] = RULES_OP_NEG;
+    Expect(image, len, RULES_E_SIZE, "image over RULES_IMAGE_MAX");
+    CHECK(Verify(image, len - 1U, &scratch) == RULES_E_SIZE, "cut by one byte: not RULES_E_SIZE");
+}
+
+static float Div(float a, float b) { return b != 0.0f ? a / b : 0.0f; }
+static float Pct(float a, float b) { return b != 0.0f ? (a - b) / b * 100.0f : 0.0f; }
+
+// Run() on 'code' with in[0] = a, in[1] = b.
+static float Run2(const uint8_t *code, uint32_t len, float a, float b) {
+    float in[RULES_INPUTS] = { 0 };
+    in[0] = a;
+    in[1] = b;
+    return Run(code, len, in);
+}
+
+static void Check_Ops(void) {
+    static const float v[] = { 0.0f, -0.0f, 1.0f, -1.0f, 2.0f, 3.0f, -2.5f, 0.5f, 97000.25f, -97000.25f,
+                               1e30f, -1e30f, 1e-30f };
+    uint32_t i, j, op;
+    uint8_t code[8] = { LOAD(0), LOAD(1), 0 };
+    for (op = RULES_OP_ADD; op < RULES_OPS; op++) {
+        if (op_info[op].pops != 2)
+            continue;
+        code[4] = (uint8_t)op;
+        for (i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+            for (j = 0; j < sizeof(v) / sizeof(v[0]); j++) {
+                float a = v[i], b = v[j], want, got = Run2(code, 5, a, b);
+                switch (op) {
+                case RULES_OP_ADD: want = a + b; break;
+                case RULES_OP_SUB: want = a - b; break;
+                case RULES_OP_MUL: want = a * b; break;
+                case RULES_OP_DIV: want = Div(a, b); break;
+                case RULES_OP_MIN: want = b < a ? b : a; break;
+                case RULES_OP_MAX: want = b > a ? b : a; break;
+                case RULES_OP_PCT: want = Pct(a, b); break;
+                case RULES_OP_LT:  want = a < b; break;
+                case RULES_OP_LE:  want = a <= b; break;
+                case RULES_OP_GT:  want = a > b; break;
+                case RULES_OP_GE:  want = a >= b; break;
+                case RULES_OP_AND: want = a != 0.0f && b != 0.0f; break;
+                default:           want = a != 0.0f || b != 0.0f; break;
+                }
+                CHECK(memcmp(&got, &want, sizeof(float)) == 0, "opcode %u on %g, %g: %g, not %g", op, a, b, got,
+                      want);
+            }
+        }
+    }
+    for (op = RULES_OP_NEG; op <= RULES_OP_NOT; op++) {
+        code[2] = (uint8_t)op;
+        for (i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+            float a = v[i], want, got = Run2(code, 3, a, 0.0f);
+            want = op == RULES_OP_NEG ? -a : op == RULES_OP_ABS ? (a < 0.0f ? -a : a) : (float)(a == 0.0f);
+            CHECK(memcmp(&got, &want, sizeof(float)) == 0, "opcode %u on %g: %g, not %g", op, a, got, want);
+        }
+    }
+    {
+        static const uint8_t c[] = { RULES_OP_CONST, 0x00, 0x00, 0x48, 0xC2 };   // -50.0f
+        float got = Run2(c, sizeof(c), 0, 0);
+        CHECK(got == -50.0f, "CONST: %g", got);
+        for (i = 0; i < RULES_INPUTS; i++) {
+            float in[RULES_INPUTS];
+            uint8_t l[2] = { LOAD(0) };
+            for (j = 0; j < RULES_INPUTS; j++)
+                in[j] = (float)(j * 10 + 1);
+            l[1] = (uint8_t)i;
+            CHECK(Run(l, 2, in) == (float)(i * 10 + 1), "LOAD %u", i);
+        }
+    }
+}
+
+#define EEPROM_MAGIC_WORD (RULES_EEPROM_WORD)
+#define EEPROM_HEAD_WORD  (RULES_EEPROM_WORD + 1U)
+
+static void Check_Eeprom(void) {
+    static const uint8_t host[] = { RULES_VERSION, 2, 8, LOAD(RULES_IN_PRICE), CONST_2, RULES_OP_GT,
+                                    5, LOAD(RULES_IN_CHANGE), LOAD(RULES_IN_PREV), RULES_OP_MUL };
+    static uint32_t saved[BOARD_EEPROM_WORDS];
+    uint8_t image[RULES_IMAGE_MAX];
+
+    memset(board_eeprom, 0, sizeof(board_eeprom));
+    Rules_Init();
+    CHECK(rules_stats.source == RULES_BUILTIN && rules_stats.status == RULES_OK, "blank EEPROM: source %u status %u",
+          rules_stats.source, rules_stats.status);
+    CHECK(rules_stats.op_ns_x10 > 0, "no time per opcode measured");
+
+    CHECK(Rules_Load(host, sizeof(host), RULES_HOST) == RULES_OK && Rules_Store() == RULES_OK &&
+          rules_stats.source == RULES_EEPROM, "store: status %u", rules_stats.status);
+    CHECK(board_eeprom[EEPROM_MAGIC_WORD] == RULES_MAGIC && (board_eeprom[EEPROM_HEAD_WORD] & 0xFFFFU) == sizeof(host),
+          "stored header %08x %08x", board_eeprom[EEPROM_MAGIC_WORD], board_eeprom[EEPROM_HEAD_WORD]);
+    memcpy(saved, board_eeprom, sizeof(saved));
+    Rules_Load(NULL, 0, RULES_BUILTIN);
+    Rules_Init();
+    CHECK(rules_stats.source == RULES_EEPROM && rules_stats.bytes == sizeof(host) && rules_stats.count == 2,
+          "reboot: source %u, %u bytes", rules_stats.source, rules_stats.bytes);
+    CHECK(Eeprom_Load(image) == sizeof(host) && memcmp(image, host, sizeof(host)) == 0, "stored image differs");
+
+    // Damage, one kind at a time: each boot falls back to the built-in set.
+    {
+        static const struct { uint32_t word, flip; const char *what; } damage[] = {
+            { EEPROM_MAGIC_WORD, 0x1U, "magic" },
+            { EEPROM_HEAD_WORD, 0x10000U, "checksum" },
+            { EEPROM_HEAD_WORD, 0x1U, "length" },
+            { EEPROM_HEAD_WORD, 0x100U, "length past RULES_IMAGE_MAX" },
+            { EEPROM_HEAD_WORD + 1U, 0x01000000U, "first image word" },
+            { EEPROM_HEAD_WORD + 3U, 0x00010000U, "last image word" },
+        };
+        uint32_t i;
+        for (i = 0; i < sizeof(damage) / sizeof(damage[0]); i++) {
+            memcpy(board_eeprom, saved, sizeof(saved));
+            board_eeprom[damage[i].word] ^= damage[i].flip;
+            Rules_Init();
+            CHECK(rules_stats.source == RULES_BUILTIN && rules_stats.bytes == sizeof(builtin),
+                  "damaged %s: source %u", damage[i].what, rules_stats.source);
+        }
+    }
+
+    // A stored image with a good checksum that Verify refuses: built-in, and the status says why.
+    memcpy(board_eeprom, saved, sizeof(saved));
+    memcpy(image, host, sizeof(host));
+    image[4] = RULES_INPUTS;                                    // LOAD of a missing input
+    board_eeprom[EEPROM_HEAD_WORD + 1U] = (uint32_t)image[0] | (uint32_t)image[1] << 8 | (uint32_t)image[2] << 16 |
+                                          (uint32_t)image[3] << 24;
+    board_eeprom[EEPROM_HEAD_WORD + 2U] = (uint32_t)image[4] | (uint32_t)image[5] << 8 | (uint32_t)image[6] << 16 |
+                                          (uint32_t)image[7] << 24;
+    board_eeprom[EEPROM_HEAD_WORD] = sizeof(host) | (uint32_t)Checksum(image, sizeof(host)) << 16;
+    Rules_Init();
+    CHECK(rules_stats.source == RULES_BUILTIN && rules_stats.status == RULES_E_OPCODE,
+          "refused stored set: source %u status %u", rules_stats.source, rules_stats.status);
+
+    // A failed write reports RULES_E_EEPROM and leaves the source as it was.
+    memcpy(board_eeprom, saved, sizeof(saved));
+    Rules_Init();
+    Rules_Load(host, sizeof(host), RULES_HOST);
+    board_eeprom_fail = 0x04U;
+    CHECK(Rules_Store() == RULES_E_EEPROM && rules_stats.source == RULES_HOST, "failed write: status %u source %u",
+          rules_stats.status, rules_stats.source);
+    board_eeprom_fail = 0;
+
+    // Storing the built-in set clears the stored one.
+    Rules_Load(NULL, 0, RULES_BUILTIN);
+    CHECK(Rules_Store() == RULES_OK && board_eeprom[EEPROM_MAGIC_WORD] == 0, "built-in store left magic %08x",
+          board_eeprom[EEPROM_MAGIC_WORD]);
+    Rules_Init();
+    CHECK(rules_stats.source == RULES_BUILTIN, "after storing the built-in set: source %u", rules_stats.source);
+}
+
+static void Check_Tick(void) {
+    // prev > price | hour < 0 | low_24h < price - 50
+    static const uint8_t set[] = { RULES_VERSION, 3,
+                                   5, LOAD(RULES_IN_PREV), LOAD(RULES_IN_PRICE), RULES_OP_GT,
+                                   8, LOAD(RULES_IN_HOUR), RULES_OP_CONST, 0, 0, 0, 0, RULES_OP_LT,
+                                   11, LOAD(RULES_IN_LOW_24H), LOAD(RULES_IN_PRICE), RULES_OP_CONST, 0x00, 0x00, 0x48,
+                                   0x42, RULES_OP_SUB, RULES_OP_LT };
+    uint32_t t = 1760000400U;
+    CHECK(Rules_Load(set, sizeof(set), RULES_HOST) == RULES_OK, "tick set refused");
+    CHECK(Rules_Tick(100.0f, 0.0f, 0.0f, 0) == 2, "first tick without a clock: %x", rules_stats.fired);
+    CHECK(Rules_Tick(90.0f, 0.0f, 0.0f, t) == 1, "price fell: %x", rules_stats.fired);
+    History_Add(t, 1000);
+    History_Add(t + 300, 1100);
+    CHECK(Rules_Tick(1100.0f, 0.0f, 0.0f, t + 310) == 4, "100 above the 24 h low: %x", rules_stats.fired);
+    CHECK(Rules_Tick(1100.0f, 0.0f, 0.0f, t + 3U * 86400U) == 0, "no history in the last 24 h: %x",
+          rules_stats.fired);
+    CHECK(rules_stats.bound == RULES_SET_CYCLES + 3U * RULES_RULE_CYCLES + 14U * 2U + 16U + 14U + 18U + 16U + 14U * 2U +
+          18U + 14U + 16U, "tick set bound %u", rules_stats.bound);
+}
+
+// Eight compiled rules against the same expressions in C, evaluated in float as Run() does.
+static const char *compiled_src[] = {
+    "price < threshold",
+    "pct(price, prev) < -2 or price < low_24h * 0.98",
+    "abs(change) > 8 and hour >= 8 and hour < 22",
+    "not (max(price, threshold) / min(mean_24h, low_24h) <= 1.05)",
+    "-price + 2 * mean_1h - high_1h >= -(low_1h - price - 3.5)",
+    "price / (threshold - threshold) < 1",
+    "high_24h - low_24h > 0.05 * mean_24h",
+    "change * -2 > 3e0 or -(-change) < -10",
+};
+
+static int Compiled_C(uint32_t r, const float *in) {
+    float p = in[RULES_IN_PRICE], c = in[RULES_IN_CHANGE], th = in[RULES_IN_THRESHOLD], pv = in[RULES_IN_PREV];
+    float h = in[RULES_IN_HOUR], l1 = in[RULES_IN_LOW_1H], h1 = in[RULES_IN_HIGH_1H], m1 = in[RULES_IN_MEAN_1H];
+    float l24 = in[RULES_IN_LOW_24H], h24 = in[RULES_IN_HIGH_24H], m24 = in[RULES_IN_MEAN_24H];
+    switch (r) {
+    case 0: return p < th;
+    case 1: return Pct(p, pv) < -2.0f || p < l24 * 0.98f;
+    case 2: return ((c < 0.0f ? -c : c) > 8.0f) && h >= 8.0f && h < 22.0f;
+    case 3: return !(Div(p > th ? p : th, l24 < m24 ? l24 : m24) <= 1.05f);
+    case 4: return -p + 2.0f * m1 - h1 >= -(l1 - p - 3.5f);
+    case 5: return Div(p, th - th) < 1.0f;
+    case 6: return h24 - l24 > 0.05f * m24;
+    default: return c * -2.0f > 3.0f || -(-c) < -10.0f;
+    }
+}
+
+static void Check_Compiler(void) {
+    char src[] = "/tmp/rules_test_XXXXXX", bin[64], cmd[256], out[256];
+    uint8_t image[RULES_IMAGE_MAX + 1];
+    uint32_t i, r, bound = 0, fired[RULES_MAX] = { 0 };
+    size_t len;
+    FILE *f;
+    int fd = mkstemp(src);
+    CHECK(fd >= 0, "no temporary file");
+    if (fd < 0)
+        return;
+    f = fdopen(fd, "w");
+    for (r = 0; r < RULES_MAX; r++)
+        fprintf(f, "%s   # rule %u\n", compiled_src[r], r);
+    fclose(f);
+    snprintf(bin, sizeof(bin), "%s.bin", src);
+    snprintf(cmd, sizeof(cmd), "python3 tools/rules_compile.py %s -o %s", src, bin);
+    f = popen(cmd, "r");
+    while (f && fgets(out, sizeof(out), f))
+        if (sscanf(out, "set: %*u rules, %*u bytes, at most %u cycles", &bound) == 1)
+            break;
+    while (f && fgets(out, sizeof(out), f)) { }
+    CHECK(f && pclose(f) == 0 && bound > 0, "%s failed", cmd);
+    f = fopen(bin, "rb");
+    len = f ? fread(image, 1, sizeof(image), f) : 0;
+    if (f)
+        fclose(f);
+    unlink(src);
+    unlink(bin);
+    CHECK(len > 0 && Verify(image, (uint32_t)len, &scratch) == RULES_OK && scratch.count == RULES_MAX,
+          "compiled image of %u bytes refused (%u)", (unsigned)len, Verify(image, (uint32_t)len, &scratch));
+    CHECK(scratch.bound == bound, "bound %u, the compiler says %u", scratch.bound, bound);
+    if (scratch.count != RULES_MAX)
+        return;
+
+    for (i = 0; i < 20000; i++) {
+        float in[RULES_INPUTS];
+        uint32_t got, want = 0;
+        in[RULES_IN_PRICE] = Uniform(90000.0f, 100000.0f);
+        in[RULES_IN_CHANGE] = Uniform(-15.0f, 15.0f);
+        in[RULES_IN_THRESHOLD] = (Rand() & 7) == 0 ? in[RULES_IN_PRICE] : Uniform(90000.0f, 100000.0f);
+        in[RULES_IN_PREV] = in[RULES_IN_PRICE] * Uniform(0.97f, 1.03f);
+        in[RULES_IN_HOUR] = (float)(Rand() % 25U) - 1.0f;
+        in[RULES_IN_LOW_1H] = in[RULES_IN_PRICE] * Uniform(0.99f, 1.0f);
+        in[RULES_IN_HIGH_1H] = in[RULES_IN_PRICE] * Uniform(1.0f, 1.01f);
+        in[RULES_IN_MEAN_1H] = Uniform(in[RULES_IN_LOW_1H], in[RULES_IN_HIGH_1H]);
+        in[RULES_IN_LOW_24H] = in[RULES_IN_PRICE] * Uniform(0.94f, 1.0f);
+        in[RULES_IN_HIGH_24H] = in[RULES_IN_PRICE] * Uniform(1.0f, 1.06f);
+        in[RULES_IN_MEAN_24H] = in[RULES_IN_LOW_24H] * Uniform(1.0f, 1.06f);
+        got = Eval_Set(&scratch, in);
+        for (r = 0; r < RULES_MAX; r++) {
+            want |= (uint32_t)Compiled_C(r, in) << r;
+            fired[r] += (got >> r) & 1U;
+        }
+        CHECK(got == want, "inputs %u: fired %02x, C says %02x", i, got, want);
+    }
+    printf("  compiled set: %u bytes, bound %u cycles; fired per rule of 20000:", (unsigned)len, bound);
+    for (r = 0; r < RULES_MAX; r++)
+        printf(" %u", fired[r]);
+    printf("\n");
+}
+
+int main(void) {
+    Check_Verify();
+    Check_Ops();
+    Check_Eeprom();
+    Check_Tick();
+    Check_Compiler();
+    return Check_Done("rules");
+}
@@ -0,0 +1,486 @@
+//sdlog_test.c
+// Host test of the microSD log (build/sdlog.c) against a model of an SD card in SPI mode on
+// the board shim's SSI2, holding a FAT32 image with TICKLOG.BIN in RAM. The uDMA driver is
+// replaced by a model that moves the 512 data bytes when the SPI clock would have.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Iqemu -Ibuild -o sdlog_test linux/sdlog_test.c build/sdlog.c qemu/board.c && ./sdlog_test
+//
+// The clock is virtual: every byte the CPU exchanges over SPI costs its bit times at the
+// clock set in SSI2, a sector sent by uDMA costs the same without the CPU, and the main loop
+// does 50 us of other work between two SdLog_Poll() calls. The card answers the commands the
+// driver sends and stays busy after each write for its program time, with a long stall every
+// so many writes as real cards do when they erase.
+//
+// Checked: mounting with no card, a powering-up card, a missing or fragmented file; the log
+// read back from the image after wrapping the ring several times, after a restart and after
+// the card was pulled and put back (every record accepted is there once, in order). Measured
+// for a fast and a slow card: the record rate each sustains without dropping anything, the
+// longest card stall, and the longest a single SdLog_Poll() call holds up the main loop.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracker.h"
+#include "sdlog.h"
+#include "udma.h"
+#include "check.h"
+
+#define CYC_MS       (CFG_SYSTEM_CLOCK_HZ / 1000U)
+#define CYC_US       (CFG_SYSTEM_CLOCK_HZ / 1000000U)
+#define LOOP_CYCLES  (50U * CYC_US)        // Main-loop work between two polls
+#define SPC          8U                    // Sectors per cluster
+#define FAT_LBA      32U
+#define FAT_SECTORS  4U
+#define DATA_LBA     (FAT_LBA + 2U * FAT_SECTORS)
+#define FILE_CLUSTER 3U                    // The root directory is cluster 2
+#define FILE_LBA     (DATA_LBA + (FILE_CLUSTER - 2U) * SPC)
+#define MAX_FILE     2048U                 // Sectors
+#define MAX_TRACK    20000U                // Accepted records remembered for the read-back
+#define SDLOG_MAGIC  0x474C4453U
+
+enum { CARD_CMD, CARD_TOKEN, CARD_DATA, CARD_BUSY };
+
+typedef struct {
+    int present;
+    uint64_t ready_at;            // ACMD41 reports "idle" until then (cycles)
+    uint32_t prog_us;             // Busy time after a write...
+    uint32_t stall_us, stall_every;  // ...and every stall_every-th write this long instead
+    uint8_t cmd[6], n_cmd, app, idle, state;
+    uint8_t q[520];               // Bytes queued to send (response, read data)
+    uint32_t q_n, q_i;
+    uint32_t lba, n_data, writes;
+    uint8_t data[514];            // Written block and its CRC
+    uint64_t busy_until;
+} Card;
+
+typedef struct {
+    const char *name;
+    uint32_t prog_us, stall_us, stall_every;
+} CardKind;
+
+static const CardKind kinds[] = {
+    { "fast", 800, 25000, 128 },  // Class 10 / A1 card: sub-ms writes, an occasional erase
+    { "slow", 3000, 250000, 32 }, // Old or worn card, stalls at the SD spec's 250 ms write limit
+};
+
+static uint8_t image[(FILE_LBA + MAX_FILE) * SDLOG_SECTOR];
+static uint32_t image_file;       // Sectors of TICKLOG.BIN in the image
+static uint64_t clk;              // Virtual time, in CPU cycles
+static Card card;
+static uint32_t tick_time = 1;    // Time field of the next tick (unique, increasing)
+static uint32_t track[MAX_TRACK], n_track;
+
+uint32_t Millis(void) {
+    return (uint32_t)(clk / CYC_MS);
+}
+
+static uint32_t Bit_Cycles(void) {          // SPI bit time at the clock SSI2 is set to
+    return board_ssi2.CPSR * (1U + (board_ssi2.CR0 >> 8));
+}
+
+// Card model
+
+static void Queue(uint8_t b) {
+    card.q[card.q_n++] = b;
+}
+
+static void Card_Command(void) {
+    uint8_t cmd = card.cmd[0] & 0x3FU;
+    uint32_t arg = (uint32_t)card.cmd[1] << 24 | (uint32_t)card.cmd[2] << 16 | (uint32_t)card.cmd[3] << 8 | card.cmd[4];
+    int app = card.app;
+    card.app = 0;
+    card.q_n = card.q_i = 0;
+    Queue(0xFF);                               // One byte before the response (Ncr)
+    if (cmd == 0) {
+        card.idle = 1;
+        Queue(0x01);
+    } else if (cmd == 8) {                     // v2 card: echo the check pattern
+        Queue(card.idle);
+        Queue(0x00);
+        Queue(0x00);
+        Queue((uint8_t)(arg >> 8));
+        Queue((uint8_t)arg);
+    } else if (cmd == 55) {
+        card.app = 1;
+        Queue(card.idle);
+    } else if (cmd == 41 && app) {
+        if (clk >= card.ready_at)
+            card.idle = 0;
+        Queue(card.idle);
+    } else if (card.idle) {
+        Queue(0x05);                           // Illegal command while initialising
+    } else if (cmd == 58) {                    // OCR: powered up, CCS (block addressing)
+        Queue(0x00);
+        Queue(0xC0);
+        Queue(0xFF);
+        Queue(0x80);
+        Queue(0x00);
+    } else if (cmd == 16) {
+        Queue(0x00);
+    } else if (cmd == 17 && arg < FILE_LBA + MAX_FILE) {
+        Queue(0x00);
+        Queue(0xFF);
+        Queue(0xFE);
+        memcpy(&card.q[card.q_n], &image[arg * SDLOG_SECTOR], SDLOG_SECTOR);
+        card.q_n += SDLOG_SECTOR;
+        Queue(0xFF);
+        Queue(0xFF);
+    } else if (cmd == 24 && arg < FILE_LBA + MAX_FILE) {
+        Queue(0x00);
+        card.lba = arg;
+        card.state = CARD_TOKEN;
+    } else {
+        Queue(0x40);                           // Parameter error
+    }
+}
+
+// One byte from the host; returns the byte the card sends back.
+static uint8_t Card_Take(uint8_t out) {
+    if (!card.present)
+        return 0xFF;
+    if (board_gpio[1][255] & 0x20U) {          // PB5: CS high, the card ignores the bus
+        card.n_cmd = 0;
+        return 0xFF;
+    }
+    if (card.q_i < card.q_n)
+        return card.q[card.q_i++];
+    if (card.state == CARD_BUSY) {             // Holds MISO low while programming
+        if (clk < card.busy_until)
+            return 0x00;
+        card.state = CARD_CMD;
+    }
+    if (card.state == CARD_TOKEN) {
+        if (out == 0xFE) {
+            card.state = CARD_DATA;
+            card.n_data = 0;
+        }
+        return 0xFF;
+    }
+    if (card.state == CARD_DATA) {
+        card.data[card.n_data++] = out;
+        if (card.n_data == sizeof(card.data)) {
+            uint32_t us = (card.stall_every && ++card.writes % card.stall_every == 0) ? card.stall_us : card.prog_us;
+            memcpy(&image[card.lba * SDLOG_SECTOR], card.data, SDLOG_SECTOR);
+            card.busy_until = clk + (uint64_t)us * CYC_US;
+            card.q_n = card.q_i = 0;
+            Queue(0xE5);                       // Data accepted
+            card.state = CARD_BUSY;
+        }
+        return 0xFF;
+    }
+    if (card.n_cmd == 0 && (out & 0xC0U) != 0x40U)
+        return 0xFF;
+    card.cmd[card.n_cmd++] = out;
+    if (card.n_cmd == 6) {
+        card.n_cmd = 0;
+        Card_Command();
+    }
+    return 0xFF;
+}
+
+static uint8_t Ssi_Byte(uint8_t out) {
+    clk += 8U * Bit_Cycles();                  // The CPU waits for the byte to go round
+    return Card_Take(out);
+}
+
+static void Card_Insert(const CardKind *k, uint32_t power_up_ms) {
+    memset(&card, 0, sizeof(card));
+    card.present = 1;
+    card.ready_at = clk + (uint64_t)power_up_ms * CYC_MS;
+    card.prog_us = k->prog_us;
+    card.stall_us = k->stall_us;
+    card.stall_every = k->stall_every;
+}
+
+// uDMA model: the transfer ends when the SPI clock has moved the last byte; the data goes to
+// the card then. Only the TX channel's source matters (RX goes to a sink).
+
+static const volatile uint8_t *dma_src;
+static uint32_t dma_items, dma_on;
+static uint64_t dma_end;
+
+void Udma_Init(void) {
+}
+
+void Udma_Assign(uint32_t channel, uint32_t encoding) {
+    (void)channel;
+    (void)encoding;
+}
+
+void Udma_Start(uint32_t channel, const volatile void *src, volatile void *dst, uint32_t items, uint32_t ctl) {
+    (void)dst;
+    (void)ctl;
+    dma_on |= 1U << channel;
+    if ((ctl & UDMA_SRC_NONE) != UDMA_SRC_NONE) {
+        dma_src = (const volatile uint8_t *)src;
+        dma_items = items;
+        dma_end = clk + (uint64_t)items * 8U * Bit_Cycles();
+    }
+}
+
+int Udma_Busy(uint32_t channel) {
+    if (dma_on && clk >= dma_end) {
+        uint32_t i;
+        for (i = 0; i < dma_items; i++)
+            Card_Take(dma_src[i]);
+        dma_on = 0;
+    }
+    return (dma_on >> channel) & 1U;
+}
+
+// FAT32 image: boot sector (no partition table), two FATs, the root directory in cluster 2
+// and TICKLOG.BIN from cluster 3 on, contiguous unless 'fragmented' (a free cluster after
+// its first one). 'name' is the 8.3 directory name to give the file.
+
+static void Put16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void Put32(uint8_t *p, uint32_t v) {
+    Put16(p, v);
+    Put16(p + 2, v >> 16);
+}
+
+static uint32_t Get32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void Make_Image(uint32_t sectors, int fragmented, const char *name) {
+    uint8_t *boot = image, *dir = &image[DATA_LBA * SDLOG_SECTOR];
+    uint32_t clusters = sectors / SPC, chain[MAX_FILE / SPC], c, f;
+    memset(image, 0, sizeof(image));
+    Put16(&boot[11], SDLOG_SECTOR);
+    boot[13] = SPC;
+    Put16(&boot[14], FAT_LBA);
+    boot[16] = 2;
+    Put32(&boot[36], FAT_SECTORS);
+    Put32(&boot[44], 2);
+    Put16(&boot[510], 0xAA55);
+    for (c = 0; c < clusters; c++)
+        chain[c] = FILE_CLUSTER + c + (fragmented && c > 0 ? 1U : 0U);
+    for (f = 0; f < 2; f++) {
+        uint8_t *fat = &image[(FAT_LBA + f * FAT_SECTORS) * SDLOG_SECTOR];
+        Put32(&fat[0], 0x0FFFFFF8U);
+        Put32(&fat[4], 0x0FFFFFFFU);
+        Put32(&fat[8], 0x0FFFFFFFU);           // Root directory: one cluster
+        for (c = 0; c < clusters; c++)
+            Put32(&fat[chain[c] * 4U], c + 1U < clusters ? chain[c + 1U] : 0x0FFFFFFFU);
+    }
+    memcpy(dir, name, 11);
+    dir[11] = 0x20;                            // Archive
+    Put16(&dir[20], FILE_CLUSTER >> 16);
+    Put16(&dir[26], FILE_CLUSTER & 0xFFFFU);
+    Put32(&dir[28], sectors * SDLOG_SECTOR);
+    image_file = sectors;
+}
+
+// Records of the log in the image, oldest sector first: the tick times into 'out'.
+static uint32_t Read_Back(uint32_t *out, uint32_t max) {
+    static uint32_t order[MAX_FILE];
+    uint32_t n = 0, i, j, k, got = 0;
+    for (i = 0; i < image_file; i++) {
+        const uint8_t *s = &image[(FILE_LBA + i) * SDLOG_SECTOR];
+        if (Get32(s) == SDLOG_MAGIC && Get32(s + 8) == ~Get32(s + 4))
+            order[n++] = i;
+    }
+    for (i = 1; i < n; i++)                    // Insertion sort by seq
+        for (j = i; j > 0 && Get32(&image[(FILE_LBA + order[j - 1]) * SDLOG_SECTOR + 4]) >
+                             Get32(&image[(FILE_LBA + order[j]) * SDLOG_SECTOR + 4]); j--) {
+            k = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = k;
+        }
+    for (i = 0; i < n; i++) {
+        const uint8_t *s = &image[(FILE_LBA + order[i]) * SDLOG_SECTOR];
+        uint32_t used = s[12] | (uint32_t)s[13] << 8, p = sizeof(SdLogHeader);
+        while (p + 2U <= used && got < max) {
+            if (s[p] == SDLOG_TICK)
+                out[got++] = Get32(&s[p + 2]);
+            p += 2U + s[p + 1];
+        }
+    }
+    return got;
+}
+
+// Main loop
+
+typedef struct {
+    uint64_t block_max;           // Longest SdLog_Poll() call with the card mounted (cycles)
+    uint64_t mount_max;           // Longest call that tried a mount
+} Blocking;
+
+// Run the main loop for 'ms', queueing 'rate' ticks per second; remembers the accepted ones.
+static void Run(uint32_t ms, uint32_t rate, Blocking *b) {
+    uint64_t end = clk + (uint64_t)ms * CYC_MS, next = clk, t;
+    while (clk < end) {
+        uint8_t state = sdlog_stats.state;
+        while (rate && next <= clk) {
+            uint32_t before = sdlog_stats.records;
+            SdLog_Tick(tick_time, 9700000, 0);
+            if (sdlog_stats.records != before && n_track < MAX_TRACK)
+                track[n_track++] = tick_time;
+            tick_time++;
+            next += CFG_SYSTEM_CLOCK_HZ / rate;
+        }
+        t = clk;
+        SdLog_Poll(Millis());
+        if (b && state == SDLOG_STATE_ABSENT && clk - t > b->mount_max)
+            b->mount_max = clk - t;
+        else if (b && state != SDLOG_STATE_ABSENT && clk - t > b->block_max)
+            b->block_max = clk - t;
+        clk += LOOP_CYCLES;
+    }
+}
+
+static void Restart(void) {
+    SdLog_Init();
+    n_track = 0;
+}
+
+// The log read back must be exactly the last records accepted (all of them when nothing was
+// overwritten).
+static void Check_Log(const char *what, int all) {
+    static uint32_t got[MAX_TRACK + 1];
+    uint32_t n = Read_Back(got, MAX_TRACK + 1), i, bad = 0;
+    if (all) {
+        CHECK(n == n_track, "%s: %u records read back, %u accepted", what, n, n_track);
+    } else {
+        CHECK(n > 0 && n <= n_track, "%s: %u records read back, %u accepted", what, n, n_track);
+    }
+    for (i = 0; i < n && i < n_track; i++)
+        bad += got[n - 1 - i] != track[n_track - 1 - i];
+    CHECK(bad == 0, "%s: %u records differ from the last ones accepted", what, bad);
+}
+
+static void Check_Mount(void) {
+    Blocking b = { 0, 0 };
+    board_ssi2_byte = Ssi_Byte;
+
+    // No card: every attempt gives up quickly, and attempts are retry_ms apart.
+    memset(&card, 0, sizeof(card));
+    Make_Image(64, 0, "TICKLOG BIN");
+    Restart();
+    Run(20000, 0, &b);
+    CHECK(sdlog_stats.state == SDLOG_STATE_ABSENT && sdlog_stats.mounts == 0, "mounted without a card");
+    CHECK(b.mount_max < CYC_MS, "a mount attempt without a card blocked %.2f ms", (double)b.mount_max / CYC_MS);
+    printf("  no card: a mount attempt blocks %.2f ms\n", (double)b.mount_max / CYC_MS);
+
+    // A card that takes 400 ms to power up: the attempt waits for it.
+    b.mount_max = 0;
+    Card_Insert(&kinds[0], 400);
+    Run(CFG_SDLOG_RETRY_MS + 100U, 0, &b);
+    CHECK(sdlog_stats.state == SDLOG_STATE_IDLE && sdlog_stats.mounts == 1, "card not mounted (state %u)",
+          sdlog_stats.state);
+    CHECK(sdlog_stats.file_sectors == 64, "file of %u sectors, want 64", sdlog_stats.file_sectors);
+    CHECK(b.mount_max >= 400U * CYC_MS && b.mount_max < 1100U * CYC_MS, "mount blocked %.0f ms",
+          (double)b.mount_max / CYC_MS);
+    printf("  card powering up for 400 ms: the mount blocks %.0f ms\n", (double)b.mount_max / CYC_MS);
+
+    // No log file, or a fragmented one: not mounted, nothing written.
+    Make_Image(64, 0, "OTHER   BIN");
+    Card_Insert(&kinds[0], 0);
+    Restart();
+    Run(1000, 10, NULL);
+    CHECK(sdlog_stats.mounts == 0, "mounted without TICKLOG.BIN");
+    Make_Image(64, 1, "TICKLOG BIN");
+    Card_Insert(&kinds[0], 0);
+    Restart();
+    Run(1000, 10, NULL);
+    CHECK(sdlog_stats.mounts == 0, "mounted a fragmented TICKLOG.BIN");
+    CHECK(Read_Back(track, MAX_TRACK) == 0, "wrote to a fragmented file");
+}
+
+static void Check_Ring(void) {
+    Make_Image(32, 0, "TICKLOG BIN");
+    Card_Insert(&kinds[1], 0);
+    Restart();
+
+    // 150 ticks/s for a minute: about 220 sectors through a 32-sector file.
+    Run(60000, 150, NULL);
+    Run(CFG_SDLOG_FLUSH_S * 1000U + 1000U, 0, NULL);  // The partial sector goes out
+    CHECK(sdlog_stats.dropped == 0 && sdlog_stats.errors == 0, "ring: %u dropped, %u errors",
+          sdlog_stats.dropped, sdlog_stats.errors);
+    CHECK(sdlog_stats.sectors > 4U * 32U, "ring: only %u sectors written", sdlog_stats.sectors);
+    Check_Log("after wrapping", 0);
+
+    // Restart: the mount finds the write position again and the log goes on after it.
+    {
+        uint32_t at = sdlog_stats.next_sector;
+        Restart();
+        Run(CFG_SDLOG_RETRY_MS, 0, NULL);
+        CHECK(sdlog_stats.next_sector == (at + 1U) % 32U, "restart resumed at sector %u, want %u",
+              sdlog_stats.next_sector, (at + 1U) % 32U);
+        Run(5000, 300, NULL);
+        Run(CFG_SDLOG_FLUSH_S * 1000U + 1000U, 0, NULL);
+        Check_Log("after a restart", 0);
+    }
+
+    // Pulled out after a partial sector was written, put back 30 s later once a full sector
+    // failed to go out: what was accepted meanwhile is written after the remount, nothing twice.
+    Make_Image(MAX_FILE, 0, "TICKLOG BIN");
+    Card_Insert(&kinds[0], 0);
+    Restart();
+    Run(2000, 5, NULL);
+    Run(CFG_SDLOG_FLUSH_S * 1000U + 1000U, 0, NULL);
+    CHECK(sdlog_stats.sectors == 1 && sdlog_stats.next_sector == 0, "partial sector: %u writes, at %u",
+          sdlog_stats.sectors, sdlog_stats.next_sector);
+    card.present = 0;
+    Run(30000, 2, NULL);
+    CHECK(sdlog_stats.state == SDLOG_STATE_ABSENT && sdlog_stats.errors == 1, "pulled card: state %u, %u errors",
+          sdlog_stats.state, sdlog_stats.errors);
+    Card_Insert(&kinds[0], 0);
+    Run(20000, 2, NULL);
+    Run(CFG_SDLOG_FLUSH_S * 1000U + 1000U, 0, NULL);
+    CHECK(sdlog_stats.mounts == 2, "%u mounts", sdlog_stats.mounts);
+    Check_Log("after the card was pulled", 1);
+}
+
+// Highest tick rate (per second) the card sustains for a minute without a drop.
+static uint32_t Sustained(const CardKind *k, Blocking *b) {
+    uint32_t lo = 1, hi = 20000, mid;
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        Make_Image(MAX_FILE, 0, "TICKLOG BIN");
+        Card_Insert(k, 0);
+        Restart();
+        Run(1000, 0, NULL);                    // Mounted
+        Run(60000, mid, b);
+        if (sdlog_stats.dropped == 0 && sdlog_stats.errors == 0)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+static void Check_Rates(void) {
+    uint32_t i, rate;
+    for (i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        Blocking b = { 0, 0 };
+        rate = Sustained(&kinds[i], &b);
+        Make_Image(MAX_FILE, 0, "TICKLOG BIN");
+        Card_Insert(&kinds[i], 0);
+        Restart();
+        Run(1000, 0, NULL);
+        Run(60000, rate, &b);
+        printf("  %s card (%.1f ms writes, %.0f ms every %u): %u ticks/s sustained, %.1f sectors/s, "
+               "card stall max %u ms, poll blocks at most %.1f us\n", kinds[i].name, kinds[i].prog_us / 1000.0,
+               kinds[i].stall_us / 1000.0, kinds[i].stall_every, rate, sdlog_stats.sectors / 60.0,
+               sdlog_stats.stall_max_ms, (double)b.block_max / CYC_US);
+        CHECK(rate >= 100, "%s card: only %u ticks/s", kinds[i].name, rate);
+        CHECK(b.block_max < 100U * CYC_US, "%s card: a poll blocked %.1f us", kinds[i].name,
+              (double)b.block_max / CYC_US);
+        CHECK(sdlog_stats.stall_max_ms < CFG_SDLOG_BUSY_TIMEOUT_MS, "%s card: stall %u ms", kinds[i].name,
+              sdlog_stats.stall_max_ms);
+    }
+}
+
+int main(void) {
+    Check_Mount();
+    Check_Ring();
+    Check_Rates();
+    return Check_Done("sdlog");
+}
@@ -0,0 +1,322 @@
+//uart_test.c
+// Bit-error injection harness for the receive path: UART1_Handler() (build/tracker.c) fed
+// through the board shim's UART1 receive queue (qemu/TM4C123GH6PM.h), whose DR words carry
+// the error flags the UART would set (FE, PE, BE, OE in bits 11:8), then main.c's own
+// Read_Line() and Ingest_Line(), compiled into this file.
+//
+// Build and run (from the repository root):
+//   cc -O2 -Wall -Iqemu -Ibuild -o uart_test linux/uart_test.c build/tracker.c build/link.c
+//      build/frame.c build/history.c build/dsp.c build/selftest.c build/flow.c build/pt.c
+//      build/rules.c build/lcdbus.c build/flashlog.c build/encoder.c build/feed.c build/sdlog.c
+//      build/ui.c build/tracker_config.c qemu/board.c && ./uart_test
+//
+// Every line is sent the way the ESP32 sends it, a break first. Checked: each flag puts the
+// UART_RX_ERROR or UART_RX_BREAK marker in the ring and is counted in uart_rx_stats; a line
+// with a flagged byte is dropped (link_quality.lines_dropped) while the lines around it arrive
+// intact, also when the flagged byte is the newline or there are no breaks; a break inside a
+// line cuts it off (link_quality.resyncs); a full ring drops bytes without corrupting a line;
+// and lines garbled without a flag are classified (lines_noise/_error/_corrupt). Then 20000
+// lines with random flagged errors must lose exactly the damaged ones.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define main Tracker_Main
+#include "main.c"
+#undef main
+
+#include "usbcdc.h"
+#include "udma.h"
+#include "check.h"
+
+#define FE 0x100U
+#define PE 0x200U
+#define BE 0x400U
+#define OE 0x800U
+
+#define MAX_LINES 20000
+#define LINE_MAX  BUFFER_SIZE
+
+// The modules main.c calls that do not build on the host (USB, DMA, TFT): idle stand-ins.
+CdcStats cdc_stats;
+void Cdc_Init(CdcTxDone tx_done) { (void)tx_done; }
+int Cdc_Ready(void) { return 0; }
+int Cdc_Send(const uint8_t *p, uint32_t len) { (void)p; (void)len; return 0; }
+uint32_t Cdc_Receive(uint8_t *out, uint32_t max) { (void)out; (void)max; return 0; }
+void Udma_Init(void) {}
+void Udma_Assign(uint32_t channel, uint32_t encoding) { (void)channel; (void)encoding; }
+void Udma_Start(uint32_t channel, const volatile void *src, volatile void *dst, uint32_t items, uint32_t ctl) {
+    (void)channel; (void)src; (void)dst; (void)items; (void)ctl;
+}
+int Udma_Busy(uint32_t channel) { (void)channel; return 0; }
+void Tft_Poll(uint32_t now) { (void)now; }
+
+static char sent[MAX_LINES][LINE_MAX];
+static char got[MAX_LINES][LINE_MAX];
+static uint32_t n_got, n_prices;
+static uint32_t rng = 7;
+
+static uint32_t Rand(void) {
+    rng = rng * 1664525U + 1013904223U;
+    return rng >> 8;
+}
+
+static void Reset(void) {
+    memset((void *)&uart_rx_stats, 0, sizeof(uart_rx_stats));
+    memset(&link_quality, 0, sizeof(link_quality));
+    uart_rx_dropped = 0;
+    line_pos = 0;
+    discard = 0;
+    n_got = n_prices = 0;
+}
+
+static void Make_Lines(uint32_t n) {
+    uint32_t i;
+    for (i = 0; i < n; i++)
+        snprintf(sent[i], LINE_MAX, "BTC Price: $%lu.%02lu, 24h Change: -1.%02lu%%, T: %lu",
+                 (unsigned long)(60000U + i * 37U % 9000U), (unsigned long)(i % 100U),
+                 (unsigned long)(i * 7U % 100U), (unsigned long)(1700000000U + i));
+}
+
+// Read every complete line out of the ring, as the main loop does, and ingest it.
+static void Drain(void) {
+    while (Read_Line()) {
+        if (n_got < MAX_LINES)
+            snprintf(got[n_got++], LINE_MAX, "%s", uart_buffer);
+        n_prices += (uint32_t)Ingest_Line();
+    }
+}
+
+// Queue one received word and let the interrupt take it.
+static void Rx(uint32_t dr) {
+    Board_Uart1_Receive(dr);
+    UART1_Handler();
+}
+
+// Send line i: a break (unless 'no_break'), its text and '\n', with 'flags' on byte 'at'
+// (the newline is byte strlen). A BE flag replaces that byte by a break, as a real one would.
+static void Send(uint32_t i, int no_break, uint32_t at, uint32_t flags) {
+    uint32_t k, len = (uint32_t)strlen(sent[i]);
+    if (!no_break)
+        Rx(BE | FE);
+    for (k = 0; k <= len; k++) {
+        uint32_t c = k < len ? (uint8_t)sent[i][k] : '\n';
+        if (k == at && flags)
+            c = (flags & BE) ? (flags | FE) : (c | flags);
+        Rx(c);
+    }
+}
+
+// The lines received must be the ones sent, in order, except those in 'lost' (a bit per line).
+static int Got_All_But(uint32_t n, uint64_t lost, const char *what) {
+    uint32_t i, k = 0;
+    for (i = 0; i < n; i++) {
+        if (lost & (1ULL << i))
+            continue;
+        if (k >= n_got || strcmp(got[k], sent[i]) != 0) {
+            CHECK(0, "%s: line %u missing or damaged (got '%s')", what, i, k < n_got ? got[k] : "");
+            return 0;
+        }
+        k++;
+    }
+    CHECK(k == n_got, "%s: %u lines received, want %u", what, n_got, k);
+    return 1;
+}
+
+static void Check_Clean(void) {
+    uint32_t i;
+    Reset();
+    for (i = 0; i < 20; i++) {
+        Send(i, 0, 0, 0);
+        Drain();
+    }
+    Got_All_But(20, 0, "clean");
+    CHECK(n_prices == 20, "clean: %u prices ingested, want 20", n_prices);
+    CHECK(uart_rx_stats.breaks == 20 && uart_rx_stats.framing == 0, "clean: %u breaks, %u framing",
+          uart_rx_stats.breaks, uart_rx_stats.framing);
+    CHECK(link_quality.lines_dropped == 0 && link_quality.resyncs == 0, "clean: dropped %u, resyncs %u",
+          link_quality.lines_dropped, link_quality.resyncs);
+}
+
+// One flagged byte in line 5 of 10.
+static void Check_Flag(uint32_t at, uint32_t flags, int no_break, const char *what) {
+    uint32_t i, len = (uint32_t)strlen(sent[5]);
+    uint64_t lost = 1ULL << 5;
+    Reset();
+    for (i = 0; i < 10; i++) {
+        Send(i, no_break, at, i == 5 ? flags : 0);
+        Drain();
+    }
+    if (no_break && at == len && !(flags & OE))
+        lost |= 1ULL << 6;        // Without a break the damaged line only ends at the next newline
+    Got_All_But(10, lost, what);
+    CHECK(link_quality.lines_dropped == 1, "%s: %u lines dropped, want 1", what, link_quality.lines_dropped);
+    CHECK(uart_rx_stats.framing == !!(flags & FE), "%s: framing %u", what, uart_rx_stats.framing);
+    CHECK(uart_rx_stats.parity == !!(flags & PE), "%s: parity %u", what, uart_rx_stats.parity);
+    CHECK(uart_rx_stats.overrun == !!(flags & OE), "%s: overrun %u", what, uart_rx_stats.overrun);
+    // Only a flagged newline leaves the damaged line open until the next line's break cuts it.
+    CHECK(link_quality.resyncs == (!no_break && at == len && !(flags & OE)), "%s: %u resyncs", what,
+          link_quality.resyncs);
+}
+
+static void Check_Flags(void) {
+    uint32_t len = (uint32_t)strlen(sent[5]);
+    Check_Flag(10, FE, 0, "framing error");
+    Check_Flag(10, PE, 0, "parity error");
+    Check_Flag(10, PE | FE, 0, "parity and framing error");
+    Check_Flag(10, OE, 0, "overrun");
+    Check_Flag(0, FE, 0, "framing error on the first byte");
+    Check_Flag(len, FE, 0, "framing error on the newline");
+    Check_Flag(len, OE, 0, "overrun on the newline");
+    Check_Flag(10, FE, 1, "framing error, no breaks");
+    Check_Flag(len, PE, 1, "parity error on the newline, no breaks");
+}
+
+// Two errors in one line count once; a marker never reaches the line buffer.
+static void Check_Markers(void) {
+    uint32_t i, k, len = (uint32_t)strlen(sent[1]);
+    Reset();
+    Send(0, 0, 0, 0);
+    Rx(BE | FE);
+    for (k = 0; k <= len; k++)
+        Rx((k < len ? (uint8_t)sent[1][k] : '\n') | (k == 3 || k == 20 ? FE : 0));
+    Send(2, 0, 0, 0);
+    Drain();
+    Got_All_But(3, 1ULL << 1, "two errors in a line");
+    CHECK(uart_rx_stats.framing == 2 && link_quality.lines_dropped == 1, "two errors: framing %u, dropped %u",
+          uart_rx_stats.framing, link_quality.lines_dropped);
+    for (i = 0; i < n_got; i++)
+        CHECK(strchr(got[i], UART_RX_ERROR) == NULL && strchr(got[i], UART_RX_BREAK) == NULL,
+              "a marker in line '%s'", got[i]);
+}
+
+// A break inside line 5 cuts it: the part before is discarded as a resync, the part after
+// ("85.05, 24h Change: ...") arrives as a line of its own and is classified as a corrupt
+// price line.
+static void Check_Break(void) {
+    uint32_t i;
+    Reset();
+    for (i = 0; i < 10; i++) {
+        Send(i, 0, 14, i == 5 ? BE : 0);
+        Drain();
+    }
+    CHECK(uart_rx_stats.breaks == 11 && link_quality.resyncs == 1, "mid-line break: %u breaks, %u resyncs",
+          uart_rx_stats.breaks, link_quality.resyncs);
+    CHECK(n_got == 10 && strcmp(got[5], sent[5] + 15) == 0, "mid-line break: fragment '%s'", n_got > 5 ? got[5] : "");
+    CHECK(n_prices == 9 && link_quality.lines_corrupt == 1, "mid-line break: %u prices, %u corrupt",
+          n_prices, link_quality.lines_corrupt);
+    CHECK(link_quality.lines_dropped == 0, "a break is not a dropped line");
+}
+
+// The main loop stalls while lines keep arriving: the ring fills and bytes are dropped. The
+// line cut off by the full ring must not come through; the ones before and after must.
+static void Check_Overflow(void) {
+    uint32_t i, n = 0, full = 0;
+    uint64_t lost = 0;
+    Reset();
+    for (i = 0; i < 60; i++) {
+        uint32_t before = uart_rx_dropped;
+        Send(i, 0, 0, 0);
+        if (uart_rx_dropped != before)
+            lost |= 1ULL << i;
+        if (uart_rx_dropped && !full)
+            full = i;             // First line that did not fit
+        if (i == 45)
+            Drain();              // The main loop catches up
+    }
+    Drain();
+    n = (uint32_t)strlen(sent[0]) + 2;
+    CHECK(full > 0 && full <= UART_RX_RING_SIZE / n, "ring filled at line %u", full);
+    CHECK(uart_rx_dropped > 0, "no bytes dropped");
+    Got_All_But(60, lost, "ring overflow");
+    CHECK(link_quality.resyncs == 1, "ring overflow: %u resyncs, want the cut line's one", link_quality.resyncs);
+}
+
+// Lines garbled without a flag (console output, error reports, a bit flip the parity missed)
+// arrive and are classified; the next price still parses.
+static void Check_Classes(void) {
+    static const char *lines[] = {
+        "WiFi connecting....", "HTTP error: -1", "JSON parsing error.", "BTC Price: $6123",
+        "BTC Pr\x81" "ce: $61234.56, 24h Change: -1.00%, T: 1", "Connected!",
+    };
+    uint32_t i, k;
+    Reset();
+    for (i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        Rx(BE | FE);
+        for (k = 0; lines[i][k]; k++)
+            Rx((uint8_t)lines[i][k]);
+        Rx('\n');
+        Send(i, 0, 0, 0);
+    }
+    Drain();
+    CHECK(n_prices == 6, "%u prices between the garbled lines", n_prices);
+    CHECK(link_quality.lines_noise == 2 && link_quality.lines_error == 2 && link_quality.lines_corrupt == 2,
+          "classes: noise %u error %u corrupt %u, want 2 each", link_quality.lines_noise,
+          link_quality.lines_error, link_quality.lines_corrupt);
+    CHECK(link_quality.lines_dropped == 0 && uart_rx_stats.framing == 0, "unflagged lines are not dropped");
+}
+
+// 20000 lines, one byte in 400 flagged FE, PE or OE: exactly the damaged lines are lost.
+static void Check_Random(void) {
+    static const uint32_t kinds[3] = { FE, PE, OE };
+    uint32_t i, k, damaged = 0, newline_cut = 0, fe = 0, pe = 0, oe = 0, j = 0, bad = 0;
+    static uint8_t lost[MAX_LINES];
+    Reset();
+    memset(lost, 0, sizeof(lost));
+    Make_Lines(MAX_LINES);
+    for (i = 0; i < MAX_LINES; i++) {
+        uint32_t len = (uint32_t)strlen(sent[i]), last = 0;
+        Rx(BE | FE);
+        for (k = 0; k <= len; k++) {
+            uint32_t c = k < len ? (uint8_t)sent[i][k] : '\n', f = 0;
+            if (Rand() % 400U == 0) {
+                f = kinds[Rand() % 3U];
+                fe += f == FE;
+                pe += f == PE;
+                oe += f == OE;
+                lost[i] = 1;
+                last = k == len ? f : 0;
+            }
+            Rx(c | f);
+        }
+        damaged += lost[i];
+        newline_cut += last == FE || last == PE;    // Open until the next break
+        if (i % 8U == 7U)
+            Drain();              // The main loop reads in bursts, well inside the ring
+    }
+    Drain();
+    for (i = 0; i < MAX_LINES; i++) {
+        if (lost[i])
+            continue;
+        while (j < n_got && strcmp(got[j], sent[i]) != 0)
+            j++, bad++;
+        if (j == n_got)
+            break;
+        j++;
+    }
+    CHECK(i == MAX_LINES, "random: undamaged line %u not received", i);
+    bad += n_got - j;
+    CHECK(bad == 0 && n_got == MAX_LINES - damaged, "random: %u lines received (%u unexpected), want %u",
+          n_got, bad, MAX_LINES - damaged);
+    CHECK(link_quality.lines_dropped == damaged, "random: %u lines dropped, want %u", link_quality.lines_dropped,
+          damaged);
+    CHECK(uart_rx_stats.framing == fe && uart_rx_stats.parity == pe && uart_rx_stats.overrun == oe,
+          "random: framing/parity/overrun %u/%u/%u, want %u/%u/%u", uart_rx_stats.framing,
+          uart_rx_stats.parity, uart_rx_stats.overrun, fe, pe, oe);
+    CHECK(link_quality.resyncs == newline_cut, "random: %u resyncs, want %u", link_quality.resyncs, newline_cut);
+    CHECK(n_prices == n_got, "random: %u of %u received lines parsed", n_prices, n_got);
+    printf("  random: %u lines, %u damaged (%u FE, %u PE, %u OE), %u received, %u resyncs\n", MAX_LINES,
+           damaged, fe, pe, oe, n_got, link_quality.resyncs);
+}
+
+int main(void) {
+    Make_Lines(64);
+    Check_Clean();
+    Check_Flags();
+    Check_Markers();
+    Check_Break();
+    Check_Overflow();
+    Check_Classes();
+    Check_Random();
+    return Check_Done("uart");
+}
@@ -0,0 +1,194 @@
+//TM4C123GH6PM.h (QEMU shim)
+// Stands in for the Keil device header when firmware modules are built for QEMU's mps2-an386
+// machine (Cortex-M4, see qemu/bench.c). -Iqemu comes before -Ibuild, so tracker.h and dsp.c
+// pick this one up. The peripheral blocks the firmware touches are plain RAM (qemu/board.c):
+// writes land there and do nothing, and the "peripheral ready" registers read as ready. The
+// GPIO blocks keep the real layout, so the masked DATA addresses (GPIOx_BASE + (bits << 2))
+// land in the same RAM. The DSP intrinsics map to their ACLE equivalents.
+//
+// The same shim builds with the host compiler (tools/qemu_bench.py --host and the linux/
+// tests): addresses are uintptr_t, and the intrinsics are plain C with the same results,
+// including the GE flags SSUB16 leaves for SEL. dsp.c only uses them on a core with the DSP
+// extension, or when a host test builds it with DSP_USE_SIMD=1 (linux/dsp_test.c).
+#ifndef TM4C123GH6PM_H
+#define TM4C123GH6PM_H
+
+#include <stdint.h>
+#if defined(__ARM_ACLE)
+#include <arm_acle.h>
+#endif
+
+#define __I  volatile const
+#define __O  volatile
+#define __IO volatile
+
+typedef enum {
+    UART1_IRQn = 6, SSI0_IRQn = 7, GPIOD_IRQn = 3, QEI0_IRQn = 13, TIMER0A_IRQn = 19,
+    GPIOF_IRQn = 30, HIB_IRQn = 43, USB0_IRQn = 44, UDMA_IRQn = 46, UDMAERR_IRQn = 47,
+    SSI2_IRQn = 57, WTIMER0A_IRQn = 94
+} IRQn_Type;
+
+typedef struct {
+    __I  uint32_t RESERVED0[255];
+    __IO uint32_t DATA, DIR, IS, IBE, IEV, IM, RIS, MIS, ICR, AFSEL;
+    __I  uint32_t RESERVED1[55];
+    __IO uint32_t DR2R, DR4R, DR8R, ODR, PUR, PDR, SLR, DEN, LOCK, CR, AMSEL, PCTL, ADCCTL, DMACTL;
+    __I  uint32_t RESERVED2[678];
+} GPIOA_Type;                     // 4 KB, as on the chip
+
+typedef struct {
+    __IO uint32_t RCGCGPIO, RCGCUART, RCGCSSI, RCGCTIMER, RCGCWTIMER, RCGCQEI, RCGCUSB, RCGCDMA, RCGCHIB, RCGCEEPROM;
+    __IO uint32_t PRGPIO, PRUART, PRSSI, PRTIMER, PRWTIMER, PRQEI, PRUSB, PRDMA, PRHIB, PREEPROM;
+} SYSCTL_Type;
+
+typedef struct {
+    __IO uint32_t DR, RSR, FR, ILPR, IBRD, FBRD, LCRH, CTL, IFLS, IM, RIS, MIS, ICR, DMACTL, CC;
+} UART0_Type;
+
+typedef struct {
+    __IO uint32_t EESIZE, EEBLOCK, EEOFFSET, RESERVED0, EERDWR, EERDWRINC, EEDONE, EESUPP;
+} EEPROM_Type;
+
+typedef struct {
+    __IO uint32_t FMA, FMD, FMC, FCRIS, FCIM, FCMISC, FMC2, FWBVAL;
+} FLASH_CTRL_Type;
+
+typedef struct {
+    __IO uint32_t CR0, CR1, DR, SR, CPSR, IM, RIS, MIS, ICR, DMACTL, CC;
+} SSI0_Type;
+
+typedef struct {
+    __IO uint32_t CTL, STAT, POS, MAXPOS, LOAD, TIME, COUNT, SPEED, INTEN, RIS, ISC;
+} QEI0_Type;                      // POS and SPEED only change when a test writes them
+
+typedef struct { __IO uint32_t CTRL, LOAD, VAL, CALIB; } SysTick_Type;
+typedef struct { __IO uint32_t CTRL, CYCCNT; } DWT_Type;
+typedef struct { __IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR; } CoreDebug_Type;
+
+extern uint32_t board_gpio[6][1024];
+extern SYSCTL_Type board_sysctl;
+extern UART0_Type board_uart1;
+extern QEI0_Type board_qei0;
+extern SysTick_Type board_systick;
+extern CoreDebug_Type board_coredebug;
+
+#define GPIOA_BASE ((uintptr_t)board_gpio[0])
+#define GPIOB_BASE ((uintptr_t)board_gpio[1])
+#define GPIOC_BASE ((uintptr_t)board_gpio[2])
+#define GPIOD_BASE ((uintptr_t)board_gpio[3])
+#define GPIOE_BASE ((uintptr_t)board_gpio[4])
+#define GPIOF_BASE ((uintptr_t)board_gpio[5])
+#define GPIOA      ((GPIOA_Type *)GPIOA_BASE)
+#define GPIOB      ((GPIOA_Type *)GPIOB_BASE)
+#define GPIOC      ((GPIOA_Type *)GPIOC_BASE)
+#define GPIOD      ((GPIOA_Type *)GPIOD_BASE)
+#define GPIOE      ((GPIOA_Type *)GPIOE_BASE)
+#define GPIOF      ((GPIOA_Type *)GPIOF_BASE)
+#define SYSCTL     (&board_sysctl)
+#define QEI0       (&board_qei0)
+#define SysTick    (&board_systick)
+#define CoreDebug  (&board_coredebug)
+
+// QEMU has no DWT cycle counter. Every read of this one moves it on by a millisecond of
+// SystemCoreClock, so DelayMs() and the coroutine timers run out after a few instructions
+// and the counts measure the code rather than the HD44780's wait times.
+DWT_Type *Board_Dwt(void);
+#define DWT (Board_Dwt())
+
+// Internal flash as a RAM image (erased words read 0xFFFFFFFF). Every access to FLASH_CTRL
+// first carries out a command left in FMC/FMC2, so the firmware's wait for the command bit
+// to clear sees it done. board_flash_ops counts the words programmed and sectors erased;
+// when it reaches board_flash_cut, power fails on that operation (see board.c).
+#define BOARD_FLASH_BYTES (256U * 1024U)
+extern uint32_t board_flash[BOARD_FLASH_BYTES / 4U];
+extern uint32_t board_flash_ops, board_flash_cut, board_flash_torn;
+extern void (*board_power_cut)(void);
+FLASH_CTRL_Type *Board_Flash(void);
+volatile uint32_t *Board_Fwb(uint32_t n);
+#define FLASH_CTRL     (Board_Flash())
+#define FLASH_FWB(n)   (*Board_Fwb(n))              // Write buffer word n (marks it valid in FWBVAL)
+#define FLASH_MEM_BASE ((uintptr_t)board_flash)    // Where flash offset 0 is read
+
+// SSI2 (the microSD card's SPI port). SR always reports room in the TX FIFO and data in the
+// RX FIFO. A byte written to DR is exchanged at the next SSI2 access: board_ssi2_byte()
+// gets it and returns what the device sends back, which DR then reads (0xFF, a released
+// MISO, if no device is attached). board_ssi2_bytes counts the exchanges.
+extern SSI0_Type board_ssi2;
+extern uint32_t board_ssi2_bytes;
+extern uint8_t (*board_ssi2_byte)(uint8_t out);
+SSI0_Type *Board_Ssi2(void);
+#define SSI2           (Board_Ssi2())
+
+// UART1's receive FIFO, for UART1_Handler()'s access pattern: each FR access that finds a
+// word queued by Board_Uart1_Receive() clears RXFE and puts the word (data in bits 7:0,
+// OE/BE/PE/FE in bits 11:8, as the UART reports them) in DR and its flags in RSR; the next
+// access, the DR read, takes it off the queue. With the queue empty FR reads RXFE only, so
+// the transmitter is never full or busy.
+#define BOARD_UART_QUEUE 4096U
+extern uint32_t board_uart1_queued;
+int Board_Uart1_Receive(uint32_t dr);
+UART0_Type *Board_Uart1(void);
+#define UART1          (Board_Uart1())
+
+// The 2 KB EEPROM as words (16 per block), for rules.c's access pattern: every EEPROM access
+// first stores a word the firmware wrote to EERDWR at EEBLOCK/EEOFFSET, then loads EERDWR
+// from the current address. EESUPP reads 0 (no errors), and EEDONE reads 0 after a write
+// unless board_eeprom_fail is set: then the write is dropped and EEDONE reads that value
+// (keep bit 0, WORKING, clear).
+#define BOARD_EEPROM_WORDS 512U
+extern uint32_t board_eeprom[BOARD_EEPROM_WORDS];
+extern uint32_t board_eeprom_fail;
+EEPROM_Type *Board_Eeprom(void);
+#define EEPROM         (Board_Eeprom())
+
+// Nothing interrupts the benchmark: the receive interrupt is never enabled.
+static inline void NVIC_EnableIRQ(IRQn_Type irq)  { (void)irq; }
+static inline void NVIC_DisableIRQ(IRQn_Type irq) { (void)irq; }
+
+#if defined(__ARM_ACLE)
+#define __SMLAD(x, y, acc)  ((uint32_t)__smlad((int32_t)(x), (int32_t)(y), (int32_t)(acc)))
+#define __SMLALD(x, y, acc) ((uint64_t)__smlald((int32_t)(x), (int32_t)(y), (int64_t)(acc)))
+#define __SSUB16(x, y)      __ssub16((int32_t)(x), (int32_t)(y))  // Used for its GE flags
+#define __SEL(x, y)         ((uint32_t)__sel((uint32_t)(x), (uint32_t)(y)))
+#define __QADD16(x, y)      ((uint32_t)__qadd16((int32_t)(x), (int32_t)(y)))
+#else
+static inline uint32_t *Board_Ge(void) {  // APSR.GE, one bit per byte lane
+    static uint32_t ge;
+    return &ge;
+}
+
+static inline int32_t Board_Lo(uint32_t x) { return (int16_t)(x & 0xFFFFU); }
+static inline int32_t Board_Hi(uint32_t x) { return (int16_t)(x >> 16); }
+
+static inline int32_t Board_Sat16(int32_t v) {
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+}
+
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc) {
+    return (uint32_t)((int64_t)(int32_t)acc + Board_Lo(x) * Board_Lo(y) + Board_Hi(x) * Board_Hi(y));
+}
+
+static inline uint64_t __SMLALD(uint32_t x, uint32_t y, uint64_t acc) {
+    return acc + (uint64_t)((int64_t)Board_Lo(x) * Board_Lo(y) + (int64_t)Board_Hi(x) * Board_Hi(y));
+}
+
+static inline uint32_t __SSUB16(uint32_t x, uint32_t y) {
+    int32_t lo = Board_Lo(x) - Board_Lo(y), hi = Board_Hi(x) - Board_Hi(y);
+    *Board_Ge() = (lo >= 0 ? 0x3U : 0U) | (hi >= 0 ? 0xCU : 0U);
+    return ((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFFU);
+}
+
+static inline uint32_t __SEL(uint32_t x, uint32_t y) {
+    uint32_t r = 0, i;
+    for (i = 0; i < 4; i++)
+        r |= ((*Board_Ge() >> i & 1U) ? x : y) & (0xFFU << (8 * i));
+    return r;
+}
+
+static inline uint32_t __QADD16(uint32_t x, uint32_t y) {
+    return ((uint32_t)Board_Sat16(Board_Hi(x) + Board_Hi(y)) << 16) |
+           ((uint32_t)Board_Sat16(Board_Lo(x) + Board_Lo(y)) & 0xFFFFU);
+}
+#endif
+
+#endif // TM4C123GH6PM_H
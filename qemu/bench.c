@@ -0,0 +1,211 @@
+//bench.c
+// Instruction-count benchmark of the TM4C's hot paths, run on QEMU's mps2-an386 (Cortex-M4)
+// by tools/qemu_bench.py. The firmware modules are linked unchanged against the board shim
+// (qemu/TM4C123GH6PM.h, qemu/board.c) and fed a recorded ESP32 session (qemu/recorded.txt).
+//
+// Arguments (semihosting command line): <path> <recorded file> [passes]
+//   none    load and pre-parse the recording only (the baseline every other path includes)
+//   parse   every line through the main loop's classification: '$' frames to Link_Handle_Frame,
+//           price lines through sscanf(CFG_PROTO_PRICE_RX), the rest to Link_Line_Failed
+//   format  the ESP32-side encoders: Fetch_Format_Price, Frame_Encode_Query/_Window
+//   stats   History_Add per price, then History_Stats and History_Chart over the last day
+//   lcd     the price screen's two rows through the HD44780 driver: LCD_Set_Cursor/_Display_String
+//           into the panel's shadow, then LCD_Poll until the changed cells are sent
+//   rules   Rules_Eval of a four-rule set per price; its items are the opcodes executed, so the
+//           per-item figure is instructions per opcode of the alert rule machine
+//
+// Prints "<path> items <n> check <x>": the number of work items and a checksum of their
+// results, so a change in what a path computes shows up next to a change in its cost.
+
+#include "tracker.h"
+#include "link.h"
+#include "frame.h"
+#include "fetch.h"
+#include "history.h"
+#include "rules.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_LINES 1024          // Lines kept from the recording
+#define BENCH_TEXT  (48 * 1024)   // Bytes kept from the recording
+
+typedef struct {
+    const char *text;             // Line without its newline, NUL-terminated
+    uint32_t len;
+    uint8_t price;                // 1: a price line (price, change and time below are valid)
+    float value, change;
+    unsigned long time;
+} BenchLine;
+
+static char text[BENCH_TEXT];
+static BenchLine lines[BENCH_LINES];
+static uint32_t n_lines;
+
+// Read the recording into 'text' and split it into lines. Returns 0 if it cannot be read.
+static int Bench_Load(const char *path) {
+    FILE *f = fopen(path, "r");
+    size_t n, pos = 0;
+    if (!f)
+        return 0;
+    n = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[n] = '\0';
+    while (pos < n && n_lines < BENCH_LINES) {
+        BenchLine *l = &lines[n_lines++];
+        char *end = strchr(&text[pos], '\n');
+        if (!end)
+            end = &text[n];
+        *end = '\0';
+        l->text = &text[pos];
+        l->len = (uint32_t)(end - &text[pos]);
+        l->time = 0;
+        l->price = l->text[0] != '$' &&
+                   sscanf(l->text, CFG_PROTO_PRICE_RX, &l->value, &l->change, &l->time) >= 2;
+        pos = (size_t)(end - text) + 1;
+    }
+    return 1;
+}
+
+// Main loop classification of one line. Returns 1 for a price.
+static uint32_t Bench_Parse(const BenchLine *l) {
+    float price, change;
+    unsigned long time = 0;
+    if (l->text[0] == '$') {
+        Link_Handle_Frame(l->text, l->len);
+        return 0;
+    }
+    if (sscanf(l->text, CFG_PROTO_PRICE_RX, &price, &change, &time) >= 2)
+        return 1 + (uint32_t)(price * 100.0f + 0.5f) + (uint32_t)time;
+    if (l->len > 0)
+        return Link_Line_Failed(l->text, l->len, 0);
+    return 0;
+}
+
+// What the ESP32 builds for one fetch: the price line, plus the query/answer pair the TM4C
+// exchanges for a statistics window.
+static uint32_t Bench_Format(const BenchLine *l) {
+    char buf[160];
+    FrameQuery q;
+    FrameWindow w;
+    int32_t cents = (int32_t)(l->value * 100.0f + 0.5f);
+    uint32_t sum = (uint32_t)Fetch_Format_Price(buf, sizeof(buf), l->value, l->change, l->time);
+    q.id = (uint8_t)l->time;
+    q.asset = 0;
+    q.window_s = CFG_ARCHIVE_SHORT_WINDOW_S;
+    sum += (uint32_t)Frame_Encode_Query(buf, sizeof(buf), &q);
+    w.id = q.id;
+    w.asset = 0;
+    w.service_us = 250;
+    w.window_s = q.window_s;
+    w.res_s = CFG_ARCHIVE_T0_BUCKET_S;
+    w.count = 1440;
+    w.open = cents - 5000;
+    w.high = cents + 12000;
+    w.low = cents - 9000;
+    w.close = cents;
+    w.mean = cents + 1500;
+    return sum + (uint32_t)Frame_Encode_Window(buf, sizeof(buf), &w);
+}
+
+// A tick into the RAM history and the statistics page's figures over the last day.
+static uint32_t Bench_Stats(const BenchLine *l, uint32_t time) {
+    static int32_t col_min[CFG_LCD_COLS * 8], col_max[CFG_LCD_COLS * 8];
+    HistStats s;
+    uint32_t since = time > 86400U ? time - 86400U : 0;
+    History_Add(time, (int32_t)l->value);
+    History_Stats(since, &s);
+    return (uint32_t)(s.min + s.max + s.mean) + s.count +
+           History_Chart(since, CFG_LCD_COLS * 8, col_min, col_max);
+}
+
+// The price screen as main.c draws it (Show_Price, without the clear).
+static uint32_t Bench_Lcd(const BenchLine *l) {
+    char line2[17];
+    int whole = (int)l->value;
+    sprintf(line2, "$%d,%03d  %+.2f%%", whole / 1000, whole % 1000, l->change);
+    LCD_Set_Cursor(0, 0);
+    LCD_Display_String(CFG_STR_PRICE_LABEL);
+    LCD_Set_Cursor(0, 1);
+    LCD_Display_String(line2);
+    while (LCD_Poll()) { }
+    return lcd_stats.bytes;
+}
+
+// tools/rules_compile.py --c of
+//   price < threshold
+//   pct(price, prev) < -2 or price < low_24h * 0.98
+//   abs(change) > 8 and hour >= 8 and hour < 22
+//   price > high_1h * 1.01
+static const uint8_t bench_rules[] = {
+    0x01, 0x04, 0x05, 0x01, 0x00, 0x01, 0x02, 0x0D, 0x17, 0x01, 0x00, 0x01, 0x03, 0x09, 0x02, 0x00,
+    0x00, 0x00, 0xC0, 0x0D, 0x01, 0x00, 0x01, 0x08, 0x02, 0x48, 0xE1, 0x7A, 0x3F, 0x05, 0x0D, 0x12,
+    0x1B, 0x01, 0x01, 0x0B, 0x02, 0x00, 0x00, 0x00, 0x41, 0x0F, 0x01, 0x04, 0x02, 0x00, 0x00, 0x00,
+    0x41, 0x10, 0x11, 0x01, 0x04, 0x02, 0x00, 0x00, 0xB0, 0x41, 0x0D, 0x11, 0x0B, 0x01, 0x00, 0x01,
+    0x06, 0x02, 0xAE, 0x47, 0x81, 0x3F, 0x05, 0x0F
+};
+
+// The alert rules on one tick. The inputs are made up from the line (previous price, a fixed
+// threshold, windows around the price) so the cost is the machine's alone, not History_Stats'.
+static uint32_t Bench_Rules(const BenchLine *l, float *prev) {
+    float in[RULES_INPUTS];
+    in[RULES_IN_PRICE] = l->value;
+    in[RULES_IN_CHANGE] = l->change;
+    in[RULES_IN_THRESHOLD] = 60000.0f;
+    in[RULES_IN_PREV] = *prev ? *prev : l->value;
+    in[RULES_IN_HOUR] = (float)((l->time / 3600U) % 24U);
+    in[RULES_IN_LOW_1H] = in[RULES_IN_LOW_24H] = l->value * 0.99f;
+    in[RULES_IN_HIGH_1H] = in[RULES_IN_HIGH_24H] = l->value * 1.01f;
+    in[RULES_IN_MEAN_1H] = in[RULES_IN_MEAN_24H] = l->value;
+    *prev = l->value;
+    return Rules_Eval(in);
+}
+
+static const char *const paths[] = { "none", "parse", "format", "stats", "lcd", "rules" };
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "none";
+    unsigned passes = argc > 3 ? (unsigned)atoi(argv[3]) : 1;
+    uint32_t items = 0, check = 0;
+    float prev = 0.0f;
+    unsigned pass, which;
+    uint32_t i;
+
+    for (which = 0; which < sizeof(paths) / sizeof(paths[0]); which++)
+        if (strcmp(path, paths[which]) == 0)
+            break;
+    if (which == sizeof(paths) / sizeof(paths[0])) {
+        printf("bench: unknown path '%s'\n", path);
+        return 1;
+    }
+    if (!Bench_Load(argc > 2 ? argv[2] : "qemu/recorded.txt")) {
+        printf("bench: cannot read the recording\n");
+        return 1;
+    }
+    if (which == 4)
+        LCD_Init();                    // Power-up sequence; the panel shows nothing yet.
+    if (Rules_Load(bench_rules, sizeof(bench_rules), RULES_HOST) != RULES_OK) {
+        printf("bench: rule set refused (%u)\n", rules_stats.status);
+        return 1;
+    }
+    for (pass = 0; pass < passes; pass++) {
+        // Later passes replay the recording a day later, so History_Add keeps taking the ticks.
+        uint32_t shift = pass * 86400U;
+        for (i = 0; i < n_lines; i++) {
+            const BenchLine *l = &lines[i];
+            if (which > 1 && (!l->price || l->time == 0))
+                continue;                  // Only parse sees the lines that are not prices.
+            switch (which) {
+            case 1:  check += Bench_Parse(l); break;
+            case 2:  check += Bench_Format(l); break;
+            case 3:  check += Bench_Stats(l, (uint32_t)l->time + shift); break;
+            case 4:  check += Bench_Lcd(l); break;
+            case 5:  check += Bench_Rules(l, &prev); break;
+            default: check += l->len; break;  // none: walk the lines doing nothing.
+            }
+            items += which == 5 ? rules_stats.ops : 1;
+        }
+    }
+    printf("%s items %lu check %08lx\n", path, (unsigned long)items, (unsigned long)check);
+    return 0;
+}
@@ -0,0 +1,181 @@
+//board.c
+// Board-support shim for the QEMU benchmark build (see qemu/TM4C123GH6PM.h): the RAM that
+// stands in for the TM4C's peripheral blocks, the DWT replacement, and the reset vector.
+// Everything else comes from newlib's rdimon crt0 (_start), which takes the heap, the stack
+// and argv from the host over semihosting, calls main() and reports its exit status. A host
+// build (tools/qemu_bench.py --host) leaves out the vectors and runs main() natively.
+
+#include "TM4C123GH6PM.h"
+#include "tracker_config.h"
+
+uint32_t board_gpio[6][1024];
+SYSCTL_Type board_sysctl = {
+    .PRGPIO = 0x3F, .PRUART = 0xFF, .PRSSI = 0x0F, .PRTIMER = 0x3F, .PRWTIMER = 0x3F,
+    .PRQEI = 0x03, .PRUSB = 0x01, .PRDMA = 0x01, .PRHIB = 0x01, .PREEPROM = 0x01  // Every module reports ready.
+};
+UART0_Type board_uart1 = { .FR = 0x10U };  // RXFE: nothing received yet
+QEI0_Type board_qei0;
+SysTick_Type board_systick;
+CoreDebug_Type board_coredebug;
+
+static DWT_Type dwt;
+
+DWT_Type *Board_Dwt(void) {
+    dwt.CYCCNT += CFG_SYSTEM_CLOCK_HZ / 1000U;
+    return &dwt;
+}
+
+// Flash model. An erased word reads all ones, programming can only clear bits, an erase sets
+// every word of a 1 KB sector back to all ones. When the operation numbered board_flash_cut
+// starts, power fails: the bits in board_flash_torn are all it got done (a program clears only
+// those of its zero bits, an erase sets only those bits of each word; 0 means it never
+// started), and board_power_cut() is called. It is expected not to return (a test longjmps
+// back to its reboot); if it does, the rest of the command is dropped.
+#define FLASH_KEY     0xA4420000U
+#define FLASH_SECTOR  1024U
+
+uint32_t board_flash[BOARD_FLASH_BYTES / 4U];
+uint32_t board_flash_ops;
+uint32_t board_flash_cut = 0xFFFFFFFFU;     // No power failure
+uint32_t board_flash_torn;
+void (*board_power_cut)(void);
+
+static FLASH_CTRL_Type flash_ctrl;
+static uint32_t fwb[32];
+
+// Count one operation; 0 when power fails on it (after applying what it got done).
+static int Flash_Op(uint32_t *word, uint32_t value, int erase) {
+    if (board_flash_ops++ != board_flash_cut) {
+        if (!erase)
+            *word &= value;
+        return 1;
+    }
+    if (erase) {
+        uint32_t i;
+        for (i = 0; i < FLASH_SECTOR / 4U; i++)
+            word[i] |= board_flash_torn;
+    } else {
+        *word &= value | ~board_flash_torn;
+    }
+    if (board_power_cut)
+        board_power_cut();
+    return 0;
+}
+
+FLASH_CTRL_Type *Board_Flash(void) {
+    uint32_t addr = flash_ctrl.FMA % BOARD_FLASH_BYTES, valid, i;
+    if (flash_ctrl.FMC == (FLASH_KEY | 0x1U)) {            // WRITE: one word from FMD
+        flash_ctrl.FMC = 0;
+        Flash_Op(&board_flash[addr / 4U], flash_ctrl.FMD, 0);
+    } else if (flash_ctrl.FMC == (FLASH_KEY | 0x2U)) {     // ERASE: the sector holding FMA
+        flash_ctrl.FMC = 0;
+        addr &= ~(FLASH_SECTOR - 1U);
+        if (Flash_Op(&board_flash[addr / 4U], 0, 1))
+            for (i = 0; i < FLASH_SECTOR / 4U; i++)
+                board_flash[addr / 4U + i] = 0xFFFFFFFFU;
+    } else if (flash_ctrl.FMC2 == (FLASH_KEY | 0x1U)) {    // WRBUF: the valid buffer words, in order
+        valid = flash_ctrl.FWBVAL;
+        flash_ctrl.FMC2 = 0;
+        flash_ctrl.FWBVAL = 0;
+        addr &= ~127U;
+        for (i = 0; i < 32U; i++)
+            if ((valid & (1U << i)) && !Flash_Op(&board_flash[addr / 4U + i], fwb[i], 0))
+                break;
+    }
+    return &flash_ctrl;
+}
+
+volatile uint32_t *Board_Fwb(uint32_t n) {
+    flash_ctrl.FWBVAL |= 1U << n;
+    return &fwb[n];
+}
+
+// SSI2: DR holds BOARD_SSI_RX (bit 31) with the last byte received until the firmware
+// writes the next byte to send, which has no bit 31.
+#define BOARD_SSI_RX  0x80000000U
+
+SSI0_Type board_ssi2 = { .DR = BOARD_SSI_RX | 0xFFU };
+uint32_t board_ssi2_bytes;
+uint8_t (*board_ssi2_byte)(uint8_t out);
+
+SSI0_Type *Board_Ssi2(void) {
+    if ((board_ssi2.DR & BOARD_SSI_RX) == 0) {
+        uint8_t out = (uint8_t)board_ssi2.DR;
+        board_ssi2_bytes++;
+        board_ssi2.DR = BOARD_SSI_RX | (board_ssi2_byte ? board_ssi2_byte(out) : 0xFFU);
+    }
+    board_ssi2.SR = 0x06U;        // TNF | RNE, never BSY
+    return &board_ssi2;
+}
+
+// UART1 receive queue: a word is published on one access and taken on the next (see the header).
+static uint32_t uart1_queue[BOARD_UART_QUEUE];
+static uint32_t uart1_head, uart1_published;
+uint32_t board_uart1_queued;
+
+int Board_Uart1_Receive(uint32_t dr) {
+    if (board_uart1_queued == BOARD_UART_QUEUE)
+        return 0;
+    uart1_queue[(uart1_head + board_uart1_queued++) % BOARD_UART_QUEUE] = dr;
+    return 1;
+}
+
+UART0_Type *Board_Uart1(void) {
+    if (uart1_published) {        // This access reads DR: the published word is taken.
+        uart1_published = 0;
+        uart1_head = (uart1_head + 1U) % BOARD_UART_QUEUE;
+        board_uart1_queued--;
+    } else if (board_uart1_queued) {
+        uart1_published = 1;
+        board_uart1.DR = uart1_queue[uart1_head];
+        board_uart1.RSR = (board_uart1.DR >> 8) & 0xFU;
+        board_uart1.FR = 0;
+    } else {
+        board_uart1.FR = 0x10U;   // RXFE
+    }
+    return &board_uart1;
+}
+
+// EEPROM: a word written to EERDWR is noticed (and stored) at the next access.
+static EEPROM_Type eeprom;
+static uint32_t eeprom_loaded;    // What the last access put in EERDWR
+uint32_t board_eeprom[BOARD_EEPROM_WORDS];
+uint32_t board_eeprom_fail;
+
+EEPROM_Type *Board_Eeprom(void) {
+    uint32_t word = (eeprom.EEBLOCK * 16U + eeprom.EEOFFSET) % BOARD_EEPROM_WORDS;
+    if (eeprom.EERDWR != eeprom_loaded) {
+        eeprom.EEDONE = board_eeprom_fail;
+        if (!board_eeprom_fail)
+            board_eeprom[word] = eeprom.EERDWR;
+    }
+    eeprom.EERDWR = eeprom_loaded = board_eeprom[word];
+    return &eeprom;
+}
+
+#if defined(__arm__)
+extern void _start(void);
+extern uint32_t __StackTop;
+
+#define CPACR (*(volatile uint32_t *)0xE000ED88U)
+
+// Semihosting SYS_EXIT with ADP_Stopped_InternalError: a fault ends the run with an error.
+static void Board_Fault(void) {
+    register uint32_t op __asm__("r0") = 0x18;
+    register uint32_t arg __asm__("r1") = 0x20024;
+    for (;;)
+        __asm__ volatile ("bkpt 0xAB" : : "r"(op), "r"(arg) : "memory");
+}
+
+static void Board_Reset(void) {
+    CPACR |= 0xFU << 20;          // CP10/CP11 full access: the firmware uses the FPU.
+    __asm__ volatile ("dsb\n\tisb");
+    _start();
+}
+
+__attribute__((section(".isr_vector"), used))
+static void (*const board_vectors[16])(void) = {
+    (void (*)(void))&__StackTop, Board_Reset,
+    Board_Fault, Board_Fault, Board_Fault, Board_Fault, Board_Fault,  // NMI, HardFault, MemManage, BusFault, UsageFault
+};
+#endif
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""alarm_sink.py - local stand-in for the ESP32's alarm notification endpoint.
+
+Accepts the JSON notifications the sketch sends ([alarm] notify in
+tracker_config.cfg): HTTP POSTs to /alarm (notify = 1) and MQTT 3.1.1 QoS 1
+publishes (notify = 2, just enough of a broker for one connection per message).
+Each notification is printed once; repeats of the same 'key' (an ESP32 retry
+whose first delivery got through) are counted but not printed again. --fail N
+rejects the first N attempts of every notification to exercise the retries.
+
+Usage:
+  python3 tools/alarm_sink.py                       webhook on :8080 and MQTT on :1883
+  python3 tools/alarm_sink.py --fail 2              refuse two attempts per notification
+  python3 tools/alarm_sink.py --http 9000 --mqtt 0  webhook only, on another port
+"""
+
+import argparse
+import http.server
+import json
+import socketserver
+import sys
+import threading
+import time
+
+lock = threading.Lock()
+attempts = {}                     # key -> attempts seen
+args = None
+
+
+def accept(body, via):
+    """Count one attempt; returns False when --fail says to refuse it."""
+    try:
+        note = json.loads(body)
+    except ValueError:
+        sys.stderr.write("alarm_sink: bad JSON via %s: %r\n" % (via, body[:80]))
+        return True
+    key = note.get("key", body)
+    with lock:
+        n = attempts[key] = attempts.get(key, 0) + 1
+        if n <= args.fail:
+            print("%s  %-4s #%s attempt %d refused (--fail)" % (time.strftime("%H:%M:%S"), via, note.get("id"), n))
+            return False
+        if n == args.fail + 1:
+            print("%s  %-4s #%s %s $%.2f  time %s%s  (attempt %d)"
+                  % (time.strftime("%H:%M:%S"), via, note.get("id"), "ALARM" if note.get("alarm") else "clear",
+                     note.get("price", 0), note.get("time"), "  TEST" if note.get("test") else "", n))
+        else:
+            print("%s  %-4s #%s duplicate (attempt %d), ignored" % (time.strftime("%H:%M:%S"), via, note.get("id"), n))
+        sys.stdout.flush()
+    return True
+
+
+class Webhook(http.server.BaseHTTPRequestHandler):
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0))).decode("utf-8", "replace")
+        ok = self.path == "/alarm" and accept(body, "http")
+        self.send_response(200 if ok else 503)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, fmt, *a):
+        pass
+
+
+def read_exact(sock, n):
+    data = b""
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+
+def read_packet(sock):
+    """One MQTT control packet as (type byte, body)."""
+    head = read_exact(sock, 1)[0]
+    length, shift = 0, 0
+    while True:
+        d = read_exact(sock, 1)[0]
+        length |= (d & 0x7F) << shift
+        shift += 7
+        if not d & 0x80:
+            break
+    return head, read_exact(sock, length)
+
+
+class Broker(socketserver.BaseRequestHandler):
+    def handle(self):
+        sock = self.request
+        try:
+            while True:
+                head, body = read_packet(sock)
+                kind = head >> 4
+                if kind == 1:                         # CONNECT
+                    sock.sendall(b"\x20\x02\x00\x00")
+                elif kind == 3:                       # PUBLISH
+                    tlen = (body[0] << 8) | body[1]
+                    pos = 2 + tlen
+                    qos = (head >> 1) & 3
+                    pid = body[pos:pos + 2] if qos else b""
+                    payload = body[pos + len(pid):].decode("utf-8", "replace")
+                    if accept(payload, "mqtt") and qos:
+                        sock.sendall(b"\x40\x02" + pid)
+                elif kind == 12:                      # PINGREQ
+                    sock.sendall(b"\xd0\x00")
+                elif kind == 14:                      # DISCONNECT
+                    return
+        except (EOFError, OSError):
+            pass
+
+
+class Server(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main():
+    global args
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--http", type=int, default=8080, help="webhook port (0: off)")
+    ap.add_argument("--mqtt", type=int, default=1883, help="MQTT port (0: off)")
+    ap.add_argument("--fail", type=int, default=0, help="refuse the first N attempts of each notification")
+    args = ap.parse_args()
+
+    servers = []
+    if args.http:
+        servers.append(http.server.ThreadingHTTPServer(("", args.http), Webhook))
+    if args.mqtt:
+        servers.append(Server(("", args.mqtt), Broker))
+    for s in servers:
+        threading.Thread(target=s.serve_forever, daemon=True).start()
+    print("alarm_sink: webhook %s, MQTT %s, refusing %d attempt(s) each"
+          % (":%d/alarm" % args.http if args.http else "off", ":%d" % args.mqtt if args.mqtt else "off", args.fail))
+    sys.stdout.flush()
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
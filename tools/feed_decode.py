@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""feed_decode.py - decode the TM4C's binary USB feed and measure its throughput.
+
+Reads the record stream described in build/feed.h from the USB CDC port (needs
+pyserial) or from a capture file, prints one line per record and, on exit, the
+byte and record rates seen on the wire.
+
+Usage:
+  python3 tools/feed_decode.py /dev/ttyACM0              follow the live feed
+  python3 tools/feed_decode.py /dev/ttyACM0 --dump       request the flash history dump
+  python3 tools/feed_decode.py /dev/ttyACM0 --boot       request the boot timeline
+  python3 tools/feed_decode.py /dev/ttyACM0 --test       start a link self-test and wait for its result
+  python3 tools/feed_decode.py /dev/ttyACM0 --notify     send a test alarm notification and wait for its outcome
+  python3 tools/feed_decode.py /dev/ttyACM0 --rules      show the running alert rules' status (see rules_compile.py)
+  python3 tools/feed_decode.py /dev/ttyACM0 --dsp        run the DSP kernel benchmark (firmware built with DSP_BENCHMARK)
+  python3 tools/feed_decode.py capture.bin --file        decode a saved capture
+  python3 tools/feed_decode.py /dev/ttyACM0 --raw out.bin --quiet   capture and count only
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+NOTIFY_STATUS = ("delivered", "FAILED", "disabled")  # FRAME_NOTIFY_* in frame.h
+RULES_STATUS = ("ok", "bad size", "bad version", "bad opcode", "bad stack", "bad rule count",
+                "over budget", "EEPROM failed")  # RULES_OK, RULES_E_* in rules.h
+RULES_SOURCE = ("built-in", "EEPROM", "host")   # RULES_BUILTIN / _EEPROM / _HOST
+BOOT_STAGES = ("clocks", "uart", "periph", "lcd", "ui", "first_line", "first_price")  # BOOT_* in tracker.h
+
+
+def fmt_time(t):
+    return time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(t)) if t else "-"
+
+
+def describe(rtype, p):
+    """Human-readable form of one record payload."""
+    if rtype == ord("T") and len(p) == 14:
+        t, cents, change, ms = struct.unpack("<IihI", p)
+        return "tick     %s  $%.2f  %+.2f%%  (device %u ms)" % (fmt_time(t), cents / 100.0, change / 100.0, ms)
+    if rtype == ord("F") and len(p) == 8:
+        tag, ok, length, ms = struct.unpack("<BBHI", p)
+        return "frame    $%c len %u %s  (device %u ms)" % (tag, length, "ok" if ok else "REJECTED", ms)
+    if rtype == ord("A") and len(p) == 9:
+        on, cents, ms = struct.unpack("<BiI", p)
+        return "alarm    %s at $%.2f  (device %u ms)" % ("ON" if on else "off", cents / 100.0, ms)
+    if rtype == ord("C") and len(p) in (28, 36):
+        ms, ticks, uart_drop, bad, recs, dropped, usb = struct.unpack_from("<7I", p)
+        text = ("counters %u ms  ticks %u  uart_drop %u  bad_frames %u  records %u  dropped %u  usb_bytes %u"
+                % (ms, ticks, uart_drop, bad, recs, dropped, usb))
+        if len(p) == 36:                            # Firmware with the shared LCD bus
+            text += "  lcd %u B/s busy %u ms" % (struct.unpack_from("<I", p, 28)[0],
+                                                 struct.unpack_from("<I", p, 32)[0] // 1000)
+        return text
+    if rtype == ord("R") and len(p) % 8 == 0:
+        pts = [struct.unpack_from("<Ii", p, i) for i in range(0, len(p), 8)]
+        return "history  %d pts %s .. %s" % (len(pts), fmt_time(pts[0][0]), fmt_time(pts[-1][0]))
+    if rtype == ord("E") and len(p) == 4:
+        return "dump end %u records" % struct.unpack("<I", p)
+    if rtype == ord("B") and len(p) == 4 * len(BOOT_STAGES) + 8:
+        v = struct.unpack("<%dI" % (len(BOOT_STAGES) + 2), p)
+        stages = "  ".join("%s %s" % (name, "%.1f ms" % (us / 1000.0) if us else "-")
+                           for name, us in zip(BOOT_STAGES, v))
+        return "boot     %s  early_lines %u  ring_peak %u B" % (stages, v[-2], v[-1])
+    if rtype == ord("S") and len(p) == 32:
+        steps, rate, size, bps, cpu, parse, disp, lost = struct.unpack("<8I", p)
+        return ("selftest %u steps  best %u/s of %u B (%u B/s, cpu %u%%)  parse behind at %s  display behind at %s  lost %u"
+                % (steps, rate, size, bps, cpu, "%u/s" % parse if parse else "-", "%u/s" % disp if disp else "-", lost))
+    if rtype == ord("N") and len(p) == 24:
+        nid, status, attempts, latency, forward, timeouts = struct.unpack("<6I", p)
+        state = NOTIFY_STATUS[status] if status < len(NOTIFY_STATUS) else "status %u" % status
+        return ("notify   #%u %s after %u attempt(s)  latency %u ms (endpoint %u ms)  unanswered %u"
+                % (nid, state, attempts, latency, forward, timeouts))
+    if rtype == ord("V") and len(p) == 40:
+        status, source, count, size, ops, bound, budget, last, worst, inputs, overruns, fired, ns = \
+            struct.unpack("<4B9I", p)
+        return ("rules    %s  %u rule(s) from %s, %u B, %u ops  bound %u of %u cycles  last %u max %u"
+                " (inputs %u)  overruns %u  fired 0x%02x  %.1f ns/op"
+                % (RULES_STATUS[status] if status < len(RULES_STATUS) else "status %u" % status,
+                   count, RULES_SOURCE[source] if source < len(RULES_SOURCE) else "?", size, ops,
+                   bound, budget, last, worst, inputs, overruns, fired, ns / 10.0))
+    if rtype == ord("K") and len(p) == 36:
+        v = struct.unpack("<9I", p)
+        return "dsp      %u samples, cycles kernel/plain C:  %s" % (v[0], "  ".join(
+            "%s %u/%u (%.1fx)" % (name, v[1 + 2 * i], v[2 + 2 * i], v[2 + 2 * i] / max(v[1 + 2 * i], 1))
+            for i, name in enumerate(("sum", "min/max", "mean", "resample"))))
+    return "unknown  type 0x%02x len %d" % (rtype, len(p))
+
+
+class Decoder:
+    """Incremental record parser that resynchronises on checksum errors."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.records = 0
+        self.bad = 0
+        self.skipped = 0
+
+    def feed(self, data):
+        self.buf += data
+        out = []
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                self.skipped += len(self.buf)
+                self.buf.clear()
+                break
+            if start:
+                self.skipped += start
+                del self.buf[:start]
+            if len(self.buf) < 4:
+                break
+            rtype, length = self.buf[1], self.buf[2]
+            if len(self.buf) < length + 4:
+                break
+            payload = bytes(self.buf[3:3 + length])
+            check = rtype ^ length
+            for b in payload:
+                check ^= b
+            if check != self.buf[3 + length]:
+                self.bad += 1
+                del self.buf[:1]              # Not a record boundary after all.
+                continue
+            del self.buf[:length + 4]
+            self.records += 1
+            out.append((rtype, payload))
+        return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("source", help="serial port, or a capture file with --file")
+    ap.add_argument("--file", action="store_true", help="read a capture file instead of a port")
+    ap.add_argument("--dump", action="store_true", help="ask the device for its flash history")
+    ap.add_argument("--boot", action="store_true", help="ask the device for its boot timeline")
+    ap.add_argument("--test", action="store_true", help="run a link self-test and stop at its result")
+    ap.add_argument("--notify", action="store_true", help="send a test alarm notification and stop at its outcome")
+    ap.add_argument("--rules", action="store_true", help="ask for the alert rules' status and stop at it")
+    ap.add_argument("--dsp", action="store_true", help="run the DSP kernel benchmark and stop at its result")
+    ap.add_argument("--raw", help="also write the raw stream to this file")
+    ap.add_argument("--quiet", action="store_true", help="only print the summary")
+    ap.add_argument("--seconds", type=float, default=0, help="stop after this long (0: until Ctrl-C)")
+    args = ap.parse_args()
+
+    if args.file:
+        src = open(args.source, "rb")
+        read = lambda: src.read(4096)
+    else:
+        try:
+            import serial
+        except ImportError:
+            sys.stderr.write("feed_decode: pyserial is required for live ports (pip install pyserial)\n")
+            return 2
+        src = serial.Serial(args.source, timeout=0.2)
+        read = lambda: src.read(src.in_waiting or 1)
+        if args.dump:
+            src.write(b"D")
+        if args.boot:
+            src.write(b"B")
+        if args.test:
+            src.write(b"S")
+        if args.notify:
+            src.write(b"N")
+        if args.rules:
+            src.write(b"V")
+        if args.dsp:
+            src.write(b"K")
+
+    raw = open(args.raw, "wb") if args.raw else None
+    dec = Decoder()
+    total = 0
+    first = last = None
+    t_end = time.monotonic() + args.seconds if args.seconds else None
+    try:
+        while t_end is None or time.monotonic() < t_end:
+            data = read()
+            if not data:
+                if args.file:
+                    break
+                continue
+            now = time.monotonic()
+            first = first if first is not None else now
+            last = now
+            total += len(data)
+            if raw:
+                raw.write(data)
+            for rtype, payload in dec.feed(data):
+                if not args.quiet:
+                    print(describe(rtype, payload))
+                if rtype == ord("E") and args.dump and not args.file:
+                    t_end = now                   # Dump finished.
+                if rtype == ord("S") and args.test and not args.file:
+                    t_end = now                   # Self-test result in.
+                if rtype == ord("N") and args.notify and not args.file:
+                    t_end = now                   # Notification answered or given up.
+                if rtype == ord("V") and args.rules and not args.file:
+                    t_end = now                   # Rules status in.
+                if rtype == ord("K") and args.dsp and not args.file:
+                    t_end = now                   # Benchmark result in.
+    except KeyboardInterrupt:
+        pass
+
+    span = (last - first) if first is not None and last > first else 0
+    sys.stderr.write("%d bytes, %d records, %d checksum errors, %d bytes skipped" %
+                     (total, dec.records, dec.bad, dec.skipped))
+    if span and not args.file:
+        sys.stderr.write(" in %.2f s: %.0f B/s, %.1f records/s" % (span, total / span, dec.records / span))
+    sys.stderr.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
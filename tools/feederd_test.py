@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""feederd_test.py - run linux/feederd.c against local stand-in providers.
+
+Builds feederd with the host compiler and points it at /simple/price servers
+started in this process. Each server answers after a set delay with fixed
+prices (asset N costs 100 + N), records the ids of every request, and can be
+told to stall so that requests time out. The tests check what feederd claims:
+
+  - 500 assets over two providers (300 at 50 ms, 200 at 200 ms response time,
+    40 ids per request) are all fetched without errors, no request asks for
+    more than 40 ids, and the latency statistics see the servers' delays;
+  - every -P pty gets its asset's price line in the ESP32's format, with the
+    price the provider served;
+  - a provider that never answers costs its assets errors after -t, while the
+    other provider's assets keep arriving;
+  - against tools/provider_sim.py with a sliding-window limit, feederd never
+    gets a 429 and no window holds more than the limit's requests;
+  - when provider_sim's real limit is lower than feederd's -r, the 429 it
+    answers with is honoured: no request until its Retry-After has passed.
+
+Usage:
+  python3 tools/feederd_test.py [-v]
+"""
+
+import http.server
+import json
+import os
+import re
+import select
+import signal
+import socket
+import socketserver
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import tty
+import unittest
+import urllib.parse
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCES = ["linux/feederd.c", "build/fetch.c", "build/plan.c"]
+LINE = re.compile(r"BTC Price: \$(-?[0-9.]+), 24h Change: (-?[0-9.]+)%, T: ([0-9]+)")
+SUMMARY = re.compile(r"feederd: (\d+) assets, (\d+) fetches, (\d+) errors, .* latency mean ([0-9.]+) ms "
+                     r"\(best asset ([0-9.]+), worst ([0-9.]+) max\)")
+ASSET = re.compile(r"^  (\S+)\s+\$\S+\s+\S+%\s+fetches (\d+) errors (\d+)", re.M)
+THROTTLED = re.compile(r"budget used \d+%  429 (\d+)")
+
+
+def price_of(asset):
+    """The stand-in price of 'p1a17': 100 + 17; change 17 / 100 percent."""
+    n = int(asset.rsplit("a", 1)[1])
+    return 100.0 + n, n / 100.0
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+    def __init__(self, delay_s, stall=False):
+        self.delay_s, self.stall = delay_s, stall
+        self.requests, self.ids, self.lock = [], set(), threading.Lock()
+        super().__init__(("127.0.0.1", 0), Handler)
+        self.url = "http://127.0.0.1:%d/simple/price?vs_currencies=usd&ids=" % self.server_address[1]
+        threading.Thread(target=self.serve_forever, daemon=True).start()
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.0"
+
+    def do_GET(self):
+        srv = self.server
+        query = urllib.parse.parse_qs(urllib.parse.urlsplit(self.path).query)
+        ids = [i for i in ",".join(query.get("ids", [])).split(",") if i]
+        with srv.lock:
+            srv.requests.append(len(ids))
+            srv.ids.update(ids)
+        if srv.stall:
+            time.sleep(30)                      # feederd gives up first (-t)
+            return
+        time.sleep(srv.delay_s)
+        body = json.dumps({i: {"usd": price_of(i)[0], "usd_24h_change": price_of(i)[1]} for i in ids}).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *a):
+        pass
+
+
+class ProviderSim:
+    """tools/provider_sim.py serving one provider; log() gives (time, status, retry_after) per request."""
+
+    def __init__(self, spec, sliding=False):
+        with socket.socket() as s:              # A free port
+            s.bind(("127.0.0.1", 0))
+            self.port = s.getsockname()[1]
+        self.log_file = tempfile.NamedTemporaryFile(mode="r", suffix=".log")
+        cmd = [sys.executable, os.path.join(ROOT, "tools", "provider_sim.py"), "%d:%s" % (self.port, spec),
+               "-s", "0", "--log", self.log_file.name] + (["--sliding"] if sliding else [])
+        self.proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, text=True)
+        self.proc.stdout.readline()             # Printed once the server listens
+        self.url = "http://127.0.0.1:%d/simple/price?vs_currencies=usd&ids=" % self.port
+
+    def stop(self):
+        self.proc.send_signal(signal.SIGINT)
+        report = self.proc.communicate()[0]
+        rows = [line.split() for line in self.log_file.read().splitlines()]
+        self.log_file.close()
+        return report, [(float(t), int(status), int(retry)) for t, _, status, retry in rows]
+
+
+class Feederd:
+    """A feederd process; stdout gives the pty paths, stderr the statistics."""
+
+    def __init__(self, exe, args, ptys):
+        self.err = tempfile.TemporaryFile(mode="w+")
+        cmd = [exe, "-s", "1"] + args + sum((["-P", p] for p in ptys), [])
+        self.proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=self.err, text=True)
+        self.ptys = {}
+        for _ in ptys:
+            asset, path = self.proc.stdout.readline().split()
+            fd = os.open(path, os.O_RDONLY | os.O_NOCTTY | os.O_NONBLOCK)
+            tty.setraw(fd)
+            self.ptys[asset] = [fd, b""]
+
+    def read_ptys(self, seconds):
+        end = time.monotonic() + seconds
+        while time.monotonic() < end:
+            ready, _, _ = select.select([p[0] for p in self.ptys.values()], [], [], 0.1)
+            for p in self.ptys.values():
+                if p[0] in ready:
+                    p[1] += os.read(p[0], 4096)
+
+    def stop(self):
+        """Ask for the full statistics (SIGUSR1), stop, and return them."""
+        self.proc.send_signal(signal.SIGUSR1)
+        time.sleep(0.3)
+        self.proc.terminate()
+        self.proc.wait()
+        for p in self.ptys.values():
+            os.close(p[0])
+        self.proc.stdout.close()
+        self.err.seek(0)
+        text = self.err.read()
+        self.err.close()
+        # Later reports override earlier ones; the SIGUSR1 one is last and lists every asset.
+        return text, {m.group(1): (int(m.group(2)), int(m.group(3))) for m in ASSET.finditer(text)}
+
+
+class FeederdTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.tmp = tempfile.TemporaryDirectory()
+        cls.exe = os.path.join(cls.tmp.name, "feederd")
+        subprocess.run(["cc", "-O2", "-Wall", "-Ibuild", "-o", cls.exe] + SOURCES + ["-lm"], cwd=ROOT, check=True)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.tmp.cleanup()
+
+    def test_two_providers_500_assets(self):
+        fast, slow = Server(0.05), Server(0.2)
+        a = ["p1a%d" % i for i in range(300)]
+        b = ["p2a%d" % i for i in range(200)]
+        f = Feederd(self.exe, ["-i", "1000",
+                               "-u", fast.url, "-r", "1000/1:40", "-a", ",".join(a),
+                               "-u", slow.url, "-r", "1000/1:40", "-a", ",".join(b)], ["p1a7", "p2a150"])
+        f.read_ptys(4)
+        lines = {k: p[1].decode() for k, p in f.ptys.items()}
+        full, per_asset = f.stop()
+        for s in (fast, slow):
+            s.shutdown()
+            s.server_close()
+
+        self.assertEqual(fast.ids, set(a))
+        self.assertEqual(slow.ids, set(b))
+        self.assertLessEqual(max(fast.requests + slow.requests), 40)
+        m = list(SUMMARY.finditer(full))[-1]
+        self.assertEqual(int(m.group(1)), 500)
+        self.assertEqual(int(m.group(3)), 0, "fetch errors")
+        self.assertGreaterEqual(float(m.group(5)), 50.0, "best asset's mean latency below the fast server's delay")
+        self.assertGreaterEqual(float(m.group(6)), 200.0, "worst latency below the slow server's delay")
+        self.assertEqual(len(per_asset), 500)
+        self.assertTrue(all(n >= 1 and e == 0 for n, e in per_asset.values()), full)
+
+        now = time.time()
+        for asset, text in lines.items():
+            got = LINE.findall(text)
+            self.assertGreaterEqual(len(got), 2, "%s: %r" % (asset, text))
+            self.assertEqual(len(got), text.count("\n"), "%s: a line not in the price format: %r" % (asset, text))
+            want = price_of(asset)
+            for price, change, stamp in got:
+                self.assertAlmostEqual(float(price), want[0], places=2)
+                self.assertAlmostEqual(float(change), want[1], places=2)
+                self.assertLess(abs(int(stamp) - now), 30)
+
+    def test_stalled_provider_times_out(self):
+        good, stalled = Server(0.02), Server(0, stall=True)
+        f = Feederd(self.exe, ["-i", "500", "-t", "300",
+                               "-u", good.url, "-r", "1000/1:40", "-a", "p1a1,p1a2",
+                               "-u", stalled.url, "-r", "1000/1:40", "-a", "p2a1,p2a2"], ["p1a1"])
+        f.read_ptys(3)
+        text = f.ptys["p1a1"][1].decode()
+        full, per_asset = f.stop()
+        for s in (good, stalled):
+            s.shutdown()
+            s.server_close()
+
+        self.assertTrue(stalled.requests, "the stalled provider was never asked")
+        for asset in ("p2a1", "p2a2"):
+            self.assertEqual(per_asset[asset][0], 0, full)
+            self.assertGreaterEqual(per_asset[asset][1], 1, "%s: timeouts not counted\n%s" % (asset, full))
+        for asset in ("p1a1", "p1a2"):
+            self.assertGreaterEqual(per_asset[asset][0], 3, full)
+            self.assertEqual(per_asset[asset][1], 0, full)
+        self.assertGreaterEqual(len(LINE.findall(text)), 3, "lines stopped while a provider stalled: %r" % text)
+
+    def test_provider_limit_kept(self):
+        limit, window = 10, 2.0
+        sim = ProviderSim("%d/%g:20" % (limit, window), sliding=True)
+        assets = ["a%d" % i for i in range(100)]
+        f = Feederd(self.exe, ["-i", "0", "-u", sim.url, "-r", "%d/%g:20" % (limit, window),
+                               "-a", ",".join(assets)], [])
+        time.sleep(7)
+        full, _ = f.stop()
+        report, log = sim.stop()
+
+        times = [t for t, status, _ in log]
+        self.assertEqual([s for _, s, _ in log if s != 200], [], "provider refused requests\n" + report)
+        self.assertEqual(int(THROTTLED.findall(full)[-1]), 0, full)
+        most = max(sum(1 for u in times if t <= u < t + window) for t in times)
+        self.assertLessEqual(most, limit, "%d requests in one %g s window" % (most, window))
+        # The budget is used, not just respected: [plan] pct is 90%, less the first window's burst.
+        self.assertGreaterEqual(len(times), int(limit * 6 / window * 0.7), report)
+
+    def test_retry_after_honoured(self):
+        # provider_sim allows 2 requests per fixed 3 s window; feederd believes in 8 per 2 s.
+        sim = ProviderSim("2/3:20")
+        f = Feederd(self.exe, ["-i", "0", "-u", sim.url, "-r", "8/2:20", "-a", ",".join("a%d" % i for i in range(40))],
+                    [])
+        time.sleep(8)
+        full, _ = f.stop()
+        report, log = sim.stop()
+
+        refused = [(t, retry) for t, status, retry in log if status == 429]
+        self.assertTrue(refused, "no 429 to honour\n" + report)
+        # feederd counted the 429s; the last ones may have come after its report.
+        self.assertTrue(1 <= int(THROTTLED.findall(full)[-1]) <= len(refused), full)
+        for t, retry in refused:
+            # Requests already on their way may follow within a few ms, none later until Retry-After.
+            early = [u - t for u, _, _ in log if t + 0.05 < u < t + retry - 0.05]
+            self.assertEqual(early, [], "requests %s s after a 429 with Retry-After: %d" % (early, retry))
+        self.assertGreater(max(t for t, _, _ in log), refused[0][0] + refused[0][1],
+                           "no request after the Retry-After time")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""fleetsim_test.py - smoke test of linux/fleetsim.c against what the README states.
+
+Builds fleetsim with the host compiler and runs each of its modes briefly:
+
+  - MQTT and RS-485 fleets deliver every poll to every display, parse every line and
+    give the same results on one thread and on four;
+  - -L: no byte is lost and no panel differs from its shadow, with 1 to 4 panels;
+    interleaving raises the aggregate byte rate with every panel added, and the
+    blocking driver takes 212 ms per panel and round;
+  - -F: without flow control lines are lost, with RTS/CTS or XON/XOFF none are and
+    the receive ring never fills;
+  - -H: every backfilled point matches and the live ticks are kept;
+  - -T and -B run through without lost lines or ring overflows.
+
+Usage:
+  python3 tools/fleetsim_test.py [-v]
+"""
+
+import os
+import re
+import subprocess
+import tempfile
+import unittest
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCES = ["linux/fleetsim.c"] + ["build/%s.c" % m for m in ("frame", "archive", "fetch", "selftest", "flow",
+                                                             "lcdbus", "history", "dsp")]
+UPDATES = re.compile(r"updates (\d+) .* lines (\d+), dropped (\d+), unparsed (\d+)")
+LCD_ROW = re.compile(r"^  (\d)\s+(blocking|serial|interleaved)\s+(\d+)\s+\S+\s+(\S+)\s+\S+\s+(\S+)\s+(\S+)$", re.M)
+FLOW_ROW = re.compile(r"^  (none|RTS/CTS|XON/XOFF)\s+\S+\s+\d+\s+\S+\s+\d+\s+(\d+)\s+(\d+)\s+(\d+)$", re.M)
+
+
+class FleetsimTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.tmp = tempfile.TemporaryDirectory()
+        cls.exe = os.path.join(cls.tmp.name, "fleetsim")
+        subprocess.run(["cc", "-O2", "-Wall", "-pthread", "-Ibuild", "-o", cls.exe] + SOURCES + ["-lm"], cwd=ROOT,
+                       check=True)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.tmp.cleanup()
+
+    def run_sim(self, *args):
+        out = subprocess.run([self.exe] + list(args), capture_output=True, text=True, timeout=300)
+        self.assertEqual(out.returncode, 0, out.stdout + out.stderr)
+        return out.stdout
+
+    def check_fleet(self, args, units, seconds):
+        one = self.run_sim(*args, "-n", str(units), "-d", str(seconds), "-j", "1")
+        four = self.run_sim(*args, "-n", str(units), "-d", str(seconds), "-j", "4")
+        updates, lines, dropped, unparsed = map(int, UPDATES.search(one).groups())
+        self.assertEqual(updates, units * seconds // 20, one)      # One update per 20 s poll per display
+        self.assertEqual((dropped, unparsed), (0, 0), one)
+        self.assertGreater(lines, updates, one)                    # History queries and answers as well
+
+        # Only the wall-clock figures may depend on the thread count.
+        def results(text):
+            return [re.sub(r"[0-9.]+/s wall", "", line) for line in text.splitlines()
+                    if not line.startswith(("fleetsim:", "  executor:"))]
+        self.assertEqual(results(one), results(four))
+
+    def test_mqtt(self):
+        self.check_fleet(["-m", "mqtt"], 200, 600)
+
+    def test_rs485(self):
+        self.check_fleet(["-m", "rs485", "-k", "32"], 256, 600)
+
+    def test_lcd_bus(self):
+        out = self.run_sim("-L", "4")
+        rows = LCD_ROW.findall(out)
+        self.assertEqual(len(rows), 12, out)
+        rate = {}
+        for panels, schedule, bytes_s, round_ms, lost, mismatch in rows:
+            if schedule == "blocking":
+                self.assertAlmostEqual(float(round_ms), 212.0 * int(panels), places=1)
+                continue
+            self.assertEqual((lost, mismatch), ("0", "0"), "%s panels, %s: bytes lost\n%s" % (panels, schedule, out))
+            rate[(int(panels), schedule)] = int(bytes_s)
+        for n in range(2, 5):
+            self.assertGreater(rate[(n, "interleaved")], rate[(n - 1, "interleaved")], out)
+            self.assertGreater(rate[(n, "interleaved")], rate[(n, "serial")], out)
+
+    def test_flow_control(self):
+        out = self.run_sim("-F")
+        rows = {mode: tuple(map(int, rest)) for mode, *rest in FLOW_ROW.findall(out)}
+        self.assertEqual(set(rows), {"none", "RTS/CTS", "XON/XOFF"}, out)
+        self.assertGreater(rows["none"][2], 0, "no lines lost without flow control\n" + out)
+        for mode in ("RTS/CTS", "XON/XOFF"):
+            peak, dropped, lost = rows[mode]
+            self.assertEqual((dropped, lost), (0, 0), "%s lost bytes\n%s" % (mode, out))
+            self.assertLess(peak, 2048, out)
+
+    def test_backfill(self):
+        out = self.run_sim("-H")
+        self.assertRegex(out, r"288 of 288 points match")
+        self.assertIn("live ticks kept", out)
+
+    def test_self_test_and_boot(self):
+        out = self.run_sim("-T")
+        self.assertRegex(out, r", 0 lost\n")
+        out = self.run_sim("-B")
+        self.assertEqual(re.findall(r"ring overflowed on (\d+) units, backfill frames lost (\d+)", out),
+                         [("0", "0"), ("0", "0")], out)
+
+
+if __name__ == "__main__":
+    unittest.main()
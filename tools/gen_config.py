@@ -0,0 +1,301 @@
+#!/usr/bin/env python3
+"""gen_config.py - compile build/tracker_config.cfg into flash-resident C tables.
+
+Reads the declarative configuration and writes:
+  build/tracker_config.h  - #defines for scalars/strings, extern declarations for tables
+  build/tracker_config.c  - 'const' tables (placed in flash by the linker) plus
+                            compile-time size checks and the static lookup indexes
+
+The generator does all the work that used to happen at runtime (sorting the
+threshold ladder, deriving the UART divisors, indexing assets by symbol), so the
+firmware only ever reads from flash.
+
+Usage:
+  python3 tools/gen_config.py            regenerate the output files
+  python3 tools/gen_config.py --check    exit 1 if the committed output is stale
+"""
+
+import argparse
+import configparser
+import os
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BUILD = os.path.join(ROOT, "build")
+CFG_PATH = os.path.join(BUILD, "tracker_config.cfg")
+HDR_PATH = os.path.join(BUILD, "tracker_config.h")
+SRC_PATH = os.path.join(BUILD, "tracker_config.c")
+
+BANNER = "// GENERATED by tools/gen_config.py from tracker_config.cfg - do not edit by hand.\n"
+
+
+KNOWN_SECTIONS = ("system", "link", "display", "timing", "assets", "thresholds",
+                  "strings", "protocol", "frames")
+
+
+class ConfigError(Exception):
+    pass
+
+
+def c_string(text):
+    """Quote 'text' as a C string literal."""
+    out = text.replace("\\", "\\\\").replace('"', '\\"')
+    return '"' + out + '"'
+
+
+def ident(name):
+    """Turn a config key into an upper-case C identifier fragment."""
+    out = "".join(ch if ch.isalnum() else "_" for ch in name).upper()
+    if not out or out[0].isdigit():
+        raise ConfigError("bad identifier: %r" % name)
+    return out
+
+
+def define(name, value, comment=None):
+    """One aligned '#define' line."""
+    line = "#define %-24s %s" % (name, value)
+    if comment:
+        line = "%-48s // %s" % (line, comment)
+    return line + "\n"
+
+
+def get_int(cfg, section, key):
+    try:
+        return int(cfg.get(section, key), 0)
+    except (configparser.Error, ValueError) as exc:
+        raise ConfigError("[%s] %s: %s" % (section, key, exc))
+
+
+def load(path):
+    cfg = configparser.ConfigParser(interpolation=None, inline_comment_prefixes=("#",))
+    cfg.optionxform = str  # keep asset symbols / frame names case-sensitive
+    with open(path) as fh:
+        cfg.read_file(fh)
+    return cfg
+
+
+def build_model(cfg):
+    """Validate the configuration and return everything the emitters need."""
+    m = {}
+    m["clock_hz"] = get_int(cfg, "system", "clock_hz")
+    m["buffer_size"] = get_int(cfg, "system", "uart_buffer_size")
+    m["baud"] = get_int(cfg, "link", "baud")
+    m["poll_ms"] = get_int(cfg, "link", "poll_interval_ms")
+    m["cols"] = get_int(cfg, "display", "cols")
+    m["rows"] = get_int(cfg, "display", "rows")
+
+    # UART divisor: BRD = clock / (16 * baud), FBRD = round(fraction * 64).
+    brd = m["clock_hz"] / (16.0 * m["baud"])
+    m["ibrd"] = int(brd)
+    m["fbrd"] = int((brd - m["ibrd"]) * 64 + 0.5)
+    if m["fbrd"] == 64:
+        m["ibrd"], m["fbrd"] = m["ibrd"] + 1, 0
+    if not 1 <= m["ibrd"] <= 0xFFFF:
+        raise ConfigError("baud %d is out of range for a %d Hz clock" % (m["baud"], m["clock_hz"]))
+
+    m["timing"] = [(ident(k), get_int(cfg, "timing", k)) for k in cfg.options("timing")]
+
+    m["assets"] = []
+    for slot, sym in enumerate(cfg.options("assets")):
+        if not sym.isalnum() or len(sym) > 7:
+            raise ConfigError("asset symbol %r must be 1-7 alphanumeric characters" % sym)
+        m["assets"].append((sym, cfg.get("assets", sym), slot))
+    if not m["assets"]:
+        raise ConfigError("at least one asset is required")
+
+    ladder = sorted(set(int(v) for v in cfg.get("thresholds", "ladder").split()))
+    if not ladder or ladder[0] <= 0:
+        raise ConfigError("threshold ladder must contain positive values")
+    default = get_int(cfg, "thresholds", "default")
+    if default not in ladder:
+        raise ConfigError("default threshold %d is not in the ladder" % default)
+    m["ladder"] = ladder
+    m["default_index"] = ladder.index(default)
+
+    m["strings"] = []
+    for key in cfg.options("strings"):
+        text = cfg.get("strings", key)
+        if len(text) > m["cols"]:
+            raise ConfigError("string %r is %d chars, display has %d" % (key, len(text), m["cols"]))
+        m["strings"].append((ident(key), text))
+
+    m["protocol"] = [(ident(k), cfg.get("protocol", k)) for k in cfg.options("protocol")]
+
+    # Any other section is a block of integer parameters, emitted as CFG_<SECTION>_<KEY>.
+    m["params"] = []
+    for section in cfg.sections():
+        if section in KNOWN_SECTIONS:
+            continue
+        for key in cfg.options(section):
+            get_int(cfg, section, key)  # validate
+            m["params"].append((ident(section) + "_" + ident(key), cfg.get(section, key)))
+
+    m["frames"] = []
+    if cfg.has_section("frames"):
+        seen = {}
+        for name in cfg.options("frames"):
+            tag = cfg.get("frames", name)
+            if len(tag) != 1 or not tag.isalpha():
+                raise ConfigError("frame %r tag must be one letter" % name)
+            if tag in seen:
+                raise ConfigError("frames %r and %r share tag %r" % (seen[tag], name, tag))
+            seen[tag] = name
+            m["frames"].append((ident(name), tag))
+    return m
+
+
+def emit_header(m):
+    out = [BANNER, "#ifndef TRACKER_CONFIG_H\n#define TRACKER_CONFIG_H\n\n#include <stdint.h>\n\n"]
+    out.append("#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n")
+
+    out.append("// System / link\n")
+    out.append(define("CFG_SYSTEM_CLOCK_HZ", "%dU" % m["clock_hz"]))
+    out.append(define("CFG_UART_BUFFER_SIZE", m["buffer_size"]))
+    out.append(define("CFG_UART_BAUD", "%dU" % m["baud"]))
+    out.append(define("CFG_UART_IBRD", "%dU" % m["ibrd"],
+                      "%d / (16 * %d), integer part" % (m["clock_hz"], m["baud"])))
+    out.append(define("CFG_UART_FBRD", "%dU" % m["fbrd"], "fractional part * 64, rounded"))
+    out.append(define("CFG_POLL_INTERVAL_MS", "%dU" % m["poll_ms"]))
+    out.append(define("CFG_LCD_COLS", m["cols"]))
+    out.append(define("CFG_LCD_ROWS", m["rows"]))
+
+    out.append("\n// Timing (milliseconds)\n")
+    for name, val in m["timing"]:
+        out.append(define("CFG_" + name, "%dU" % val))
+
+    if m["params"]:
+        out.append("\n// Module parameters\n")
+        for name, val in m["params"]:
+            out.append(define("CFG_" + name, val + ("" if val.startswith("-") else "U")))
+
+    out.append("\n// Assets (slot numbers index cfg_assets[])\n")
+    out.append(define("CFG_ASSET_COUNT", len(m["assets"])))
+    for sym, api_id, slot in m["assets"]:
+        out.append(define("CFG_ASSET_" + ident(sym), slot))
+        out.append(define("CFG_ASSET_" + ident(sym) + "_API_ID", c_string(api_id)))
+
+    out.append("\n// Threshold ladder (sorted ascending in cfg_thresholds[])\n")
+    out.append(define("CFG_THRESHOLD_COUNT", len(m["ladder"])))
+    out.append(define("CFG_THRESHOLD_DEFAULT", m["default_index"], "index of the default entry"))
+
+    out.append("\n// LCD strings\n")
+    for name, text in m["strings"]:
+        out.append(define("CFG_STR_" + name, c_string(text)))
+
+    out.append("\n// Protocol\n")
+    for name, text in m["protocol"]:
+        out.append(define("CFG_PROTO_" + name, c_string(text)))
+    for name, tag in m["frames"]:
+        out.append(define("CFG_FRAME_" + name, "'%s'" % tag))
+
+    out.append("""
+// Flash-resident tables (defined in tracker_config.c):
+typedef struct {
+    const char *symbol;           // Ticker symbol shown on the display, e.g. "BTC"
+    const char *api_id;           // Identifier used by the price API, e.g. "bitcoin"
+} CfgAsset;
+
+typedef struct {
+    const char *symbol;           // Ticker symbol (index is sorted by this field)
+    uint8_t slot;                 // Slot into cfg_assets[]
+} CfgAssetIndex;
+
+extern const CfgAsset cfg_assets[CFG_ASSET_COUNT];
+extern const CfgAssetIndex cfg_asset_index[CFG_ASSET_COUNT];
+extern const int32_t cfg_thresholds[CFG_THRESHOLD_COUNT];
+
+// Look up an asset slot by ticker symbol (binary search over cfg_asset_index).
+// Returns the slot number, or -1 if the symbol is unknown.
+int Config_Asset_Slot(const char *symbol);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACKER_CONFIG_H
+""")
+    return "".join(out)
+
+
+def emit_source(m):
+    out = [BANNER, '#include "tracker_config.h"\n#include <string.h>\n\n']
+
+    out.append("// Compile-time size checks: a failed check declares an array of size -1.\n")
+    out.append("#define CFG_STATIC_ASSERT(cond, name) typedef char cfg_assert_##name[(cond) ? 1 : -1]\n\n")
+    out.append("CFG_STATIC_ASSERT(CFG_UART_BUFFER_SIZE >= 2 && CFG_UART_BUFFER_SIZE <= 255, uart_buffer_fits_uint8);\n")
+    out.append("CFG_STATIC_ASSERT(CFG_THRESHOLD_COUNT <= 255, threshold_index_fits_uint8);\n")
+    out.append("CFG_STATIC_ASSERT(CFG_ASSET_COUNT <= 255, asset_slot_fits_uint8);\n")
+    out.append("CFG_STATIC_ASSERT(CFG_THRESHOLD_DEFAULT < CFG_THRESHOLD_COUNT, threshold_default_in_range);\n")
+    for name, _ in m["strings"]:
+        out.append("CFG_STATIC_ASSERT(sizeof(CFG_STR_%s) - 1 <= CFG_LCD_COLS, str_%s_fits_row);\n"
+                   % (name, name.lower()))
+    out.append("// Each numeric field of the price frame expands to at most 12 characters.\n")
+    out.append("CFG_STATIC_ASSERT(sizeof(CFG_PROTO_PRICE_TX) + 3 * 12 < CFG_UART_BUFFER_SIZE, price_frame_fits_buffer);\n")
+
+    out.append("\nconst CfgAsset cfg_assets[CFG_ASSET_COUNT] = {\n")
+    for sym, api_id, slot in m["assets"]:
+        out.append("    { %s, %s },  // slot %d\n" % (c_string(sym), c_string(api_id), slot))
+    out.append("};\n\n")
+
+    out.append("const CfgAssetIndex cfg_asset_index[CFG_ASSET_COUNT] = {\n")
+    for sym, _, slot in sorted(m["assets"], key=lambda a: a[0]):
+        out.append("    { %s, %d },\n" % (c_string(sym), slot))
+    out.append("};\n\n")
+
+    out.append("const int32_t cfg_thresholds[CFG_THRESHOLD_COUNT] = {\n")
+    for i in range(0, len(m["ladder"]), 6):
+        out.append("    " + ", ".join("%d" % v for v in m["ladder"][i:i + 6]) + ",\n")
+    out.append("};\n\n")
+
+    out.append("""int Config_Asset_Slot(const char *symbol) {
+    int lo = 0, hi = CFG_ASSET_COUNT - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(symbol, cfg_asset_index[mid].symbol);
+        if (cmp == 0)
+            return cfg_asset_index[mid].slot;
+        if (cmp < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+    return -1;
+}
+""")
+    return "".join(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--check", action="store_true", help="verify generated files are up to date")
+    ap.add_argument("--config", default=CFG_PATH, help="configuration file (default: %(default)s)")
+    args = ap.parse_args()
+
+    try:
+        model = build_model(load(args.config))
+    except (ConfigError, configparser.Error, OSError) as exc:
+        sys.stderr.write("gen_config: %s\n" % exc)
+        return 2
+
+    outputs = [(HDR_PATH, emit_header(model)), (SRC_PATH, emit_source(model))]
+    stale = []
+    for path, text in outputs:
+        current = None
+        if os.path.exists(path):
+            with open(path) as fh:
+                current = fh.read()
+        if current == text:
+            continue
+        if args.check:
+            stale.append(os.path.relpath(path, ROOT))
+        else:
+            with open(path, "w") as fh:
+                fh.write(text)
+    if stale:
+        sys.stderr.write("gen_config: stale output, re-run tools/gen_config.py: %s\n" % ", ".join(stale))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
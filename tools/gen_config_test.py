@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""gen_config_test.py - host tests of tools/gen_config.py.
+
+Feeds small configurations through the generator and checks the emitted header
+and tables, and that bad input is refused with an error instead of producing
+output (a value that is not a number, a duplicate key, an LCD string longer
+than a row, ...).
+
+Usage:
+  python3 tools/gen_config_test.py [-v]
+"""
+
+import configparser
+import os
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_config  # noqa: E402
+
+BASE = """\
+[system]
+clock_hz = 50000000
+uart_buffer_size = 128
+
+[link]
+baud = 115200
+poll_interval_ms = 20000
+
+[display]
+cols = 16
+rows = 2
+
+[timing]
+alarm_blink_ms = 150
+
+[assets]
+ETH = ethereum
+BTC = bitcoin
+
+[thresholds]
+ladder = 30000 10000 20000 10000
+default = 20000
+
+[strings]
+alarm = BUY NOW               # trailing comment
+
+[protocol]
+price_tx = P %.2f
+
+[frames]
+query = Q
+window = W
+
+[flashlog]
+base = 0x20000
+segments = 128
+"""
+
+
+def generate(text):
+    """(header, source) generated from configuration 'text'."""
+    fd, path = tempfile.mkstemp(suffix=".cfg")
+    try:
+        with os.fdopen(fd, "w") as fh:
+            fh.write(text)
+        model = gen_config.build_model(gen_config.load(path))
+    finally:
+        os.unlink(path)
+    return gen_config.emit_header(model), gen_config.emit_source(model)
+
+
+def edit(old, new):
+    """BASE with the one occurrence of 'old' replaced by 'new'."""
+    assert BASE.count(old) == 1, old
+    return BASE.replace(old, new)
+
+
+def defines(header):
+    """{name: value} of the header's #define lines, comments stripped."""
+    out = {}
+    for line in header.splitlines():
+        if line.startswith("#define "):
+            parts = line.split("//")[0].split(None, 2)
+            if len(parts) == 3:
+                out[parts[1]] = parts[2].strip()
+    return out
+
+
+class Output(unittest.TestCase):
+    def setUp(self):
+        self.hdr, self.src = generate(BASE)
+        self.defs = defines(self.hdr)
+
+    def test_banner_and_guard(self):
+        for text in (self.hdr, self.src):
+            self.assertTrue(text.startswith(gen_config.BANNER))
+        self.assertIn("#ifndef TRACKER_CONFIG_H", self.hdr)
+        self.assertTrue(self.hdr.rstrip().endswith("#endif // TRACKER_CONFIG_H"))
+
+    def test_scalars(self):
+        self.assertEqual(self.defs["CFG_SYSTEM_CLOCK_HZ"], "50000000U")
+        self.assertEqual(self.defs["CFG_UART_BUFFER_SIZE"], "128")
+        self.assertEqual(self.defs["CFG_LCD_COLS"], "16")
+        self.assertEqual(self.defs["CFG_ALARM_BLINK_MS"], "150U")
+
+    def test_uart_divisor(self):
+        # 50 MHz / (16 * 115200) = 27.126..., fraction * 64 = 8.1 -> 8
+        self.assertEqual(self.defs["CFG_UART_IBRD"], "27U")
+        self.assertEqual(self.defs["CFG_UART_FBRD"], "8U")
+
+    def test_divisor_fraction_rounds_up(self):
+        # 16 MHz / (16 * 1000001) = 0.99999..., rounds to IBRD 1, FBRD 0
+        defs = defines(generate(edit("clock_hz = 50000000", "clock_hz = 16000000")
+                                .replace("baud = 115200", "baud = 1000001"))[0])
+        self.assertEqual((defs["CFG_UART_IBRD"], defs["CFG_UART_FBRD"]), ("1U", "0U"))
+
+    def test_params_sections(self):
+        self.assertEqual(self.defs["CFG_FLASHLOG_BASE"], "0x20000U")
+        self.assertEqual(self.defs["CFG_FLASHLOG_SEGMENTS"], "128U")
+        defs = defines(generate(BASE + "[uart]\nlevel = -3\n")[0])
+        self.assertEqual(defs["CFG_UART_LEVEL"], "-3")
+
+    def test_assets_in_declaration_order_index_sorted(self):
+        self.assertEqual(self.defs["CFG_ASSET_COUNT"], "2")
+        self.assertEqual(self.defs["CFG_ASSET_ETH"], "0")
+        self.assertEqual(self.defs["CFG_ASSET_BTC_API_ID"], '"bitcoin"')
+        table = self.src.split("cfg_assets[CFG_ASSET_COUNT] = {")[1].split("};")[0]
+        self.assertLess(table.index('"ETH"'), table.index('"BTC"'))
+        index = self.src.split("cfg_asset_index[CFG_ASSET_COUNT] = {")[1].split("};")[0]
+        self.assertEqual([l.strip() for l in index.strip().splitlines()],
+                         ['{ "BTC", 1 },', '{ "ETH", 0 },'])
+
+    def test_ladder_sorted_and_deduplicated(self):
+        self.assertEqual(self.defs["CFG_THRESHOLD_COUNT"], "3")
+        self.assertEqual(self.defs["CFG_THRESHOLD_DEFAULT"], "1")
+        self.assertIn("    10000, 20000, 30000,\n", self.src)
+
+    def test_strings_and_frames(self):
+        self.assertEqual(self.defs["CFG_STR_ALARM"], '"BUY NOW"')
+        self.assertEqual(self.defs["CFG_PROTO_PRICE_TX"], '"P %.2f"')
+        self.assertEqual(self.defs["CFG_FRAME_QUERY"], "'Q'")
+        self.assertIn("CFG_STATIC_ASSERT(sizeof(CFG_STR_ALARM) - 1 <= CFG_LCD_COLS, str_alarm_fits_row);",
+                      self.src)
+
+    def test_string_quoting(self):
+        defs = defines(generate(edit("alarm = BUY NOW", 'alarm = say "hi" \\o/'))[0])
+        self.assertEqual(defs["CFG_STR_ALARM"], '"say \\"hi\\" \\\\o/"')
+
+    def test_string_exactly_one_row(self):
+        generate(edit("alarm = BUY NOW", "alarm = " + "x" * 16))
+
+
+class Errors(unittest.TestCase):
+    def refused(self, text, exc=gen_config.ConfigError, match=None):
+        with self.assertRaises(exc) as ctx:
+            generate(text)
+        if match:
+            self.assertIn(match, str(ctx.exception))
+
+    def test_bad_type(self):
+        self.refused(edit("baud = 115200", "baud = fast"), match="[link] baud")
+        self.refused(edit("segments = 128", "segments = 12.5"), match="[flashlog] segments")
+
+    def test_missing_key(self):
+        self.refused(edit("poll_interval_ms = 20000\n", ""), match="[link] poll_interval_ms")
+
+    def test_duplicate_key(self):
+        self.refused(edit("[timing]\n", "[timing]\nalarm_blink_ms = 100\n"),
+                     configparser.DuplicateOptionError)
+
+    def test_duplicate_section(self):
+        self.refused(BASE + "[display]\ncols = 20\n", configparser.DuplicateSectionError)
+
+    def test_string_too_long(self):
+        self.refused(edit("alarm = BUY NOW", "alarm = " + "x" * 17), match="is 17 chars, display has 16")
+
+    def test_string_too_long_for_narrow_display(self):
+        self.refused(edit("cols = 16", "cols = 6"), match="'alarm' is 7 chars, display has 6")
+
+    def test_baud_out_of_range(self):
+        self.refused(edit("baud = 115200", "baud = 10"), match="out of range")
+
+    def test_bad_asset_symbol(self):
+        self.refused(edit("ETH = ethereum", "ETH-X = ethereum"), match="alphanumeric")
+        self.refused(edit("ETH = ethereum", "ETHEREUM = ethereum"), match="alphanumeric")
+
+    def test_no_assets(self):
+        self.refused(edit("ETH = ethereum\nBTC = bitcoin\n", ""), match="at least one asset")
+
+    def test_default_not_in_ladder(self):
+        self.refused(edit("default = 20000", "default = 25000"), match="not in the ladder")
+
+    def test_ladder_not_positive(self):
+        self.refused(edit("ladder = 30000 10000 20000 10000", "ladder = 0 20000"), match="positive")
+
+    def test_frame_tags(self):
+        self.refused(edit("window = W", "window = Q"), match="share tag 'Q'")
+        self.refused(edit("window = W", "window = WW"), match="one letter")
+
+    def test_bad_identifier(self):
+        self.refused(edit("alarm_blink_ms = 150", "1st_ms = 150"), match="bad identifier")
+
+
+class Main(unittest.TestCase):
+    def test_exit_status(self):
+        fd, path = tempfile.mkstemp(suffix=".cfg")
+        with os.fdopen(fd, "w") as fh:
+            fh.write(edit("baud = 115200", "baud = fast"))
+        argv, stderr = sys.argv, sys.stderr
+        try:
+            sys.argv = ["gen_config.py", "--check", "--config", path]
+            sys.stderr = open(os.devnull, "w")
+            self.assertEqual(gen_config.main(), 2)
+        finally:
+            sys.stderr.close()
+            sys.argv, sys.stderr = argv, stderr
+            os.unlink(path)
+
+    def test_committed_output_current(self):
+        argv = sys.argv
+        try:
+            sys.argv = ["gen_config.py", "--check"]
+            self.assertEqual(gen_config.main(), 0)
+        finally:
+            sys.argv = argv
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""host_tests.py - build and run the host tests.
+
+The C tests in linux/*_test.c are built with the host compiler against the firmware
+sources they test (and, where they need registers, the board shim in qemu/), then
+run. The Python tests in tools/*_test.py are run as they are. Exit status 1 if any
+test fails to build or fails a check.
+
+Usage:
+  python3 tools/host_tests.py                 all tests
+  python3 tools/host_tests.py flashlog        selected tests
+  python3 tools/host_tests.py --cc clang -v   another compiler; show every test's output
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+CFLAGS = ["-O2", "-Wall", "-Wextra"]
+SHIM = ["-Iqemu"]                   # Ahead of -Ibuild: the shim stands in for the device header
+
+# name: (extra flags, sources besides the test, test source if not linux/<name>_test.c)
+C_TESTS = {
+    "flashlog": (SHIM, ["build/flashlog.c", "qemu/board.c", "build/tracker_config.c"]),
+    "sdlog": (SHIM, ["build/sdlog.c", "qemu/board.c"]),
+    "encoder": (SHIM, ["build/encoder.c", "qemu/board.c"]),
+    "uart": (SHIM, ["build/" + m + ".c" for m in ("tracker", "link", "frame", "history", "dsp", "selftest", "flow",
+                                                  "pt", "rules", "lcdbus", "flashlog", "encoder", "feed", "sdlog",
+                                                  "ui", "tracker_config")] + ["qemu/board.c"]),  # Includes main.c
+    "pt": (SHIM, ["build/ui.c", "build/tracker_config.c"]),   # Compiles pt.c itself, on a virtual clock
+    "dsp": ([], ["build/dsp.c"]),
+    "dsp_simd": (SHIM + ["-DDSP_USE_SIMD=1", "-DDSP_BENCHMARK"], ["build/dsp.c"], "linux/dsp_test.c"),
+    "frame": ([], ["build/frame.c"]),
+    "history": ([], ["build/history.c", "build/dsp.c"]),
+    "archive": ([], ["build/archive.c", "build/frame.c"]),
+    "lcdbus": ([], []),                                        # Compiles lcdbus.c itself
+    "lcdbus_20x4": (["-DLCDBUS_TEST_20X4"], [], "linux/lcdbus_test.c"),
+    "rules": (SHIM, ["build/history.c", "build/dsp.c", "qemu/board.c"]),      # Compiles rules.c itself
+}
+PY_TESTS = ("gen_config", "feederd", "tft_snapshot", "fleetsim")
+
+
+def run_c(name, cc, tmp, verbose):
+    flags, sources = C_TESTS[name][:2]
+    test = C_TESTS[name][2] if len(C_TESTS[name]) > 2 else "linux/%s_test.c" % name
+    exe = os.path.join(tmp, name + "_test")
+    cmd = [cc] + CFLAGS + flags + ["-Ibuild", "-o", exe, test] + sources + ["-lm"]
+    built = subprocess.run(cmd, cwd=ROOT, capture_output=True, text=True)
+    if built.returncode:
+        return False, " ".join(cmd) + "\n" + built.stdout + built.stderr
+    out = subprocess.run([exe], cwd=ROOT, capture_output=True, text=True, timeout=600)
+    return out.returncode == 0, (built.stderr if verbose else "") + out.stdout + out.stderr
+
+
+def run_py(name):
+    out = subprocess.run([sys.executable, os.path.join("tools", name + "_test.py")], cwd=ROOT,
+                         capture_output=True, text=True, timeout=600)
+    return out.returncode == 0, out.stdout + out.stderr
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("tests", nargs="*", help="tests to run (default: all)")
+    ap.add_argument("--cc", default="cc", help="host C compiler")
+    ap.add_argument("-v", "--verbose", action="store_true", help="print the output of passing tests too")
+    args = ap.parse_args()
+
+    names = args.tests or list(C_TESTS) + list(PY_TESTS)
+    for n in names:
+        if n not in C_TESTS and n not in PY_TESTS:
+            ap.error("unknown test '%s' (one of %s)" % (n, ", ".join(list(C_TESTS) + list(PY_TESTS))))
+    failed = []
+    with tempfile.TemporaryDirectory() as tmp:
+        for n in names:
+            ok, text = run_c(n, args.cc, tmp, args.verbose) if n in C_TESTS else run_py(n)
+            print("%-12s %s" % (n, "ok" if ok else "FAILED"))
+            if not ok or args.verbose:
+                sys.stdout.write(text)
+            if not ok:
+                failed.append(n)
+    if failed:
+        print("failed: %s" % ", ".join(failed))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
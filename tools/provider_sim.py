@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""provider_sim.py - local stand-in price providers that enforce request limits.
+
+Each provider answers /simple/price style requests (any path; the ids come from
+the 'ids=' parameter) with random-walk prices, the way feederd and the ESP32
+parse them. A request over the provider's limit gets 429 with Retry-After, and
+one with more ids than the provider accepts gets 400. Some assets move much
+more than others (-v percent of them), so the planner's volatility weighting
+has something to find. Every -s seconds, and on exit, each provider prints the
+requests it accepted and refused and the ids it served. --log FILE writes one
+line per request: monotonic time, port, status and Retry-After (0 if none).
+
+Provider spec: PORT:LIMIT/WINDOW_S[:MAX_IDS], e.g. 8001:30/60:50 allows 30
+requests per 60 s of at most 50 ids each. --sliding counts the window as a
+sliding log instead of fixed windows.
+
+Usage:
+  python3 tools/provider_sim.py 8001:30/60:50 8002:10/10:25
+  ./feederd -u http://127.0.0.1:8001/simple/price?ids= -r 30/60:50 -a ...
+"""
+
+import argparse
+import collections
+import http.server
+import json
+import math
+import random
+import socketserver
+import sys
+import threading
+import time
+import urllib.parse
+
+lock = threading.Lock()
+prices = {}                       # id -> [price, change_24h, sigma]
+args = None
+
+
+def quote(asset):
+    """Advance the asset's random walk by the time since it was last asked for."""
+    now = time.monotonic()
+    p = prices.get(asset)
+    if p is None:
+        rng = random.Random(asset)
+        volatile = rng.random() * 100 < args.volatile
+        p = prices[asset] = [rng.uniform(0.1, 60000), rng.uniform(-5, 5), 0.02 if volatile else 0.002, now]
+    dt = max(now - p[3], 0.0)
+    p[0] *= math.exp(random.gauss(0, p[2] * math.sqrt(dt / 10.0)))   # sigma per 10 s
+    p[1] += random.gauss(0, p[2] * 10 * math.sqrt(dt / 10.0))
+    p[3] = now
+    return {"usd": round(p[0], 6), "usd_24h_change": round(p[1], 4)}
+
+
+class Provider:
+    def __init__(self, spec):
+        port, rest = spec.split(":", 1)
+        limit, rest = rest.split("/", 1)
+        window, _, max_ids = rest.partition(":")
+        self.port, self.limit, self.window = int(port), int(limit), float(window)
+        self.max_ids = int(max_ids) if max_ids else 0
+        self.log = collections.deque()          # Sliding: times of accepted requests
+        self.fixed_start, self.fixed_count = time.monotonic(), 0
+        self.accepted = self.refused = self.too_big = self.ids = 0
+
+    def admit(self):
+        """Returns 0 if the request may go ahead, else the seconds to wait."""
+        now = time.monotonic()
+        if args.sliding:
+            while self.log and now - self.log[0] >= self.window:
+                self.log.popleft()
+            if len(self.log) >= self.limit:
+                return self.window - (now - self.log[0])
+            self.log.append(now)
+            return 0
+        if now - self.fixed_start >= self.window:
+            self.fixed_start += (now - self.fixed_start) // self.window * self.window
+            self.fixed_count = 0
+        if self.fixed_count >= self.limit:
+            return self.window - (now - self.fixed_start)
+        self.fixed_count += 1
+        return 0
+
+    def report(self):
+        return ("provider :%d  %d/%gs  accepted %d  refused %d (429)  too many ids %d  ids served %d"
+                % (self.port, self.limit, self.window, self.accepted, self.refused, self.too_big, self.ids))
+
+
+def log(prov, status, retry):
+    """One --log line for a request to 'prov' (called with the lock held)."""
+    if args.log:
+        args.log.write("%.4f %d %d %d\n" % (time.monotonic(), prov.port, status, retry))
+        args.log.flush()
+
+
+def handler_for(prov):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.0"
+
+        def reply(self, status, body=b"", headers=()):
+            self.send_response(status)
+            for k, v in headers:
+                self.send_header(k, v)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def do_GET(self):
+            query = urllib.parse.parse_qs(urllib.parse.urlsplit(self.path).query)
+            ids = [i for i in ",".join(query.get("ids", [])).split(",") if i]
+            with lock:
+                if prov.max_ids and len(ids) > prov.max_ids:
+                    prov.too_big += 1
+                    log(prov, 400, 0)
+                    return self.reply(400, b'{"error":"too many ids"}')
+                wait = prov.admit()
+                if wait:
+                    prov.refused += 1
+                    retry = max(1, math.ceil(wait))
+                    log(prov, 429, retry)
+                    return self.reply(429, b'{"status":{"error_code":429}}', [("Retry-After", str(retry))])
+                prov.accepted += 1
+                prov.ids += len(ids)
+                body = json.dumps({i: quote(i) for i in ids}).encode()
+                log(prov, 200, 0)
+            self.reply(200, body)
+
+        def log_message(self, fmt, *a):
+            pass
+
+    return Handler
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main():
+    global args
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("providers", nargs="+", help="PORT:LIMIT/WINDOW_S[:MAX_IDS]")
+    ap.add_argument("--sliding", action="store_true", help="sliding-window limit instead of fixed windows")
+    ap.add_argument("-v", "--volatile", type=float, default=10, help="percent of assets that move 10x more")
+    ap.add_argument("-s", "--stats", type=float, default=10, help="report period in seconds (0: only on exit)")
+    ap.add_argument("--seconds", type=float, default=0, help="stop after this long (0: until Ctrl-C)")
+    ap.add_argument("--log", type=argparse.FileType("w"), help="write time, port, status, Retry-After per request")
+    args = ap.parse_args()
+
+    provs = [Provider(s) for s in args.providers]
+    for p in provs:
+        threading.Thread(target=Server(("127.0.0.1", p.port), handler_for(p)).serve_forever, daemon=True).start()
+    print("provider_sim: %d provider(s), %s windows" % (len(provs), "sliding" if args.sliding else "fixed"))
+    sys.stdout.flush()
+    start = time.monotonic()
+    next_stats = start + args.stats if args.stats else None
+    try:
+        while not args.seconds or time.monotonic() - start < args.seconds:
+            time.sleep(0.2)
+            if next_stats and time.monotonic() >= next_stats:
+                next_stats += args.stats
+                with lock:
+                    for p in provs:
+                        print(p.report())
+                sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    with lock:
+        for p in provs:
+            print(p.report())
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""qemu_bench.py - Cortex-M4 instruction counts of the TM4C's hot paths under QEMU.
+
+Builds qemu/bench.c with the firmware modules for QEMU's mps2-an386 machine
+(Cortex-M4F; board shim in qemu/) and runs each benchmark path on the recorded
+ESP32 session in qemu/recorded.txt. QEMU's insn plugin counts the guest
+instructions of every run; the 'none' path (loading and splitting the
+recording) is subtracted, and the rest is divided by the path's work items.
+
+Needs arm-none-eabi-gcc with newlib (rdimon.specs, for semihosting),
+qemu-system-arm, and libinsn.so from QEMU's tests/plugin (built with
+'make plugins' in a QEMU build tree; some distributions ship it).
+
+--host builds the same sources against the same shim with the host compiler
+and runs every path natively. That counts no instructions, but it checks that
+each path runs through and prints its items and checksum, which a QEMU run of
+the same recording must reproduce.
+
+Usage:
+  python3 tools/qemu_bench.py --plugin ~/qemu/build/tests/plugin/libinsn.so
+  python3 tools/qemu_bench.py --passes 4 parse stats     selected paths, recording replayed 4 times
+  python3 tools/qemu_bench.py --build-only               compile and link bench.elf only
+  python3 tools/qemu_bench.py --host                     native build: items and checksums only
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PATHS = ("parse", "format", "stats", "lcd", "rules") # Besides the "none" baseline (see qemu/bench.c)
+MODULES = ("tracker", "link", "frame", "history", "dsp", "selftest", "flow", "fetch", "pt", "rules", "lcdbus", "tracker_config")
+CFLAGS = ["-mcpu=cortex-m4", "-mthumb", "-mfloat-abi=hard", "-mfpu=fpv4-sp-d16", "-O2",
+          "-ffunction-sections", "-fdata-sections", "-Wall"]
+PLUGIN_DIRS = ("/usr/lib/qemu/plugins", "/usr/local/lib/qemu/plugins", "/usr/libexec/qemu/plugins")
+
+
+def build(cc, elf):
+    src = [os.path.join("qemu", "board.c"), os.path.join("qemu", "bench.c")]
+    src += [os.path.join("build", m + ".c") for m in MODULES]
+    cmd = [cc] + CFLAGS + ["-Iqemu", "-Ibuild", "--specs=rdimon.specs",
+                           "-T", os.path.join("qemu", "mps2_an386.ld"), "-Wl,--gc-sections",
+                           "-o", elf] + src + ["-lm"]
+    subprocess.run(cmd, cwd=ROOT, check=True)
+
+
+def build_host(cc, exe):
+    src = [os.path.join("qemu", "board.c"), os.path.join("qemu", "bench.c")]
+    src += [os.path.join("build", m + ".c") for m in MODULES]
+    cmd = [cc, "-O2", "-Iqemu", "-Ibuild", "-o", exe] + src + ["-lm"]
+    subprocess.run(cmd, cwd=ROOT, check=True)
+
+
+def run_host(exe, path, passes):
+    """One native run: returns (items, checksum)."""
+    out = subprocess.run([exe, path, "qemu/recorded.txt", str(passes)], cwd=ROOT,
+                         capture_output=True, text=True, timeout=600)
+    m = re.search(r"^%s items (\d+) check ([0-9a-f]+)" % path, out.stdout, re.M)
+    if out.returncode or not m:
+        sys.stderr.write("qemu_bench: host run '%s' failed (exit %d):\n%s%s"
+                         % (path, out.returncode, out.stdout, out.stderr))
+        sys.exit(1)
+    return int(m.group(1)), m.group(2)
+
+
+def run(qemu, plugin, elf, path, passes):
+    """One benchmark run: returns (items, checksum, instructions)."""
+    cmd = [qemu, "-M", "mps2-an386", "-nographic", "-monitor", "none", "-serial", "none",
+           "-semihosting-config",
+           "enable=on,target=native,arg=bench,arg=%s,arg=qemu/recorded.txt,arg=%d" % (path, passes),
+           "-kernel", elf, "-plugin", plugin + ",inline=on", "-d", "plugin"]
+    out = subprocess.run(cmd, cwd=ROOT, capture_output=True, text=True, timeout=600)
+    text = out.stdout + out.stderr
+    m = re.search(r"^%s items (\d+) check ([0-9a-f]+)" % path, text, re.M)
+    n = re.search(r"insns:\s*(\d+)", text)
+    if out.returncode or not m or not n:
+        sys.stderr.write("qemu_bench: run '%s' failed (exit %d):\n%s" % (path, out.returncode, text))
+        sys.exit(1)
+    return int(m.group(1)), m.group(2), int(n.group(1))
+
+
+def find_plugin():
+    for d in PLUGIN_DIRS:
+        p = os.path.join(d, "libinsn.so")
+        if os.path.exists(p):
+            return p
+    return None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("paths", nargs="*", default=list(PATHS), help="paths to run (default: all)")
+    ap.add_argument("--cc", default="arm-none-eabi-gcc", help="cross compiler")
+    ap.add_argument("--qemu", default="qemu-system-arm", help="QEMU system emulator")
+    ap.add_argument("--plugin", default=find_plugin(), help="QEMU's libinsn.so")
+    ap.add_argument("--passes", type=int, default=1, help="times the recording is replayed per run")
+    ap.add_argument("--elf", default=os.path.join("qemu", "bench.elf"), help="output image")
+    ap.add_argument("--build-only", action="store_true", help="stop after linking")
+    ap.add_argument("--host", nargs="?", const="cc", metavar="CC",
+                    help="build with the host compiler (default cc) and run natively")
+    args = ap.parse_args()
+
+    for p in args.paths:
+        if p not in PATHS:
+            ap.error("unknown path '%s' (one of %s)" % (p, ", ".join(PATHS)))
+    if args.host:
+        exe = os.path.join("qemu", "bench.host")
+        build_host(args.host, exe)
+        if args.build_only:
+            return 0
+        print("%-8s %8s  %s" % ("path", "items", "check"))
+        for p in ["none"] + args.paths:
+            items, check = run_host(os.path.join(ROOT, exe), p, args.passes)
+            print("%-8s %8d  %s" % (p, items, check))
+        return 0
+    for tool, option in ((args.cc, "--cc"), (args.qemu, "--qemu")):
+        if not shutil.which(tool) and (option == "--cc" or not args.build_only):
+            ap.error("%s not found; pass %s, or use --host for a native run (no instruction counts)"
+                     % (tool, option))
+    build(args.cc, args.elf)
+    if args.build_only:
+        return 0
+    if not args.plugin:
+        ap.error("libinsn.so not found; pass --plugin")
+
+    _, _, base = run(args.qemu, args.plugin, args.elf, "none", args.passes)
+    print("baseline (load and split the recording): %d instructions" % base)
+    print("%-8s %8s %14s %12s  %s" % ("path", "items", "instructions", "per item", "check"))
+    for p in args.paths:
+        items, check, insns = run(args.qemu, args.plugin, args.elf, p, args.passes)
+        net = insns - base
+        print("%-8s %8d %14d %12.1f  %s" % (p, items, net, net / items if items else 0.0, check))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,339 @@
+#!/usr/bin/env python3
+"""rules_compile.py - compile alert rules for the TM4C's rule machine (build/rules.h).
+
+One rule per line ('#' starts a comment); a rule fires when its expression is true:
+    price < threshold
+    pct(price, prev) < -2 or price < low_24h * 0.98
+    abs(change) > 8 and hour >= 8 and hour < 22
+
+Values: price, change (24 h, percent), threshold, prev (price of the previous tick),
+hour (UTC, -1 without a clock), low_1h, high_1h, mean_1h, low_24h, high_24h, mean_24h
+and numbers. Operators, loosest first: or; and; not; < <= > >=; + -; * /; unary -.
+Functions: min(a, b), max(a, b), abs(a), pct(a, b) (change from b to a in percent).
+'and' and 'or' evaluate both sides: the machine has no jumps.
+
+Prints each rule's code and worst-case cycles, and the set's bound against the budget
+([rules] budget_cycles). With --port it loads the set into the TM4C over the USB feed
+(needs pyserial) and prints the device's answer; --store also keeps it in the EEPROM
+for the next boot.
+
+Usage:
+  python3 tools/rules_compile.py rules.txt                        check and list
+  python3 tools/rules_compile.py rules.txt -o rules.bin            write the image
+  python3 tools/rules_compile.py rules.txt --c                     the image as a C initializer
+  python3 tools/rules_compile.py rules.txt --port /dev/ttyACM0 --store
+  python3 tools/rules_compile.py --builtin --port /dev/ttyACM0 --store   back to price < threshold
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import feed_decode  # noqa: E402  (record framing and the status record's text)
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+VERSION = 1                                 # RULES_VERSION
+MAX_RULES, STACK, IMAGE_MAX = 8, 8, 240     # RULES_MAX, RULES_STACK, RULES_IMAGE_MAX
+SET_CYCLES, RULE_CYCLES = 40, 24            # RULES_SET_CYCLES, RULES_RULE_CYCLES in rules.c
+
+# name: (opcode, operand bytes, pops, worst-case cycles) as op_info[] in rules.c
+OPS = {
+    "load": (1, 1, 0, 14), "const": (2, 4, 0, 18),
+    "add": (3, 0, 2, 14), "sub": (4, 0, 2, 14), "mul": (5, 0, 2, 14), "div": (6, 0, 2, 30),
+    "min": (7, 0, 2, 16), "max": (8, 0, 2, 16), "pct": (9, 0, 2, 44),
+    "neg": (10, 0, 1, 12), "abs": (11, 0, 1, 12), "not": (12, 0, 1, 14),
+    "lt": (13, 0, 2, 16), "le": (14, 0, 2, 16), "gt": (15, 0, 2, 16), "ge": (16, 0, 2, 16),
+    "and": (17, 0, 2, 18), "or": (18, 0, 2, 18),
+}
+INPUTS = ("price", "change", "threshold", "prev", "hour",
+          "low_1h", "high_1h", "mean_1h", "low_24h", "high_24h", "mean_24h")   # RULES_IN_*
+FUNCS = {"min": 2, "max": 2, "pct": 2, "abs": 1}
+COMPARE = {"<": "lt", "<=": "le", ">": "gt", ">=": "ge"}
+TOKEN = re.compile(r"\s*(?:(\d+\.?\d*(?:[eE][-+]?\d+)?|\.\d+)|([A-Za-z_]\w*)|(<=|>=|[-+*/<>(),]))")
+
+
+class RuleError(Exception):
+    pass
+
+
+class Parser:
+    """Recursive descent straight to code: a list of (op, operand) in evaluation order."""
+
+    def __init__(self, text):
+        self.toks, pos = [], 0
+        text = text.rstrip()
+        while pos < len(text):
+            m = TOKEN.match(text, pos)
+            if not m or m.end() == pos:
+                raise RuleError("unexpected '%s'" % text[pos:].strip()[:10])
+            num, name, sym = m.groups()
+            self.toks.append(("num", float(num)) if num else ("name", name) if name else ("sym", sym))
+            pos = m.end()
+        self.i = 0
+        self.code = []
+
+    def peek(self, kind=None, value=None):
+        if self.i >= len(self.toks):
+            return None
+        t = self.toks[self.i]
+        if (kind and t[0] != kind) or (value is not None and t[1] != value):
+            return None
+        return t
+
+    def take(self, kind=None, value=None):
+        t = self.peek(kind, value)
+        if t:
+            self.i += 1
+        return t
+
+    def expect(self, value):
+        if not self.take("sym", value):
+            raise RuleError("expected '%s'" % value)
+
+    def parse(self):
+        self.expr_or()
+        if self.i != len(self.toks):
+            raise RuleError("unexpected '%s'" % (self.toks[self.i][1],))
+        return self.code
+
+    def expr_or(self):
+        self.expr_and()
+        while self.take("name", "or"):
+            self.expr_and()
+            self.code.append(("or", None))
+
+    def expr_and(self):
+        self.expr_not()
+        while self.take("name", "and"):
+            self.expr_not()
+            self.code.append(("and", None))
+
+    def expr_not(self):
+        if self.take("name", "not"):
+            self.expr_not()
+            self.code.append(("not", None))
+        else:
+            self.expr_cmp()
+
+    def expr_cmp(self):
+        self.expr_sum()
+        t = self.peek("sym")
+        if t and t[1] in COMPARE:
+            self.i += 1
+            self.expr_sum()
+            self.code.append((COMPARE[t[1]], None))
+
+    def expr_sum(self):
+        self.expr_term()
+        while True:
+            t = self.take("sym", "+") or self.take("sym", "-")
+            if not t:
+                return
+            self.expr_term()
+            self.code.append(("add" if t[1] == "+" else "sub", None))
+
+    def expr_term(self):
+        self.expr_unary()
+        while True:
+            t = self.take("sym", "*") or self.take("sym", "/")
+            if not t:
+                return
+            self.expr_unary()
+            self.code.append(("mul" if t[1] == "*" else "div", None))
+
+    def expr_unary(self):
+        if self.take("sym", "-"):
+            t = self.peek("num")
+            if t:                                   # A negative constant is one opcode.
+                self.i += 1
+                self.code.append(("const", -t[1]))
+                return
+            self.expr_unary()
+            self.code.append(("neg", None))
+            return
+        self.atom()
+
+    def atom(self):
+        t = self.take()
+        if t is None:
+            raise RuleError("expression ends too early")
+        if t[0] == "num":
+            self.code.append(("const", t[1]))
+        elif t == ("sym", "("):
+            self.expr_or()
+            self.expect(")")
+        elif t[0] == "name" and t[1] in FUNCS:
+            self.expect("(")
+            for k in range(FUNCS[t[1]]):
+                if k:
+                    self.expect(",")
+                self.expr_or()
+            self.expect(")")
+            self.code.append((t[1], None))
+        elif t[0] == "name" and t[1] in INPUTS:
+            self.code.append(("load", INPUTS.index(t[1])))
+        else:
+            raise RuleError("unknown name '%s'" % (t[1],))
+
+
+def encode(code):
+    out = bytearray()
+    for op, arg in code:
+        out.append(OPS[op][0])
+        if op == "load":
+            out.append(arg)
+        elif op == "const":
+            out += struct.pack("<f", arg)
+    return bytes(out)
+
+
+def cost(code):
+    """Worst-case cycles and deepest stack of one rule, as Verify() in rules.c finds them."""
+    cycles, depth, deepest = RULE_CYCLES, 0, 0
+    for op, _ in code:
+        depth = depth - OPS[op][2] + 1
+        deepest = max(deepest, depth)
+        cycles += OPS[op][3]
+    return cycles, deepest
+
+
+def listing(code):
+    parts = []
+    for op, arg in code:
+        if op == "load":
+            parts.append(INPUTS[arg])
+        elif op == "const":
+            parts.append("%g" % struct.unpack("<f", struct.pack("<f", arg))[0])
+        else:
+            parts.append(op.upper())
+    return " ".join(parts)
+
+
+def budget():
+    """CFG_RULES_BUDGET_CYCLES from the generated header."""
+    try:
+        with open(os.path.join(ROOT, "build", "tracker_config.h")) as f:
+            m = re.search(r"#define CFG_RULES_BUDGET_CYCLES\s+(\d+)", f.read())
+            return int(m.group(1)) if m else None
+    except OSError:
+        return None
+
+
+def compile_rules(lines):
+    """Returns (image, [(source, code, cycles)]); raises RuleError naming the line."""
+    rules = []
+    for n, line in enumerate(lines, 1):
+        src = line.split("#", 1)[0].strip()
+        if not src:
+            continue
+        try:
+            code = Parser(src).parse()
+        except RuleError as e:
+            raise RuleError("line %d: %s" % (n, e))
+        cycles, deepest = cost(code)
+        if deepest > STACK:
+            raise RuleError("line %d: needs %d stack entries (the machine has %d)" % (n, deepest, STACK))
+        if len(encode(code)) > 255:
+            raise RuleError("line %d: longer than 255 bytes of code" % n)
+        rules.append((src, code, cycles))
+    if not rules:
+        raise RuleError("no rules")
+    if len(rules) > MAX_RULES:
+        raise RuleError("%d rules (at most %d)" % (len(rules), MAX_RULES))
+    image = bytearray([VERSION, len(rules)])
+    for _, code, _ in rules:
+        body = encode(code)
+        image += bytes([len(body)]) + body
+    if len(image) > IMAGE_MAX:
+        raise RuleError("image of %d bytes (at most %d)" % (len(image), IMAGE_MAX))
+    return bytes(image), rules
+
+
+def record(rtype, payload):
+    check = rtype ^ len(payload)
+    for b in payload:
+        check ^= b
+    return bytes([feed_decode.SYNC, rtype, len(payload)]) + payload + bytes([check])
+
+
+def wait_status(port, dec, seconds=3.0):
+    """The next rules status record from the device, or None."""
+    t_end = time.monotonic() + seconds
+    while time.monotonic() < t_end:
+        for rtype, payload in dec.feed(port.read(port.in_waiting or 1)):
+            if rtype == ord("V"):
+                return payload
+    return None
+
+
+def send(path, image, store):
+    try:
+        import serial
+    except ImportError:
+        sys.stderr.write("rules_compile: pyserial is required to load rules (pip install pyserial)\n")
+        return 2
+    port = serial.Serial(path, timeout=0.2)
+    dec = feed_decode.Decoder()
+    port.write(record(ord("L"), image))
+    for step in ("load", "store") if store else ("load",):
+        if step == "store":
+            port.write(b"W")
+        status = wait_status(port, dec)
+        if status is None:
+            sys.stderr.write("rules_compile: no answer to the %s\n" % step)
+            return 1
+        print(feed_decode.describe(ord("V"), status))
+        if status[0] != 0:
+            return 1
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("rules", nargs="?", help="rule file, one expression per line ('-': stdin)")
+    ap.add_argument("--builtin", action="store_true", help="the built-in set (price < threshold) instead of a file")
+    ap.add_argument("-o", "--out", help="write the image to this file")
+    ap.add_argument("--c", action="store_true", help="print the image as a C initializer")
+    ap.add_argument("--port", help="load the set into the TM4C on this USB CDC port")
+    ap.add_argument("--store", action="store_true", help="with --port: keep the set in the EEPROM")
+    args = ap.parse_args()
+    if not args.builtin and not args.rules:
+        ap.error("a rule file or --builtin is needed")
+
+    if args.builtin:
+        image = b""                                 # An empty load restores the built-in set.
+        print("built-in set: price < threshold")
+    else:
+        src = sys.stdin if args.rules == "-" else open(args.rules)
+        try:
+            image, rules = compile_rules(src.read().splitlines())
+        except RuleError as e:
+            sys.stderr.write("rules_compile: %s\n" % e)
+            return 1
+        limit = budget()
+        total = SET_CYCLES
+        for i, (text, code, cycles) in enumerate(rules):
+            total += cycles
+            print("rule %d: %s\n        %s\n        %d ops, %d bytes, at most %d cycles"
+                  % (i, text, listing(code), len(code), len(encode(code)), cycles))
+        print("set: %d rules, %d bytes, at most %d cycles per tick (budget %s)"
+              % (len(rules), len(image), total, limit if limit is not None else "?"))
+        if limit is not None and total > limit:
+            sys.stderr.write("rules_compile: over the budget; the TM4C would refuse the set\n")
+            return 1
+        if args.out:
+            with open(args.out, "wb") as f:
+                f.write(image)
+        if args.c:
+            print("{ " + ", ".join("0x%02X" % b for b in image) + " }")
+    if args.port:
+        return send(args.port, image, args.store)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""sdlog.py - prepare and read the TM4C's microSD tick log (build/sdlog.c).
+
+The firmware writes raw sectors into a contiguous, preallocated TICKLOG.BIN in the
+root of a FAT32 card. Create that file on a freshly formatted card (so the file
+system hands out one contiguous run of clusters) and read it back afterwards.
+
+Usage:
+  python3 tools/sdlog.py prealloc /media/sdcard --mb 256   create TICKLOG.BIN
+  python3 tools/sdlog.py dump /media/sdcard/TICKLOG.BIN     print the logged records
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+SECTOR = 512
+MAGIC = 0x474C4453          # "SDLG"
+HEADER = struct.Struct("<IIIHH")
+
+
+def prealloc(args):
+    path = os.path.join(args.mount, "TICKLOG.BIN")
+    if os.path.exists(path) and not args.force:
+        sys.stderr.write("sdlog: %s exists (use --force to recreate it)\n" % path)
+        return 1
+    chunk = bytes(1 << 20)
+    with open(path, "wb") as fh:
+        for _ in range(args.mb):
+            fh.write(chunk)         # Zeros: no sector carries a valid header yet.
+        fh.flush()
+        os.fsync(fh.fileno())
+    print("created %s (%d MB, %d sectors)" % (path, args.mb, args.mb * 2048))
+    return 0
+
+
+def sectors(path):
+    """Valid log sectors as (seq, payload bytes), in write order."""
+    out = []
+    with open(path, "rb") as fh:
+        while True:
+            sec = fh.read(SECTOR)
+            if len(sec) < SECTOR:
+                break
+            magic, seq, seq_inv, used, _ = HEADER.unpack_from(sec)
+            if magic == MAGIC and seq_inv == (~seq & 0xFFFFFFFF) and HEADER.size <= used <= SECTOR:
+                out.append((seq, sec[HEADER.size:used]))
+    out.sort()
+    return out
+
+
+def dump(args):
+    for seq, data in sectors(args.file):
+        i = 0
+        while i + 2 <= len(data):
+            rtype, length = data[i], data[i + 1]
+            p = data[i + 2:i + 2 + length]
+            i += 2 + length
+            if rtype == ord("T") and length == 10:
+                t, cents, change = struct.unpack("<Iih", p)
+                print("%s  tick   $%.2f  %+.2f%%" % (stamp(t), cents / 100.0, change / 100.0))
+            elif rtype == ord("A") and length == 9:
+                on, cents, t = struct.unpack("<BiI", p)
+                print("%s  alarm  %s at $%.2f" % (stamp(t), "ON" if on else "off", cents / 100.0))
+            else:
+                print("sector %d: unknown record 0x%02x (%d bytes)" % (seq, rtype, length))
+    return 0
+
+
+def stamp(t):
+    return time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(t)) if t else "-" * 19
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("prealloc", help="create TICKLOG.BIN on a mounted card")
+    p.add_argument("mount", help="mount point of the card")
+    p.add_argument("--mb", type=int, default=256, help="file size in MB (default: %(default)s)")
+    p.add_argument("--force", action="store_true", help="overwrite an existing log")
+    p.set_defaults(func=prealloc)
+    d = sub.add_parser("dump", help="print the records of a TICKLOG.BIN")
+    d.add_argument("file")
+    d.set_defaults(func=dump)
+    args = ap.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
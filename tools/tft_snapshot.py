@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""tft_snapshot.py - render the TFT screen on a PC and save it as a PNG.
+
+Builds build/tft_render.c (the renderer the firmware runs, with the panel size from
+build/tracker_config.h) into a shared library with the host C compiler, draws the
+given text and price series through it and writes the result tile by tile, so the
+image is exactly what the panel would receive. Also prints how many tiles and SPI
+bytes a price update costs: the second row is redrawn with --update and the tiles
+whose pixel hash changed are counted, as Tft_Poll() does.
+
+With --golden the snapshot is compared pixel for pixel against a PNG written earlier
+by this tool (exit status 1 on a difference), so renderer changes can be checked
+against reference images. --golden without a file checks the screens kept in
+tools/golden/ (the price screen, the alarm and the statistics page over a volatile
+week's chart, with the firmware's strings and the configured panel); --regolden
+rewrites them after an intended change.
+
+Usage:
+  python3 tools/tft_snapshot.py out.png
+  python3 tools/tft_snapshot.py out.png --line2 '$97,412 +1.25%' --prices prices.txt
+  python3 tools/tft_snapshot.py out.png --update '$97,415 +1.26%'
+  python3 tools/tft_snapshot.py out.png --golden ref.png
+  python3 tools/tft_snapshot.py --golden
+  python3 tools/tft_snapshot.py --regolden
+"""
+
+import argparse
+import ctypes
+import math
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+BUILD = os.path.join(ROOT, "build")
+GOLDEN = os.path.normpath(os.path.join(ROOT, "tools", "golden"))
+TILE = 16
+WINDOW_BYTES = 11  # CASET, RASET, RAMWR with their parameters (tft.c)
+
+
+def config():
+    """CFG_* integers and strings from tracker_config.h."""
+    cfg = {}
+    with open(os.path.join(BUILD, "tracker_config.h")) as f:
+        text = f.read()
+    for m in re.finditer(r"#define\s+(CFG_\w+)\s+(0x[0-9A-Fa-f]+|\d+)U?\b", text):
+        cfg[m.group(1)] = int(m.group(2), 0)
+    for m in re.finditer(r'#define\s+(CFG_STR_\w+)\s+"([^"]*)"', text):
+        cfg[m.group(1)] = m.group(2)
+    return cfg
+
+
+def build_renderer(tmp):
+    lib = os.path.join(tmp, "tft_render.so")
+    cc = os.environ.get("CC", "cc")
+    subprocess.check_call([cc, "-O2", "-shared", "-fPIC", "-I", BUILD, "-o", lib,
+                           os.path.join(BUILD, "tft_render.c")])
+    r = ctypes.CDLL(lib)
+    r.Tft_Scene_Size.restype = ctypes.c_uint32
+    r.Tft_Render_Tile.restype = ctypes.c_uint32
+    r.Tft_Render_Tile.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p]
+    r.Tft_Scene_Put.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_char]
+    r.Tft_Scene_Chart.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+    return r
+
+
+def put_line(r, scene, row, text, cols):
+    text = text[:cols].ljust(cols)
+    for col, ch in enumerate(text.encode("ascii", "replace")):
+        r.Tft_Scene_Put(scene, col, row, bytes([ch]))
+
+
+def chart_columns(prices, width):
+    """Column min/max of a series, like History_Chart() (empty columns repeat the left one)."""
+    lo = (ctypes.c_int32 * width)(*([0x7FFFFFFF] * width))
+    hi = (ctypes.c_int32 * width)(*([-0x7FFFFFFF] * width))
+    n = len(prices)
+    for c in range(width):
+        part = prices[n * c // width:max(n * (c + 1) // width, n * c // width + 1)] if n else []
+        if part:
+            lo[c], hi[c] = int(min(part)), int(max(part))
+        elif c > 0:
+            lo[c], hi[c] = lo[c - 1], hi[c - 1]
+    return lo, hi
+
+
+def demo_prices(n=288, seed=1):
+    """A day of 5-minute prices: a random walk with a gentle swing."""
+    rnd = random.Random(seed)
+    p, out = 96000.0, []
+    for i in range(n):
+        p += rnd.gauss(0, 60) + 40 * math.sin(i / 40.0)
+        out.append(p)
+    return out
+
+
+def week_prices(n=336, seed=2):
+    """A week of half-hourly prices with a crash and a recovery, for the chart's scaling."""
+    rnd = random.Random(seed)
+    p, out = 97000.0, []
+    for i in range(n):
+        p += rnd.gauss(0, 150) - (900 if 150 <= i < 160 else 0) + (120 if i >= 200 else 0)
+        out.append(p)
+    return out
+
+
+def screens(cfg):
+    """The golden screens: name -> (line1, line2, prices)."""
+    return {
+        "price": (cfg["CFG_STR_PRICE_LABEL"], "$97,412 +1.25%", demo_prices()),
+        "alarm": ("$97,412", cfg["CFG_STR_ALARM"], demo_prices()),
+        "chart": ("24h 95.1k-97.4k", "7d  88.0k-99.3k", week_prices()),
+    }
+
+
+def render(r, scene, tiles_x, tiles_y):
+    """All tiles: list of (hash, 512 bytes of big-endian RGB565)."""
+    buf = ctypes.create_string_buffer(TILE * TILE * 2)
+    out = []
+    for t in range(tiles_x * tiles_y):
+        h = r.Tft_Render_Tile(scene, t, buf)
+        out.append((h, buf.raw))
+    return out
+
+
+def to_rgb(tiles, w, h, tiles_x):
+    rows = []
+    for y in range(h):
+        row = bytearray()
+        for x in range(w):
+            t = (y // TILE) * tiles_x + x // TILE
+            o = ((y % TILE) * TILE + x % TILE) * 2
+            c = (tiles[t][1][o] << 8) | tiles[t][1][o + 1]
+            row += bytes((((c >> 11) & 31) * 255 // 31, ((c >> 5) & 63) * 255 // 63, (c & 31) * 255 // 31))
+        rows.append(bytes(row))
+    return rows
+
+
+def png_write(path, rows, w, h):
+    def chunk(kind, data):
+        return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", zlib.crc32(kind + data) & 0xFFFFFFFF)
+    raw = b"".join(b"\x00" + row for row in rows)
+    with open(path, "wb") as f:
+        f.write(b"\x89PNG\r\n\x1a\n")
+        f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", w, h, 8, 2, 0, 0, 0)))
+        f.write(chunk(b"IDAT", zlib.compress(raw, 9)))
+        f.write(chunk(b"IEND", b""))
+
+
+def png_read(path):
+    """Pixel rows of a PNG written by png_write (8-bit RGB, filter 0)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    pos, idat, w, h = 8, b"", 0, 0
+    while pos < len(data):
+        n, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + n]
+        if kind == b"IHDR":
+            w, h = struct.unpack(">II", body[:8])
+        elif kind == b"IDAT":
+            idat += body
+        pos += 12 + n
+    raw = zlib.decompress(idat)
+    stride = 1 + 3 * w
+    return [raw[y * stride + 1:(y + 1) * stride] for y in range(h)], w, h
+
+
+def draw(r, scene, line1, line2, prices, cols, w):
+    r.Tft_Scene_Init(scene)
+    put_line(r, scene, 0, line1, cols)
+    put_line(r, scene, 1, line2, cols)
+    r.Tft_Scene_Chart(scene, *chart_columns(prices, w))
+
+
+def compare(rows, w, h, golden):
+    """0 when 'rows' match the PNG 'golden' pixel for pixel, else 1 (and why)."""
+    if not os.path.exists(golden):
+        print("golden %s is missing (--regolden writes it)" % golden)
+        return 1
+    ref, rw, rh = png_read(golden)
+    if (rw, rh) != (w, h):
+        print("golden %s is %ux%u, snapshot is %ux%u" % (golden, rw, rh, w, h))
+        return 1
+    diff = sum(1 for y in range(h) for x in range(w) if rows[y][3 * x:3 * x + 3] != ref[y][3 * x:3 * x + 3])
+    if diff:
+        print("MISMATCH: %u pixels differ from %s" % (diff, golden))
+        return 1
+    print("matches %s" % golden)
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("png", nargs="?", help="output image")
+    ap.add_argument("--line1", default="BTC Price:", help="first text row")
+    ap.add_argument("--line2", default="$97,412 +1.25%", help="second text row")
+    ap.add_argument("--prices", help="price series, one USD value per line (default: a synthetic day)")
+    ap.add_argument("--update", help="second row after the next tick, to measure the cost of an update")
+    ap.add_argument("--golden", nargs="?", const="", help="reference PNG the snapshot must match "
+                    "(without a file: the screens in tools/golden/)")
+    ap.add_argument("--regolden", action="store_true", help="rewrite the screens in tools/golden/")
+    args = ap.parse_args()
+    named = args.regolden or args.golden == ""
+    if not named and not args.png:
+        ap.error("an output image is needed unless --golden or --regolden checks the named screens")
+
+    cfg = config()
+    w, h, cols = cfg["CFG_TFT_WIDTH"], cfg["CFG_TFT_HEIGHT"], cfg["CFG_LCD_COLS"]
+    tiles_x, tiles_y = (w + TILE - 1) // TILE, (h + TILE - 1) // TILE
+
+    if args.prices:
+        with open(args.prices) as f:
+            prices = [float(s) for s in f.read().split()]
+    else:
+        prices = demo_prices()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        r = build_renderer(tmp)
+        scene = ctypes.create_string_buffer(r.Tft_Scene_Size())
+        if named:
+            failed = 0
+            for name, (line1, line2, series) in screens(cfg).items():
+                draw(r, scene, line1, line2, series, cols, w)
+                rows = to_rgb(render(r, scene, tiles_x, tiles_y), w, h, tiles_x)
+                path = os.path.join(GOLDEN, "tft_%s.png" % name)
+                if args.regolden:
+                    os.makedirs(GOLDEN, exist_ok=True)
+                    png_write(path, rows, w, h)
+                    print("wrote %s" % path)
+                else:
+                    failed |= compare(rows, w, h, path)
+            return failed
+
+        draw(r, scene, args.line1, args.line2, prices, cols, w)
+        tiles = render(r, scene, tiles_x, tiles_y)
+        full = len(tiles) * (WINDOW_BYTES + TILE * TILE * 2)
+        print("%ux%u, %u tiles, full screen %u bytes" % (w, h, len(tiles), full))
+
+        if args.update:
+            put_line(r, scene, 1, args.update, cols)
+            r.Tft_Scene_Chart(scene, *chart_columns(prices + [prices[-1] * 1.0005], w))
+            after = render(r, scene, tiles_x, tiles_y)
+            changed = sum(1 for a, b in zip(tiles, after) if a[0] != b[0])
+            print("update: %u tiles changed, %u bytes (%.1f%% of a full redraw)"
+                  % (changed, changed * (WINDOW_BYTES + TILE * TILE * 2),
+                     100.0 * changed * (WINDOW_BYTES + TILE * TILE * 2) / full))
+            tiles = after
+
+    rows = to_rgb(tiles, w, h, tiles_x)
+    png_write(args.png, rows, w, h)
+    print("wrote %s" % args.png)
+    return compare(rows, w, h, args.golden) if args.golden else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
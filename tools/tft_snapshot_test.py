@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+"""tft_snapshot_test.py - the TFT renderer against the golden screens in tools/golden/.
+
+Runs tools/tft_snapshot.py --golden (price, alarm and statistics screens), and checks
+that a snapshot differing from its golden image by one glyph is reported as a
+mismatch.
+
+Usage:
+  python3 tools/tft_snapshot_test.py [-v]
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+TOOL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "tft_snapshot.py")
+
+
+def run(*args):
+    return subprocess.run([sys.executable, TOOL] + list(args), capture_output=True, text=True)
+
+
+class Golden(unittest.TestCase):
+    def test_screens_match(self):
+        out = run("--golden")
+        self.assertEqual(out.returncode, 0, out.stdout + out.stderr)
+        self.assertEqual(out.stdout.count("matches"), 3, out.stdout)
+
+    def test_mismatch_fails(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            golden = os.path.join(os.path.dirname(TOOL), "golden", "tft_price.png")
+            out = run(os.path.join(tmp, "s.png"), "--line2", "$97,413 +1.25%", "--golden", golden)
+        self.assertEqual(out.returncode, 1, out.stdout + out.stderr)
+        self.assertIn("MISMATCH", out.stdout)
+
+
+if __name__ == "__main__":
+    unittest.main()